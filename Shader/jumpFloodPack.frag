@@ -0,0 +1,21 @@
+// GLSL 3.3 Fragment Shader
+// Jump Flooding (Distance Transform) - Pack result
+
+#version 330
+
+// input format: see jumpFloodStep.frag
+// output format (FDTPixelPacked): xy = closest seed offset position, z = squared distance,
+// clamped to MAX_DISTANCE, w = contour index, always -1 (no contour)
+
+uniform sampler2DRect sImage;
+
+in vec2 vFragmentTexCoord;
+out ivec4 vResult;
+
+const float MAX_DISTANCE = 32767.0;
+
+void main()
+{
+	vec4 v = texture(sImage, gl_FragCoord.xy);
+	vResult = ivec4(int(v.x), int(v.y), int(min(v.z, MAX_DISTANCE)), -1);
+}
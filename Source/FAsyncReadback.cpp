@@ -0,0 +1,235 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FAsyncReadback.cpp
+//  Description		Implementation of class FAsyncReadback
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-23 11:12:47 +0200 (Fr, 23 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#include "FTrackMeStable.h"
+
+#include <cstring>
+#include "FStopWatch.h"
+
+#include "FAsyncReadback.h"
+#include "FMemoryTracer.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FAsyncReadback
+// ----------------------------------------------------------------------------------------------------
+
+// Constructors and destructor ------------------------------------------------------------------------
+
+FAsyncReadback::FAsyncReadback()
+: m_bufferSize(0),
+  m_firstPending(0),
+  m_pendingCount(0),
+  m_isMapped(false),
+  m_lastStallTime(0.0)
+{
+}
+
+FAsyncReadback::~FAsyncReadback()
+{
+	release();
+}
+
+// Public commands ------------------------------------------------------------------------------------
+
+bool FAsyncReadback::create(size_t bufferSize, size_t bufferCount /* = 2 */)
+{
+	F_ASSERT(bufferSize > 0 && bufferCount > 0);
+	release();
+
+	m_slots.resize(bufferCount);
+	m_bufferSize = bufferSize;
+
+	for (size_t i = 0; i < bufferCount; i++)
+	{
+		slot_t& slot = m_slots[i];
+		slot.fence = 0;
+		glGenBuffers(1, &slot.buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)bufferSize, NULL, GL_STREAM_READ);
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	F_GLERROR_ASSERT;
+	return true;
+}
+
+void FAsyncReadback::release()
+{
+	if (m_isMapped)
+		unmap();
+
+	while (m_pendingCount > 0)
+		discard();
+
+	for (size_t i = 0; i < m_slots.size(); i++)
+		glDeleteBuffers(1, &m_slots[i].buffer);
+
+	m_slots.clear();
+	m_bufferSize = 0;
+	m_firstPending = 0;
+}
+
+bool FAsyncReadback::readTexture(const FGLTextureRect& texture, GLenum format, GLenum type)
+{
+	slot_t* pSlot = _beginRead();
+	if (!pSlot)
+		return false;
+
+	// the texture unit 0 is left with the binding of the caller
+	GLint previousTexture = 0;
+	glActiveTexture(GL_TEXTURE0);
+	glGetIntegerv(GL_TEXTURE_BINDING_RECTANGLE, &previousTexture);
+
+	texture.bind(0);
+	glGetTexImage(GL_TEXTURE_RECTANGLE, 0, format, type, NULL);
+	glBindTexture(GL_TEXTURE_RECTANGLE, (GLuint)previousTexture);
+
+	_endRead(pSlot);
+	return true;
+}
+
+bool FAsyncReadback::readFramebuffer(const QSize& size, GLenum format, GLenum type)
+{
+	slot_t* pSlot = _beginRead();
+	if (!pSlot)
+		return false;
+
+	glReadPixels(0, 0, size.width(), size.height(), format, type, NULL);
+
+	_endRead(pSlot);
+	return true;
+}
+
+bool FAsyncReadback::finish(void* pData)
+{
+	F_ASSERT(pData);
+
+	const void* pBuffer = map();
+	if (!pBuffer)
+		return false;
+
+	memcpy(pData, pBuffer, m_bufferSize);
+	unmap();
+	return true;
+}
+
+const void* FAsyncReadback::map()
+{
+	F_ASSERT(!m_isMapped);
+	if (m_isMapped || m_pendingCount == 0)
+		return NULL;
+
+	FStopWatch stopWatch;
+	stopWatch.start();
+
+	slot_t* pSlot = _waitOldest();
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pSlot->buffer);
+	const void* pBuffer = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)m_bufferSize, GL_MAP_READ_BIT);
+	m_lastStallTime = stopWatch.stop();
+
+	if (!pBuffer)
+	{
+		fWarning("Async Readback", "Failed to map pixel pack buffer");
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		_releaseOldest();
+		return NULL;
+	}
+
+	m_isMapped = true;
+	return pBuffer;
+}
+
+void FAsyncReadback::unmap()
+{
+	F_ASSERT(m_isMapped && m_pendingCount > 0);
+	if (!m_isMapped)
+		return;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_slots[m_firstPending].buffer);
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	m_isMapped = false;
+	_releaseOldest();
+}
+
+void FAsyncReadback::discard()
+{
+	F_ASSERT(!m_isMapped);
+	if (m_isMapped || m_pendingCount == 0)
+		return;
+
+	slot_t& slot = m_slots[m_firstPending];
+	if (slot.fence)
+	{
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+	}
+
+	_releaseOldest();
+}
+
+// Internal functions ---------------------------------------------------------------------------------
+
+FAsyncReadback::slot_t* FAsyncReadback::_beginRead()
+{
+	F_ASSERT(isValid());
+	if (!isValid() || m_isMapped || m_pendingCount == m_slots.size())
+		return NULL;
+
+	slot_t* pSlot = &m_slots[(m_firstPending + m_pendingCount) % m_slots.size()];
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pSlot->buffer);
+	return pSlot;
+}
+
+void FAsyncReadback::_endRead(slot_t* pSlot)
+{
+	pSlot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	m_pendingCount++;
+
+	F_GLERROR_ASSERT;
+}
+
+FAsyncReadback::slot_t* FAsyncReadback::_waitOldest()
+{
+	slot_t* pSlot = &m_slots[m_firstPending];
+	if (!pSlot->fence)
+		return pSlot;
+
+	// the first wait flushes the command stream, so the fence is guaranteed to signal
+	GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+	while (true)
+	{
+		GLenum result = glClientWaitSync(pSlot->fence, flags, 100000000); // 100ms
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+			break;
+		if (result == GL_WAIT_FAILED)
+		{
+			fWarning("Async Readback", "Failed to wait for readback fence");
+			break;
+		}
+		flags = 0;
+	}
+
+	glDeleteSync(pSlot->fence);
+	pSlot->fence = 0;
+	return pSlot;
+}
+
+void FAsyncReadback::_releaseOldest()
+{
+	F_ASSERT(m_pendingCount > 0);
+	m_firstPending = (m_firstPending + 1) % m_slots.size();
+	m_pendingCount--;
+}
+
+// ----------------------------------------------------------------------------------------------------
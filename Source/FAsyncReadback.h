@@ -0,0 +1,114 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FAsyncReadback.h
+//  Description		Header file for FAsyncReadback.cpp
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-23 11:12:47 +0200 (Fr, 23 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#ifndef FASYNCREADBACK_H
+#define FASYNCREADBACK_H
+
+#include <vector>
+
+#include "FTrackMe.h"
+#include "FlowGLDefs.h"
+#include "FGLTextureRect.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FAsyncReadback
+// ----------------------------------------------------------------------------------------------------
+
+/// Asynchronous transfer of textures or framebuffer contents to host memory. A readback is
+/// issued into one of several pixel pack buffers and guarded by a fence, so the GPU copies
+/// the data while the caller continues with other work. finish() or map() retrieve the oldest
+/// pending readback and wait only if the GPU has not completed it yet. All functions must be
+/// called from the thread with the GL context current.
+class FAsyncReadback
+{
+	//  Constructors and destructor --------------------------------------------
+
+public:
+	/// Default Constructor.
+	FAsyncReadback();
+	/// Virtual destructor.
+	virtual ~FAsyncReadback();
+
+private:
+	FAsyncReadback(const FAsyncReadback& other);
+	FAsyncReadback& operator=(const FAsyncReadback& other);
+
+	//  Public commands --------------------------------------------------------
+
+public:
+	/// Creates the given number of pixel pack buffers, each of the given size in bytes.
+	/// Pending readbacks are discarded.
+	bool create(size_t bufferSize, size_t bufferCount = 2);
+	/// Deletes the pixel pack buffers. Pending readbacks are discarded.
+	void release();
+
+	/// Starts reading the given texture into the next free buffer.
+	/// Returns false if all buffers are pending. The texture binding of unit 0 is restored.
+	bool readTexture(const FGLTextureRect& texture, GLenum format, GLenum type);
+	/// Starts reading the given area of the currently bound read framebuffer into
+	/// the next free buffer. Returns false if all buffers are pending.
+	bool readFramebuffer(const QSize& size, GLenum format, GLenum type);
+
+	/// Waits for the oldest pending readback and copies its data to the given memory.
+	/// Returns false if no readback is pending.
+	bool finish(void* pData);
+	/// Waits for the oldest pending readback and maps its buffer for reading. The buffer
+	/// must be released with unmap() before issuing other GL commands. Returns NULL if
+	/// no readback is pending.
+	const void* map();
+	/// Unmaps the buffer mapped with map() and releases the readback.
+	void unmap();
+	/// Drops the oldest pending readback without waiting.
+	void discard();
+
+	//  Public queries ---------------------------------------------------------
+
+public:
+	/// Returns true if the buffers have been created.
+	bool isValid() const { return !m_slots.empty(); }
+	/// Returns the number of readbacks issued but not yet retrieved.
+	size_t pendingCount() const { return m_pendingCount; }
+	/// Returns the size of each buffer in bytes.
+	size_t bufferSize() const { return m_bufferSize; }
+
+	/// Returns the time in seconds spent waiting for the GPU in the last call
+	/// to finish() or map().
+	double lastStallTime() const { return m_lastStallTime; }
+
+	//  Internal types ---------------------------------------------------------
+
+private:
+	struct slot_t
+	{
+		GLuint buffer;
+		GLsync fence;
+	};
+
+	//  Internal functions -----------------------------------------------------
+
+private:
+	slot_t* _beginRead();
+	void _endRead(slot_t* pSlot);
+	slot_t* _waitOldest();
+	void _releaseOldest();
+
+	//  Internal data members --------------------------------------------------
+
+private:
+	std::vector<slot_t> m_slots;
+	size_t m_bufferSize;
+	size_t m_firstPending;
+	size_t m_pendingCount;
+	bool m_isMapped;
+	double m_lastStallTime;
+};
+
+// ----------------------------------------------------------------------------------------------------
+
+#endif // FASYNCREADBACK_H
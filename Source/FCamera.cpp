@@ -237,6 +237,37 @@ void FCamera::getProjectionGLSmooth(FMatrix4f& matPGL) const
 	_generateProjectionMatrixGL(matPGL, m_poseSmooth[m_frameIndex][6]);
 }
 
+void FCamera::getDerivativesMVPCurrent(FMatrix4f* pMatDerivMVP) const
+{
+	F_ASSERT(pMatDerivMVP);
+	const double* pParam = m_pose[m_frameIndex];
+
+	FMatrix4f matMV, matP, matD;
+	_generateModelViewMatrix(matMV, pParam);
+	_generateProjectionMatrix(matP, pParam[6]);
+
+	// translation: the derivative of the model-view matrix is a unit translation column
+	for (size_t i = 0; i < 3; i++)
+	{
+		matD.makeZero();
+		matD[i][3] = 1.0f;
+		pMatDerivMVP[i] = matP * matD;
+	}
+
+	// rotation (parameters are given in degrees)
+	for (size_t i = 0; i < 3; i++)
+	{
+		_generateRotationDerivative(matD, matMV, pParam, i);
+		pMatDerivMVP[3 + i] = matP * matD;
+	}
+
+	// focal distance: only the scaling terms of the projection depend on it
+	matD.makeZero();
+	matD[0][0] = (float)(m_imageSize.x() / m_apertureSize.x() / FD_MULTIPLIER);
+	matD[1][1] = (float)(m_imageSize.y() / m_apertureSize.y() / FD_MULTIPLIER);
+	pMatDerivMVP[6] = matD * matMV;
+}
+
 double FCamera::poseCurrent(size_t index)
 {
 	if (index == 6)
@@ -269,6 +300,57 @@ void FCamera::_generateModelViewMatrix(FMatrix4f& matMV, const double* pParam) c
 	matMV.setTranslation(translation);
 }
 
+void FCamera::_generateRotationDerivative(FMatrix4f& matDR, const FMatrix4f& matMV,
+										 const double* pParam, size_t axis) const
+{
+	// Derivative of the rotation matrix R = exp([v]x) with respect to the component v_i
+	// of the rotation vector: dR/dv_i = (v_i [v]x + [v x (I - R) e_i]x) R / |v|^2
+	// (Gallego and Yezzi, 2015). Reduces to [e_i]x R for a zero rotation.
+
+	const float d2r = 0.017453293f;
+	float v[3] = { (float)pParam[3] * d2r, (float)pParam[4] * d2r, (float)pParam[5] * d2r };
+	float theta2 = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+
+	float R[3][3];
+	for (size_t r = 0; r < 3; r++)
+		for (size_t c = 0; c < 3; c++)
+			R[r][c] = matMV[r][c];
+
+	float w[3];
+	if (theta2 < 1e-12f)
+	{
+		w[0] = w[1] = w[2] = 0.0f;
+		w[axis] = 1.0f;
+	}
+	else
+	{
+		// (I - R) e_i
+		float a[3] = { -R[0][axis], -R[1][axis], -R[2][axis] };
+		a[axis] += 1.0f;
+
+		// v x (I - R) e_i
+		float b[3] = {
+			v[1] * a[2] - v[2] * a[1],
+			v[2] * a[0] - v[0] * a[2],
+			v[0] * a[1] - v[1] * a[0] };
+
+		float invTheta2 = 1.0f / theta2;
+		for (size_t k = 0; k < 3; k++)
+			w[k] = (v[axis] * v[k] + b[k]) * invTheta2;
+	}
+
+	// skew-symmetric matrix [w]x, multiplied by R
+	float S[3][3] = {
+		{  0.0f, -w[2],  w[1] },
+		{  w[2],  0.0f, -w[0] },
+		{ -w[1],  w[0],  0.0f } };
+
+	matDR.makeZero();
+	for (size_t r = 0; r < 3; r++)
+		for (size_t c = 0; c < 3; c++)
+			matDR[r][c] = d2r * (S[r][0] * R[0][c] + S[r][1] * R[1][c] + S[r][2] * R[2][c]);
+}
+
 void FCamera::_generateProjectionMatrix(FMatrix4f& matProj, double focalDistance) const
 {
 	focalDistance /= FD_MULTIPLIER;
@@ -93,6 +93,11 @@ public:
 	void getProjectionSmooth(FMatrix4f& matP) const;
 	void getProjectionGLSmooth(FMatrix4f& matPGL) const;
 
+	/// Calculates the derivatives of the current model-view-projection matrix with respect
+	/// to the pose parameters (translation, rotation, focal distance). Expects an array of
+	/// NUM_PARAM matrices.
+	void getDerivativesMVPCurrent(FMatrix4f* pMatDerivMVP) const;
+
 	double poseCurrent(size_t index);
 	double poseSmooth(size_t index);
 
@@ -108,6 +113,8 @@ private:
 	void _generateModelViewMatrix(FMatrix4f& matMV, const double* pParam) const;
 	void _generateProjectionMatrix(FMatrix4f& matProj, double fovY) const;
 	void _generateProjectionMatrixGL(FMatrix4f& matProjGL, double fovY) const;
+	void _generateRotationDerivative(FMatrix4f& matDR, const FMatrix4f& matMV,
+		const double* pParam, size_t axis) const;
 
 	//  Internal data members --------------------------------------------------
 
@@ -121,8 +128,12 @@ private:
 	FVector3f m_rotation;
 	float m_focalDistance;
 
-	// Current pose and history
+public:
+	/// Number of pose parameters (translation, rotation, focal distance).
 	static const size_t NUM_PARAM = 7;
+
+private:
+	// Current pose and history
 	static const size_t HISTORY_SIZE = 12;
 	size_t m_frameIndex;
 
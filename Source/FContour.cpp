@@ -11,6 +11,7 @@
 
 #include "Eigen/Dense"
 #include "levmar.h"
+#include "FLevmarWorkspace.h"
 #include "FLevmarTermReason.h"
 #include "FlowGL.h"
 #include "FContour.h"
@@ -23,13 +24,51 @@
 // Constructors and destructor ------------------------------------------------------------------------
 
 FContour::FContour()
-: length(0),
+: pos(NULL),
+  length(0),
   m_isValid(false),
   m_isNormalized(false),
-  m_isClosed(true)
+  m_isClosed(true),
+  m_hasMoments(false)
 {
 }
 
+FContour::FContour(const FContour& other)
+: pos(NULL),
+  length(0)
+{
+	*this = other;
+}
+
+FContour& FContour::operator=(const FContour& other)
+{
+	if (this == &other)
+		return *this;
+
+	m_points.assign(other.pos, other.pos + other.length);
+	pos = m_points.empty() ? NULL : &m_points[0];
+	length = other.length;
+
+	m_isValid = other.m_isValid;
+	m_isNormalized = other.m_isNormalized;
+	m_isClosed = other.m_isClosed;
+	m_hasMoments = other.m_hasMoments;
+	m_index = other.m_index;
+
+	m_barycenter = other.m_barycenter;
+	m_boundingBox = other.m_boundingBox;
+	m_covariance = other.m_covariance;
+	m_orientation = other.m_orientation;
+
+	m_ellipse = other.m_ellipse;
+	m_quadCoords = other.m_quadCoords;
+	m_scale = other.m_scale;
+	m_translation = other.m_translation;
+	m_rotationAngle = other.m_rotationAngle;
+
+	return *this;
+}
+
 // Public commands ------------------------------------------------------------------------------------
 
 void FContour::clear()
@@ -37,7 +76,9 @@ void FContour::clear()
 	m_isValid = false;
 	m_isNormalized = false;
 	m_isClosed = true;
+	m_hasMoments = false;
 	
+	pos = NULL;
 	length = 0;
 }
 
@@ -45,35 +86,21 @@ void FContour::process(int imWidth, int imHeight)
 {
 	F_ASSERT(!m_isValid);
 	m_isNormalized = false;
-	F_ASSERT(length <= MAX_CONTOUR_LENGTH);
 
 	if (!m_isClosed)
 		return;
 
-	if (length < 75 || length == MAX_CONTOUR_LENGTH)
+	if (length < 75)
 		return;
 
-	// find mean and bounding box
+	// find mean, bounding box and second moments
+	if (!m_hasMoments)
+		_calculateMoments();
 
-	float minX = FLT_MAX;
-	float minY = FLT_MAX;
-	float maxX = 0.0f;
-	float maxY = 0.0f;
-	float meanX = 0.0f;
-	float meanY = 0.0f;
-
-	for (int i = 0; i < length; i++)
-	{
-		float x = pos[i].x();
-		meanX += x;
-		minX = fMin(minX, x);
-		maxX = fMax(maxX, x);
-
-		float y = pos[i].y();
-		meanY += y;
-		minY = fMin(minY, y);
-		maxY = fMax(maxY, y);
-	}
+	float minX = m_boundingBox.p0().x();
+	float minY = m_boundingBox.p0().y();
+	float maxX = m_boundingBox.p1().x();
+	float maxY = m_boundingBox.p1().y();
 
 	// reject if contour touches image bounds
 	if (minX < 2.0f || maxX >= imWidth - 2.0f || minY < 2.0f || maxY >= imHeight - 2.0f)
@@ -91,11 +118,6 @@ void FContour::process(int imWidth, int imHeight)
 	if (maxX - minX < 16.0f || maxY - minY < 16.0f)
 		return;
 
-	meanX /= (float)length;
-	meanY /= (float)length;
-	m_barycenter.set(meanX, meanY);
-	m_boundingBox.set(minX, minY, maxX, maxY);
-
 	_fitEllipse();
 	if (m_ellipse.radii().x() > imWidth || m_ellipse.radii().y() > imWidth)
 		return;
@@ -232,6 +254,50 @@ void FContour::drawToTexture(FGLTextureRect& texture, const QSize& textureSize)
 
 // Internal functions ---------------------------------------------------------------------------------
 
+void FContour::_setMoments(const FVector2f& mean, const FRect2f& boundingBox, const FVector3f& covariance)
+{
+	m_barycenter = mean;
+	m_boundingBox = boundingBox;
+	m_covariance = covariance;
+	m_hasMoments = true;
+}
+
+void FContour::_calculateMoments()
+{
+	float minX = FLT_MAX;
+	float minY = FLT_MAX;
+	float maxX = 0.0f;
+	float maxY = 0.0f;
+	double sumX = 0.0, sumY = 0.0, sumXX = 0.0, sumXY = 0.0, sumYY = 0.0;
+
+	for (int i = 0; i < length; i++)
+	{
+		float x = pos[i].x();
+		minX = fMin(minX, x);
+		maxX = fMax(maxX, x);
+
+		float y = pos[i].y();
+		minY = fMin(minY, y);
+		maxY = fMax(maxY, y);
+
+		sumX += x;
+		sumY += y;
+		sumXX += x * x;
+		sumXY += x * y;
+		sumYY += y * y;
+	}
+
+	double n = (double)fMax(length, 1);
+	double meanX = sumX / n;
+	double meanY = sumY / n;
+
+	m_barycenter.set((float)meanX, (float)meanY);
+	m_boundingBox.set(minX, minY, maxX, maxY);
+	m_covariance.set((float)(sumXX / n - meanX * meanX),
+		(float)(sumXY / n - meanX * meanY), (float)(sumYY / n - meanY * meanY));
+	m_hasMoments = true;
+}
+
 void FContour::_fitEllipse2()
 {
 	// Method: See http://cococubed.asu.edu/papers/conics/fitzgibbon_1999.pdf
@@ -312,17 +378,26 @@ void FContour::_fitEllipse2()
 
 void FContour::_fitEllipse()
 {
+	// start from the ellipse with the same second moments, the pixels of an ellipse
+	// outline have a variance of half the squared radius along each axis
+	float cxx = m_covariance.x();
+	float cxy = m_covariance.y();
+	float cyy = m_covariance.z();
+	float mid = 0.5f * (cxx + cyy);
+	float dev = sqrtf(0.25f * (cxx - cyy) * (cxx - cyy) + cxy * cxy);
+
 	m_ellipse.setCenter(m_barycenter);
-	m_ellipse.setRadii(m_boundingBox.size());
-	m_ellipse.setTiltAngle(0.0f);
+	m_ellipse.setRadii(FVector2f(fMax(sqrtf(2.0f * (mid + dev)), 1.0f),
+		fMax(sqrtf(2.0f * fMax(mid - dev, 0.0f)), 1.0f)));
+	m_ellipse.setTiltAngle(0.5f * atan2f(2.0f * cxy, cxx - cyy));
 
 	float deltaParams[] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
 	float opts[] = { 1e-2, 1e-17, 1e-17, 1e-17, 1e-2 }; // tau, eps1, eps2, eps3, delta
 	float lmInfo[LM_INFO_SZ];
-	float* pBuffer = FGlobalConstants::pLevmarDetectionWorkspace;
+	FLevmarWorkspace workspace(LM_DIF_WORKSZ(5, length), sizeof(float));
 
 	int iter = slevmar_dif(FContour::sLevmarUpdate,
-		deltaParams, NULL, 5, length, 80, opts, lmInfo, pBuffer, NULL, (void*)this, 0, 0.0);
+		deltaParams, NULL, 5, length, 80, opts, lmInfo, workspace.floatData(), NULL, (void*)this, 0, 0.0);
 
 	/*
 	F_TRACE(QString("Ellipse fit, contour #%0, it: %1, %2").arg(m_identity)
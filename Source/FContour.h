@@ -10,6 +10,8 @@
 #ifndef FCONTOUR_H
 #define FCONTOUR_H
 
+#include <vector>
+
 #include "FTrackMe.h"
 #include "FlowMath.h"
 
@@ -21,6 +23,8 @@ class FGLTextureRect;
 
 /// Holds a list of edge pixels belonging to the contour of a shape. Provides methods for
 /// fitting an ellipse to the contour and calculates various properties of the contour.
+/// The pixels of contours extracted by FContourFinder are stored in the point buffer of the
+/// finder and are valid until the next extraction. Copies store their pixels themselves.
 class FContour
 {
 	friend class FContourFinder;
@@ -28,8 +32,6 @@ class FContour
 	//  Static members ---------------------------------------------------------
 
 public:
-	static const size_t MAX_CONTOUR_LENGTH = 4096;
-
 	inline static void sLevmarUpdate(float* p, float* hx, int m, int n, void* pData) {
 		F_ASSERT(pData);
 		((FContour*)pData)->_levmarUpdate(p, hx, m, n);
@@ -37,13 +39,17 @@ public:
 
 	//  Public members ---------------------------------------------------------
 
-	FVector2f pos[MAX_CONTOUR_LENGTH];
+	FVector2f* pos;
 	int length;
 	
 	//  Constructors and destructor --------------------------------------------
 
 	/// Default constructor.
 	FContour();
+	/// Copy constructor, the copy owns its pixels.
+	FContour(const FContour& other);
+	/// Assignment operator, the pixels are copied to storage owned by this contour.
+	FContour& operator=(const FContour& other);
 
 	//  Public commands --------------------------------------------------------
 
@@ -99,6 +105,10 @@ public:
 
 private:
 	void _setIndex(quint32 id) { m_index = id; }
+	/// Sets the moments of the contour if they are already known, process() then skips
+	/// calculating them from the pixels.
+	void _setMoments(const FVector2f& mean, const FRect2f& boundingBox, const FVector3f& covariance);
+	void _calculateMoments();
 	void _fitEllipse2();
 	void _fitEllipse();
 	void _levmarUpdate(float* p, float* hx, int m, int n);
@@ -106,14 +116,18 @@ private:
 
 	//  Internal data members --------------------------------------------------
 
+	std::vector<FVector2f> m_points;	// pixels of copied contours
+
 	bool m_isValid;
 	bool m_isNormalized;
 	bool m_isClosed;
+	bool m_hasMoments;
 
 	quint32 m_index;
 
 	FVector2f m_barycenter;
 	FRect2f m_boundingBox;
+	FVector3f m_covariance;		// central second moments xx, xy, yy
 	FVector2f m_orientation;
 
 	FEllipse2f m_ellipse;
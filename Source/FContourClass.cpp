@@ -21,12 +21,14 @@
 
 FContourClass::FContourClass()
 : m_templateIndex(0),
-  m_pFrequency(NULL),
   m_classFrequency(0),
   m_numFerns(0),
   m_numBits(0),
   m_mseSum(0.0),
-  m_dpSum(0.0)
+  m_dpSum(0.0),
+  m_pFernTable(NULL),
+  m_tableColumn(0),
+  m_numTestsPerFern(0)
 {
 }
 
@@ -39,12 +41,12 @@ FContourClass::FContourClass(const FContour* pContour,
   m_numFerns(numFerns),
   m_numBits(numBits),
   m_mseSum(0.0),
-  m_dpSum(0.0)
+  m_dpSum(0.0),
+  m_pFernTable(NULL),
+  m_tableColumn(0)
 {
 	m_numTestsPerFern = (1 << m_numBits);
-	quint32 numTests = m_numFerns * m_numTestsPerFern;
-	m_pFrequency = new quint32[numTests];
-	memset(m_pFrequency, 0, numTests * sizeof(quint32));
+	m_histogram.reset(FFernTable::sRowCount(m_numFerns, m_numBits));
 
 	m_templateIndex = pContour->index();
 	m_template.createMaps(pContour);
@@ -55,7 +57,6 @@ FContourClass::FContourClass(const FContour* pContour,
 
 FContourClass::~FContourClass()
 {
-	F_SAFE_DELETE_ARRAY(m_pFrequency);
 }
 
 // Public commands ------------------------------------------------------------------------------------
@@ -85,12 +86,16 @@ void FContourClass::serialize(FArchive& ar)
 		ar >> m_mseSum;
 		ar >> m_dpSum;
 
+		// the legacy format stores numFerns * 2^numBits counts, only the first
+		// rows of the fern table are addressed by increment()
 		m_numTestsPerFern = (1 << m_numBits);
 		quint32 numTests = m_numFerns * m_numTestsPerFern;
-		F_SAFE_DELETE_ARRAY(m_pFrequency);
-		m_pFrequency = new quint32[numTests];
+		std::vector<quint32> frequency(numTests);
 		for (quint32 i = 0; i < numTests; i++)
-			ar >> m_pFrequency[i];
+			ar >> frequency[i];
+
+		size_t numBins = FFernTable::sRowCount(m_numFerns, m_numBits);
+		m_histogram.setCounts(&frequency[0], numBins);
 	}
 	else
 	{
@@ -109,13 +114,100 @@ void FContourClass::serialize(FArchive& ar)
 		ar << m_dpSum;
 
 		quint32 numTests = m_numFerns * m_numTestsPerFern;
+		std::vector<quint32> frequency(numTests, 0);
+		m_histogram.getCounts(&frequency[0]);
 		for (quint32 i = 0; i < numTests; i++)
-			ar << m_pFrequency[i];
+			ar << frequency[i];
+	}
+}
+
+void FContourClass::serializeInfo(FArchive& ar)
+{
+	if (ar.isReading())
+	{
+		ar >> m_matNKP;
+		ar >> m_templateIndex;
+		ar >> m_numFerns;
+		ar >> m_numBits;
+		ar >> m_classFrequency;
+		ar >> m_mseSum;
+		ar >> m_dpSum;
+
+		m_numTestsPerFern = (1 << m_numBits);
+	}
+	else
+	{
+		ar << m_matNKP;
+		ar << m_templateIndex;
+		ar << m_numFerns;
+		ar << m_numBits;
+		ar << m_classFrequency;
+		ar << m_mseSum;
+		ar << m_dpSum;
+	}
+}
+
+void FContourClass::serializeTemplate(FArchive& ar)
+{
+	m_template.serialize(ar);
+
+	if (ar.isReading())
+	{
+		F_ASSERT(!m_pFernTable);
+
+		ar >> m_matNKP;
+		ar >> m_templateIndex;
+		ar >> m_numFerns;
+		ar >> m_numBits;
+
+		m_numTestsPerFern = (1 << m_numBits);
+		m_histogram.reset(FFernTable::sRowCount(m_numFerns, m_numBits));
+		m_classFrequency = 0;
+		m_mseSum = 0.0;
+		m_dpSum = 0.0;
+	}
+	else
+	{
+		ar << m_matNKP;
+		ar << m_templateIndex;
+		ar << m_numFerns;
+		ar << m_numBits;
 	}
 }
 
+void FContourClass::attachData(const QSize& patchSize,
+							   const float* pDistanceMap,
+							   const FVector2f* pGradientMap,
+							   FFernHistogram::storage_t storage,
+							   const void* pFrequency,
+							   size_t entryCount)
+{
+	F_ASSERT(m_numTestsPerFern > 0);
+
+	m_template.attachMaps(patchSize, pDistanceMap, pGradientMap);
+	m_histogram.attach(storage, pFrequency, entryCount, FFernTable::sRowCount(m_numFerns, m_numBits));
+}
+
+void FContourClass::detachData()
+{
+	m_template.detachMaps();
+	m_histogram.detach();
+}
+
 // Public queries -------------------------------------------------------------------------------------
 
+double FContourClass::exactLogProbability(const quint32* pDescriptors) const
+{
+	// Laplace-smoothed posterior of each descriptor value, see FFernTable
+	double norm = -log((double)(m_classFrequency + m_numTestsPerFern));
+
+	double sum = 0.0;
+	for (quint32 f = 0; f < m_numFerns; f++)
+		sum += log((double)m_histogram.count(f * m_numBits + pDescriptors[f]) + 1.0) + norm;
+
+	return sum;
+}
+
 void FContourClass::dump(QDebug& debug) const
 {
 	debug.nospace() << "ID: " << m_templateIndex << ", Ferns: " << m_numFerns << ", Bits: " << m_numBits
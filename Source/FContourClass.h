@@ -17,6 +17,8 @@
 #include "FContourTemplate.h"
 #include "FContour.h"
 #include "FCameraPose.h"
+#include "FFernTable.h"
+#include "FFernHistogram.h"
 
 // ----------------------------------------------------------------------------------------------------
 //  Class FContourClass
@@ -24,6 +26,8 @@
 
 class FContourClass
 {
+	friend class FFernTable;
+
 	//  Constructors and destructor --------------------------------------------
 
 public:
@@ -45,6 +49,7 @@ public:
 	/// Adds the given descriptors to the class, updating it's posterior probability.
 	/// MSE is the mean square error from contour fitting, DP the Frobenius norm of the
 	/// delta pose (current contour against base contour template of class).
+	/// If the class is part of a fern table, the table is updated as well.
 	void increment(quint32* pDescriptors, double mse, double dp);
 
 	/// Sets the transformation of this class' contour template.
@@ -53,11 +58,32 @@ public:
 
 	/// Serialization
 	void serialize(FArchive& ar);
+	/// Serializes the class parameters only, without the template maps and frequency counts.
+	/// Used by the mapped database format, which stores these in separate sections.
+	void serializeInfo(FArchive& ar);
+	/// Serializes the template maps and transformation, the state of a class when it is created.
+	/// Reading resets the frequency counts. Used by the journal of the database.
+	void serializeTemplate(FArchive& ar);
+	/// Uses the given template maps and frequency counts without copying them, see
+	/// FFernHistogram::attach(). The memory must stay valid for the lifetime of the class.
+	/// The counts are copied on the first increment(). The class parameters must have been
+	/// read with serializeInfo() before.
+	void attachData(const QSize& patchSize, const float* pDistanceMap, const FVector2f* pGradientMap,
+		FFernHistogram::storage_t storage, const void* pFrequency, size_t entryCount);
+	/// Copies attached template maps and frequency counts to memory owned by the class.
+	void detachData();
 
 	//  Public queries ---------------------------------------------------------
 
 	/// Returns the probability of this class given the fern descriptors.
+	/// The class must be part of a fern table.
 	double probability(quint32* pDescriptors) const;
+	/// Returns the log-probability of this class given the fern descriptors.
+	/// The class must be part of a fern table.
+	float logProbability(quint32* pDescriptors) const;
+	/// Returns the log-probability of this class given the fern descriptors, calculated from
+	/// the frequency counts. Used to check the quantized values of the fern table.
+	double exactLogProbability(const quint32* pDescriptors) const;
 
 	/// Matches the given normalized contour pixels to the distance map of
 	/// this class by optimizing a homography warp. The function returns the
@@ -65,15 +91,25 @@ public:
 	/// pInfo[0]: MSE, pInfo[1]: PC covariance, pInfo[2]: determinant homography
 	void matchContour(const FContour* pNormalizedContour,
 		OUT FMatrix3f& homography, OUT float* pInfo = NULL) const;
+	/// Returns the mean squared error of the unwarped contour, see FContourTemplate::contourError().
+	float contourError(const FContour* pNormalizedContour) const;
 
 	/// Returns the id of the contour template.
 	quint32 templateIndex() const { return m_templateIndex; }
 	/// Returns the distance map and gradient map template.
 	const FContourTemplate& contourTemplate() const { return m_template; }
 
+	/// Returns the frequency counts, one bin per row of the fern table, see increment().
+	const FFernHistogram& histogram() const { return m_histogram; }
+
 	/// Returns the transformation of this class' contour template.
 	const FMatrix3f& matrixNKP() const { return m_matNKP; }
 	
+	/// Returns the number of ferns.
+	quint32 numFerns() const { return m_numFerns; }
+	/// Returns the number of bits per fern.
+	quint32 numBits() const { return m_numBits; }
+
 	/// Returns the total number of training samples for this class.
 	size_t sampleCount() const { return m_classFrequency; }
 	
@@ -88,11 +124,19 @@ public:
 	/// Writes information about the internal state to the given debug object.
 	void dump(QDebug& debug) const;
 
+	//  Internal functions -----------------------------------------------------
+
+private:
+	void _attachTable(FFernTable* pTable, size_t column) {
+		m_pFernTable = pTable;
+		m_tableColumn = column;
+	}
+
 	//  Internal data members --------------------------------------------------
 
 private:
 	FContourTemplate m_template;// distance and gradient map
-	quint32* m_pFrequency;		// classifier data
+	FFernHistogram m_histogram;	// classifier data
 	quint32 m_classFrequency;
 	quint32 m_numFerns;
 	quint32 m_numBits;
@@ -103,6 +147,9 @@ private:
 	double m_mseSum;			// sum of fitting mse (measure of fitting accuracy)
 	double m_dpSum;				// sum of pose differences (measure of pose variablility)
 
+	FFernTable* m_pFernTable;	// packed classifier data, owned by the database
+	size_t m_tableColumn;
+
 	// temporary
 	quint32 m_numTestsPerFern;
 };
@@ -120,10 +167,13 @@ inline void FContourClass::increment(quint32* pDescriptors, double mse, double d
 	{
 		quint32 d = pDescriptors[f];
 		F_ASSERT(d < (1 << m_numBits));
-		m_pFrequency[f * m_numBits + pDescriptors[f]]++;
+		m_histogram.increment(f * m_numBits + pDescriptors[f]);
 	}
 
 	m_classFrequency++;
+
+	if (m_pFernTable)
+		m_pFernTable->updateClass(this, pDescriptors);
 }
 
 inline void FContourClass::matchContour(const FContour* pNormalizedContour,
@@ -132,17 +182,20 @@ inline void FContourClass::matchContour(const FContour* pNormalizedContour,
 	m_template.matchContour(pNormalizedContour, homography, pInfo);
 }
 
+inline float FContourClass::contourError(const FContour* pNormalizedContour) const
+{
+	return m_template.contourError(pNormalizedContour);
+}
+
 inline double FContourClass::probability(quint32* pDescriptors) const
 {
-	double p = 1.0;
-	double r = 1.0 / ((double)(m_classFrequency + m_numTestsPerFern));
-	for (quint32 f = 0; f < m_numFerns; f++)
-	{
-		quint32 d = pDescriptors[f];
-		p *= ((double)m_pFrequency[f * m_numBits + pDescriptors[f]] + 1.0) * r;
-	}
+	return exp((double)logProbability(pDescriptors));
+}
 
-	return p;
+inline float FContourClass::logProbability(quint32* pDescriptors) const
+{
+	F_ASSERT(m_pFernTable);
+	return m_pFernTable->logProbability(m_tableColumn, pDescriptors);
 }
 	
 // ----------------------------------------------------------------------------------------------------
@@ -9,6 +9,14 @@
 
 #include "FTrackMeStable.h"
 
+#include <algorithm>
+#include <cstdio>
+#ifdef Q_OS_WIN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#endif
+
 #include "FContourDatabase.h"
 #include "FMemoryTracer.h"
 
@@ -16,6 +24,46 @@
 //  Class FContourDatabase
 // ----------------------------------------------------------------------------------------------------
 
+const char* FContourDatabase::FILE_MAGIC = "TRACKMEdatabase";
+const char* FContourDatabase::JOURNAL_MAGIC = "TRACKMEjournal";
+
+static inline quint64 sAlign(quint64 value, quint64 alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static inline void sWritePadding(QFile& file, qint64 position)
+{
+	qint64 count = position - file.pos();
+	if (count > 0)
+		file.write(QByteArray((int)count, '\0'));
+}
+
+/// Writes the data of the given open file through to the disk.
+static bool sSyncFile(QFile& file)
+{
+	if (!file.flush())
+		return false;
+#ifdef Q_OS_WIN
+	return FlushFileBuffers((HANDLE)_get_osfhandle(file.handle())) != 0;
+#else
+	return true;
+#endif
+}
+
+/// Replaces the target file with the source file in a single step, an existing
+/// target is either left intact or replaced completely.
+static bool sReplaceFile(const QString& sourcePath, const QString& targetPath)
+{
+#ifdef Q_OS_WIN
+	return MoveFileExW((LPCWSTR)QDir::toNativeSeparators(sourcePath).utf16(),
+		(LPCWSTR)QDir::toNativeSeparators(targetPath).utf16(),
+		MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return rename(QFile::encodeName(sourcePath).constData(), QFile::encodeName(targetPath).constData()) == 0;
+#endif
+}
+
 // Constructors and destructor ------------------------------------------------------------------------
 
 FContourDatabase::FContourDatabase()
@@ -25,7 +73,18 @@ FContourDatabase::FContourDatabase()
   m_patchSize(0, 0),
   m_pLastClass(NULL),
   m_warpErrorThreshold(2.0f),
-  m_isValid(false)
+  m_fitCandidateCount(8),
+  m_earlyExitEnabled(true),
+  m_isValid(false),
+  m_pMappedFile(NULL),
+  m_quantizationCheckEnabled(false),
+  m_journalingEnabled(false),
+  m_generation(0),
+  m_journalSize(0),
+  m_lastFitCount(0),
+  m_lastSkippedFitCount(0),
+  m_totalFitCount(0),
+  m_totalSkippedFitCount(0)
 {
 }
 
@@ -39,6 +98,15 @@ FContourDatabase::~FContourDatabase()
 bool FContourDatabase::insertContourPose(const FContourPatch& contourPatch,
 										 const FContour* pContour,
 										 const FCameraPose& cameraPose)
+{
+	return insertContourPose(contourPatch, pContour, cameraPose, candidateList_t(), 0);
+}
+
+bool FContourDatabase::insertContourPose(const FContourPatch& contourPatch,
+										 const FContour* pContour,
+										 const FCameraPose& cameraPose,
+										 const candidateList_t& candidates,
+										 size_t numSelected)
 {
 	F_ASSERT(isValid());
 	if (!isValid())
@@ -53,15 +121,13 @@ bool FContourDatabase::insertContourPose(const FContourPatch& contourPatch,
 	quint32 descriptor[MAX_FERNS];
 	contourPatch.getDescriptor(m_test, &descriptor[0]);
 
-	// match the contour against all classes of same contour type
-	FContourClass* pClass = _matchClass(pContour);
+	// match the contour against the candidate classes of same contour type
+	FContourClass* pClass = _matchClass(pContour, candidates, numSelected);
 	m_pLastClass = pClass;
 
 	// scale mse to compensate for patch scaling
 	// scaled mse is used only to compare against threshold
-	float templateArea = (float)(m_templateSize.width() * m_templateSize.height() * 0.25f);
-	float areaScale = fMax(1.0f, pContour->scale().x() * pContour->scale().y() * templateArea);
-	m_lastScaledMSE = m_lastMSE / areaScale;
+	m_lastScaledMSE = m_lastMSE / _areaScale(pContour);
 
 	// found matching class
 	if (m_lastScaledMSE < m_warpErrorThreshold)
@@ -89,6 +155,10 @@ bool FContourDatabase::insertContourPose(const FContourPatch& contourPatch,
 
 		// update posterior probability
 		pClass->increment(&descriptor[0], m_lastMSE, tDiff);
+
+		classList_t& classes = m_data[contourId];
+		size_t classIndex = std::find(classes.begin(), classes.end(), pClass) - classes.begin();
+		_addJournalEntry(JournalIncrement, contourId, classIndex, &descriptor[0], m_lastMSE, tDiff);
 		return false;
 	}
 
@@ -97,7 +167,11 @@ bool FContourDatabase::insertContourPose(const FContourPatch& contourPatch,
 	pClass->setTransform(matNKP);
 	pClass->increment(&descriptor[0], 0.0f, 0.0f);
 	m_data[contourId].push_back(pClass);
+	m_fernTable.addClass(pClass);
 
+	size_t classIndex = m_data[contourId].size() - 1;
+	_addJournalEntry(JournalInsertion, contourId, classIndex);
+	_addJournalEntry(JournalIncrement, contourId, classIndex, &descriptor[0]);
 	return true;
 }
 
@@ -158,6 +232,7 @@ void FContourDatabase::serialize(FArchive& ar)
 		size_t numContours;
 		ar >> numContours;
 		m_data.resize(numContours);
+		m_fernTable.reset(m_numFerns, m_numBits);
 
 		for (size_t i = 0; i < numContours; i++)
 		{
@@ -168,6 +243,7 @@ void FContourDatabase::serialize(FArchive& ar)
 				FContourClass* pClass = new FContourClass();
 				pClass->serialize(ar);
 				m_data[i].push_back(pClass);
+				m_fernTable.addClass(pClass);
 			}
 		}
 
@@ -208,10 +284,350 @@ void FContourDatabase::serialize(FArchive& ar)
 	}
 }
 
+bool FContourDatabase::load(const QString& filePath)
+{
+	QFile* pFile = new QFile(filePath);
+	if (!pFile->open(QIODevice::ReadOnly))
+	{
+		fWarning("Contour Database", QString("Failed to open database file: %1").arg(filePath));
+		delete pFile;
+		return false;
+	}
+
+	fileHeader_t header;
+	if (pFile->peek((char*)&header, sizeof(fileHeader_t)) == sizeof(fileHeader_t)
+		&& strncmp(header.magic, FILE_MAGIC, sizeof(header.magic)) == 0)
+	{
+		if (!_loadMapped(pFile))
+			return false;
+
+		m_journalBasePath = QFileInfo(filePath).canonicalFilePath();
+		_replayJournal(filePath);
+		return true;
+	}
+
+	// legacy format
+	FArchive ar(pFile, false);
+	serialize(ar);
+	delete pFile;
+
+	return m_isValid;
+}
+
+bool FContourDatabase::save(const QString& filePath)
+{
+	F_ASSERT(isValid());
+	if (!isValid())
+		return false;
+
+	// the mapped file can't be written while its data is in use
+	if (m_pMappedFile && QFileInfo(filePath).canonicalFilePath()
+		== QFileInfo(*m_pMappedFile).canonicalFilePath())
+		_detachMapping();
+
+	classList_t classes;
+	for (size_t i = 0; i < m_data.size(); i++)
+		classes.insert(classes.end(), m_data[i].begin(), m_data[i].end());
+
+	size_t numClasses = classes.size();
+	size_t numPixels = m_templateSize.width() * m_templateSize.height();
+
+	for (size_t i = 0; i < numClasses; i++)
+	{
+		if (classes[i]->contourTemplate().patchSize() != m_templateSize)
+		{
+			fWarning("Contour Database", "Failed to save database: template size mismatch");
+			return false;
+		}
+	}
+
+	QByteArray info;
+	QBuffer infoBuffer(&info);
+	infoBuffer.open(QIODevice::WriteOnly);
+	{
+		FArchive ar(&infoBuffer, false);
+		_serializeInfo(ar);
+	}
+	infoBuffer.close();
+
+	// histograms are stored sparse or dense, as chosen by each class
+	std::vector<histogramRecord_t> histograms(numClasses);
+	quint64 histogramSize = 0;
+	for (size_t i = 0; i < numClasses; i++)
+	{
+		const FFernHistogram& histogram = classes[i]->histogram();
+		histograms[i].offset = histogramSize;
+		histograms[i].storage = histogram.storage();
+		histograms[i].entryCount = (quint32)histogram.entryCount();
+		histogramSize = sAlign(histogramSize + histogram.byteSize(), ENTRY_ALIGNMENT);
+	}
+
+	// section layout
+	const quint32 numSections = 6;
+	fileSection_t sections[numSections];
+	memset(sections, 0, sizeof(sections));
+
+	sections[0].type = SectionInfo;
+	sections[0].size = info.size();
+	sections[1].type = SectionDistanceMaps;
+	sections[1].stride = (quint32)sAlign(numPixels * sizeof(float), ENTRY_ALIGNMENT);
+	sections[1].size = (quint64)sections[1].stride * numClasses;
+	sections[2].type = SectionGradientMaps;
+	sections[2].stride = (quint32)sAlign(numPixels * sizeof(FVector2f), ENTRY_ALIGNMENT);
+	sections[2].size = (quint64)sections[2].stride * numClasses;
+	sections[3].type = SectionHistogramIndex;
+	sections[3].stride = sizeof(histogramRecord_t);
+	sections[3].size = (quint64)sections[3].stride * numClasses;
+	sections[4].type = SectionHistograms;
+	sections[4].size = histogramSize;
+	sections[5].type = SectionCostTable;
+	sections[5].stride = (quint32)(sAlign(numClasses, 8) * sizeof(FFernTable::cost_t));
+	sections[5].size = (quint64)sections[5].stride * m_fernTable.rowCount();
+
+	quint64 offset = sAlign(sizeof(fileHeader_t) + sizeof(sections), FILE_ALIGNMENT);
+	for (quint32 s = 0; s < numSections; s++)
+	{
+		sections[s].offset = offset;
+		offset = sAlign(offset + sections[s].size, FILE_ALIGNMENT);
+	}
+
+	fileHeader_t header;
+	memset(&header, 0, sizeof(fileHeader_t));
+	strncpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+	header.version = FILE_VERSION;
+	header.byteOrder = 0x01020304;
+	header.sectionCount = numSections;
+	header.classCount = (quint32)numClasses;
+	header.fileSize = offset;
+	header.generation = ((quint64)QDateTime::currentDateTime().toTime_t() << 32) | (quint32)qrand();
+	if (header.generation == m_generation)
+		header.generation++;
+
+	// an interrupted save leaves the previous file and its journal intact, the complete
+	// temporary file replaces it in a single step; a remaining temporary file is incomplete
+	QFile file(filePath + ".tmp");
+	if (!file.open(QIODevice::WriteOnly))
+	{
+		fWarning("Contour Database", QString("Failed to create database file: %1").arg(filePath));
+		return false;
+	}
+
+	file.write((const char*)&header, sizeof(fileHeader_t));
+	file.write((const char*)sections, sizeof(sections));
+
+	sWritePadding(file, sections[0].offset);
+	file.write(info);
+
+	sWritePadding(file, sections[1].offset);
+	for (size_t i = 0; i < numClasses; i++)
+	{
+		file.write((const char*)classes[i]->contourTemplate().distanceMap(), numPixels * sizeof(float));
+		sWritePadding(file, sections[1].offset + (i + 1) * sections[1].stride);
+	}
+
+	sWritePadding(file, sections[2].offset);
+	for (size_t i = 0; i < numClasses; i++)
+	{
+		file.write((const char*)classes[i]->contourTemplate().gradientMap(), numPixels * sizeof(FVector2f));
+		sWritePadding(file, sections[2].offset + (i + 1) * sections[2].stride);
+	}
+
+	sWritePadding(file, sections[3].offset);
+	if (numClasses > 0)
+		file.write((const char*)&histograms[0], sections[3].size);
+
+	sWritePadding(file, sections[4].offset);
+	for (size_t i = 0; i < numClasses; i++)
+	{
+		const FFernHistogram& histogram = classes[i]->histogram();
+		sWritePadding(file, sections[4].offset + histograms[i].offset);
+		file.write((const char*)histogram.data(), histogram.byteSize());
+	}
+
+	// cost table, columns reordered from insertion order to database order
+	F_ASSERT(m_fernTable.classCount() == numClasses);
+	QHash<const FContourClass*, size_t> tableColumns;
+	for (size_t c = 0; c < m_fernTable.classCount(); c++)
+		tableColumns.insert(m_fernTable.classAt(c), c);
+
+	sWritePadding(file, sections[5].offset);
+	const FFernTable::cost_t* pTable = m_fernTable.tableData();
+	std::vector<FFernTable::cost_t> row(sections[5].stride / sizeof(FFernTable::cost_t), 0);
+	for (size_t r = 0; r < m_fernTable.rowCount() && !row.empty(); r++)
+	{
+		const FFernTable::cost_t* pRow = pTable + r * m_fernTable.stride();
+		for (size_t i = 0; i < numClasses; i++)
+			row[i] = pRow[tableColumns.value(classes[i])];
+		file.write((const char*)&row[0], sections[5].stride);
+	}
+
+	sWritePadding(file, header.fileSize);
+
+	if (file.error() != QFile::NoError || !sSyncFile(file))
+	{
+		fWarning("Contour Database", QString("Failed to write database file: %1").arg(filePath));
+		file.remove();
+		return false;
+	}
+
+	file.close();
+	if (!sReplaceFile(file.fileName(), filePath))
+	{
+		fWarning("Contour Database", QString("Failed to replace database file: %1").arg(filePath));
+		file.remove();
+		return false;
+	}
+
+	// the new generation makes a remaining journal stale
+	QFile::remove(journalFilePath(filePath));
+	m_journal.clear();
+	m_journalBasePath = QFileInfo(filePath).canonicalFilePath();
+	m_generation = header.generation;
+	m_journalSize = 0;
+
+	return true;
+}
+
+bool FContourDatabase::checkpoint(const QString& filePath)
+{
+	F_ASSERT(isValid());
+	if (!isValid())
+		return false;
+
+	QFileInfo fileInfo(filePath);
+	QString journalPath = journalFilePath(filePath);
+	if (m_generation == 0 || m_journalBasePath.isEmpty()
+		|| fileInfo.canonicalFilePath() != m_journalBasePath
+		|| QFileInfo(journalPath).size() * 2 > fileInfo.size())
+		return save(filePath);
+
+	if (m_journal.empty())
+		return true;
+
+	QFile file(journalPath);
+	if (!file.open(QIODevice::ReadWrite))
+	{
+		fWarning("Contour Database", QString("Failed to open journal file: %1").arg(journalPath));
+		return false;
+	}
+
+	// start a new journal if there is none for the current generation,
+	// otherwise drop what follows the last complete batch
+	journalHeader_t header;
+	if (m_journalSize < (qint64)sizeof(journalHeader_t)
+		|| file.read((char*)&header, sizeof(journalHeader_t)) != sizeof(journalHeader_t)
+		|| !_isJournalValid(header))
+	{
+		memset(&header, 0, sizeof(journalHeader_t));
+		strncpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+		header.version = JOURNAL_VERSION;
+		header.byteOrder = 0x01020304;
+		header.generation = m_generation;
+		header.numFerns = m_numFerns;
+		header.numBits = m_numBits;
+
+		file.resize(0);
+		file.seek(0);
+		file.write((const char*)&header, sizeof(journalHeader_t));
+		m_journalSize = sizeof(journalHeader_t);
+	}
+
+	file.resize(m_journalSize);
+	file.seek(m_journalSize);
+
+	QByteArray data;
+	QBuffer buffer(&data);
+	buffer.open(QIODevice::WriteOnly);
+	{
+		FArchive ar(&buffer, false);
+		for (size_t i = 0; i < m_journal.size(); i++)
+		{
+			const journalEntry_t& entry = m_journal[i];
+			quint32 type = entry.type;
+			ar << type;
+			ar << entry.contourIndex;
+			ar << entry.classIndex;
+
+			if (entry.type == JournalInsertion)
+			{
+				m_data[entry.contourIndex][entry.classIndex]->serializeTemplate(ar);
+			}
+			else
+			{
+				ar << entry.mse;
+				ar << entry.dp;
+				for (quint32 f = 0; f < m_numFerns; f++)
+					ar << entry.descriptor[f];
+			}
+		}
+	}
+	buffer.close();
+
+	journalBatch_t batch;
+	batch.marker = JOURNAL_BATCH_MARKER;
+	batch.entryCount = (quint32)m_journal.size();
+	batch.size = (quint32)data.size();
+	batch.checksum = qChecksum(data.constData(), (uint)data.size());
+
+	file.write((const char*)&batch, sizeof(journalBatch_t));
+	file.write(data);
+	file.flush();
+
+	// the entries are kept if writing fails, the next checkpoint overwrites the batch
+	if (file.error() != QFile::NoError)
+	{
+		fWarning("Contour Database", QString("Failed to write journal file: %1").arg(journalPath));
+		return false;
+	}
+
+	m_journalSize = file.pos();
+	m_journal.clear();
+	return true;
+}
+
+bool FContourDatabase::convert(const QString& sourceFilePath, const QString& targetFilePath)
+{
+	FContourDatabase database;
+	return database.load(sourceFilePath) && database.save(targetFilePath);
+}
+
+void FContourDatabase::resetQuantizationCheck()
+{
+	m_checkQueryCount = 0;
+	m_checkSameBestCount = 0;
+	m_checkSameCandidatesCount = 0;
+}
+
 // Public queries -------------------------------------------------------------------------------------
 
+void FContourDatabase::selectCandidates(const FContour* pContour, size_t numClasses,
+										OUT candidateList_t& candidates) const
+{
+	F_ASSERT(pContour->index() < m_data.size());
+	F_ASSERT(numClasses <= m_data[pContour->index()].size());
+
+	candidates.clear();
+	_addCandidates(pContour, 0, numClasses, candidates);
+}
+
+void FContourDatabase::fitCandidate(const FContour* pContour, classCandidate_t& candidate) const
+{
+	const FContourClass* pClass = m_data[pContour->index()][candidate.classIndex];
+
+	float info[3];
+	pClass->matchContour(pContour, candidate.homography, info);
+	candidate.meanSquareError = info[0];
+
+	// homography nearly singular
+	if (info[2] < 0.25f)
+		candidate.meanSquareError = 1000.0f;
+
+	candidate.isFitted = true;
+}
+
 void FContourDatabase::getBestClassCandidates(const FContourPatch& contourPatch,
-											  FContourClass** ppClassList) const
+											  FContourClass** ppClassList,
+											  size_t numCandidates /* = 3 */) const
 {
 	F_ASSERT(isValid());
 	if (!isValid())
@@ -219,7 +635,77 @@ void FContourDatabase::getBestClassCandidates(const FContourPatch& contourPatch,
 
 	quint32 descriptor[MAX_FERNS];
 	contourPatch.getDescriptor(m_test, &descriptor[0]);
-	return _getBestClassCandidates(&descriptor[0], ppClassList);
+	_getBestClassCandidates(&descriptor[0], ppClassList, numCandidates);
+
+	if (m_quantizationCheckEnabled)
+		_checkQuantization(&descriptor[0], ppClassList, numCandidates);
+}
+
+void FContourDatabase::getBestClassCandidates(const quint32* pDescriptors, size_t numQueries,
+											  size_t numCandidates, classScore_t* pResults) const
+{
+	F_ASSERT(isValid());
+	if (!isValid())
+		return;
+
+	m_fernTable.getBestClasses(pDescriptors, numQueries, numCandidates, pResults);
+
+	if (m_quantizationCheckEnabled && numCandidates > 0)
+	{
+		std::vector<FContourClass*> classList(numCandidates);
+		for (size_t q = 0; q < numQueries; q++)
+		{
+			for (size_t k = 0; k < numCandidates; k++)
+				classList[k] = pResults[q * numCandidates + k].pClass;
+			_checkQuantization(pDescriptors + q * m_numFerns, &classList[0], numCandidates);
+		}
+	}
+}
+
+void FContourDatabase::getBestClassCandidates(const FContourPatch* const* ppPatches, size_t numPatches,
+											  size_t numCandidates, classScore_t* pResults) const
+{
+	F_ASSERT(isValid());
+	if (!isValid() || numPatches == 0)
+		return;
+
+	std::vector<const float*> patchData(numPatches);
+	for (size_t i = 0; i < numPatches; i++)
+		patchData[i] = ppPatches[i]->data();
+
+	std::vector<quint32> descriptors(numPatches * m_numFerns);
+	m_test.getDescriptors(&patchData[0], numPatches, &descriptors[0]);
+	getBestClassCandidates(&descriptors[0], numPatches, numCandidates, pResults);
+}
+
+FContourDatabase::quantizationCheck_t FContourDatabase::quantizationCheck() const
+{
+	quantizationCheck_t check;
+	check.queryCount = (int)m_checkQueryCount;
+	check.sameBestCount = (int)m_checkSameBestCount;
+	check.sameCandidatesCount = (int)m_checkSameCandidatesCount;
+	return check;
+}
+
+size_t FContourDatabase::sparseHistogramCount() const
+{
+	size_t count = 0;
+	for (size_t c = 0; c < m_data.size(); c++)
+		for (classList_t::const_iterator it = m_data[c].begin(); it != m_data[c].end(); ++it)
+			if ((*it)->histogram().storage() == FFernHistogram::Sparse)
+				count++;
+
+	return count;
+}
+
+size_t FContourDatabase::histogramByteSize() const
+{
+	size_t size = 0;
+	for (size_t c = 0; c < m_data.size(); c++)
+		for (classList_t::const_iterator it = m_data[c].begin(); it != m_data[c].end(); ++it)
+			size += (*it)->histogram().byteSize();
+
+	return size;
 }
 
 size_t FContourDatabase::sampleCount(size_t index) const
@@ -286,6 +772,13 @@ void FContourDatabase::dump(QDebug& debug) const
 	debug << "\n   Patch size:    " << m_patchSize;
 	debug << "\n   #Ferns:        " << m_numFerns;
 	debug << "\n   #Bits:         " << m_numBits;
+	debug << "\n   Fern table:    " << m_fernTable.rowCount() << " rows, "
+		<< m_fernTable.byteSize() / 1024 << " KB";
+	debug << "\n   Histograms:    " << histogramByteSize() / 1024 << " KB, "
+		<< sparseHistogramCount() << " of " << totalClassCount() << " sparse";
+	debug << "\n   Fits:          " << m_totalFitCount << ", skipped: " << m_totalSkippedFitCount;
+	debug << "\n   Journal:       " << m_journalSize / 1024 << " KB, "
+		<< m_journal.size() << " pending entries";
 	debug << "\n";
 	debug << "\n   Contours:      " << m_data.size();
 	for (size_t i = 0; i < m_data.size(); i++)
@@ -314,41 +807,476 @@ void FContourDatabase::dump(QDebug& debug) const
 
 void FContourDatabase::_clear()
 {
+	// detach the classes from the table before deleting them
+	m_fernTable.reset(m_numFerns, m_numBits);
+
+	m_totalFitCount = 0;
+	m_totalSkippedFitCount = 0;
+
 	for (size_t c = 0; c < m_data.size(); c++)
 	{
 		for (classList_t::iterator it = m_data[c].begin(); it != m_data[c].end(); ++it)
 			F_SAFE_DELETE(*it);
 		m_data[c].clear();
 	}
+
+	// closing the file releases the mapping
+	F_SAFE_DELETE(m_pMappedFile);
+
+	m_journal.clear();
+	m_journalBasePath.clear();
+	m_generation = 0;
+	m_journalSize = 0;
 }
 
-FContourClass* FContourDatabase::_matchClass(const FContour* pContour)
+bool FContourDatabase::_serializeInfo(FArchive& ar)
 {
-	float minMSE = FLT_MAX;
-	FContourClass* pMinClass = NULL;
+	if (ar.isReading())
+	{
+		m_model.serialize(ar);
+
+		ar >> m_templateSize;
+		ar >> m_patchSize;
+		ar >> m_cameraMetrics;
+		ar >> m_numFerns;
+		ar >> m_numBits;
+		ar >> m_warpErrorThreshold;
+		ar >> m_trainingParameter;
+
+		// descriptors are held in arrays of MAX_FERNS on the stack, see create()
+		if (m_numFerns == 0 || m_numFerns >= MAX_FERNS || m_numBits == 0 || m_numBits >= MAX_BITS)
+			return false;
+
+		quint32 numContours;
+		ar >> numContours;
+		m_data.resize(numContours);
+
+		for (quint32 i = 0; i < numContours; i++)
+		{
+			quint32 numClasses;
+			ar >> numClasses;
+			for (quint32 j = 0; j < numClasses; j++)
+			{
+				FContourClass* pClass = new FContourClass();
+				pClass->serializeInfo(ar);
+				m_data[i].push_back(pClass);
+
+				if (pClass->numFerns() != m_numFerns || pClass->numBits() != m_numBits)
+					return false;
+			}
+		}
+
+		m_test.serialize(ar);
+		if (m_test.numFerns() != m_numFerns || m_test.numBits() != m_numBits)
+			return false;
+	}
+	else
+	{
+		m_model.serialize(ar);
+
+		ar << m_templateSize;
+		ar << m_patchSize;
+		ar << m_cameraMetrics;
+		ar << m_numFerns;
+		ar << m_numBits;
+		ar << m_warpErrorThreshold;
+		ar << m_trainingParameter;
+
+		quint32 numContours = (quint32)m_data.size();
+		ar << numContours;
+
+		for (quint32 i = 0; i < numContours; i++)
+		{
+			quint32 numClasses = (quint32)m_data[i].size();
+			ar << numClasses;
+			for (classList_t::iterator it = m_data[i].begin(); it != m_data[i].end(); ++it)
+				(*it)->serializeInfo(ar);
+		}
+
+		m_test.serialize(ar);
+	}
+
+	return true;
+}
+
+bool FContourDatabase::_loadMapped(QFile* pFile)
+{
+	_clear();
+	m_isValid = false;
+	m_pLastClass = NULL;
+
+	quint64 fileSize = (quint64)pFile->size();
+	const uchar* pData = pFile->map(0, fileSize);
+	const fileHeader_t* pHeader = (const fileHeader_t*)pData;
+	const fileSection_t* pSection[SectionTypeCount] = { NULL };
+
+	QString error;
+	if (!pData)
+		error = "failed to map file";
+	else if (fileSize < sizeof(fileHeader_t))
+		error = "file truncated";
+	else if (pHeader->version < MIN_FILE_VERSION || pHeader->version > FILE_VERSION)
+		error = QString("unsupported version %1").arg(pHeader->version);
+	else if (pHeader->byteOrder != 0x01020304)
+		error = "unsupported byte order";
+	else if (pHeader->fileSize != fileSize
+		|| sizeof(fileHeader_t) + (quint64)pHeader->sectionCount * sizeof(fileSection_t) > fileSize)
+		error = "file truncated";
+
+	if (error.isEmpty())
+	{
+		// unknown sections are skipped
+		const fileSection_t* pSections = (const fileSection_t*)(pData + sizeof(fileHeader_t));
+		for (quint32 s = 0; s < pHeader->sectionCount; s++)
+		{
+			const fileSection_t& section = pSections[s];
+			// checked without forming offset + size, which may overflow for a corrupt file
+			if (section.offset % FILE_ALIGNMENT != 0
+				|| section.offset > fileSize || section.size > fileSize - section.offset)
+			{
+				error = "invalid section";
+				break;
+			}
+
+			if (section.type >= SectionInfo && section.type < SectionTypeCount)
+				pSection[section.type] = &section;
+		}
+
+		// version 6 stores dense frequency counts instead of histograms
+		bool hasHistograms = pSection[SectionHistogramIndex] && pSection[SectionHistograms];
+		if (error.isEmpty() && (!pSection[SectionInfo] || !pSection[SectionDistanceMaps] || !pSection[SectionGradientMaps]
+			|| (!hasHistograms && !pSection[SectionFrequencies])))
+			error = "missing section";
+	}
+
+	if (error.isEmpty())
+	{
+		QByteArray info = QByteArray::fromRawData(
+			(const char*)pData + pSection[SectionInfo]->offset, (int)pSection[SectionInfo]->size);
+		QBuffer infoBuffer(&info);
+		infoBuffer.open(QIODevice::ReadOnly);
+		FArchive ar(&infoBuffer, false);
+		if (!_serializeInfo(ar))
+			error = "invalid fern configuration";
+	}
+
+	classList_t classes;
+	for (size_t i = 0; i < m_data.size(); i++)
+		classes.insert(classes.end(), m_data[i].begin(), m_data[i].end());
+
+	size_t numClasses = classes.size();
+	size_t numPixels = m_templateSize.width() * m_templateSize.height();
+	size_t numBins = error.isEmpty() ? FFernTable::sRowCount(m_numFerns, m_numBits) : 0;
+
+	size_t entrySize[SectionTypeCount] = { 0 };
+	entrySize[SectionDistanceMaps] = numPixels * sizeof(float);
+	entrySize[SectionGradientMaps] = numPixels * sizeof(FVector2f);
+	entrySize[SectionFrequencies] = numBins * sizeof(quint32);
+	entrySize[SectionHistogramIndex] = sizeof(histogramRecord_t);
+
+	if (error.isEmpty() && numClasses != pHeader->classCount)
+		error = "class count mismatch";
+
+	for (quint32 t = 0; t < SectionTypeCount && error.isEmpty(); t++)
+	{
+		const fileSection_t* pEntries = pSection[t];
+		if (pEntries && entrySize[t] > 0 && (pEntries->stride < entrySize[t]
+			|| pEntries->stride % sizeof(quint32) != 0
+			|| (quint64)pEntries->stride * numClasses > pEntries->size))
+			error = "invalid section";
+	}
+
+	// histogram locations, sparse entries are checked as they are small
+	std::vector<histogramRecord_t> histograms;
+	if (error.isEmpty() && pSection[SectionHistogramIndex])
+	{
+		const fileSection_t* pIndex = pSection[SectionHistogramIndex];
+		const fileSection_t* pHistograms = pSection[SectionHistograms];
+
+		for (size_t i = 0; i < numClasses && error.isEmpty(); i++)
+		{
+			histogramRecord_t record = *(const histogramRecord_t*)(pData + pIndex->offset + i * pIndex->stride);
+			FFernHistogram::storage_t storage = (FFernHistogram::storage_t)record.storage;
+
+			if ((storage != FFernHistogram::Sparse && storage != FFernHistogram::Dense)
+				|| (storage == FFernHistogram::Dense ? record.entryCount != numBins : record.entryCount > numBins)
+				|| record.offset % ENTRY_ALIGNMENT != 0
+				|| record.offset > pHistograms->size
+				|| FFernHistogram::sByteSize(storage, record.entryCount) > pHistograms->size - record.offset)
+			{
+				error = "invalid histogram";
+				break;
+			}
+
+			if (storage == FFernHistogram::Sparse)
+			{
+				const FFernHistogram::entry_t* pEntries =
+					(const FFernHistogram::entry_t*)(pData + pHistograms->offset + record.offset);
+				for (quint32 e = 0; e < record.entryCount; e++)
+					if (pEntries[e].bin >= numBins || (e > 0 && pEntries[e].bin <= pEntries[e - 1].bin))
+						error = "invalid histogram";
+			}
+
+			histograms.push_back(record);
+		}
+	}
+
+	if (!error.isEmpty())
+	{
+		fWarning("Contour Database", QString("Failed to load database file %1: %2")
+			.arg(pFile->fileName()).arg(error));
+		_clear();
+		delete pFile;
+		return false;
+	}
+
+	for (size_t i = 0; i < numClasses; i++)
+	{
+		const float* pDistanceMap = (const float*)(pData
+			+ pSection[SectionDistanceMaps]->offset + i * pSection[SectionDistanceMaps]->stride);
+		const FVector2f* pGradientMap = (const FVector2f*)(pData
+			+ pSection[SectionGradientMaps]->offset + i * pSection[SectionGradientMaps]->stride);
+
+		if (!histograms.empty())
+		{
+			classes[i]->attachData(m_templateSize, pDistanceMap, pGradientMap,
+				(FFernHistogram::storage_t)histograms[i].storage,
+				pData + pSection[SectionHistograms]->offset + histograms[i].offset, histograms[i].entryCount);
+		}
+		else
+		{
+			classes[i]->attachData(m_templateSize, pDistanceMap, pGradientMap, FFernHistogram::Dense,
+				pData + pSection[SectionFrequencies]->offset + i * pSection[SectionFrequencies]->stride, numBins);
+		}
+	}
+
+	// use the stored cost table if present, otherwise rebuild it from the frequency counts;
+	// the table of version 7 holds normalized costs and is rebuilt as well
+	m_fernTable.reset(m_numFerns, m_numBits);
+	const fileSection_t* pTable = (pHeader->version >= 8) ? pSection[SectionCostTable] : NULL;
+	size_t tableStride = pTable ? pTable->stride / sizeof(FFernTable::cost_t) : 0;
+
+	if (pTable && tableStride % 8 == 0 && tableStride >= numClasses
+		&& (quint64)pTable->stride * m_fernTable.rowCount() <= pTable->size)
+	{
+		m_fernTable.attachTable(classes, (const FFernTable::cost_t*)(pData + pTable->offset), tableStride);
+	}
+	else
+	{
+		for (size_t i = 0; i < numClasses; i++)
+			m_fernTable.addClass(classes[i]);
+	}
+
+	m_pMappedFile = pFile;
+	m_generation = pHeader->generation;
+	m_isValid = true;
+	return true;
+}
+
+void FContourDatabase::_detachMapping()
+{
+	if (!m_pMappedFile)
+		return;
+
+	for (size_t c = 0; c < m_data.size(); c++)
+		for (classList_t::iterator it = m_data[c].begin(); it != m_data[c].end(); ++it)
+			(*it)->detachData();
+
+	m_fernTable.detachTable();
+	F_SAFE_DELETE(m_pMappedFile);
+}
+
+void FContourDatabase::_addJournalEntry(journalEntryType_t type, size_t contourIndex, size_t classIndex,
+										const quint32* pDescriptor, double mse, double dp)
+{
+	// the journal can't reproduce changes that haven't been recorded
+	if (!m_journalingEnabled)
+	{
+		m_journal.clear();
+		m_journalBasePath.clear();
+		return;
+	}
+
+	journalEntry_t entry;
+	entry.type = type;
+	entry.contourIndex = (quint32)contourIndex;
+	entry.classIndex = (quint32)classIndex;
+	entry.mse = mse;
+	entry.dp = dp;
+
+	if (pDescriptor)
+		memcpy(entry.descriptor, pDescriptor, m_numFerns * sizeof(quint32));
+
+	m_journal.push_back(entry);
+}
+
+bool FContourDatabase::_isJournalValid(const journalHeader_t& header) const
+{
+	return strncmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) == 0
+		&& header.version == JOURNAL_VERSION
+		&& header.byteOrder == 0x01020304
+		&& header.generation == m_generation
+		&& header.numFerns == m_numFerns
+		&& header.numBits == m_numBits;
+}
+
+void FContourDatabase::_replayJournal(const QString& filePath)
+{
+	QFile file(journalFilePath(filePath));
+	if (!file.exists())
+		return;
+
+	journalHeader_t header;
+	if (!file.open(QIODevice::ReadOnly)
+		|| file.read((char*)&header, sizeof(journalHeader_t)) != sizeof(journalHeader_t)
+		|| m_generation == 0 || !_isJournalValid(header))
+	{
+		fWarning("Contour Database", QString("Ignoring journal not matching the database: %1")
+			.arg(file.fileName()));
+		return;
+	}
+
+	m_journalSize = sizeof(journalHeader_t);
+	size_t batchCount = 0;
+	size_t entryCount = 0;
+
+	// stops at a batch written incompletely, which is overwritten by the next checkpoint
+	while (!file.atEnd())
+	{
+		journalBatch_t batch;
+		if (file.read((char*)&batch, sizeof(journalBatch_t)) != sizeof(journalBatch_t)
+			|| batch.marker != JOURNAL_BATCH_MARKER || batch.size > file.size() - file.pos())
+			break;
+
+		QByteArray data = file.read(batch.size);
+		if (data.size() != (int)batch.size || qChecksum(data.constData(), (uint)data.size()) != batch.checksum)
+			break;
+
+		QBuffer buffer(&data);
+		buffer.open(QIODevice::ReadOnly);
+		FArchive ar(&buffer, false);
+
+		for (quint32 i = 0; i < batch.entryCount; i++)
+		{
+			if (!_replayJournalEntry(ar))
+			{
+				// the state doesn't match the journal anymore, the next checkpoint compacts
+				fWarning("Contour Database", QString("Invalid entry in journal: %1").arg(file.fileName()));
+				m_journalBasePath.clear();
+				return;
+			}
+		}
+
+		m_journalSize = file.pos();
+		batchCount++;
+		entryCount += batch.entryCount;
+	}
+
+	fInfo("Contour Database", QString("Journal replayed: %1 batches, %2 entries")
+		.arg(batchCount).arg(entryCount));
+}
+
+bool FContourDatabase::_replayJournalEntry(FArchive& ar)
+{
+	quint32 type, contourIndex, classIndex;
+	ar >> type;
+	ar >> contourIndex;
+	ar >> classIndex;
+
+	if (contourIndex >= m_data.size())
+		return false;
+
+	classList_t& classes = m_data[contourIndex];
+
+	if (type == JournalInsertion)
+	{
+		if (classIndex != classes.size())
+			return false;
+
+		FContourClass* pClass = new FContourClass();
+		pClass->serializeTemplate(ar);
+		if (pClass->templateIndex() != contourIndex || pClass->contourTemplate().patchSize() != m_templateSize)
+		{
+			delete pClass;
+			return false;
+		}
+
+		classes.push_back(pClass);
+		m_fernTable.addClass(pClass);
+		return true;
+	}
+
+	if (type == JournalIncrement)
+	{
+		double mse, dp;
+		ar >> mse;
+		ar >> dp;
+
+		quint32 descriptor[MAX_FERNS];
+		for (quint32 f = 0; f < m_numFerns; f++)
+		{
+			ar >> descriptor[f];
+			if (descriptor[f] >= (1u << m_numBits))
+				return false;
+		}
+
+		if (classIndex >= classes.size())
+			return false;
+
+		classes[classIndex]->increment(&descriptor[0], mse, dp);
+		return true;
+	}
 
+	return false;
+}
+
+FContourClass* FContourDatabase::_matchClass(const FContour* pContour,
+											 const candidateList_t& candidates,
+											 size_t numSelected)
+{
 	quint32 cId = pContour->index();
 	F_ASSERT(cId < m_data.size());
+	F_ASSERT(numSelected <= m_data[cId].size());
 
-	for (classList_t::const_iterator it = m_data[cId].begin(); it != m_data[cId].end(); ++it)
-	{
-		float info[3];
-		FMatrix3f homography;
-		(*it)->matchContour(pContour, homography, info);
-		float mse = info[0];
+	// add candidates for the classes created after the given ones were selected
+	size_t numClasses = m_data[cId].size();
+	candidateList_t fitList = candidates;
+	_addCandidates(pContour, numSelected, numClasses, fitList);
 
-		// homography nearly singular
-		if (info[2] < 0.25f)
-			mse = 1000.0f;
+	size_t numFits = 0;
+	for (size_t i = 0; i < candidates.size(); i++)
+		numFits += candidates[i].isFitted ? 1 : 0;
 
-		if (mse < minMSE)
+	float minMSE = FLT_MAX;
+	FContourClass* pMinClass = NULL;
+	float areaScale = _areaScale(pContour);
+
+	for (size_t i = 0; i < fitList.size(); i++)
+	{
+		classCandidate_t& candidate = fitList[i];
+		if (!candidate.isFitted)
+		{
+			fitCandidate(pContour, candidate);
+			numFits++;
+		}
+
+		if (candidate.meanSquareError < minMSE)
 		{
-			minMSE = mse;
-			m_lastHomography = homography;
-			pMinClass = *it;
+			minMSE = candidate.meanSquareError;
+			m_lastHomography = candidate.homography;
+			pMinClass = m_data[cId][candidate.classIndex];
 		}
+
+		// same criterion as for accepting the match in insertContourPose
+		if (m_earlyExitEnabled && minMSE < 1000.0f && minMSE / areaScale < m_warpErrorThreshold)
+			break;
 	}
 
+	m_lastFitCount = numFits;
+	m_lastSkippedFitCount = numClasses - fMin(numFits, numClasses);
+	m_totalFitCount += m_lastFitCount;
+	m_totalSkippedFitCount += m_lastSkippedFitCount;
+
 	if (minMSE < 1000.0f)
 	{
 		m_lastMSE= minMSE;
@@ -362,42 +1290,85 @@ FContourClass* FContourDatabase::_matchClass(const FContour* pContour)
 	return pMinClass;
 }
 
-void FContourDatabase::_getBestClassCandidates(quint32* pDescriptor, OUT FContourClass** ppClassList) const
+void FContourDatabase::_addCandidates(const FContour* pContour, size_t firstClass, size_t lastClass,
+									  candidateList_t& candidates) const
+{
+	if (firstClass >= lastClass)
+		return;
+
+	const classList_t& classes = m_data[pContour->index()];
+	bool usePrefilter = (m_fitCandidateCount > 0);
+
+	for (size_t i = firstClass; i < lastClass; i++)
+	{
+		classCandidate_t candidate;
+		candidate.classIndex = i;
+		candidate.coarseError = usePrefilter ? classes[i]->contourError(pContour) : 0.0f;
+		candidates.push_back(candidate);
+	}
+
+	// fitting order: lowest unwarped error first, on equal errors the earlier class
+	if (usePrefilter)
+	{
+		std::sort(candidates.begin(), candidates.end(), sCandidateOrder);
+		if (candidates.size() > m_fitCandidateCount)
+			candidates.resize(m_fitCandidateCount);
+	}
+}
+
+float FContourDatabase::_areaScale(const FContour* pContour) const
+{
+	float templateArea = (float)(m_templateSize.width() * m_templateSize.height() * 0.25f);
+	return fMax(1.0f, pContour->scale().x() * pContour->scale().y() * templateArea);
+}
+
+void FContourDatabase::_getBestClassCandidates(quint32* pDescriptor,
+											   OUT FContourClass** ppClassList,
+											   size_t numCandidates) const
 {
 	F_ASSERT(ppClassList);
+	m_fernTable.getBestClasses(pDescriptor, numCandidates, ppClassList);
+}
 
-	for (int i = 0; i < 3; i++)
-		ppClassList[i] = NULL;
+void FContourDatabase::_checkQuantization(const quint32* pDescriptor,
+										  FContourClass* const* ppClassList,
+										  size_t numCandidates) const
+{
+	if (numCandidates == 0)
+		return;
 
-	double p1 = 0.0;
-	double p2 = 0.0;
-	double p3 = 0.0;
+	// same selection as FFernTable::getBestClasses, on exact log-probabilities
+	std::vector<double> best(numCandidates, -DBL_MAX);
+	std::vector<const FContourClass*> exactList(numCandidates, (const FContourClass*)NULL);
 
-	for (size_t c = 0; c < m_data.size(); c++)
+	for (size_t c = 0; c < m_fernTable.classCount(); c++)
 	{
-		for (classList_t::const_iterator it = m_data[c].begin(); it != m_data[c].end(); ++it)
+		const FContourClass* pClass = m_fernTable.classAt(c);
+		double p = pClass->exactLogProbability(pDescriptor);
+		if (p <= best[numCandidates - 1])
+			continue;
+
+		size_t k = numCandidates - 1;
+		for (; k > 0 && p > best[k - 1]; k--)
 		{
-			double p = (*it)->probability(pDescriptor);
-			if (p > p1)
-			{
-				ppClassList[2] = ppClassList[1];
-				ppClassList[1] = ppClassList[0];
-				ppClassList[0] = *it;
-				p3 = p2; p2 = p1; p1 = p;
-			}
-			else if (p > p2)
-			{
-				ppClassList[2] = ppClassList[1];
-				ppClassList[1] = *it;
-				p3 = p2; p2 = p;
-			}
-			else if (p > p3)
-			{
-				ppClassList[2] = *it;
-				p3 = p;
-			}
+			best[k] = best[k - 1];
+			exactList[k] = exactList[k - 1];
 		}
+
+		best[k] = p;
+		exactList[k] = pClass;
 	}
+
+	bool sameCandidates = true;
+	for (size_t k = 0; k < numCandidates; k++)
+		if (std::find(ppClassList, ppClassList + numCandidates, exactList[k]) == ppClassList + numCandidates)
+			sameCandidates = false;
+
+	m_checkQueryCount.ref();
+	if (exactList[0] == ppClassList[0])
+		m_checkSameBestCount.ref();
+	if (sameCandidates)
+		m_checkSameCandidatesCount.ref();
 }
 
 void FContourDatabase::_buildMatrixNKP(const FCameraPose& cameraPose,
@@ -22,6 +22,7 @@
 #include "FContourPatch.h"
 #include "FContour.h"
 #include "FFernTest.h"
+#include "FFernTable.h"
 
 // ----------------------------------------------------------------------------------------------------
 //  Class FContourDatabase
@@ -32,6 +33,9 @@ class FContourDatabase
 	//  Private types ----------------------------------------------------------
 
 private:
+	static const quint32 MAX_FERNS = 64;
+	static const quint32 MAX_BITS = 32;
+
 	struct hDecomp_t
 	{
 		FVector3f translation[2];
@@ -39,6 +43,124 @@ private:
 		FVector3f normal[2];
 	};
 
+	/// Header of a mapped database file, followed by sectionCount entries of fileSection_t.
+	/// All values are stored in the byte order of the machine that wrote the file.
+	struct fileHeader_t
+	{
+		char magic[16];
+		quint32 version;
+		quint32 byteOrder;
+		quint32 sectionCount;
+		quint32 classCount;
+		quint64 fileSize;
+		quint64 generation;		// changes with every save, identifies the base of a journal
+		quint32 reserved[4];
+	};
+
+	/// Section of a mapped database file. Sections start at multiples of FILE_ALIGNMENT.
+	/// Sections with per-class data store the classes in database order, each entry
+	/// starting at a multiple of stride bytes from the section start.
+	struct fileSection_t
+	{
+		quint32 type;
+		quint32 stride;
+		quint64 offset;
+		quint64 size;
+		quint64 reserved;
+	};
+
+	/// Location of the frequency counts of a class in the histogram section.
+	struct histogramRecord_t
+	{
+		quint64 offset;			// from the section start, a multiple of ENTRY_ALIGNMENT
+		quint32 storage;		// FFernHistogram::storage_t
+		quint32 entryCount;
+	};
+
+	enum sectionType_t
+	{
+		SectionInfo = 1,		// FArchive: model, parameters, class parameters, fern tests
+		SectionDistanceMaps,	// per class: float[templateSize]
+		SectionGradientMaps,	// per class: FVector2f[templateSize]
+		SectionFrequencies,		// version 6 only, per class: quint32[numFerns * 2^numBits]
+		SectionFernTable,		// version 6 only, float[rowCount][stride]
+		SectionHistogramIndex,	// per class: histogramRecord_t
+		SectionHistograms,		// per class: FFernHistogram data, see histogramRecord_t
+		SectionCostTable,		// FFernTable::cost_t[rowCount][stride], columns in database order,
+								// log-counts since version 8, negated log-probabilities before
+		SectionTypeCount
+	};
+
+	/// Header of a journal file, followed by the batches appended by checkpoint().
+	/// The journal only applies to the database file with the same generation.
+	struct journalHeader_t
+	{
+		char magic[16];
+		quint32 version;
+		quint32 byteOrder;
+		quint64 generation;
+		quint32 numFerns;
+		quint32 numBits;
+		quint32 reserved[2];
+	};
+
+	/// Header of a journal batch, followed by size bytes of FArchive data holding entryCount
+	/// entries. Batches with a wrong checksum have been written incompletely and are dropped.
+	struct journalBatch_t
+	{
+		quint32 marker;
+		quint32 entryCount;
+		quint32 size;
+		quint32 checksum;		// qChecksum() of the data
+	};
+
+	enum journalEntryType_t
+	{
+		JournalInsertion = 1,	// class template and transformation, see FContourClass::serializeTemplate()
+		JournalIncrement		// mse, dp and descriptors, see FContourClass::increment()
+	};
+
+	/// Change of the database since the last checkpoint. Classes are identified by their
+	/// index within the classes of their contour, as classes are never removed or reordered.
+	struct journalEntry_t
+	{
+		journalEntryType_t type;
+		quint32 contourIndex;
+		quint32 classIndex;
+		double mse;
+		double dp;
+		quint32 descriptor[MAX_FERNS];
+	};
+
+	//  Public types -----------------------------------------------------------
+
+public:
+	/// Class to be fitted to a contour during insertion, see selectCandidates().
+	struct classCandidate_t
+	{
+		classCandidate_t() : classIndex(0), coarseError(0.0f),
+			isFitted(false), meanSquareError(FLT_MAX) { homography.makeZero(); }
+
+		size_t classIndex;
+		float coarseError;
+		bool isFitted;
+		FMatrix3f homography;
+		float meanSquareError;
+	};
+
+	typedef std::vector<classCandidate_t> candidateList_t;
+
+	/// Class returned by a batch classification and its log-probability.
+	typedef FFernTable::classScore_t classScore_t;
+
+	/// Agreement of the fern table with the exact log-probabilities, see setQuantizationCheckEnabled().
+	struct quantizationCheck_t
+	{
+		size_t queryCount;
+		size_t sameBestCount;
+		size_t sameCandidatesCount;
+	};
+
 	//  Constructors and destructor --------------------------------------------
 
 public:
@@ -64,19 +186,75 @@ public:
 	/// Otherwise, a new contour-pose template class is created and true is returned.
 	bool insertContourPose(const FContourPatch& contourPatch,
 		const FContour* pContour, const FCameraPose& pose);
+	/// Same as above, but the candidates among the first numSelected classes of the contour's
+	/// type have already been selected with selectCandidates() and possibly been fitted with
+	/// fitCandidate(). Used to run the expensive fits of a training batch in parallel.
+	bool insertContourPose(const FContourPatch& contourPatch,
+		const FContour* pContour, const FCameraPose& pose,
+		const candidateList_t& candidates, size_t numSelected);
 
 	/// Sets the squared error threshold that must be exceeded for a new class to be insert.
 	void setWarpErrorThreshold(float mseThreshold) { m_warpErrorThreshold = mseThreshold; }
+	/// Sets the number of classes with the lowest unwarped error that are fitted
+	/// during insertion. If set to 0, all classes are fitted.
+	void setFitCandidateCount(size_t count) { m_fitCandidateCount = count; }
+	/// If enabled, the fitting stops at the first class with an error below the threshold.
+	void setEarlyExitEnabled(bool enabled) { m_earlyExitEnabled = enabled; }
 	/// Sets the parameters used for training. This includes the params in serialization.
 	void setTrainingParameter(const FTrainingParameter& param) { m_trainingParameter = param; }
-
-	/// Serialization.
+	/// If enabled, getBestClassCandidates() also ranks all classes by the exact log-probabilities
+	/// calculated from the frequency counts and compares the result with the classes selected
+	/// from the quantized fern table. This is slow and meant for testing only.
+	void setQuantizationCheckEnabled(bool enabled) { m_quantizationCheckEnabled = enabled; }
+	/// Resets the results of the quantization check.
+	void resetQuantizationCheck();
+	/// If enabled, insertions and increments are recorded until they are appended to the
+	/// journal with checkpoint(). Changes made while disabled invalidate the journal.
+	void setJournalingEnabled(bool enabled) { m_journalingEnabled = enabled; }
+
+	/// Serialization in the legacy format (TRACKMEdatabase5).
 	void serialize(FArchive& ar);
 
+	/// Loads the database from the given file. A file in the mapped format is memory mapped and
+	/// its templates, frequency counts and fern table are used without copying; the mapping is
+	/// kept until the database is cleared. Data of mapped classes is copied when they are trained.
+	/// A file in the legacy format is imported with serialize().
+	bool load(const QString& filePath);
+	/// Saves the database in the mapped format. The file is written under a temporary name
+	/// and replaces the existing file when complete. A journal of the file is removed.
+	bool save(const QString& filePath);
+	/// Appends the changes since the last save or checkpoint to the journal of the given file.
+	/// The database is compacted instead, i.e. saved completely and the journal removed, if the
+	/// journal doesn't extend the file to the current state, or has grown beyond half of its size.
+	/// load() replays the journal.
+	bool checkpoint(const QString& filePath);
+	/// Converts the given database file to the mapped format.
+	static bool convert(const QString& sourceFilePath, const QString& targetFilePath);
+
 	//  Public queries ---------------------------------------------------------
 
-	/// Returns the three most probable classes given the normalized distance map.
-	void getBestClassCandidates(const FContourPatch& contourPatch, OUT FContourClass** ppClassList) const;
+	/// Returns the most probable classes given the normalized distance map, most probable first.
+	/// ppClassList must have room for numCandidates entries, unused entries are set to NULL.
+	void getBestClassCandidates(const FContourPatch& contourPatch,
+		OUT FContourClass** ppClassList, size_t numCandidates = 3) const;
+	/// Classifies a batch of descriptors with a single pass over the fern table. pDescriptors
+	/// holds numFerns() descriptors per query, as returned by FFernTest::getDescriptors(). The
+	/// numCandidates most probable classes of query i are written to pResults[i * numCandidates],
+	/// most probable first, unused entries have a NULL class. Only reads the database and can be
+	/// called concurrently, as long as the database is not trained or loaded at the same time.
+	void getBestClassCandidates(const quint32* pDescriptors, size_t numQueries,
+		size_t numCandidates, OUT classScore_t* pResults) const;
+	/// Same as above, using the descriptors of the given patches.
+	void getBestClassCandidates(const FContourPatch* const* ppPatches, size_t numPatches,
+		size_t numCandidates, OUT classScore_t* pResults) const;
+
+	/// Selects the classes among the first numClasses classes of the contour's type to be
+	/// fitted during insertion, in fitting order. These are the classes with the lowest unwarped
+	/// error, or all classes if the fit candidate count is 0. Can be called concurrently.
+	void selectCandidates(const FContour* pContour, size_t numClasses,
+		OUT candidateList_t& candidates) const;
+	/// Runs the homography fit of the given candidate. Can be called concurrently.
+	void fitCandidate(const FContour* pContour, OUT classCandidate_t& candidate) const;
 
 	/// Returns the class from last insertion that either has been created or matched.
 	const FContourClass* lastClass() const { return m_pLastClass; }
@@ -85,6 +263,14 @@ public:
 	float lastScaledMSE() const { return m_lastScaledMSE; }
 	/// Returns the homography from the last insertion attempt.
 	const FMatrix3f& lastHomography() const { return m_lastHomography; }
+	/// Returns the number of homography fits of the last insertion attempt.
+	size_t lastFitCount() const { return m_lastFitCount; }
+	/// Returns the number of classes skipped by prefilter and early exit in the last insertion attempt.
+	size_t lastSkippedFitCount() const { return m_lastSkippedFitCount; }
+	/// Returns the number of homography fits since the database has been created or loaded.
+	size_t totalFitCount() const { return m_totalFitCount; }
+	/// Returns the number of skipped fits since the database has been created or loaded.
+	size_t totalSkippedFitCount() const { return m_totalSkippedFitCount; }
 
 
 	/// Returns the number of different contour types in the database.
@@ -111,6 +297,10 @@ public:
 	const QSize& templateSize() const { return m_templateSize; }
 	/// Returns the size of warp patches.
 	const QSize& patchSize() const { return m_patchSize; }
+	/// Returns the binary tests the descriptors of the patches are built from.
+	const FFernTest& fernTest() const { return m_test; }
+	/// Returns the number of ferns, i.e. the number of descriptors per patch.
+	quint32 numFerns() const { return m_numFerns; }
 
 	/// Returns the squared error threshold that must be exceeded for a new class to be insert.
 	float warpErrorThreshold() const { return m_warpErrorThreshold; }
@@ -119,6 +309,22 @@ public:
 
 	/// Returns true if the database is initialized and ready for training or classification.
 	bool isValid() const { return m_isValid; }
+	/// Returns true if the database uses data of a memory mapped file.
+	bool isMapped() const { return m_pMappedFile != NULL; }
+	/// Returns true if changes are recorded for the journal.
+	bool isJournalingEnabled() const { return m_journalingEnabled; }
+	/// Returns the number of changes not yet appended to the journal.
+	size_t pendingJournalCount() const { return m_journal.size(); }
+	/// Returns the path of the journal file belonging to the given database file.
+	static QString journalFilePath(const QString& filePath) { return filePath + ".journal"; }
+
+	/// Returns the number of classifications checked, and how many of them returned the same
+	/// best class and the same set of candidates as the exact log-probabilities.
+	quantizationCheck_t quantizationCheck() const;
+	/// Returns the number of classes storing their frequency counts sparse.
+	size_t sparseHistogramCount() const;
+	/// Returns the size of the frequency counts of all classes in bytes.
+	size_t histogramByteSize() const;
 
 	/// Writes information about the internal state to the given debug object.
 	void dump(QDebug& debug) const;
@@ -129,11 +335,46 @@ private:
 	/// Deletes all allocated data in the database.
 	void _clear();
 
-	/// Fits the contour to each class' distance map. If a match is found, the class is returned.
-	FContourClass* _matchClass(const FContour* pContour);
-
-	/// Returns the three most probable classes given the descriptor.
-	void _getBestClassCandidates(quint32* pDescriptor, OUT FContourClass** ppClassList) const;
+	/// Serializes everything but the per-class data of the mapped format. When reading, returns
+	/// false as soon as a fern configuration is out of range or differs from the database's.
+	bool _serializeInfo(FArchive& ar);
+	/// Reads the database from the given open file in the mapped format.
+	bool _loadMapped(QFile* pFile);
+	/// Copies all data of the mapped file to memory owned by the database and closes the mapping.
+	void _detachMapping();
+
+	/// Records a change for the next checkpoint.
+	void _addJournalEntry(journalEntryType_t type, size_t contourIndex, size_t classIndex,
+		const quint32* pDescriptor = NULL, double mse = 0.0, double dp = 0.0);
+	/// Returns true if the given journal header belongs to the current database file.
+	bool _isJournalValid(const journalHeader_t& header) const;
+	/// Applies the journal of the given database file, which must have been loaded before.
+	void _replayJournal(const QString& filePath);
+	/// Reads the next journal entry and applies it. Returns false if the entry is invalid.
+	bool _replayJournalEntry(FArchive& ar);
+
+	/// Fits the contour to the distance maps of the candidate classes. Candidates for the classes
+	/// [numSelected, classCount) are added to the given ones. Returns the best fitting class.
+	FContourClass* _matchClass(const FContour* pContour,
+		const candidateList_t& candidates, size_t numSelected);
+	/// Adds candidates for the classes [firstClass, lastClass) and keeps the best ones in fitting order.
+	void _addCandidates(const FContour* pContour, size_t firstClass, size_t lastClass,
+		OUT candidateList_t& candidates) const;
+	/// Returns the factor compensating the mean squared error for the patch scaling.
+	float _areaScale(const FContour* pContour) const;
+
+	/// Fitting order of candidates: lowest unwarped error first, then lowest class index.
+	inline static bool sCandidateOrder(const classCandidate_t& a, const classCandidate_t& b) {
+		return a.coarseError < b.coarseError
+			|| (a.coarseError == b.coarseError && a.classIndex < b.classIndex);
+	}
+
+	/// Returns the most probable classes given the descriptor.
+	void _getBestClassCandidates(quint32* pDescriptor,
+		OUT FContourClass** ppClassList, size_t numCandidates) const;
+	/// Compares the given classes with the classes ranked by exact log-probabilities.
+	void _checkQuantization(const quint32* pDescriptor,
+		FContourClass* const* ppClassList, size_t numCandidates) const;
 
 	/// Homography decomposition.
 	void _decomposeHomography(const float* pHomography, float fovY, hDecomp_t& decomposition);
@@ -145,15 +386,23 @@ private:
 	//  Internal data members --------------------------------------------------
 
 private:
-	static const quint32 MAX_FERNS = 64;
-	static const quint32 MAX_BITS = 32;
+	static const char* FILE_MAGIC;
+	static const quint32 FILE_VERSION = 8;
+	static const quint32 MIN_FILE_VERSION = 6;
+	static const quint32 FILE_ALIGNMENT = 64;
+	static const quint32 ENTRY_ALIGNMENT = 16;
+
+	static const char* JOURNAL_MAGIC;
+	static const quint32 JOURNAL_VERSION = 1;
+	static const quint32 JOURNAL_BATCH_MARKER = 0x4243544a;
 
-	typedef std::list<FContourClass*> classList_t;
+	typedef std::vector<FContourClass*> classList_t;
 	typedef std::vector<classList_t> contourList_t;
 
 	contourList_t m_data;
 	FContourModel m_model;
 	FFernTest m_test;
+	FFernTable m_fernTable;
 
 	QSize m_templateSize;
 	QSize m_patchSize;
@@ -161,15 +410,34 @@ private:
 	quint32 m_numFerns;
 	quint32 m_numBits;
 	float m_warpErrorThreshold;
+	size_t m_fitCandidateCount;
+	bool m_earlyExitEnabled;
 	FTrainingParameter m_trainingParameter;
 
 	bool m_isValid;
+	QFile* m_pMappedFile;
+
+	bool m_quantizationCheckEnabled;
+	mutable QAtomicInt m_checkQueryCount;
+	mutable QAtomicInt m_checkSameBestCount;
+	mutable QAtomicInt m_checkSameCandidatesCount;
+
+	// journal
+	bool m_journalingEnabled;
+	std::vector<journalEntry_t> m_journal;
+	QString m_journalBasePath;	// file whose journal and the pending entries give the current state
+	quint64 m_generation;		// generation of the file loaded or saved last
+	qint64 m_journalSize;		// size of the valid part of the journal file
 
 	// temporary
 	FContourClass* m_pLastClass;
 	float m_lastMSE;
 	float m_lastScaledMSE;
 	FMatrix3f m_lastHomography;
+	size_t m_lastFitCount;
+	size_t m_lastSkippedFitCount;
+	size_t m_totalFitCount;
+	size_t m_totalSkippedFitCount;
 };
 	
 // ----------------------------------------------------------------------------------------------------
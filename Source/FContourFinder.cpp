@@ -9,6 +9,8 @@
 
 #include "FTrackMeStable.h"
 
+#include <cstring>
+
 #include "FContourFinder.h"
 #include "FMemoryTracer.h"
 
@@ -16,8 +18,8 @@
 //  Class FContourFinder
 // ----------------------------------------------------------------------------------------------------
 
-static const float DIST_MIN = 0.0f;
-static const float DIST_MAX = 2.0f;
+static const int DIST_MIN = 0;
+static const int DIST_MAX = 2;		// squared distance
 
 // Constructors and destructor ------------------------------------------------------------------------
 
@@ -28,7 +30,10 @@ FContourFinder::FContourFinder()
   m_pStatistics(NULL),
   m_contFragCount(0),
   m_contCandCount(0),
-  m_useDirectExtraction(true)
+  m_pPoints(NULL),
+  m_pointCount(0),
+  m_pointCapacity(0),
+  m_extractionMode(Labeling)
 {
 	m_texContourData.create();
 }
@@ -36,11 +41,12 @@ FContourFinder::FContourFinder()
 FContourFinder::~FContourFinder()
 {
 	F_SAFE_DELETE_ARRAY(m_pFrameDataInt);
+	F_SAFE_DELETE_ARRAY(m_pPoints);
 }
 
 // Public commands ------------------------------------------------------------------------------------
 
-void FContourFinder::findContours(const FGLTextureRect& distanceTransform,
+void FContourFinder::findContours(FDistanceTransform& distanceTransform,
 								  FDetectorStatistics* pStats /* = NULL */)
 {
 	F_ASSERT(distanceTransform.isValid());
@@ -52,21 +58,23 @@ void FContourFinder::findContours(const FGLTextureRect& distanceTransform,
 		m_stopWatch.start();
 	}
 
-	// Read the distance transform map back to host memory
+	// Read the packed distance transform map back to host memory
 	m_pFrameData = m_pFrameDataInt;
-	distanceTransform.read(FGLDataFormat::RGBA, FGLDataType::Float, m_pFrameData);
+	distanceTransform.getResult(m_pFrameData);
 
 	_clearContourData();
 	_prepareDTImage();
 
-	if (m_useDirectExtraction)
+	if (m_extractionMode == Labeling)
+		_findContoursLabeling();
+	else if (m_extractionMode == Direct)
 		_findContoursDirect();
 	else
 		_findContoursLevelCurve();
 	_findContoursPostProcess();
 }
 
-void FContourFinder::findContours(FDTPixel* pDTImage,
+void FContourFinder::findContours(FDTPixelPacked* pDTImage,
 								  FDetectorStatistics* pStats /* = NULL */)
 {
 	F_ASSERT(pDTImage);
@@ -82,76 +90,27 @@ void FContourFinder::findContours(FDTPixel* pDTImage,
 	_clearContourData();
 	_prepareDTImage();
 
-	if (m_useDirectExtraction)
+	if (m_extractionMode == Labeling)
+		_findContoursLabeling();
+	else if (m_extractionMode == Direct)
 		_findContoursDirect();
 	else
 		_findContoursLevelCurve();
 	_findContoursPostProcess();
 }
 
-void FContourFinder::findContoursTraining(const FGLTextureRect& distanceTransform,
-										  const FContourModel& contourModel)
+void FContourFinder::findContoursTraining(const FGLTextureRect& distanceTransform)
 {
 	F_ASSERT(distanceTransform.isValid());
-	m_pFrameData = m_pFrameDataInt;
-	distanceTransform.read(FGLDataFormat::RGBA, FGLDataType::Float, m_pFrameData);
-
-	_clearContourData();
-
-	FDTPixel* pData = m_pFrameData;
-	int nx = m_frameSize.width();
-	int ny = m_frameSize.height();
-
-	for (int y = 1; y < ny - 1; y++)
-	{
-		int yy = y * nx;
-		for (int x = 1; x < nx - 1; x++)
-		{
-			float distance = pData[yy + x].distance;
-			float index = pData[yy + x].index;
-			float idf = floorf(index * 255.0f + 0.5f) - 1.0f;
-			pData[yy + x].index = idf;
-
-			if (distance == 0.0f && index != 0.0f)
-			{
-				quint32 id = (quint32)idf;
-
-				if (id < FGlobalConstants::MAX_TEMPLATES)
-				{
-					if (m_contFragments[id].length < FContour::MAX_CONTOUR_LENGTH)
-					{
-						int p = m_contFragments[id].length++;
-						m_contFragments[id].pos[p].set(x, y);
-					}
-				}
-			}
-		}
-	}
-
-	m_contFragCount = 0;
-	m_contCandCount = 0;
+	distanceTransform.read(FGLDataFormat::RGBA, FGLDataType::Float, &m_floatImage[0]);
 
-	for (size_t i = 0; i < FGlobalConstants::MAX_TEMPLATES; i++)
-	{
-		FContour* pContour = &m_contFragments[i];
-		if (pContour->length > 0)
-		{
-			m_contFragCount = fMax(m_contFragCount, i + 1);
-			pContour->process(m_frameSize.width(), m_frameSize.height());
-			if (pContour->isValid())
-			{
-				pContour->normalize();
-				pContour->_setIndex(i);
-				m_contCandidates[m_contCandCount] = pContour;
-				
-				m_contCandCount++;
-				if (m_contCandCount >= FGlobalConstants::MAX_CONTOUR_CANDIDATES)
-					break;
-			}
-		}
-	}
+	_findContoursTraining(&m_floatImage[0]);
+}
 
-	F_CONSOLE("\nCONTOUR FINDER\nTraining: Frags: " << m_contFragCount << ", Candidates: " << m_contCandCount);
+void FContourFinder::findContoursTraining(const FDTPixel* pDTImage)
+{
+	F_ASSERT(pDTImage);
+	_findContoursTraining(pDTImage);
 }
 
 bool FContourFinder::reset(const QSize& frameSize)
@@ -161,16 +120,20 @@ bool FContourFinder::reset(const QSize& frameSize)
 
 	_clearContourData();
 
-	F_SAFE_DELETE_ARRAY(m_pFrameData);
-	m_pFrameDataInt = new FDTPixel[frameSize.width() * frameSize.height()];
+	F_SAFE_DELETE_ARRAY(m_pFrameDataInt);
+	m_pFrameDataInt = new FDTPixelPacked[frameSize.width() * frameSize.height()];
 	m_pFrameData = m_pFrameDataInt;
+	m_floatImage.resize(frameSize.width() * frameSize.height());
+
+	// initial room for a few contours spanning the frame, grows on demand
+	_reservePoints((frameSize.width() + frameSize.height()) * 16);
 
 	return (m_pFrameDataInt != NULL);
 }
 
 void FContourFinder::setContourExtractionMode(extractionMode_t mode)
 {
-	m_useDirectExtraction = (mode == Direct);
+	m_extractionMode = mode;
 }
 
 void FContourFinder::drawContourStatistics(FGLCanvas& canvas)
@@ -201,22 +164,102 @@ void FContourFinder::drawContourStatistics(FGLCanvas& canvas)
 
 const FGLTextureRect& FContourFinder::contourView()
 {
-	size_t numBytes = m_frameSize.width() * m_frameSize.height() * sizeof(FDTPixel);
+	size_t numPixels = m_frameSize.width() * m_frameSize.height();
+	for (size_t i = 0; i < numPixels; i++)
+		m_pFrameData[i].unpack(m_floatImage[i]);
 
 	m_texContourData.initialize(FGLPixelFormat::R32G32B32A32_Float, m_frameSize,
-		FGLDataFormat::RGBA, FGLDataType::Float, numBytes, m_pFrameData, false); // Do not flip
+		FGLDataFormat::RGBA, FGLDataType::Float, numPixels * sizeof(FDTPixel), &m_floatImage[0], false); // Do not flip
 
 	return m_texContourData;
 }
 
 // Internal functions ---------------------------------------------------------------------------------
 
+void FContourFinder::_findContoursTraining(const FDTPixel* pSource)
+{
+	_clearContourData();
+
+	m_pFrameData = m_pFrameDataInt;
+	FDTPixelPacked* pData = m_pFrameData;
+	int nx = m_frameSize.width();
+	int ny = m_frameSize.height();
+
+	// pack the image, the index is converted from the template color to the template id
+	for (int y = 0; y < ny; y++)
+	{
+		int yy = y * nx;
+		bool isInnerRow = (y > 0 && y < ny - 1);
+
+		for (int x = 0; x < nx; x++)
+		{
+			float distance = pSource[yy + x].distance;
+			float index = pSource[yy + x].index;
+			float idf = floorf(index * 255.0f + 0.5f) - 1.0f;
+			pData[yy + x].pack(pSource[yy + x]);
+			pData[yy + x].index = (qint16)idf;
+
+			if (isInnerRow && x > 0 && x < nx - 1 && distance == 0.0f && index != 0.0f)
+			{
+				quint32 id = (quint32)idf;
+				if (id < FGlobalConstants::MAX_TEMPLATES)
+					m_contFragments[id].length++;
+			}
+		}
+	}
+
+	// collect the pixels counted above into the spans of their contours
+	_allocateSpans(FGlobalConstants::MAX_TEMPLATES);
+
+	for (int y = 1; y < ny - 1; y++)
+	{
+		int yy = y * nx;
+		for (int x = 1; x < nx - 1; x++)
+		{
+			int id = pData[yy + x].index;
+			if (pData[yy + x].distance == 0 && id >= 0 && id < (int)FGlobalConstants::MAX_TEMPLATES)
+			{
+				int p = m_contFragments[id].length++;
+				m_pPoints[m_fragFirst[id] + p].set(x, y);
+			}
+		}
+	}
+
+	_attachSpans(FGlobalConstants::MAX_TEMPLATES);
+
+	m_contFragCount = 0;
+	m_contCandCount = 0;
+
+	for (size_t i = 0; i < FGlobalConstants::MAX_TEMPLATES; i++)
+	{
+		FContour* pContour = &m_contFragments[i];
+		if (pContour->length > 0)
+		{
+			m_contFragCount = fMax(m_contFragCount, i + 1);
+			pContour->process(m_frameSize.width(), m_frameSize.height());
+			if (pContour->isValid())
+			{
+				pContour->normalize();
+				pContour->_setIndex(i);
+				m_contCandidates[m_contCandCount] = pContour;
+				
+				m_contCandCount++;
+				if (m_contCandCount >= FGlobalConstants::MAX_CONTOUR_CANDIDATES)
+					break;
+			}
+		}
+	}
+
+	F_CONSOLE("\nCONTOUR FINDER\nTraining: Frags: " << m_contFragCount << ", Candidates: " << m_contCandCount);
+}
+
 void FContourFinder::_clearContourData()
 {
 	for (int i = 0; i < FGlobalConstants::MAX_CONTOUR_FRAGMENTS; i++)
 		m_contFragments[i].clear();
 	m_contFragCount = 0;
 	m_contCandCount = 0;
+	m_pointCount = 0;
 }
 
 void FContourFinder::_prepareDTImage()
@@ -224,10 +267,13 @@ void FContourFinder::_prepareDTImage()
 	int nx = m_frameSize.width();
 	int ny = m_frameSize.height();
 
-	// ensure all pixels have index -1
-	int n = nx * ny;
-	for (int i = 0; i < n; i++)
-		m_pFrameData[i].index = -1.0f;
+	// ensure all pixels have index -1, the labeler sets the index of all inner pixels
+	if (m_extractionMode != Labeling)
+	{
+		int n = nx * ny;
+		for (int i = 0; i < n; i++)
+			m_pFrameData[i].index = -1;
+	}
 
 	// set distance to -1 at all border pixels of image
 	// so we don't have to check boundary conditions later
@@ -236,24 +282,60 @@ void FContourFinder::_prepareDTImage()
 
 	for (int x = 0; x < nx; x++)
 	{
-		m_pFrameData[x].distance = -1.0f;
-		m_pFrameData[x].offset.makeZero();
+		m_pFrameData[x].distance = -1;
+		m_pFrameData[x].index = -1;
+		m_pFrameData[x].offsetX = m_pFrameData[x].offsetY = 0;
 	}
 	for (int x = yy; x < yy + nx; x++)
 	{
-		m_pFrameData[x].distance = -1.0f;
-		m_pFrameData[x].offset.makeZero();
+		m_pFrameData[x].distance = -1;
+		m_pFrameData[x].index = -1;
+		m_pFrameData[x].offsetX = m_pFrameData[x].offsetY = 0;
 	}
 
 	for (int y = 0; y < ny; y++)
 	{
-		m_pFrameData[y * nx].distance = -1.0f;
-		m_pFrameData[y * nx].offset.makeZero();
+		m_pFrameData[y * nx].distance = -1;
+		m_pFrameData[y * nx].index = -1;
+		m_pFrameData[y * nx].offsetX = m_pFrameData[y * nx].offsetY = 0;
 	}
 	for (int y = 1; y <= ny; y++)
 	{
-		m_pFrameData[y * nx - 1].distance = -1.0f;
-		m_pFrameData[y * nx - 1].offset.makeZero();
+		m_pFrameData[y * nx - 1].distance = -1;
+		m_pFrameData[y * nx - 1].index = -1;
+		m_pFrameData[y * nx - 1].offsetX = m_pFrameData[y * nx - 1].offsetY = 0;
+	}
+}
+
+void FContourFinder::_findContoursLabeling()
+{
+	const size_t maxContFrags = FGlobalConstants::MAX_CONTOUR_FRAGMENTS;
+
+	// label connected edge pixels, sets the index of all pixels to their fragment
+	size_t numFragments = m_labeler.label(m_pFrameData, m_frameSize, maxContFrags);
+	if (numFragments >= maxContFrags)
+		F_CONSOLE("FContourFinder::_findContoursLabeling - WARNING: Contour fragment limit exceeded");
+
+	FVector2f* pPoints = m_labeler.points();
+
+	for (size_t i = 0; i < numFragments; i++)
+	{
+		const FContourLabeler::fragment_t& fragment = m_labeler.fragmentAt(i);
+		FContour& contour = m_contFragments[i];
+
+		contour.pos = pPoints + fragment.first;
+		contour.length = fragment.length;
+		contour._setMoments(fragment.mean, fragment.boundingBox, fragment.covariance);
+
+		if (!fragment.isClosed)
+			contour.discardNonClosed();
+	}
+
+	if (m_pStatistics)
+	{
+		m_pStatistics->timeContourExtraction = m_stopWatch.stop();
+		m_stopWatch.reset();
+		m_stopWatch.start();
 	}
 }
 
@@ -261,9 +343,9 @@ void FContourFinder::_findContoursLevelCurve()
 {
 	int nx = m_frameSize.width();
 	int ny = m_frameSize.height();
-	FDTPixel* pData = m_pFrameData;
+	FDTPixelPacked* pData = m_pFrameData;
 
-	float contourIndex = 0.0f;
+	int contourIndex = 0;
 	bool contourLimitExceeded = false;
 	const size_t maxContFrags = FGlobalConstants::MAX_CONTOUR_FRAGMENTS;
 
@@ -276,7 +358,7 @@ void FContourFinder::_findContoursLevelCurve()
 			int ci = yy + x;
 
 			// if on the right distance and not visited yet, follow contour
-			if (pData[ci].distance > DIST_MIN && pData[ci].distance <= DIST_MAX && pData[ci].index < 0.0f)
+			if (pData[ci].distance > DIST_MIN && pData[ci].distance <= DIST_MAX && pData[ci].index < 0)
 			{
 				_followContourLevelCurve(pData, ci, nx, ny, contourIndex);
 				contourIndex++;
@@ -295,38 +377,52 @@ void FContourFinder::_findContoursLevelCurve()
 	}
 
 	// set index of all pixels according to the contour they belong to
-	// collect contour pixels into contour bins
+	// count contour pixels per contour
 	for (int y = 1; y < ny - 1; y++)
 	{
 		int yy = y * nx;
 		for (int x = 1; x < nx - 1; x++)
 		{
 			int i = yy + x;
-			if (pData[i].distance > 0.0f)
+			if (pData[i].distance > 0)
 			{
-				int sx = x + pData[i].offset.x();
-				int sy = y + pData[i].offset.y();
+				int sx = x + pData[i].offsetX;
+				int sy = y + pData[i].offsetY;
 				int si = sy * nx + sx;
 				pData[i].index = pData[si].index;
 			}
-			else if (pData[i].distance == 0.0f)
+			else if (pData[i].distance == 0)
+			{
+				int cId = (int)pData[i].index;
+				if (cId >= 0 && cId < maxContFrags)
+					m_contFragments[cId].length++;
+			}
+		}
+	}
+
+	// collect contour pixels into the spans of their contours
+	_allocateSpans(maxContFrags);
+
+	for (int y = 1; y < ny - 1; y++)
+	{
+		int yy = y * nx;
+		for (int x = 1; x < nx - 1; x++)
+		{
+			int i = yy + x;
+			if (pData[i].distance == 0)
 			{
 				int cId = (int)pData[i].index;
 				if (cId >= 0 && cId < maxContFrags)
 				{
-					int j = m_contFragments[cId].length;
-					if (j < FContour::MAX_CONTOUR_LENGTH - 1)
-					{
-						m_contFragments[cId].pos[j].set((float)x, (float)y);
-						m_contFragments[cId].length++;
-					}
-					else
-						F_CONSOLE("FContourFinder::_findContours - WARNING: Contour length exceeded");
+					int j = m_contFragments[cId].length++;
+					m_pPoints[m_fragFirst[cId] + j].set((float)x, (float)y);
 				}
 			}
 		}
 	}
 
+	_attachSpans(maxContFrags);
+
 	if (m_pStatistics)
 	{
 		m_pStatistics->timeContourExtraction = m_stopWatch.stop();
@@ -339,9 +435,9 @@ void FContourFinder::_findContoursDirect()
 {
 	int nx = m_frameSize.width();
 	int ny = m_frameSize.height();
-	FDTPixel* pData = m_pFrameData;
+	FDTPixelPacked* pData = m_pFrameData;
 
-	float contourIndex = 0.0f;
+	int contourIndex = 0;
 	bool contourLimitExceeded = false;
 	const size_t maxContFrags = FGlobalConstants::MAX_CONTOUR_FRAGMENTS;
 
@@ -354,11 +450,11 @@ void FContourFinder::_findContoursDirect()
 			int ci = yy + x;
 
 			// if on a contour pixel and not visited yet, follow contour
-			if (pData[ci].distance == 0.0f && pData[ci].index < 0.0f)
+			if (pData[ci].distance == 0 && pData[ci].index < 0)
 			{
 				bool isClosed = _followContourDirect(pData, ci, nx, ny, contourIndex);
 				if (!isClosed)
-					m_contFragments[(int)contourIndex].discardNonClosed();
+					m_contFragments[contourIndex].discardNonClosed();
 								
 				contourIndex++;
 
@@ -382,16 +478,18 @@ void FContourFinder::_findContoursDirect()
 		for (int x = 1; x < nx - 1; x++)
 		{
 			int i = yy + x;
-			if (pData[i].distance > 0.0f)
+			if (pData[i].distance > 0)
 			{
-				int sx = x + pData[i].offset.x();
-				int sy = y + pData[i].offset.y();
+				int sx = x + pData[i].offsetX;
+				int sy = y + pData[i].offsetY;
 				int si = sy * nx + sx;
 				pData[i].index = pData[si].index;
 			}
 		}
 	}
 
+	_attachSpans(maxContFrags);
+
 	if (m_pStatistics)
 	{
 		m_pStatistics->timeContourExtraction = m_stopWatch.stop();
@@ -444,9 +542,9 @@ void FContourFinder::_findContoursPostProcess()
 	}
 }
 
-bool FContourFinder::_followContourLevelCurve(FDTPixel* pData,
+bool FContourFinder::_followContourLevelCurve(FDTPixelPacked* pData,
 											  int ci, int nx, int ny,
-											  float contourId)
+											  int contourId)
 {
 	// si: index of seed pixel, ci: index of contour pixel
 	int next_ci, prev_si, next_si, nsi;
@@ -458,59 +556,59 @@ bool FContourFinder::_followContourLevelCurve(FDTPixel* pData,
 	while(true)
 	{
 		prev_si = si;
-		si = ci + pData[ci].offset.y() * nx + pData[ci].offset.x();
+		si = ci + pData[ci].offsetY * nx + pData[ci].offsetX;
 
 		
 		// check if contour has already been (partially) traced with another index
-		if (si != prev_si && restart == 0 && pData[si].index >= 0.0f && pData[si].index != contourId)
+		if (si != prev_si && restart == 0 && pData[si].index >= 0 && pData[si].index != contourId)
 		{
 			// change contour id and trace again
 			contourId = pData[si].index;
 			ci = start_ci;
-			si = ci + pData[ci].offset.y() * nx + pData[ci].offset.x();
+			si = ci + pData[ci].offsetY * nx + pData[ci].offsetX;
 			restart = 1;
 		}
 		
 		
 		// mark current contour and seed pixels (incl. neighbors) as visited
-		pData[ci].index = contourId;
+		pData[ci].index = (qint16)contourId;
 
 		// seed must not be on border
-		if (pData[si].distance == 0.0)
+		if (pData[si].distance == 0)
 		{
-			pData[si].index = contourId;
+			pData[si].index = (qint16)contourId;
 
 			nsi = si - 1;
-			if (pData[nsi].distance == 0.0)
+			if (pData[nsi].distance == 0)
 			{
-				pData[nsi].index = contourId;
+				pData[nsi].index = (qint16)contourId;
 				nsi = nsi - 1;
-				if (pData[nsi].distance == 0.0)
-					pData[nsi].index = contourId;
+				if (pData[nsi].distance == 0)
+					pData[nsi].index = (qint16)contourId;
 			}
 			nsi = si - nx;
-			if (pData[nsi].distance == 0.0)
+			if (pData[nsi].distance == 0)
 			{
-				pData[nsi].index = contourId;
+				pData[nsi].index = (qint16)contourId;
 				nsi = nsi - nx;
-				if (pData[nsi].distance == 0.0)
-					pData[nsi].index = contourId;
+				if (pData[nsi].distance == 0)
+					pData[nsi].index = (qint16)contourId;
 			}
 			nsi = si + 1;
-			if (pData[nsi].distance == 0.0)
+			if (pData[nsi].distance == 0)
 			{
-				pData[nsi].index = contourId;
+				pData[nsi].index = (qint16)contourId;
 				nsi = nsi + 1;
-				if (pData[nsi].distance == 0.0)
-					pData[nsi].index = contourId;
+				if (pData[nsi].distance == 0)
+					pData[nsi].index = (qint16)contourId;
 			}
 			nsi = si + nx;
-			if (pData[nsi].distance == 0.0)
+			if (pData[nsi].distance == 0)
 			{
-				pData[nsi].index = contourId;
+				pData[nsi].index = (qint16)contourId;
 				nsi = nsi + nx;
-				if (pData[nsi].distance == 0.0)
-					pData[nsi].index = contourId;
+				if (pData[nsi].distance == 0)
+					pData[nsi].index = (qint16)contourId;
 			}
 		}
 
@@ -566,9 +664,10 @@ found:
 	} // end while(true)
 }
 
-bool FContourFinder::_followContourDirect(FDTPixel *pData, int ci, int nx, int ny, float contourId)
+bool FContourFinder::_followContourDirect(FDTPixelPacked* pData, int ci, int nx, int ny, int contourId)
 {
-	int cId = (int)contourId;
+	int cId = contourId;
+	m_fragFirst[cId] = m_pointCount;
 
 	// si: index of seed pixel, ci: index of contour pixel
 	int next_ci;
@@ -578,12 +677,12 @@ bool FContourFinder::_followContourDirect(FDTPixel *pData, int ci, int nx, int n
 	while(true)
 	{
 		// mark current contour and seed pixels (incl. neighbors) as visited
-		pData[ci].index = contourId;
+		pData[ci].index = (qint16)contourId;
 		int visitedCount = 0;
 
 		// move on to next contour pixel, first consider direct 4-neighbors
 		next_ci = ci - 1;
-		if (next_ci != prev_ci && pData[next_ci].distance == 0.0f)
+		if (next_ci != prev_ci && pData[next_ci].distance == 0)
 		{
 			visitedCount++;
 			if (pData[next_ci].index != contourId)
@@ -591,7 +690,7 @@ bool FContourFinder::_followContourDirect(FDTPixel *pData, int ci, int nx, int n
 		}
 
 		next_ci = ci - nx;
-		if (next_ci != prev_ci && pData[next_ci].distance == 0.0f)
+		if (next_ci != prev_ci && pData[next_ci].distance == 0)
 		{
 			visitedCount++;
 			if (pData[next_ci].index != contourId)
@@ -599,7 +698,7 @@ bool FContourFinder::_followContourDirect(FDTPixel *pData, int ci, int nx, int n
 		}
 
 		next_ci = ci + 1;
-		if (next_ci != prev_ci && pData[next_ci].distance == 0.0f)
+		if (next_ci != prev_ci && pData[next_ci].distance == 0)
 		{
 			visitedCount++;
 			if (pData[next_ci].index != contourId)
@@ -607,7 +706,7 @@ bool FContourFinder::_followContourDirect(FDTPixel *pData, int ci, int nx, int n
 		}
 
 		next_ci = ci + nx;
-		if (next_ci != prev_ci && pData[next_ci].distance == 0.0f)
+		if (next_ci != prev_ci && pData[next_ci].distance == 0)
 		{
 			visitedCount++;
 			if (pData[next_ci].index != contourId)
@@ -616,7 +715,7 @@ bool FContourFinder::_followContourDirect(FDTPixel *pData, int ci, int nx, int n
 
 		// now consider 8-connected neighbors
 		next_ci = ci - 1 - nx;
-		if (next_ci != prev_ci && pData[next_ci].distance == 0.0f)
+		if (next_ci != prev_ci && pData[next_ci].distance == 0)
 		{
 			visitedCount++;
 			if (pData[next_ci].index != contourId)
@@ -624,7 +723,7 @@ bool FContourFinder::_followContourDirect(FDTPixel *pData, int ci, int nx, int n
 		}
 
 		next_ci = ci + 1 - nx;
-		if (next_ci != prev_ci && pData[next_ci].distance == 0.0f)
+		if (next_ci != prev_ci && pData[next_ci].distance == 0)
 		{
 			visitedCount++;
 			if (pData[next_ci].index != contourId)
@@ -632,7 +731,7 @@ bool FContourFinder::_followContourDirect(FDTPixel *pData, int ci, int nx, int n
 		}
 
 		next_ci = ci + 1 + nx;
-		if (next_ci != prev_ci && pData[next_ci].distance == 0.0f)
+		if (next_ci != prev_ci && pData[next_ci].distance == 0)
 		{
 			visitedCount++;
 			if (pData[next_ci].index != contourId)
@@ -640,7 +739,7 @@ bool FContourFinder::_followContourDirect(FDTPixel *pData, int ci, int nx, int n
 		}
 
 		next_ci = ci - 1 + nx;
-		if (next_ci != prev_ci && pData[next_ci].distance == 0.0f)
+		if (next_ci != prev_ci && pData[next_ci].distance == 0)
 		{
 			visitedCount++;
 			if (pData[next_ci].index != contourId)
@@ -655,14 +754,8 @@ found:
 		float py = (float)(next_ci / nx);
 		float px = (float)(next_ci % nx);
 
-		int j = m_contFragments[cId].length;
-		if (j < FContour::MAX_CONTOUR_LENGTH - 1)
-		{
-			m_contFragments[cId].pos[j].set((float)px, (float)py);
-			m_contFragments[cId].length++;
-		}
-		else
-			F_CONSOLE("FContourFinder::_findContours - WARNING: Contour length exceeded");
+		_addPoint(px, py);
+		m_contFragments[cId].length++;
 
 		// make next pixel current
 		prev_ci = ci;
@@ -671,4 +764,43 @@ found:
 	} // end while(true)
 }
 
+void FContourFinder::_reservePoints(size_t count)
+{
+	if (count <= m_pointCapacity)
+		return;
+
+	size_t capacity = fMax(count, m_pointCapacity * 2);
+	FVector2f* pPoints = new FVector2f[capacity];
+	if (m_pointCount > 0)
+		memcpy(pPoints, m_pPoints, m_pointCount * sizeof(FVector2f));
+
+	F_SAFE_DELETE_ARRAY(m_pPoints);
+	m_pPoints = pPoints;
+	m_pointCapacity = capacity;
+}
+
+void FContourFinder::_allocateSpans(size_t numFragments)
+{
+	size_t first = m_pointCount;
+	for (size_t i = 0; i < numFragments; i++)
+	{
+		m_fragFirst[i] = first;
+		first += m_contFragments[i].length;
+		m_contFragments[i].length = 0;
+	}
+
+	_reservePoints(first);
+	m_pointCount = first;
+}
+
+void FContourFinder::_attachSpans(size_t numFragments)
+{
+	// the buffer may have moved while it was filled
+	for (size_t i = 0; i < numFragments; i++)
+	{
+		if (m_contFragments[i].length > 0)
+			m_contFragments[i].pos = m_pPoints + m_fragFirst[i];
+	}
+}
+
 // ----------------------------------------------------------------------------------------------------
\ No newline at end of file
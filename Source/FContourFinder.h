@@ -10,15 +10,18 @@
 #ifndef FCONTOURFINDER_H
 #define FCONTOURFINDER_H
 
+#include <vector>
+
 #include "FTrackMe.h"
 #include "FlowMath.h"
 #include "FlowGL.h"
 #include "FPixelStruct.h"
 #include "FDTPixel.h"
+#include "FDistanceTransform.h"
 #include "FStopWatch.h"
 #include "FFrameStatistics.h"
-#include "FContourModel.h"
 #include "FContour.h"
+#include "FContourLabeler.h"
 
 // ----------------------------------------------------------------------------------------------------
 //  Class FContourFinder
@@ -31,6 +34,7 @@ class FContourFinder
 public:
 	enum extractionMode_t
 	{
+		Labeling,
 		Direct,
 		LevelCurve
 	};
@@ -50,21 +54,29 @@ private:
 	//  Public commands --------------------------------------------------------
 
 public:
-	/// Extracts closed contours in the given distance transform map.
-	void findContours(const FGLTextureRect& distanceTransform, FDetectorStatistics* pStats = NULL);
-	void findContours(FDTPixel* pDTImage, FDetectorStatistics* pStats = NULL);
-
-	/// Extracts contours in the given distance transform map during training,
-	/// using the information of the given contour model.
-	void findContoursTraining(const FGLTextureRect& distanceTransform, const FContourModel& contourModel);
+	/// Extracts closed contours in the result of the given distance transform.
+	void findContours(FDistanceTransform& distanceTransform, FDetectorStatistics* pStats = NULL);
+	/// Extracts closed contours in the given distance transform map in host memory.
+	/// The image is modified in place.
+	void findContours(FDTPixelPacked* pDTImage, FDetectorStatistics* pStats = NULL);
+
+	/// Extracts contours in the given distance transform map during training.
+	void findContoursTraining(const FGLTextureRect& distanceTransform);
+	/// Extracts contours during training from a distance transform map in host memory, whose
+	/// index holds the template colors. The map is packed into the internal image. Does not use
+	/// OpenGL and can run in a worker thread.
+	void findContoursTraining(const FDTPixel* pDTImage);
 
 	/// Resets the contour finder and allocates space for data structures.
 	bool reset(const QSize& frameSize);
 
-	/// Choses a method for for contour extraction: 'Direct' directly
-	/// follows the edge pixels, 'LevelCurve' follows the contour in a distance,
-	/// using the distance transform.
+	/// Choses a method for for contour extraction: 'Labeling' (default) collects the
+	/// connected edge pixels in a single pass, 'Direct' directly follows the edge pixels,
+	/// 'LevelCurve' follows the contour in a distance, using the distance transform.
 	void setContourExtractionMode(extractionMode_t mode);
+	/// Sets the worker pool used for labeling the edge pixels. If NULL, the
+	/// image is labeled in the calling thread.
+	void setWorkerPool(FWorkerPool* pPool) { m_labeler.setWorkerPool(pPool); }
 
 	void drawContourStatistics(FGLCanvas& canvas);
 
@@ -84,52 +96,45 @@ public:
 		return m_contCandidates[index];
 	}
 	/// Returns the distance transform image in host memory.
-	const FDTPixel* dtImage() const { return m_pFrameData; }
+	const FDTPixelPacked* dtImage() const { return m_pFrameData; }
 
 	//  Internal functions -----------------------------------------------------
 
 private:
 	void _clearContourData();
 	void _prepareDTImage();
+	void _findContoursTraining(const FDTPixel* pSource);
 	
+	void _findContoursLabeling();
 	void _findContoursLevelCurve();
 	void _findContoursDirect();
 	void _findContoursPostProcess();
 
-	bool _followContourLevelCurve(FDTPixel* pData, int ci, int nx, int ny, float contourId);
-	bool _followContourDirect(FDTPixel* pData, int ci, int nx, int ny, float contourId);
-
-	void _fillArea(int x, int y, float minDist, float searchIndex, float replaceIndex);
-
-	//  Simple stack implementation for 2d coordinates
-	inline bool push(const FVector2i& p) {
-		if (m_stackPointer + 1 < STACK_SIZE) {
-			m_pointStack[++m_stackPointer] = p;
-			return true;
-		}
-		else
-			return false;
-	}
-
-	inline bool pop(FVector2i& p) {
-		if (m_stackPointer >= 0) {
-			p = m_pointStack[m_stackPointer--];
-			return true;
-		}
-		else
-			return false;
-	}
-
-	inline void emptyStack() {
-		m_stackPointer = -1;
+	bool _followContourLevelCurve(FDTPixelPacked* pData, int ci, int nx, int ny, int contourId);
+	bool _followContourDirect(FDTPixelPacked* pData, int ci, int nx, int ny, int contourId);
+
+	/// Grows the point buffer geometrically to hold at least the given number of points.
+	void _reservePoints(size_t count);
+	/// Assigns consecutive spans of the point buffer to the given number of fragments, sized
+	/// by the pixel counts stored in their lengths. The lengths are reset for filling the spans.
+	void _allocateSpans(size_t numFragments);
+	/// Points the fragments to their spans, after the point buffer has been filled.
+	void _attachSpans(size_t numFragments);
+
+	/// Appends a pixel of the fragment currently followed to the point buffer.
+	inline void _addPoint(float x, float y) {
+		if (m_pointCount == m_pointCapacity)
+			_reservePoints(m_pointCount + 1);
+		m_pPoints[m_pointCount++].set(x, y);
 	}
 
 	//  Internal data members --------------------------------------------------
 
 private:
 	QSize m_frameSize;
-	FDTPixel* m_pFrameData;
-	FDTPixel* m_pFrameDataInt;
+	FDTPixelPacked* m_pFrameData;
+	FDTPixelPacked* m_pFrameDataInt;
+	std::vector<FDTPixel> m_floatImage;	// float layout for training readback and display
 	FGLTextureRect m_texContourData;
 
 	FContour m_contFragments[FGlobalConstants::MAX_CONTOUR_FRAGMENTS];
@@ -137,16 +142,18 @@ private:
 	size_t m_contFragCount;
 	size_t m_contCandCount;
 
-	bool m_useDirectExtraction;
+	// Pixels of all fragments, kept between frames
+	FVector2f* m_pPoints;
+	size_t m_pointCount;
+	size_t m_pointCapacity;
+	size_t m_fragFirst[FGlobalConstants::MAX_CONTOUR_FRAGMENTS];
+
+	FContourLabeler m_labeler;
+	extractionMode_t m_extractionMode;
 
 	// Statistics
 	FStopWatch m_stopWatch;
 	FDetectorStatistics* m_pStatistics;
-
-	// Stack for flood fill
-	static const size_t STACK_SIZE = 4096;
-	FVector2i m_pointStack[STACK_SIZE];
-	int m_stackPointer;
 };
 	
 // ----------------------------------------------------------------------------------------------------
@@ -0,0 +1,341 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FContourLabeler.cpp
+//  Description		Implementation of class FContourLabeler
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-25 14:37:20 +0200 (So, 25 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#include "FTrackMeStable.h"
+
+#include "FContourLabeler.h"
+#include "FMemoryTracer.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FContourLabeler
+// ----------------------------------------------------------------------------------------------------
+
+// Constructors and destructor ------------------------------------------------------------------------
+
+FContourLabeler::FContourLabeler()
+: m_pData(NULL),
+  m_width(0),
+  m_height(0),
+  m_rowsPerBand(ROWS_PER_TASK),
+  m_pWorkerPool(NULL),
+  m_pass(LabelPass)
+{
+}
+
+FContourLabeler::~FContourLabeler()
+{
+}
+
+// Public commands ------------------------------------------------------------------------------------
+
+size_t FContourLabeler::label(FDTPixelPacked* pData, const QSize& imageSize, size_t maxFragments)
+{
+	F_ASSERT(pData && imageSize.width() > 2 && imageSize.height() > 2);
+
+	m_pData = pData;
+	m_width = imageSize.width();
+	m_height = imageSize.height();
+
+	size_t numPixels = (size_t)m_width * m_height;
+	if (m_pixelLabels.size() < numPixels)
+		m_pixelLabels.resize(numPixels);
+
+	// a row holds at most one new label per two pixels, the labels of a band must fit in LABEL_BITS
+	int labelsPerRow = (m_width + 1) / 2;
+	m_rowsPerBand = fMax(1, fMin(ROWS_PER_TASK, (int)(LABEL_MASK + 1) / labelsPerRow));
+	F_ASSERT(labelsPerRow * m_rowsPerBand <= (int)LABEL_MASK + 1);
+
+	m_bands.resize((m_height + m_rowsPerBand - 1) / m_rowsPerBand);
+
+	_runPass(LabelPass);
+	_merge(maxFragments);
+	_runPass(CollectPass);
+
+	return m_fragments.size();
+}
+
+// Overrides ------------------------------------------------------------------------------------------
+
+void FContourLabeler::runTask(size_t taskIndex, size_t workerIndex)
+{
+	if (m_pass == LabelPass)
+		_labelBand(taskIndex);
+	else
+		_collectBand(taskIndex);
+}
+
+// Internal functions ---------------------------------------------------------------------------------
+
+void FContourLabeler::_runPass(pass_t pass)
+{
+	m_pass = pass;
+	size_t taskCount = m_bands.size();
+
+	if (m_pWorkerPool)
+		m_pWorkerPool->run(this, taskCount);
+	else
+		for (size_t i = 0; i < taskCount; i++)
+			runTask(i, 0);
+}
+
+void FContourLabeler::_labelBand(size_t band)
+{
+	// labels of a band only refer to labels of the same band until merged
+	labelList_t& labels = m_bands[band];
+	labels.clear();
+
+	int nx = m_width;
+	int y0 = fMax(1, (int)band * m_rowsPerBand);
+	int y1 = fMin(((int)band + 1) * m_rowsPerBand, m_height - 1);
+	quint32 bandLabel = (quint32)band << LABEL_BITS;
+
+	for (int y = y0; y < y1; y++)
+	{
+		const FDTPixelPacked* pRow = m_pData + y * nx;
+		quint32* pLabelRow = &m_pixelLabels[y * nx];
+
+		for (int x = 1; x < nx - 1; x++)
+		{
+			if (pRow[x].distance != 0)
+				continue;
+
+			// join the labels of the neighbors visited before
+			quint32 label = NO_LABEL;
+			if (pRow[x - 1].distance == 0)
+				label = pLabelRow[x - 1];
+
+			if (y > y0)
+			{
+				for (int i = x - 1; i <= x + 1; i++)
+				{
+					if (pRow[i - nx].distance == 0)
+					{
+						quint32 aboveLabel = pLabelRow[i - nx];
+						if (label == NO_LABEL)
+							label = aboveLabel;
+						else if (aboveLabel != label)
+							_join(label, aboveLabel);
+					}
+				}
+			}
+
+			if (label == NO_LABEL)
+			{
+				label = bandLabel | (quint32)labels.size();
+				label_t newLabel;
+				memset(&newLabel, 0, sizeof(label_t));
+				newLabel.parent = label;
+				newLabel.minX = newLabel.minY = FLT_MAX;
+				labels.push_back(newLabel);
+			}
+
+			pLabelRow[x] = label;
+
+			float fx = (float)x;
+			float fy = (float)y;
+			label_t& l = labels[label & LABEL_MASK];
+			l.count++;
+			l.edgeCount += _edgeCount(pRow + x);
+			l.minX = fMin(l.minX, fx);
+			l.minY = fMin(l.minY, fy);
+			l.maxX = fMax(l.maxX, fx);
+			l.maxY = fMax(l.maxY, fy);
+			l.sumX += fx;
+			l.sumY += fy;
+			l.sumXX += fx * fx;
+			l.sumXY += fx * fy;
+			l.sumYY += fy * fy;
+		}
+	}
+}
+
+void FContourLabeler::_collectBand(size_t band)
+{
+	int nx = m_width;
+	int y0 = fMax(1, (int)band * m_rowsPerBand);
+	int y1 = fMin(((int)band + 1) * m_rowsPerBand, m_height - 1);
+
+	for (int y = y0; y < y1; y++)
+	{
+		FDTPixelPacked* pRow = m_pData + y * nx;
+		const quint32* pLabelRow = &m_pixelLabels[y * nx];
+
+		for (int x = 1; x < nx - 1; x++)
+		{
+			FDTPixelPacked& pixel = pRow[x];
+
+			if (pixel.distance == 0)
+			{
+				// the labels of the pixels of this band belong to this band
+				label_t& l = _label(pLabelRow[x]);
+				if (l.fragment != NO_FRAGMENT)
+				{
+					pixel.index = (qint16)l.fragment;
+					m_points[l.offset++].set((float)x, (float)y);
+				}
+				else
+					pixel.index = -1;
+			}
+			else if (pixel.distance > 0)
+			{
+				// index of the nearest edge pixel, which may be in another band
+				int si = (y + pixel.offsetY) * nx + x + pixel.offsetX;
+				quint32 fragment = NO_FRAGMENT;
+				if (m_pData[si].distance == 0)
+					fragment = _label(m_pixelLabels[si]).fragment;
+				pixel.index = (fragment != NO_FRAGMENT) ? (qint16)fragment : (qint16)-1;
+			}
+			else
+				pixel.index = -1;
+		}
+	}
+}
+
+void FContourLabeler::_merge(size_t maxFragments)
+{
+	int nx = m_width;
+
+	// join the labels of 8-connected pixels across band borders
+	for (size_t band = 1; band < m_bands.size(); band++)
+	{
+		int y = (int)band * m_rowsPerBand;
+		if (y < 2 || y >= m_height - 1)
+			continue;
+
+		const FDTPixelPacked* pRow = m_pData + y * nx;
+		const quint32* pLabelRow = &m_pixelLabels[y * nx];
+
+		for (int x = 1; x < nx - 1; x++)
+		{
+			if (pRow[x].distance != 0)
+				continue;
+
+			for (int i = x - 1; i <= x + 1; i++)
+				if (pRow[i - nx].distance == 0)
+					_join(pLabelRow[x], pLabelRow[i - nx]);
+		}
+	}
+
+	// number the fragments, the root label of a fragment is visited before all other labels
+	m_fragmentSums.clear();
+
+	for (size_t band = 0; band < m_bands.size(); band++)
+	{
+		labelList_t& labels = m_bands[band];
+		quint32 bandLabel = (quint32)band << LABEL_BITS;
+
+		for (size_t i = 0; i < labels.size(); i++)
+		{
+			label_t& l = labels[i];
+			quint32 root = _findRoot(bandLabel | (quint32)i);
+
+			if (root == (bandLabel | (quint32)i))
+			{
+				l.fragment = NO_FRAGMENT;
+				if (m_fragmentSums.size() < maxFragments)
+				{
+					l.fragment = (quint32)m_fragmentSums.size();
+					label_t sums;
+					memset(&sums, 0, sizeof(label_t));
+					sums.minX = sums.minY = FLT_MAX;
+					m_fragmentSums.push_back(sums);
+				}
+			}
+			else
+				l.fragment = _label(root).fragment;
+
+			if (l.fragment != NO_FRAGMENT)
+				_addLabel(m_fragmentSums[l.fragment], l);
+		}
+	}
+
+	// place the pixels of each fragment in a contiguous span
+	size_t numFragments = m_fragmentSums.size();
+	m_fragments.resize(numFragments);
+	size_t first = 0;
+
+	for (size_t f = 0; f < numFragments; f++)
+	{
+		label_t& sums = m_fragmentSums[f];
+		fragment_t& fragment = m_fragments[f];
+
+		double n = (double)sums.count;
+		double meanX = sums.sumX / n;
+		double meanY = sums.sumY / n;
+
+		fragment.first = first;
+		fragment.length = (int)sums.count;
+		fragment.isClosed = (sums.edgeCount >= sums.count);
+		fragment.mean.set((float)meanX, (float)meanY);
+		fragment.boundingBox.set(sums.minX, sums.minY, sums.maxX, sums.maxY);
+		fragment.covariance.set((float)(sums.sumXX / n - meanX * meanX),
+			(float)(sums.sumXY / n - meanX * meanY), (float)(sums.sumYY / n - meanY * meanY));
+
+		sums.offset = (quint32)first;
+		first += sums.count;
+	}
+
+	for (size_t band = 0; band < m_bands.size(); band++)
+	{
+		labelList_t& labels = m_bands[band];
+		for (size_t i = 0; i < labels.size(); i++)
+		{
+			label_t& l = labels[i];
+			if (l.fragment != NO_FRAGMENT)
+			{
+				l.offset = m_fragmentSums[l.fragment].offset;
+				m_fragmentSums[l.fragment].offset += l.count;
+			}
+		}
+	}
+
+	m_points.resize(first);
+}
+
+quint32 FContourLabeler::_findRoot(quint32 label)
+{
+	// path halving
+	while (true)
+	{
+		label_t& l = _label(label);
+		if (l.parent == label)
+			return label;
+
+		l.parent = _label(l.parent).parent;
+		label = l.parent;
+	}
+}
+
+void FContourLabeler::_join(quint32 label0, quint32 label1)
+{
+	quint32 root0 = _findRoot(label0);
+	quint32 root1 = _findRoot(label1);
+
+	if (root0 < root1)
+		_label(root1).parent = root0;
+	else if (root1 < root0)
+		_label(root0).parent = root1;
+}
+
+void FContourLabeler::_addLabel(label_t& target, const label_t& source)
+{
+	target.count += source.count;
+	target.edgeCount += source.edgeCount;
+	target.minX = fMin(target.minX, source.minX);
+	target.minY = fMin(target.minY, source.minY);
+	target.maxX = fMax(target.maxX, source.maxX);
+	target.maxY = fMax(target.maxY, source.maxY);
+	target.sumX += source.sumX;
+	target.sumY += source.sumY;
+	target.sumXX += source.sumXX;
+	target.sumXY += source.sumXY;
+	target.sumYY += source.sumYY;
+}
+
+// ----------------------------------------------------------------------------------------------------
@@ -0,0 +1,168 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FContourLabeler.h
+//  Description		Header file for FContourLabeler.cpp
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-25 14:37:20 +0200 (So, 25 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#ifndef FCONTOURLABELER_H
+#define FCONTOURLABELER_H
+
+#include <vector>
+
+#include "FTrackMe.h"
+#include "FlowMath.h"
+#include "FDTPixel.h"
+#include "FWorkerPool.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FContourLabeler
+// ----------------------------------------------------------------------------------------------------
+
+/// Connected component labelling of the edge pixels (distance 0) of a distance transform image.
+/// A streaming pass over bands of rows assigns provisional labels to the 8-connected edge pixels,
+/// joins them with union-find and accumulates the moments of each label. A merge step joins the
+/// labels across band borders and numbers the fragments in the raster order of their first pixel.
+/// A second pass sets the index of every pixel to the fragment of its nearest edge pixel and
+/// collects the pixels of each fragment. The bands are processed by the workers of an optional
+/// FWorkerPool, the result does not depend on the number of workers.
+class FContourLabeler : private FWorkerTask
+{
+	//  Public types -----------------------------------------------------------
+
+public:
+	/// Connected set of edge pixels.
+	struct fragment_t
+	{
+		size_t first;			// first pixel in points()
+		int length;
+		bool isClosed;			// true if the pixels form at least one loop
+		FVector2f mean;
+		FRect2f boundingBox;
+		FVector3f covariance;	// central second moments xx, xy, yy
+	};
+
+	//  Constructors and destructor --------------------------------------------
+
+public:
+	/// Default Constructor.
+	FContourLabeler();
+	/// Virtual destructor.
+	virtual ~FContourLabeler();
+
+private:
+	FContourLabeler(const FContourLabeler& other);
+	FContourLabeler& operator=(const FContourLabeler& other);
+
+	//  Public commands --------------------------------------------------------
+
+public:
+	/// Labels the edge pixels of the given image and sets the index of all pixels inside the
+	/// one pixel border, which must have a negative distance. Fragments beyond maxFragments are
+	/// ignored and their pixels get index -1. Returns the number of fragments.
+	size_t label(FDTPixelPacked* pData, const QSize& imageSize, size_t maxFragments);
+
+	/// Sets the worker pool used to process the bands. If NULL, the
+	/// bands are processed in the calling thread. The pool must not be used concurrently.
+	void setWorkerPool(FWorkerPool* pPool) { m_pWorkerPool = pPool; }
+
+	//  Public queries ---------------------------------------------------------
+
+public:
+	/// Returns the number of fragments found by the last call to label().
+	size_t fragmentCount() const { return m_fragments.size(); }
+	/// Returns the fragment with the given index.
+	const fragment_t& fragmentAt(size_t index) const {
+		F_ASSERT(index < m_fragments.size());
+		return m_fragments[index];
+	}
+	/// Returns the pixels of all fragments, valid until the next call to label().
+	FVector2f* points() { return m_points.empty() ? NULL : &m_points[0]; }
+
+	//  Internal types ---------------------------------------------------------
+
+private:
+	/// Provisional label. Labels are numbered by band and in the order of their first pixel,
+	/// the root of a set of joined labels is the label with the smallest number.
+	struct label_t
+	{
+		quint32 parent;
+		quint32 fragment;
+		quint32 count;
+		quint32 edgeCount;		// see _edgeCount()
+		quint32 offset;			// next position in the point buffer
+		float minX, minY, maxX, maxY;
+		double sumX, sumY, sumXX, sumXY, sumYY;
+	};
+
+	typedef std::vector<label_t> labelList_t;
+
+	enum pass_t
+	{
+		LabelPass,
+		CollectPass
+	};
+
+	//  Overrides --------------------------------------------------------------
+
+private:
+	virtual void runTask(size_t taskIndex, size_t workerIndex);
+
+	//  Internal functions -----------------------------------------------------
+
+private:
+	void _runPass(pass_t pass);
+	void _labelBand(size_t band);
+	void _collectBand(size_t band);
+	void _merge(size_t maxFragments);
+
+	quint32 _findRoot(quint32 label);
+	void _join(quint32 label0, quint32 label1);
+	/// Adds the sums of the given label to the other.
+	static void _addLabel(label_t& target, const label_t& source);
+
+	/// Returns the number of edges to the 8-connected edge pixels right and below the given one.
+	/// Diagonal neighbors only count if they are not connected by a common 4-neighbor, so
+	/// a fragment forms a loop if it has at least as many edges as pixels.
+	int _edgeCount(const FDTPixelPacked* pPixel) const {
+		int nx = m_width;
+		bool e = pPixel[1].distance == 0;
+		bool w = pPixel[-1].distance == 0;
+		bool s = pPixel[nx].distance == 0;
+		return (int)e + (int)s + (int)(!e && !s && pPixel[nx + 1].distance == 0)
+			+ (int)(!w && !s && pPixel[nx - 1].distance == 0);
+	}
+
+	label_t& _label(quint32 label) {
+		return m_bands[label >> LABEL_BITS][label & LABEL_MASK];
+	}
+
+	//  Internal data members --------------------------------------------------
+
+private:
+	static const int ROWS_PER_TASK = 16;
+	static const quint32 LABEL_BITS = 16;
+	static const quint32 LABEL_MASK = (1 << LABEL_BITS) - 1;
+	static const quint32 NO_LABEL = 0xffffffff;
+	static const quint32 NO_FRAGMENT = 0xffffffff;
+
+	FDTPixelPacked* m_pData;
+	int m_width;
+	int m_height;
+	int m_rowsPerBand;
+
+	std::vector<quint32> m_pixelLabels;
+	std::vector<labelList_t> m_bands;
+	std::vector<label_t> m_fragmentSums;
+	std::vector<fragment_t> m_fragments;
+	std::vector<FVector2f> m_points;
+
+	FWorkerPool* m_pWorkerPool;
+	pass_t m_pass;
+};
+
+// ----------------------------------------------------------------------------------------------------
+
+#endif // FCONTOURLABELER_H
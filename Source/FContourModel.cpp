@@ -8,6 +8,7 @@
 // ----------------------------------------------------------------------------------------------------
 
 #include "FTrackMeStable.h"
+#include <algorithm>
 #include <QMessageBox>
 
 #include <assimp.hpp>
@@ -50,8 +51,9 @@ bool FContourModel::import(const QString& filePath)
 		return false;
 	}
 
+	// the GL resources are recreated on the next draw
 	m_filePath = filePath;
-	_createGL();
+	_releaseGL();
 	return true;
 }
 
@@ -61,6 +63,9 @@ void FContourModel::draw() const
 	if (!isValid())
 		return;
 
+	if (!m_vertexArray.isValid())
+		_createGL();
+
 	m_vertexArray.draw(FGLPrimitiveType::Lines, 0, m_lines.size() * 2);
 	F_GLERROR_ASSERT;
 }
@@ -72,6 +77,9 @@ void FContourModel::draw(size_t contourIndex) const
 	if (!isValid())
 		return;
 
+	if (!m_vertexArray.isValid())
+		_createGL();
+
 	m_vertexArray.draw(FGLPrimitiveType::Lines,
 		m_contours[contourIndex].firstVertex, m_contours[contourIndex].vertexCount);
 	F_GLERROR_ASSERT;
@@ -104,7 +112,7 @@ void FContourModel::serialize(FArchive& ar)
 
 		ar >> m_filePath;
 		_calculateBoundingBox();
-		_createGL();
+		_releaseGL();
 	}
 	else
 	{
@@ -130,6 +138,38 @@ void FContourModel::serialize(FArchive& ar)
 	}
 }
 
+void FContourModel::rasterize(const FMatrix4f& matMVP, const QSize& imageSize, float* pSeedImage) const
+{
+	F_ASSERT(pSeedImage && !imageSize.isEmpty());
+
+	int nx = imageSize.width();
+	int ny = imageSize.height();
+	std::fill(pSeedImage, pSeedImage + nx * ny, 0.0f);
+
+	// lines are drawn in order without depth test, the last line wins
+	for (size_t i = 0; i < m_lines.size(); i++)
+	{
+		const line_t& line = m_lines[i];
+		const FVector3f& p0 = line.v0.pos;
+		const FVector3f& p1 = line.v1.pos;
+
+		FVector4f c0 = matMVP * FVector4f(p0.x(), p0.y(), p0.z(), 1.0f);
+		FVector4f c1 = matMVP * FVector4f(p1.x(), p1.y(), p1.z(), 1.0f);
+		if (!_clipLine(c0, c1))
+			continue;
+
+		// window coordinates of the viewport (0, 0, nx, ny)
+		float x0 = (c0.x() / c0.w() + 1.0f) * 0.5f * nx;
+		float y0 = (c0.y() / c0.w() + 1.0f) * 0.5f * ny;
+		float x1 = (c1.x() / c1.w() + 1.0f) * 0.5f * nx;
+		float y1 = (c1.y() / c1.w() + 1.0f) * 0.5f * ny;
+
+		// the flat index is written to an 8 bit unsigned normalized target
+		float value = floorf(fMinMax(line.v0.index, 0.0f, 255.0f) + 0.5f) / 255.0f;
+		_rasterizeLine(x0, y0, x1, y1, value, nx, ny, pSeedImage);
+	}
+}
+
 // Public queries -------------------------------------------------------------------------------------
 
 void FContourModel::dump(QDebug& debug) const
@@ -147,7 +187,7 @@ void FContourModel::dump(QDebug& debug) const
 
 // Internal functions ---------------------------------------------------------------------------------
 
-void FContourModel::_createGL()
+void FContourModel::_createGL() const
 {
 	size_t numVertices = m_lines.size() * 2;
 	size_t numBytes = m_lines.size() * sizeof(line_t);
@@ -168,6 +208,63 @@ void FContourModel::_releaseGL()
 	m_vertexBuffer.release();
 }
 
+bool FContourModel::_clipLine(FVector4f& c0, FVector4f& c1)
+{
+	// x and y are clipped to the image during rasterization
+	for (int plane = 0; plane < 2; plane++)
+	{
+		float sign = (plane == 0) ? 1.0f : -1.0f;
+		float d0 = c0.w() + sign * c0.z();
+		float d1 = c1.w() + sign * c1.z();
+
+		if (d0 < 0.0f && d1 < 0.0f)
+			return false;
+
+		if (d0 < 0.0f)
+			c0 = c0 + (c1 - c0) * (d0 / (d0 - d1));
+		else if (d1 < 0.0f)
+			c1 = c1 + (c0 - c1) * (d1 / (d1 - d0));
+	}
+
+	return true;
+}
+
+void FContourModel::_rasterizeLine(float x0, float y0, float x1, float y1, float value,
+								   int nx, int ny, float* pImage)
+{
+	// step along the major axis a, the minor axis b is sampled at the pixel centers
+	bool isSteep = fabsf(y1 - y0) > fabsf(x1 - x0);
+	if (isSteep)
+	{
+		std::swap(x0, y0);
+		std::swap(x1, y1);
+	}
+	if (x0 > x1)
+	{
+		std::swap(x0, x1);
+		std::swap(y0, y1);
+	}
+
+	int na = isSteep ? ny : nx;
+	int nb = isSteep ? nx : ny;
+	float slope = (x1 > x0) ? (y1 - y0) / (x1 - x0) : 0.0f;
+
+	int a0 = (int)fMax(ceilf(x0 - 0.5f), 0.0f);
+	int a1 = (int)fMin(ceilf(x1 - 0.5f), (float)na);
+
+	for (int a = a0; a < a1; a++)
+	{
+		int b = (int)floorf(y0 + ((float)a + 0.5f - x0) * slope);
+		if (b < 0 || b >= nb)
+			continue;
+
+		if (isSteep)
+			pImage[a * nx + b] = value;
+		else
+			pImage[b * nx + a] = value;
+	}
+}
+
 bool FContourModel::_importModel(const QString& filePath)
 {
 	F_TRACE(QString("FContourModel::_importModel - Importing %1").arg(filePath));
@@ -202,9 +299,14 @@ bool FContourModel::_importModel(const QString& filePath)
 
 	if (!pass)
 	{
-		QMessageBox::warning(NULL, "Contour Model Import",
-			QString("Warning: Model is not planar in xy-plane (max z-value: %1).\r\n"
-			"All z-values will be forced to zero which may lead to unexpected results.").arg(maxAbsZ));
+		QString message = QString("Warning: Model is not planar in xy-plane (max z-value: %1).\r\n"
+			"All z-values will be forced to zero which may lead to unexpected results.").arg(maxAbsZ);
+
+		// no message box when running without user interface
+		if (qobject_cast<QApplication*>(QCoreApplication::instance()))
+			QMessageBox::warning(NULL, "Contour Model Import", message);
+		else
+			fWarning("ContourModel", message);
 	}
 	else
 		F_TRACE("FContourModel::_importModel - xy-plane test passed");
@@ -21,7 +21,8 @@
 // ----------------------------------------------------------------------------------------------------
 
 /// Imported line model for DT contour classifier training.
-/// Supports OpenGL drawing of line contours.
+/// Supports OpenGL drawing of line contours, the GL resources are created on the first draw.
+/// The contours can also be rasterized on the CPU, e.g. for training without OpenGL.
 class  FContourModel
 {
 	//  Constructors and destructor --------------------------------------------
@@ -40,13 +41,19 @@ public:
 	void draw() const;
 	void draw(size_t contourIndex) const;
 
+	/// Rasterizes the lines of all contours like draw() with the training shader, without
+	/// using OpenGL. The image has one float per pixel and is cleared to 0, the pixels of a
+	/// contour are set to its index / 255, as read back from the 8 bit GL target. Rows are
+	/// ordered bottom-up like in an OpenGL framebuffer of the given size.
+	void rasterize(const FMatrix4f& matMVP, const QSize& imageSize, OUT float* pSeedImage) const;
+
 	/// Serialization.
 	void serialize(FArchive& ar);
 
 	//  Public queries ---------------------------------------------------------
 
 	/// Returns true if the model has been loaded and initialized properly.
-	bool isValid() const { return m_vertexArray.isValid(); }
+	bool isValid() const { return !m_lines.empty(); }
 
 	/// Returns the file path of the contour model.
 	const QString& filePath() const { return m_filePath; }
@@ -74,11 +81,19 @@ public:
 	//  Internal functions -----------------------------------------------------
 
 private:
-	void _createGL();
+	void _createGL() const;
 	void _releaseGL();
 	bool _importModel(const QString& filePath);
 	void _getEdgesFromNode(const aiScene* pScene, const aiNode* pNode, FMatrix4f trafo);
 	void _calculateBoundingBox();
+
+	/// Clips the line to the near and far plane in clip coordinates. Returns false if
+	/// the line is outside.
+	static bool _clipLine(FVector4f& c0, FVector4f& c1);
+	/// Sets the pixels whose centers are crossed by the line along its major axis, i.e.
+	/// the pixels drawn by OpenGL for a line of width 1, ignoring the last pixel.
+	static void _rasterizeLine(float x0, float y0, float x1, float y1, float value,
+		int nx, int ny, float* pImage);
 	
 	//  Internal data members --------------------------------------------------
 
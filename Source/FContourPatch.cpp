@@ -9,6 +9,7 @@
 
 #include "FTrackMeStable.h"
 
+#include <emmintrin.h>
 #include "FlowGL.h"
 #include "FContour.h"
 
@@ -19,6 +20,10 @@
 //  Class FContourPatch
 // ----------------------------------------------------------------------------------------------------
 
+// Static members -------------------------------------------------------------------------------------
+
+bool FContourPatch::s_isSSE2WarpEnabled = false;
+
 // Constructors and destructor ------------------------------------------------------------------------
 
 FContourPatch::FContourPatch()
@@ -30,10 +35,11 @@ FContourPatch::FContourPatch()
 
 FContourPatch::FContourPatch(const QSize& patchSize)
 : m_patchSize(patchSize),
+  m_pPatch(NULL),
   m_pContour(NULL)
 {
 	F_ASSERT(!patchSize.isEmpty());
-	m_pPatch = new float[patchSize.width() * patchSize.height()];
+	_allocatePatch();
 }
 
 FContourPatch::~FContourPatch()
@@ -43,7 +49,49 @@ FContourPatch::~FContourPatch()
 
 // Public commands ------------------------------------------------------------------------------------
 
-void FContourPatch::warpImage(const FDTPixel* pImage, int nx, int ny, const FContour* pContour)
+void FContourPatch::warpImage(const FDTPixelPacked* pImage, int nx, int ny, const FContour* pContour)
+{
+	_warpImage(pImage, nx, ny, pContour, s_isSSE2WarpEnabled);
+}
+
+void FContourPatch::setPatchSize(const QSize& patchSize)
+{
+	F_ASSERT(!patchSize.isEmpty());
+	m_patchSize = patchSize;
+	_allocatePatch();
+}
+
+// Public queries -------------------------------------------------------------------------------------
+
+size_t FContourPatch::compareWarp(const FDTPixelPacked* pImage, int nx, int ny, const FContour* pContour)
+{
+	size_t numPixels = m_patchSize.width() * m_patchSize.height();
+
+	_warpImage(pImage, nx, ny, pContour, false);
+	std::vector<float> reference(m_pPatch, m_pPatch + numPixels);
+	_warpImage(pImage, nx, ny, pContour, true);
+
+	size_t mismatchCount = 0;
+	for (size_t i = 0; i < numPixels; i++)
+	{
+		if (memcmp(&reference[i], &m_pPatch[i], sizeof(float)) != 0)
+			mismatchCount++;
+	}
+
+	return mismatchCount;
+}
+
+void FContourPatch::drawToTexture(FGLTextureRect& texture)
+{
+	size_t numBytes = m_patchSize.width() * m_patchSize.height() * sizeof(float);
+
+	texture.createInitialize(FGLPixelFormat::R32_Float, m_patchSize,
+		FGLDataFormat::Red, FGLDataType::Float, numBytes, m_pPatch, false); // DO NOT FLIP
+}
+
+// Internal functions ---------------------------------------------------------------------------------
+
+void FContourPatch::_warpImage(const FDTPixelPacked* pImage, int nx, int ny, const FContour* pContour, bool useSSE2)
 {
 	F_ASSERT(pImage);
 	F_ASSERT(pContour);
@@ -61,7 +109,6 @@ void FContourPatch::warpImage(const FDTPixel* pImage, int nx, int ny, const FCon
 	int sx = m_patchSize.width();
 	int sy = m_patchSize.height();
 
-	float dx = 1.0f / sx;
 	float dy = 1.0f / sy;
 
 	for (int y = 0; y < sy; y++)
@@ -69,55 +116,12 @@ void FContourPatch::warpImage(const FDTPixel* pImage, int nx, int ny, const FCon
 		float ty = y * dy;
 		FVector2f p2 = p0 + d0 * ty;
 		FVector2f d2 = p1 + d1 * ty - p2;
-		int yy = y * sx;
-
-		for (int x = 0; x < sx; x++)
-		{
-			float tx = x * dx;
-			FVector2f p = p2 + tx * d2;
-
-			// coordinates of the four neighboring pixels for bi-linear interpolation
-			int ix0 = p.x();
-			int ix1 = ix0 + 1;
-			float ixt = p.x() - ix0;
-			float ixtInv = 1.0f - ixt;
-			int iy0 = p.y();
-			int iy1 = iy0 + 1;
-			float iyt = p.y() - iy0;
-			float iytInv = 1.0f - iyt;
-
-			if(ix0 >= 0 && ix1 < nx && iy0 >= 0 && iy1 < ny)
-			{
-				const FDTPixel& pix00 = pImage[iy0 * nx + ix0];
-				const FDTPixel& pix01 = pImage[iy0 * nx + ix1];
-				const FDTPixel& pix10 = pImage[iy1 * nx + ix0];
-				const FDTPixel& pix11 = pImage[iy1 * nx + ix1];
-
-				int i00 = (int)pix00.index;
-				int i01 = (int)pix01.index;
-				int i10 = (int)pix10.index;
-				int i11 = (int)pix11.index;
-
-				// bi-linear interpolation of distance value
-				float d = (pix00.distance * ixtInv + pix01.distance * ixt) * iytInv
-					+ (pix10.distance * ixtInv + pix11.distance * ixt) * iyt;
-
-				if (index == -1 || (i00 == index && i01 == index && i10 == index && i11 == index))
-				{
-					m_pPatch[yy + x] = d;
-				}
-				else // mask out pixels with a different contour index
-				{
-					m_pPatch[yy + x] = -d - 10.0f;
-				}
-			}
-			else // mask out pixels outside image boundaries
-			{
-				m_pPatch[yy + x] = FLT_MAX;
-			}
 
-		} // for x
-	} // for y
+		if (useSSE2)
+			_warpRowSSE2(pImage, nx, ny, index, p2, d2, m_pPatch + y * sx);
+		else
+			_warpRow(pImage, nx, ny, index, p2, d2, m_pPatch + y * sx);
+	}
 
 	// mark outer area of contour shape
 	float minSqDist = 7.0f * 7.0f;
@@ -149,135 +153,204 @@ void FContourPatch::warpImage(const FDTPixel* pImage, int nx, int ny, const FCon
 			m_pPatch[i] = -m_pPatch[i] - 10.0f;
 }
 
-void FContourPatch::setPatchSize(const QSize& patchSize)
+void FContourPatch::_allocatePatch()
 {
-	F_ASSERT(!patchSize.isEmpty());
+	int sx = m_patchSize.width();
+	int sy = m_patchSize.height();
+
+	// the last row is stored four pixels at a time as well
+	int paddedWidth = (sx + 3) & ~3;
 	F_SAFE_DELETE_ARRAY(m_pPatch);
-	m_patchSize = patchSize;
-	m_pPatch = new float[patchSize.width() * patchSize.height()];
-}
+	m_pPatch = new float[(sy - 1) * sx + paddedWidth];
 
-// Public queries -------------------------------------------------------------------------------------
+	float dx = 1.0f / sx;
+	m_columnSteps.resize(paddedWidth);
+	for (int x = 0; x < paddedWidth; x++)
+		m_columnSteps[x] = x * dx;
 
-void FContourPatch::getDescriptor(const FFernTest& test, quint32* pResult) const
+	m_fillStack.reserve(sx + sy);
+}
+
+void FContourPatch::_warpRow(const FDTPixelPacked* pImage, int nx, int ny, int index,
+	const FVector2f& p2, const FVector2f& d2, float* pRow)
 {
-	quint32 nf = test.numFerns();
-	quint32 nb = test.numBits();
+	int sx = m_patchSize.width();
+	float dx = 1.0f / sx;
 
-	for (quint32 f = 0; f < nf; f++)
+	// same evaluation as the warp the classifier databases have been trained with
+	for (int x = 0; x < sx; x++)
 	{
-		quint32 dc = 0;
-		
-		for (quint32 b = 0; b < nb; b++)
+		float tx = x * dx;
+		FVector2f p = p2 + tx * d2;
+
+		// coordinates of the four neighboring pixels for bi-linear interpolation
+		int ix0 = p.x();
+		int ix1 = ix0 + 1;
+		float ixt = p.x() - ix0;
+		float ixtInv = 1.0f - ixt;
+		int iy0 = p.y();
+		int iy1 = iy0 + 1;
+		float iyt = p.y() - iy0;
+		float iytInv = 1.0f - iyt;
+
+		if (ix0 >= 0 && ix1 < nx && iy0 >= 0 && iy1 < ny)
 		{
-			quint32 i0, i1;
-			test.testIndex(f, b, i0, i1);
-			F_ASSERT(i0 < m_patchSize.width() * m_patchSize.height());
-			F_ASSERT(i1 < m_patchSize.width() * m_patchSize.height());
+			const FDTPixelPacked& pix00 = pImage[iy0 * nx + ix0];
+			const FDTPixelPacked& pix01 = pImage[iy0 * nx + ix1];
+			const FDTPixelPacked& pix10 = pImage[iy1 * nx + ix0];
+			const FDTPixelPacked& pix11 = pImage[iy1 * nx + ix1];
 
-			float d0 = m_pPatch[i0];
-			float d1 = m_pPatch[i1];
+			// bi-linear interpolation of distance value
+			float d = (pix00.squaredDistance() * ixtInv + pix01.squaredDistance() * ixt) * iytInv
+				+ (pix10.squaredDistance() * ixtInv + pix11.squaredDistance() * ixt) * iyt;
 
-			dc <<= 1;
-			if (d0 >= 0.0f && d1 > d0)
-				dc++;
+			if (index == -1 || (pix00.index == index && pix01.index == index
+				&& pix10.index == index && pix11.index == index))
+			{
+				pRow[x] = d;
+			}
+			else // mask out pixels with a different contour index
+			{
+				pRow[x] = -d - 10.0f;
+			}
+		}
+		else // mask out pixels outside image boundaries
+		{
+			pRow[x] = FLT_MAX;
 		}
-
-		F_ASSERT(dc < (1 << nb));
-		pResult[f] = dc;
 	}
 }
 
-void FContourPatch::drawToTexture(FGLTextureRect& texture)
+void FContourPatch::_warpRowSSE2(const FDTPixelPacked* pImage, int nx, int ny, int index,
+	const FVector2f& p2, const FVector2f& d2, float* pRow)
 {
-	size_t numBytes = m_patchSize.width() * m_patchSize.height() * sizeof(float);
+	const __m128 p2x = _mm_set1_ps(p2.x());
+	const __m128 p2y = _mm_set1_ps(p2.y());
+	const __m128 d2x = _mm_set1_ps(d2.x());
+	const __m128 d2y = _mm_set1_ps(d2.y());
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 maskOffset = _mm_set1_ps(10.0f);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	const __m128 outside = _mm_set1_ps(FLT_MAX);
+	const __m128i minusOne = _mm_set1_epi32(-1);
+	const __m128i maxX = _mm_set1_epi32(nx - 1);
+	const __m128i maxY = _mm_set1_epi32(ny - 1);
 
-	texture.createInitialize(FGLPixelFormat::R32_Float, m_patchSize,
-		FGLDataFormat::Red, FGLDataType::Float, numBytes, m_pPatch, false); // DO NOT FLIP
-}
+	int sx = m_patchSize.width();
 
-// Internal functions ---------------------------------------------------------------------------------
+	// a row is written in blocks of four pixels, surplus pixels are overwritten by the
+	// next row or end up in the padding of the last row
+	for (int x = 0; x < sx; x += 4)
+	{
+		__m128 tx = _mm_loadu_ps(&m_columnSteps[x]);
+		__m128 px = _mm_add_ps(p2x, _mm_mul_ps(tx, d2x));
+		__m128 py = _mm_add_ps(p2y, _mm_mul_ps(tx, d2y));
+
+		// coordinates of the four neighboring pixels for bi-linear interpolation
+		__m128i ix0 = _mm_cvttps_epi32(px);
+		__m128i iy0 = _mm_cvttps_epi32(py);
+		__m128 ixt = _mm_sub_ps(px, _mm_cvtepi32_ps(ix0));
+		__m128 iyt = _mm_sub_ps(py, _mm_cvtepi32_ps(iy0));
+		__m128 ixtInv = _mm_sub_ps(one, ixt);
+		__m128 iytInv = _mm_sub_ps(one, iyt);
+
+		__m128i isInside = _mm_and_si128(
+			_mm_and_si128(_mm_cmpgt_epi32(ix0, minusOne), _mm_cmpgt_epi32(maxX, ix0)),
+			_mm_and_si128(_mm_cmpgt_epi32(iy0, minusOne), _mm_cmpgt_epi32(maxY, iy0)));
+
+		int ix[4], iy[4], inside[4];
+		_mm_storeu_si128((__m128i*)ix, ix0);
+		_mm_storeu_si128((__m128i*)iy, iy0);
+		_mm_storeu_si128((__m128i*)inside, isInside);
+
+		// gather the distances, lanes outside the image are replaced below
+		float d00[4], d01[4], d10[4], d11[4];
+		int isMatch[4];
+
+		for (int i = 0; i < 4; i++)
+		{
+			if (!inside[i])
+			{
+				d00[i] = d01[i] = d10[i] = d11[i] = 0.0f;
+				isMatch[i] = -1;
+				continue;
+			}
 
-void FContourPatch::_fillArea(int x, int y, float minDist)
-{
-	int cx = m_patchSize.width();
-	int cy = m_patchSize.height();
+			const FDTPixelPacked* pPix = pImage + iy[i] * nx + ix[i];
+			d00[i] = pPix[0].squaredDistance();
+			d01[i] = pPix[1].squaredDistance();
+			d10[i] = pPix[nx].squaredDistance();
+			d11[i] = pPix[nx + 1].squaredDistance();
 
-	bool spanLeft, spanRight;
-	float* pLine = NULL;
-	float pixel = 0.0f;
-	FVector2i p(x, y);
+			isMatch[i] = (index == -1 || (pPix[0].index == index && pPix[1].index == index
+				&& pPix[nx].index == index && pPix[nx + 1].index == index)) ? -1 : 0;
+		}
 
-	emptyStack();
-	push(p);
+		// bi-linear interpolation of distance value
+		__m128 d = _mm_add_ps(
+			_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(d00), ixtInv), _mm_mul_ps(_mm_loadu_ps(d01), ixt)), iytInv),
+			_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(d10), ixtInv), _mm_mul_ps(_mm_loadu_ps(d11), ixt)), iyt));
 
-	while(pop(p))
-	{    
-		x = p.x();
-		y = p.y();
+		// mask out pixels with a different contour index and outside image boundaries
+		__m128 matchMask = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)isMatch));
+		__m128 masked = _mm_sub_ps(_mm_xor_ps(d, signBit), maskOffset);
+		__m128 result = _mm_or_ps(_mm_and_ps(matchMask, d), _mm_andnot_ps(matchMask, masked));
 
-		pLine = m_pPatch + y * cx;
-		pixel = pLine[x];
+		__m128 insideMask = _mm_castsi128_ps(isInside);
+		result = _mm_or_ps(_mm_and_ps(insideMask, result), _mm_andnot_ps(insideMask, outside));
 
-		while (pixel >= minDist || pixel <= -10.0f)
-		{
-			y--;
-			if (y < 0)
-				break;
+		_mm_storeu_ps(pRow + x, result);
+	}
+}
 
-			pLine = m_pPatch + y * cx;
-			pixel = pLine[x];
-		}
+void FContourPatch::_fillArea(int x, int y, float minDist)
+{
+	// scanline fill, each seed is extended to a run of outer pixels within its row,
+	// which seeds the runs of the rows above and below
+	int cx = m_patchSize.width();
+	int cy = m_patchSize.height();
 
-		y++;
-		spanLeft = spanRight = false;
+	m_fillStack.clear();
+	m_fillStack.push_back(FVector2i(x, y));
 
-		if (y < cy)
-		{
-			pLine = m_pPatch + y * cx;
-			pixel = pLine[x];
+	while (!m_fillStack.empty())
+	{
+		FVector2i p = m_fillStack.back();
+		m_fillStack.pop_back();
 
-			while (pixel >= minDist || pixel <= -10.0f)
-			{
-				if (pLine[x] < -10.0f)
-					pLine[x] = -1.0f;
-				else
-					pLine[x] = -2.0f;
-
-				if (x > 0)
-				{
-					BOOL isFeat = (pLine[x-1] >= minDist || pLine[x-1] <= -10.0f);
-					if (!spanLeft && isFeat)
-					{
-						if (!push(FVector2i(x - 1, y)))
-							return;
-						spanLeft = true;
-					}
-					else if (spanLeft && !isFeat)
-						spanLeft = false;
-				}
-				if (x < cx - 1)
-				{
-					BOOL isFeat = (pLine[x+1] >= minDist || pLine[x+1] <= -10.0f);
-					if (!spanRight && isFeat)
-					{
-						if (!push(FVector2i(x + 1, y)))
-							return;
-						spanRight = true;
-					}
-					else if (spanRight && !isFeat)
-						spanRight = false;
-				}
-
-				y++;
-				if (y >= cy)
-					break;
-
-				pLine = m_pPatch + y * cx;
-				pixel = pLine[x];
-			}
+		y = p.y();
+		float* pLine = m_pPatch + y * cx;
+		if (!_isOuter(pLine[p.x()], minDist))
+			continue;
+
+		int x0 = p.x();
+		int x1 = p.x();
+		while (x0 > 0 && _isOuter(pLine[x0 - 1], minDist))
+			x0--;
+		while (x1 < cx - 1 && _isOuter(pLine[x1 + 1], minDist))
+			x1++;
+
+		for (int i = x0; i <= x1; i++)
+			pLine[i] = (pLine[i] < -10.0f) ? -1.0f : -2.0f;
+
+		if (y > 0)
+			_pushRuns(x0, x1, y - 1, minDist);
+		if (y < cy - 1)
+			_pushRuns(x0, x1, y + 1, minDist);
+	}
+}
 
-		}
+void FContourPatch::_pushRuns(int x0, int x1, int y, float minDist)
+{
+	const float* pLine = m_pPatch + y * m_patchSize.width();
+	bool isInRun = false;
+
+	for (int x = x0; x <= x1; x++)
+	{
+		bool isOuter = _isOuter(pLine[x], minDist);
+		if (isOuter && !isInRun)
+			m_fillStack.push_back(FVector2i(x, y));
+		isInRun = isOuter;
 	}
 }
 
@@ -10,6 +10,8 @@
 #ifndef FCONTOURPATCH_H
 #define FCONTOURPATCH_H
 
+#include <vector>
+
 #include "FTrackMe.h"
 #include "FQuad2T.h"
 #include "FDTPixel.h"
@@ -46,17 +48,37 @@ private:
 public:
 	/// Creates the warped patch from the given image using the patch coordinates.
 	/// Only the DT area corresponding to the given contour index is used, everything
-	/// else is masked. If index is set to -1, masking is skipped
-	void warpImage(const FDTPixel* pImage, int nx, int ny, const FContour* pContour);
+	/// else is masked. If index is set to -1, masking is skipped. The rows are sampled by
+	/// the scalar warp the classifier databases have been trained with, or four pixels at
+	/// a time with SSE2 if enabled, see setSSE2WarpEnabled().
+	void warpImage(const FDTPixelPacked* pImage, int nx, int ny, const FContour* pContour);
 
 	/// Sets or changes the patch size.
 	void setPatchSize(const QSize& patchSize);
 
+	/// Selects the SSE2 warp for all patches, disabled by default. The SSE2 warp rounds the
+	/// interpolation to single precision after each operation and may differ in the last bit
+	/// from the scalar warp, which can flip fern tests of existing databases. Enable it only
+	/// once compareWarp() reports no differences on real frames with the build in use.
+	/// Not thread-safe, call only while no patches are warped.
+	static void setSSE2WarpEnabled(bool enabled) { s_isSSE2WarpEnabled = enabled; }
+
 	//  Public queries ---------------------------------------------------------
 
 	/// Runs the binary tests of the given FFernTest object on the distance map
 	/// and returns an array of unsigned integers holding the descriptor for each fern.
-	void getDescriptor(const FFernTest& test, quint32* pResult) const;
+	void getDescriptor(const FFernTest& test, quint32* pResult) const {
+		F_ASSERT(test.patchSize().width() * test.patchSize().height() <= m_patchSize.width() * m_patchSize.height());
+		test.getDescriptor(m_pPatch, pResult);
+	}
+	/// Returns the warped distance map, one float per pixel.
+	const float* data() const { return m_pPatch; }
+
+	/// Returns true if the SSE2 warp is used.
+	static bool isSSE2WarpEnabled() { return s_isSSE2WarpEnabled; }
+	/// Warps the given contour with the scalar and the SSE2 warp and returns the number of patch
+	/// pixels that are not bitwise identical. The patch holds the result of the SSE2 warp.
+	size_t compareWarp(const FDTPixelPacked* pImage, int nx, int ny, const FContour* pContour);
 
 	/// Returns the width and height of this patch.
 	const QSize& patchSize() const { return m_patchSize; }
@@ -69,46 +91,36 @@ public:
 	//  Internal functions -----------------------------------------------------
 
 private:
+	void _allocatePatch();
+	void _warpImage(const FDTPixelPacked* pImage, int nx, int ny, const FContour* pContour, bool useSSE2);
+	void _warpRow(const FDTPixelPacked* pImage, int nx, int ny, int index,
+		const FVector2f& p2, const FVector2f& d2, float* pRow);
+	void _warpRowSSE2(const FDTPixelPacked* pImage, int nx, int ny, int index,
+		const FVector2f& p2, const FVector2f& d2, float* pRow);
+
+	/// Marks the 4-connected area of outer pixels containing the given pixel.
 	void _fillArea(int x, int y, float minDist);
+	/// Pushes the first pixel of each run of outer pixels between x0 and x1 in the given row.
+	void _pushRuns(int x0, int x1, int y, float minDist);
 
-	//  Simple stack implementation for 2d coordinates
-	inline bool push(const FVector2i& p) {
-		if (m_stackPointer + 1 < STACK_SIZE) {
-			m_pointStack[++m_stackPointer] = p;
-			return true;
-		}
-		else {
-			F_ASSERT(false);
-			return false;
-		}
-	}
-
-	inline bool pop(FVector2i& p) {
-		if (m_stackPointer >= 0) {
-			p = m_pointStack[m_stackPointer--];
-			return true;
-		}
-		else {
-			return false;
-		}
-	}
-
-	inline void emptyStack() {
-		m_stackPointer = -1;
+	/// Returns true if the pixel is far from the contour or masked.
+	static bool _isOuter(float pixel, float minDist) {
+		return pixel >= minDist || pixel <= -10.0f;
 	}
 
 	//  Internal data members --------------------------------------------------
 
 private:
 	QSize m_patchSize;
-	float* m_pPatch;
+	float* m_pPatch;					// padded to a multiple of 4 pixels
+	std::vector<float> m_columnSteps;	// interpolation parameter of each column
 
-	// Stack for flood fill
-	static const size_t STACK_SIZE = 256;
-	FVector2i m_pointStack[STACK_SIZE];
-	int m_stackPointer;
+	// Seed stack for the scanline fill
+	std::vector<FVector2i> m_fillStack;
 
 	const FContour* m_pContour;
+
+	static bool s_isSSE2WarpEnabled;
 };
 	
 // ----------------------------------------------------------------------------------------------------
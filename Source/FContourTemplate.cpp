@@ -11,6 +11,7 @@
 
 #include "Eigen/Dense"
 #include "levmar.h"
+#include "FLevmarWorkspace.h"
 #include "FlowGL.h"
 #include "FContour.h"
 #include "FContourTemplate.h"
@@ -28,32 +29,31 @@ FContourTemplate::FContourTemplate()
 : m_patchSize(0, 0),
   m_pDistanceMap(NULL),
   m_pGradientMap(NULL),
-  m_pCurrentContour(NULL)
+  m_ownsMaps(true)
 {
 }
 
 FContourTemplate::FContourTemplate(const QSize& patchSize)
 : m_patchSize(patchSize),
-  m_pCurrentContour(NULL)
+  m_pDistanceMap(NULL),
+  m_pGradientMap(NULL),
+  m_ownsMaps(true)
 {
-	int numPixels = m_patchSize.width() * m_patchSize.height();
-	m_pDistanceMap = new float[numPixels];
-	m_pGradientMap = new FVector2f[numPixels];
-
-	memset(m_pDistanceMap, 0, numPixels * sizeof(float));
-	memset(m_pGradientMap, 0, numPixels * sizeof(FVector2f));
+	_allocateMaps();
 }
 
 FContourTemplate::~FContourTemplate()
 {
-	F_SAFE_DELETE_ARRAY(m_pDistanceMap);
-	F_SAFE_DELETE_ARRAY(m_pGradientMap);
+	_releaseMaps();
 }
 
 // Public commands ------------------------------------------------------------------------------------
 
 void FContourTemplate::createMaps(const FContour* pContour)
 {
+	if (!m_ownsMaps)
+		_allocateMaps();
+
 	int numPixels = m_patchSize.width() * m_patchSize.height();
 	memset(m_pDistanceMap, 0, numPixels * sizeof(float));
 	memset(m_pGradientMap, 0, numPixels * sizeof(FVector2f));
@@ -78,6 +78,34 @@ void FContourTemplate::createMaps(const FContour* pContour)
 	_signedDistanceTransform();
 }
 
+void FContourTemplate::attachMaps(const QSize& patchSize,
+								  const float* pDistanceMap,
+								  const FVector2f* pGradientMap)
+{
+	F_ASSERT(pDistanceMap && pGradientMap);
+	_releaseMaps();
+
+	// the maps are never written while not owned, see createMaps()
+	m_patchSize = patchSize;
+	m_pDistanceMap = const_cast<float*>(pDistanceMap);
+	m_pGradientMap = const_cast<FVector2f*>(pGradientMap);
+	m_ownsMaps = false;
+}
+
+void FContourTemplate::detachMaps()
+{
+	if (m_ownsMaps)
+		return;
+
+	const float* pDistanceMap = m_pDistanceMap;
+	const FVector2f* pGradientMap = m_pGradientMap;
+	_allocateMaps();
+
+	int numPixels = m_patchSize.width() * m_patchSize.height();
+	memcpy(m_pDistanceMap, pDistanceMap, numPixels * sizeof(float));
+	memcpy(m_pGradientMap, pGradientMap, numPixels * sizeof(FVector2f));
+}
+
 void FContourTemplate::serialize(FArchive& ar)
 {
 	if (ar.isReading())
@@ -85,13 +113,10 @@ void FContourTemplate::serialize(FArchive& ar)
 		ar >> m_patchSize;
 		size_t numPixels = m_patchSize.width() * m_patchSize.height();
 
-		F_SAFE_DELETE_ARRAY(m_pDistanceMap);
-		m_pDistanceMap = new float[numPixels];
+		_allocateMaps();
 		for (size_t i = 0; i < numPixels; i++)
 			ar >> m_pDistanceMap[i];
 
-		F_SAFE_DELETE_ARRAY(m_pGradientMap);
-		m_pGradientMap = new FVector2f[numPixels];
 		for (size_t i = 0; i < numPixels; i++)
 			ar >> m_pGradientMap[i];
 	}
@@ -113,7 +138,7 @@ void FContourTemplate::matchContour(const FContour* pContour,
 									OUT float* pInfo) const
 {
 	F_ASSERT(pContour);
-	m_pCurrentContour = pContour;
+	levmarContext_t context = { this, pContour };
 
 	// levmar setup
 	int numData = pContour->length;
@@ -122,11 +147,11 @@ void FContourTemplate::matchContour(const FContour* pContour,
 	float opts[] = { 1e-3, 1e-6, 1e-6, 1e-6, 1e-6 }; // tau, eps1, eps2, eps3, delta
 	Eigen::Matrix<float, 8, 8> matCovar;
 	float* pCovar = matCovar.data();
-	float* pBuffer = FGlobalConstants::pLevmarDetectionWorkspace;
+	FLevmarWorkspace workspace(LM_DER_WORKSZ(8, numData), sizeof(float));
 
 	// run Levenberg-Marquardt optimization
-	int iter = slevmar_der(sLevmarUpdate, sLevmarJacobian,
-		params, NULL, 8, numData, 100, NULL /*opts*/, lmInfo, pBuffer, pCovar, (void*)this, 0, 0.0f);
+	int iter = slevmar_der(sLevmarUpdate, sLevmarJacobian, params, NULL, 8, numData, 100,
+		NULL /*opts*/, lmInfo, workspace.floatData(), pCovar, (void*)&context, 0, 0.0f);
 
 	float mse = lmInfo[1] / (float)numData;
 
@@ -154,6 +179,31 @@ void FContourTemplate::matchContour(const FContour* pContour,
 	}
 }
 
+float FContourTemplate::contourError(const FContour* pContour) const
+{
+	F_ASSERT(pContour && pContour->length > 0);
+
+	int nx = m_patchSize.width();
+	int ny = m_patchSize.height();
+	float fx = nx * 0.5f;
+	float fy = ny * 0.5f;
+
+	// same lookup as _levmarUpdate with the identity homography
+	float sum = 0.0f;
+	for (int i = 0; i < pContour->length; i++)
+	{
+		int px = (int)((pContour->pos[i].x() + 1.0f) * fx);
+		int py = (int)((pContour->pos[i].y() + 1.0f) * fy);
+		px = fMinMax(px, 0, nx - 1);
+		py = fMinMax(py, 0, ny - 1);
+
+		float d = m_pDistanceMap[py * nx + px];
+		sum += d * d;
+	}
+
+	return sum / (float)pContour->length;
+}
+
 void FContourTemplate::drawToTexture(FGLTextureRect& texture,
 									 const FContour* pContour /* = NULL */,
 									 const FMatrix3f* pHomography /* = NULL */) const
@@ -203,6 +253,32 @@ void FContourTemplate::drawToTexture(FGLTextureRect& texture,
 
 // Internal functions ---------------------------------------------------------------------------------
 
+void FContourTemplate::_allocateMaps()
+{
+	_releaseMaps();
+
+	int numPixels = m_patchSize.width() * m_patchSize.height();
+	m_pDistanceMap = new float[numPixels];
+	m_pGradientMap = new FVector2f[numPixels];
+	m_ownsMaps = true;
+
+	memset(m_pDistanceMap, 0, numPixels * sizeof(float));
+	memset(m_pGradientMap, 0, numPixels * sizeof(FVector2f));
+}
+
+void FContourTemplate::_releaseMaps()
+{
+	if (m_ownsMaps)
+	{
+		F_SAFE_DELETE_ARRAY(m_pDistanceMap);
+		F_SAFE_DELETE_ARRAY(m_pGradientMap);
+	}
+
+	m_pDistanceMap = NULL;
+	m_pGradientMap = NULL;
+	m_ownsMaps = true;
+}
+
 void FContourTemplate::_signedDistanceTransform()
 {
 	int numPixels = m_patchSize.width() * m_patchSize.height();
@@ -310,10 +386,11 @@ void FContourTemplate::_signedDistanceTransform()
 		m_pGradientMap[i] = -m_pGradientMap[i].normalized();
 }
 
-void FContourTemplate::_levmarUpdate(float* p, float* hx, int m, int n)
+void FContourTemplate::_levmarUpdate(const FContour* pContour,
+									 float* p, float* hx, int m, int n) const
 {
-	F_ASSERT(m_pCurrentContour);
-	F_ASSERT(m_pCurrentContour->length == n);
+	F_ASSERT(pContour);
+	F_ASSERT(pContour->length == n);
 	F_ASSERT(m == 8);
 
 	// denormalization of coordinates for lookup
@@ -335,8 +412,8 @@ void FContourTemplate::_levmarUpdate(float* p, float* hx, int m, int n)
 	for (int i = 0; i < n; i++)
 	{
 		// unwarped, normalized contour coordinates
-		float cx = m_pCurrentContour->pos[i].x();
-		float cy = m_pCurrentContour->pos[i].y();
+		float cx = pContour->pos[i].x();
+		float cy = pContour->pos[i].y();
 
 		// warped, normalized contour coordinates
 		float w = cx * p7 + cy * p8 + 1.0f;
@@ -357,10 +434,11 @@ void FContourTemplate::_levmarUpdate(float* p, float* hx, int m, int n)
 	}
 }
 
-void FContourTemplate::_levmarJacobian(float* p, float* j, int m, int n)
+void FContourTemplate::_levmarJacobian(const FContour* pContour,
+									 float* p, float* j, int m, int n) const
 {
-	F_ASSERT(m_pCurrentContour);
-	F_ASSERT(m_pCurrentContour->length == n);
+	F_ASSERT(pContour);
+	F_ASSERT(pContour->length == n);
 	F_ASSERT(m == 8);
 
 	// denormalization of coordinates for lookup
@@ -383,8 +461,8 @@ void FContourTemplate::_levmarJacobian(float* p, float* j, int m, int n)
 	for (int i = 0; i < n; i++)
 	{
 		// unwarped, normalized contour coordinates
-		float cx = m_pCurrentContour->pos[i].x();
-		float cy = m_pCurrentContour->pos[i].y();
+		float cx = pContour->pos[i].x();
+		float cy = pContour->pos[i].y();
 
 		// warped, normalized contour coordinates
 		float w = cx * p7 + cy * p8 + 1.0f;
@@ -24,16 +24,29 @@ class FGLTextureRect;
 
 class FContourTemplate
 {
+	//  Internal types ---------------------------------------------------------
+
+private:
+	/// Per-call solver data, passed to the levmar callbacks. Keeps matchContour()
+	/// free of shared state so it can be called from several threads at once.
+	struct levmarContext_t
+	{
+		const FContourTemplate* pTemplate;
+		const FContour* pContour;
+	};
+
 	//  Static callbacks -------------------------------------------------------
 
 private:
 	inline static void sLevmarUpdate(float* p, float* hx, int m, int n, void* pData) {
 		F_ASSERT(pData);
-		((FContourTemplate*)pData)->_levmarUpdate(p, hx, m, n);
+		const levmarContext_t* pContext = (const levmarContext_t*)pData;
+		pContext->pTemplate->_levmarUpdate(pContext->pContour, p, hx, m, n);
 	}
 	inline static void sLevmarJacobian(float* p, float* j, int m, int n, void* pData) {
 		F_ASSERT(pData);
-		((FContourTemplate*)pData)->_levmarJacobian(p, j, m, n);
+		const levmarContext_t* pContext = (const levmarContext_t*)pData;
+		pContext->pTemplate->_levmarJacobian(pContext->pContour, p, j, m, n);
 	}
 
 	//  Constructors and destructor --------------------------------------------
@@ -56,6 +69,12 @@ public:
 	/// From the given contour, create the distance map and the distance gradient map.
 	/// The contour positions must be normalized to (0, 0) - (1, 1).
 	void createMaps(const FContour* pContour);
+	/// Uses the given distance and gradient maps without copying them, e.g. from a memory
+	/// mapped database file. The maps must stay valid for the lifetime of the template.
+	/// createMaps() and serialize() replace them with maps owned by the template.
+	void attachMaps(const QSize& patchSize, const float* pDistanceMap, const FVector2f* pGradientMap);
+	/// Copies attached maps to memory owned by the template.
+	void detachMaps();
 
 	/// Serialization.
 	void serialize(FArchive& ar);
@@ -66,11 +85,22 @@ public:
 	/// this class by optimizing a homography warp. The function returns the
 	/// parameters of the homography. pInfo[0] contains the mean squared error.
 	/// If the MSE is < 10.0, pInfo[1] contains the 1st PCA component of the covariance matrix.
+	/// The function is reentrant and may be called concurrently on the same template.
 	void matchContour(const FContour* pNormalizedContour,
 		OUT FMatrix3f& homography, OUT float* pInfo = NULL) const;
+	/// Returns the mean squared distance of the given normalized contour pixels to the
+	/// distance map without warping. This is the error matchContour() starts from and
+	/// serves as a cheap estimate of how well the contour fits.
+	float contourError(const FContour* pNormalizedContour) const;
 
 	/// Returns the size of the template patch.
 	const QSize& patchSize() const { return m_patchSize; }
+	/// Returns the distance map, one float per pixel.
+	const float* distanceMap() const { return m_pDistanceMap; }
+	/// Returns the distance gradient map, one vector per pixel.
+	const FVector2f* gradientMap() const { return m_pGradientMap; }
+	/// Returns false if the maps have been attached with attachMaps().
+	bool ownsMaps() const { return m_ownsMaps; }
 
 	/// Draws the warped distance transform map to the given texture.
 	/// If a contour and homography are given, the contour is drawn over the distance transform map.
@@ -80,9 +110,11 @@ public:
 	//  Internal functions -----------------------------------------------------
 
 private:
+	void _allocateMaps();
+	void _releaseMaps();
 	void _signedDistanceTransform();
-	void _levmarUpdate(float* p, float* hx, int m, int n);
-	void _levmarJacobian(float* p, float* j, int m, int n);
+	void _levmarUpdate(const FContour* pContour, float* p, float* hx, int m, int n) const;
+	void _levmarJacobian(const FContour* pContour, float* p, float* j, int m, int n) const;
 
 	//  Internal data members --------------------------------------------------
 
@@ -90,8 +122,7 @@ private:
 	QSize m_patchSize;
 	float* m_pDistanceMap;
 	FVector2f* m_pGradientMap;
-
-	mutable const FContour* m_pCurrentContour;
+	bool m_ownsMaps;
 };
 
 // ----------------------------------------------------------------------------------------------------
@@ -17,12 +17,60 @@
 //  Struct FDTPixel
 // ----------------------------------------------------------------------------------------------------
 
+/// Distance transform pixel as rendered by the jump flooding shaders (RGBA, 32 bit float):
+/// offset to the nearest seed, squared distance and seed or contour index.
 struct FDTPixel
 {
 	FVector2f offset;
 	float distance;
 	float index;
 };
+
+// ----------------------------------------------------------------------------------------------------
+//  Struct FDTPixelPacked
+// ----------------------------------------------------------------------------------------------------
+
+/// Distance transform pixel in the packed layout used by the detection pipeline (RGBA, 16 bit
+/// signed integer). Offsets and squared distances of the jump flooding result are integers
+/// and are stored exactly, except that the distance is clamped to MAX_DISTANCE, about 181
+/// pixels. The clamped distance suffices for the edge tests; squaredDistance() restores the
+/// distance of the float layout from the offsets and is used wherever distances are compared,
+/// e.g. by the fern tests of FContourPatch. A distance of -1 marks the image border, an index
+/// of -1 marks pixels which belong to no contour.
+struct FDTPixelPacked
+{
+	static const qint16 MAX_DISTANCE = 32767;
+
+	qint16 offsetX;
+	qint16 offsetY;
+	qint16 distance;
+	qint16 index;
+
+	/// Sets the pixel from the given float pixel, the index is taken as is.
+	void pack(const FDTPixel& pixel) {
+		offsetX = (qint16)pixel.offset.x();
+		offsetY = (qint16)pixel.offset.y();
+		distance = (qint16)(pixel.distance < (float)MAX_DISTANCE ? pixel.distance : (float)MAX_DISTANCE);
+		index = (qint16)pixel.index;
+	}
+	/// Converts the pixel to the float layout.
+	void unpack(FDTPixel& pixel) const {
+		pixel.offset.set((float)offsetX, (float)offsetY);
+		pixel.distance = squaredDistance();
+		pixel.index = (float)index;
+	}
+
+	/// Returns the squared distance as stored in the float layout. A clamped distance is
+	/// recalculated from the offsets, which are exact; pixels without a seed in reach of the
+	/// jump flooding have a zero offset and the distance of an uninitialized pixel.
+	float squaredDistance() const {
+		if (distance < MAX_DISTANCE)
+			return (float)distance;
+		if (offsetX == 0 && offsetY == 0)
+			return 100000.0f;
+		return (float)((int)offsetX * offsetX + (int)offsetY * offsetY);
+	}
+};
 	
 // ----------------------------------------------------------------------------------------------------
 
@@ -28,6 +28,7 @@ FDetectorThread::FDetectorThread(QObject* pParent /* = NULL */)
   m_isIdle(true),
   m_pDetector(NULL),
   m_pDTImage(NULL),
+  m_pImage(NULL),
   m_poseCount(0)
 {
 }
@@ -54,7 +55,7 @@ void FDetectorThread::stop()
 	}
 }
 
-void FDetectorThread::processFrame(FDTPixel* pDistanceTransform)
+void FDetectorThread::processFrame(FDTPixelPacked* pDistanceTransform)
 {
 	if (!isRunning())
 	{
@@ -65,6 +66,24 @@ void FDetectorThread::processFrame(FDTPixel* pDistanceTransform)
 	m_objectLock.lock();
 	m_isIdle = false;
 	m_pDTImage = pDistanceTransform;
+	m_pImage = NULL;
+	m_objectLock.unlock();
+
+	m_frameAvailable.wakeAll();
+}
+
+void FDetectorThread::processFrame(const quint8* pImage, FDTPixelPacked* pDistanceTransform)
+{
+	if (!isRunning())
+	{
+		F_ASSERT(false);
+		return;
+	}
+
+	m_objectLock.lock();
+	m_isIdle = false;
+	m_pDTImage = pDistanceTransform;
+	m_pImage = pImage;
 	m_objectLock.unlock();
 
 	m_frameAvailable.wakeAll();
@@ -109,6 +128,11 @@ void FDetectorThread::_processFrame()
 	if (!m_pDetector || !m_pDTImage)
 		return;
 
+	if (m_pImage)
+		m_pDetector->preprocess(m_pImage, m_pDTImage, &m_statistics);
+	else
+		m_statistics.timePreprocessing = 0.0;
+
 	m_pDetector->detect(m_pDTImage, &m_statistics);
 
 	m_poseDataLock.lock();
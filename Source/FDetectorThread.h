@@ -44,7 +44,10 @@ public:
 	void stop();
 
 	/// Processes one frame.
-	void processFrame(FDTPixel* pDistanceTransform);
+	void processFrame(FDTPixelPacked* pDistanceTransform);
+	/// Processes one frame, running the preprocessing on the CPU. The distance
+	/// transform of the given RGBA image is written to the given buffer.
+	void processFrame(const quint8* pImage, FDTPixelPacked* pDistanceTransform);
 
 	/// Sets the pose detector to be used.
 	void setPoseDetector(FPoseDetector* pDetector);
@@ -92,7 +95,8 @@ private:
 	mutable QMutex m_poseDataLock;
 
 	FPoseDetector* m_pDetector;
-	FDTPixel* m_pDTImage;
+	FDTPixelPacked* m_pDTImage;
+	const quint8* m_pImage;
 
 	static const size_t MAX_POSE_CANDIDATES = 8;
 	FCameraPose m_detectedPose[MAX_POSE_CANDIDATES];
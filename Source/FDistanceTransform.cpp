@@ -9,6 +9,7 @@
 
 #include "FTrackMeStable.h"
 #include "FBit.h"
+#include "FAsyncReadback.h"
 
 #include "FDistanceTransform.h"
 #include "FMemoryTracer.h"
@@ -25,13 +26,17 @@ FDistanceTransform::FDistanceTransform()
   m_maxStepSize(0),
   m_stepCount(0),
   m_edgeThresholdLow(0.02f),
-  m_edgeThresholdHigh(0.07f)
+  m_edgeThresholdHigh(0.07f),
+  m_packFramebuffer(0),
+  m_packRenderbuffer(0)
 {
 	F_VERIFY(_initGL());
 }
 
 FDistanceTransform::~FDistanceTransform()
 {
+	glDeleteFramebuffers(1, &m_packFramebuffer);
+	glDeleteRenderbuffers(1, &m_packRenderbuffer);
 }
 
 // Public commands ------------------------------------------------------------------------------------
@@ -72,10 +77,26 @@ const FGLTextureRect& FDistanceTransform::result() const
 	return m_texBuffer[(m_stepCount + 1) % 2];
 }
 
-void FDistanceTransform::getResult(FDTPixel* pDTImage)
+void FDistanceTransform::getResult(FDTPixelPacked* pDTImage)
 {
-	F_ASSERT(m_texBuffer[0].isValid());
-	m_texBuffer[(m_stepCount + 1) % 2].read(FGLDataFormat::RGBA, FGLDataType::Float, pDTImage);
+	F_ASSERT(pDTImage);
+	_packResult();
+
+	glReadPixels(0, 0, m_imageSize.width(), m_imageSize.height(), GL_RGBA_INTEGER, GL_SHORT, pDTImage);
+	FGLFramebuffer::bindDefault();
+
+	F_GLERROR_ASSERT;
+}
+
+bool FDistanceTransform::readResult(FAsyncReadback& readback)
+{
+	F_ASSERT(readback.bufferSize() >= m_imageSize.width() * m_imageSize.height() * sizeof(FDTPixelPacked));
+	_packResult();
+
+	bool result = readback.readFramebuffer(m_imageSize, GL_RGBA_INTEGER, GL_SHORT);
+	FGLFramebuffer::bindDefault();
+
+	return result;
 }
 
 // Internal functions ---------------------------------------------------------------------------------
@@ -169,6 +190,23 @@ void FDistanceTransform::_runDistanceTransform(const FGLTextureRect& inputImage)
 	m_samplerBorder.unbind(0);
 }
 
+void FDistanceTransform::_packResult()
+{
+	F_ASSERT(isValid() && m_packFramebuffer);
+
+	glViewport(0, 0, m_imageSize.width(), m_imageSize.height());
+	glBindFramebuffer(GL_FRAMEBUFFER, m_packFramebuffer);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+	m_prgJumpFloodPack.bind();
+	m_prgJumpFloodPack.setSamplerUniform(0, "sImage");
+	m_samplerBorder.bind(0);
+	result().bind(0);
+	m_overlayRect.draw();
+	m_samplerBorder.unbind(0);
+}
+
 bool FDistanceTransform::_initGL()
 {
 	for (int i = 0; i < 2; i++)
@@ -209,12 +247,18 @@ bool FDistanceTransform::_initGL()
 
 	FGLShader shJumpFloodInit("Shader/jumpFloodInit.frag");
 	FGLShader shJumpFloodStep("Shader/jumpFloodStep.frag");
+	FGLShader shJumpFloodPack("Shader/jumpFloodPack.frag");
 
 	m_prgJumpFloodInit.createLinkProgram(shOverlay, shJumpFloodInit);
 	m_prgJumpFloodStep.createLinkProgram(shOverlay, shJumpFloodStep);
+	m_prgJumpFloodPack.createLinkProgram(shOverlay, shJumpFloodPack);
 
 	F_ASSERT(m_prgJumpFloodInit.isLinked());
 	F_ASSERT(m_prgJumpFloodStep.isLinked());
+	F_ASSERT(m_prgJumpFloodPack.isLinked());
+
+	glGenFramebuffers(1, &m_packFramebuffer);
+	glGenRenderbuffers(1, &m_packRenderbuffer);
 
 	m_uImage = m_prgJumpFloodStep.getUniformLocation("sImage");
 	m_uStepSize = m_prgJumpFloodStep.getUniformLocation("stepSize");
@@ -235,6 +279,22 @@ bool FDistanceTransform::_resetGL()
 		F_ASSERT(m_fbBuffer[i].checkStatus());
 	}
 
+	glBindRenderbuffer(GL_RENDERBUFFER, m_packRenderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA16I, m_imageSize.width(), m_imageSize.height());
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_packFramebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_packRenderbuffer);
+	bool isComplete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	FGLFramebuffer::bindDefault();
+
+	F_ASSERT(isComplete);
+	if (!isComplete)
+	{
+		fWarning("Distance Transform", "Failed to create packed result framebuffer");
+		return false;
+	}
+
 	m_overlayRect.setTexCoords(m_imageSize);
 	m_overlayRect.create();
 
@@ -14,6 +14,8 @@
 #include "FlowGL.h"
 #include "FDTPixel.h"
 
+class FAsyncReadback;
+
 // ----------------------------------------------------------------------------------------------------
 //  Class FDistanceTransform
 // ----------------------------------------------------------------------------------------------------
@@ -51,14 +53,19 @@ public:
 	bool isValid() const { return m_isValid; }
 	/// Returns a texture holding the resulting distance transform.
 	const FGLTextureRect& result() const;
-	/// Copies the resulting distance transform map to the given array.
-	void getResult(FDTPixel* pDTImage);
+	/// Packs the resulting distance transform map and copies it to the given array.
+	void getResult(FDTPixelPacked* pDTImage);
+	/// Packs the resulting distance transform map and starts reading it into the given
+	/// readback, whose buffers must hold an FDTPixelPacked per pixel.
+	bool readResult(FAsyncReadback& readback);
 
 	//  Internal functions -----------------------------------------------------
 
 private:
 	void _runCanny(const FGLTextureRect& inputImage);
 	void _runDistanceTransform(const FGLTextureRect& inputImage);
+	/// Renders the result in the FDTPixelPacked layout and binds it for reading.
+	void _packResult();
 	bool _initGL();
 	bool _resetGL();
 
@@ -91,6 +98,11 @@ private:
 	FGLProgram m_prgJumpFloodStep;
 	FGLSampler m_samplerBorder;
 
+	// packed result, 16 bit signed integer RGBA
+	FGLProgram m_prgJumpFloodPack;
+	GLuint m_packFramebuffer;
+	GLuint m_packRenderbuffer;
+
 	quint32 m_uImage;
 	quint32 m_uStepSize;
 	int m_stepCount;
@@ -0,0 +1,650 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FDistanceTransformCPU.cpp
+//  Description		Implementation of class FDistanceTransformCPU
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-22 18:03:12 +0200 (Do, 22 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#include "FTrackMeStable.h"
+
+#include <cstring>
+#include <xmmintrin.h>
+
+#include "FDistanceTransformCPU.h"
+#include "FMemoryTracer.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Shader constants
+// ----------------------------------------------------------------------------------------------------
+
+namespace
+{
+	// jumpFloodInit.frag, jumpFloodStep.frag
+	const float NOT_INITIALIZED = 100000.0f;
+
+	// jumpFloodPack.frag
+	const float MAX_DISTANCE = (float)FDTPixelPacked::MAX_DISTANCE;
+
+	// cannyEdgeThreshold.frag
+	enum { Rejected = -1, Undecided = 0, Confirmed = 1 };
+	const int PIXEL_FOLLOW_COUNT = 20;
+	const int s_dPos[8][2] = {
+		{  0,  1 }, {  1,  1 }, {  1,  0 }, {  1, -1 },
+		{  0, -1 }, { -1, -1 }, { -1,  0 }, { -1,  1 } };
+	const float s_zeroTexel[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	// cannyEdgeSuppress.frag, indexed by gradient direction
+	const int s_suppressPos[4][4][2] = {
+		{ {  0,  1 }, {  0,  2 }, {  0, -1 }, {  0, -2 } },
+		{ {  1,  1 }, {  2,  2 }, { -1, -1 }, { -2, -2 } },
+		{ { -2,  0 }, { -1,  0 }, {  1,  0 }, {  2,  0 } },
+		{ { -2,  2 }, { -1,  1 }, {  1, -1 }, {  2, -2 } } };
+
+	// gaussianHorz.frag, gaussianVert.frag
+	const float s_gaussian[7] = {
+		0.015625f, 0.09375f, 0.234375f, 0.3125f, 0.234375f, 0.09375f, 0.015625f };
+
+	// jump flood neighbors in shader order (left top, center top, ..., right bottom)
+	const int s_floodPos[8][2] = {
+		{ -1, -1 }, {  0, -1 }, {  1, -1 },
+		{ -1,  0 },             {  1,  0 },
+		{ -1,  1 }, {  0,  1 }, {  1,  1 } };
+
+	inline __m128 sAbs(__m128 v)
+	{
+		return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+	}
+
+	inline float sSumRGB(__m128 v)
+	{
+		float f[4];
+		_mm_storeu_ps(f, v);
+		return f[0] + f[1] + f[2];
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FDistanceTransformCPU
+// ----------------------------------------------------------------------------------------------------
+
+// Constructors and destructor ------------------------------------------------------------------------
+
+FDistanceTransformCPU::FDistanceTransformCPU()
+: m_width(0),
+  m_height(0),
+  m_stepCount(0),
+  m_maxStepSize(0),
+  m_pWorkerPool(NULL),
+  m_edgeThresholdLow(0.02f),
+  m_edgeThresholdHigh(0.07f),
+  m_pass(UnpackImage),
+  m_pSource(NULL),
+  m_pTarget(NULL),
+  m_pImage(NULL),
+  m_pResult(NULL),
+  m_seedStride(4),
+  m_stepSize(0)
+{
+	m_pBuffer[0] = NULL;
+	m_pBuffer[1] = NULL;
+
+	for (int i = 0; i < 256; i++)
+		m_unorm8[i] = (float)i / 255.0f;
+}
+
+FDistanceTransformCPU::~FDistanceTransformCPU()
+{
+	F_SAFE_DELETE_ARRAY(m_pBuffer[0]);
+	F_SAFE_DELETE_ARRAY(m_pBuffer[1]);
+}
+
+// Public commands ------------------------------------------------------------------------------------
+
+void FDistanceTransformCPU::calculateDt(const float* pSeedImage, FDTPixelPacked* pResult)
+{
+	F_ASSERT(isValid() && pSeedImage && pResult);
+	if (!isValid())
+		return;
+
+	_runDistanceTransform(pSeedImage, 1, pResult);
+}
+
+void FDistanceTransformCPU::calculateDt(const float* pSeedImage, FDTPixel* pResult)
+{
+	F_ASSERT(isValid() && pSeedImage && pResult);
+	if (!isValid())
+		return;
+
+	// the jump flooding buffers have the layout of FDTPixel
+	const float* pBuffer = _runDistanceTransform(pSeedImage, 1, NULL);
+	memcpy(pResult, pBuffer, (size_t)m_width * m_height * sizeof(FDTPixel));
+}
+
+void FDistanceTransformCPU::calculateCannyDt(const quint8* pImage, FDTPixelPacked* pResult)
+{
+	F_ASSERT(isValid() && pImage && pResult);
+	if (!isValid())
+		return;
+
+	_runCanny(pImage);
+	_runDistanceTransform(m_pBuffer[0], 4, pResult);
+}
+
+bool FDistanceTransformCPU::reset(const QSize& imageSize)
+{
+	F_ASSERT(!imageSize.isEmpty());
+	if (imageSize.isEmpty())
+		return false;
+
+	if (imageSize != m_imageSize)
+	{
+		F_SAFE_DELETE_ARRAY(m_pBuffer[0]);
+		F_SAFE_DELETE_ARRAY(m_pBuffer[1]);
+
+		size_t numValues = (size_t)imageSize.width() * imageSize.height() * 4;
+		m_pBuffer[0] = new float[numValues];
+		m_pBuffer[1] = new float[numValues];
+	}
+
+	m_imageSize = imageSize;
+	m_width = imageSize.width();
+	m_height = imageSize.height();
+
+	// same step schedule as FDistanceTransform
+	int maxSize = fMax(m_width, m_height) >> 1;
+	for(m_maxStepSize = 1; m_maxStepSize < maxSize; m_maxStepSize <<= 1)
+		;
+	for(m_stepCount = 1; maxSize > 0; maxSize >>= 1)
+		m_stepCount++;
+
+	return true;
+}
+
+// Public queries -------------------------------------------------------------------------------------
+
+size_t FDistanceTransformCPU::compareResults(const FDTPixelPacked* pResult1,
+	const FDTPixelPacked* pResult2, size_t numPixels)
+{
+	size_t mismatchCount = 0;
+
+	for (size_t i = 0; i < numPixels; i++)
+	{
+		if (memcmp(&pResult1[i], &pResult2[i], sizeof(FDTPixelPacked)) != 0)
+			mismatchCount++;
+	}
+
+	return mismatchCount;
+}
+
+// Overrides ------------------------------------------------------------------------------------------
+
+void FDistanceTransformCPU::runTask(size_t taskIndex, size_t workerIndex)
+{
+	int y0 = (int)taskIndex * ROWS_PER_TASK;
+	int y1 = fMin(y0 + ROWS_PER_TASK, m_height);
+
+	for (int y = y0; y < y1; y++)
+	{
+		switch(m_pass)
+		{
+		case UnpackImage:    _unpackImage(y);     break;
+		case GaussianHorz:   _gaussianHorz(y);    break;
+		case GaussianVert:   _gaussianVert(y);    break;
+		case CannyDetect:    _cannyDetect(y);     break;
+		case CannySuppress:  _cannySuppress(y);   break;
+		case CannyThreshold: _cannyThreshold(y);  break;
+		case CannyReduce1:   _cannyReduce(y, 1);  break;
+		case CannyReduce2:   _cannyReduce(y, -1); break;
+		case JumpFloodInit:  _jumpFloodInit(y);   break;
+		case JumpFloodStep:  _jumpFloodStep(y);   break;
+		case PackResult:     _packResult(y);      break;
+		}
+	}
+}
+
+// Internal functions ---------------------------------------------------------------------------------
+
+void FDistanceTransformCPU::_runPass(pass_t pass, const float* pSource, float* pTarget)
+{
+	F_ASSERT(pSource != pTarget);
+
+	m_pass = pass;
+	m_pSource = pSource;
+	m_pTarget = pTarget;
+
+	// each pass reads the complete result of the previous one
+	size_t taskCount = (size_t)(m_height + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+
+	if (m_pWorkerPool)
+		m_pWorkerPool->run(this, taskCount);
+	else
+		for (size_t i = 0; i < taskCount; i++)
+			runTask(i, 0);
+}
+
+void FDistanceTransformCPU::_runCanny(const quint8* pImage)
+{
+	// same buffer sequence as FPoseDetector::_runCanny, result in buffer 0
+	m_pImage = pImage;
+	_runPass(UnpackImage, NULL, m_pBuffer[1]);
+	m_pImage = NULL;
+
+	_runPass(GaussianHorz, m_pBuffer[1], m_pBuffer[0]);
+	_runPass(GaussianVert, m_pBuffer[0], m_pBuffer[1]);
+	_runPass(CannyDetect, m_pBuffer[1], m_pBuffer[0]);
+	_runPass(CannySuppress, m_pBuffer[0], m_pBuffer[1]);
+	_runPass(CannyThreshold, m_pBuffer[1], m_pBuffer[0]);
+	_runPass(CannyReduce1, m_pBuffer[0], m_pBuffer[1]);
+	_runPass(CannyReduce2, m_pBuffer[1], m_pBuffer[0]);
+}
+
+const float* FDistanceTransformCPU::_runDistanceTransform(const float* pSeeds, size_t seedStride,
+	FDTPixelPacked* pResult)
+{
+	// the passes alternate between both buffers, the seeds are only read by the first pass
+	int target = (pSeeds == m_pBuffer[0]) ? 1 : 0;
+
+	m_seedStride = seedStride;
+	m_stepSize = m_maxStepSize;
+	_runPass(JumpFloodInit, pSeeds, m_pBuffer[target]);
+
+	m_stepSize = m_maxStepSize >> 1;
+	for (int i = 1; i < m_stepCount; i++)
+	{
+		_runPass(JumpFloodStep, m_pBuffer[target], m_pBuffer[target ^ 1]);
+		target ^= 1;
+		m_stepSize = m_stepSize >> 1;
+	}
+
+	if (pResult)
+	{
+		m_pResult = pResult;
+		_runPass(PackResult, m_pBuffer[target], NULL);
+		m_pResult = NULL;
+	}
+
+	return m_pBuffer[target];
+}
+
+void FDistanceTransformCPU::_unpackImage(int y)
+{
+	const quint8* pSrc = m_pImage + (size_t)y * m_width * 4;
+	float* pDst = m_pTarget + (size_t)y * m_width * 4;
+
+	for (int i = 0; i < m_width * 4; i++)
+		pDst[i] = m_unorm8[pSrc[i]];
+}
+
+void FDistanceTransformCPU::_gaussianHorz(int y)
+{
+	const float* pSrc = m_pSource + (size_t)y * m_width * 4;
+	float* pDst = m_pTarget + (size_t)y * m_width * 4;
+
+	__m128 w[7];
+	for (int k = 0; k < 7; k++)
+		w[k] = _mm_set1_ps(s_gaussian[k]);
+
+	for (int x = 0; x < m_width; x++)
+	{
+		__m128 c = _mm_setzero_ps();
+		for (int k = 0; k < 7; k++)
+		{
+			int xk = fMinMax(x + k - 3, 0, m_width - 1);
+			c = _mm_add_ps(c, _mm_mul_ps(_mm_loadu_ps(pSrc + xk * 4), w[k]));
+		}
+
+		_mm_storeu_ps(pDst + x * 4, c);
+		pDst[x * 4 + 3] = 1.0f;
+	}
+}
+
+void FDistanceTransformCPU::_gaussianVert(int y)
+{
+	const float* pRow[7];
+	for (int k = 0; k < 7; k++)
+		pRow[k] = m_pSource + (size_t)fMinMax(y + k - 3, 0, m_height - 1) * m_width * 4;
+
+	float* pDst = m_pTarget + (size_t)y * m_width * 4;
+
+	__m128 w[7];
+	for (int k = 0; k < 7; k++)
+		w[k] = _mm_set1_ps(s_gaussian[k]);
+
+	for (int i = 0; i < m_width * 4; i += 4)
+	{
+		__m128 c = _mm_setzero_ps();
+		for (int k = 0; k < 7; k++)
+			c = _mm_add_ps(c, _mm_mul_ps(_mm_loadu_ps(pRow[k] + i), w[k]));
+
+		_mm_storeu_ps(pDst + i, c);
+		pDst[i + 3] = 1.0f;
+	}
+}
+
+void FDistanceTransformCPU::_cannyDetect(int y)
+{
+	const float* pRowN = m_pSource + (size_t)fMin(y + 1, m_height - 1) * m_width * 4;
+	const float* pRowC = m_pSource + (size_t)y * m_width * 4;
+	const float* pRowS = m_pSource + (size_t)fMax(y - 1, 0) * m_width * 4;
+	float* pDst = m_pTarget + (size_t)y * m_width * 4;
+
+	const __m128 scale = _mm_set1_ps(0.333334f);
+	const __m128 scaleDiag = _mm_set1_ps(0.707107f * 0.333334f);
+
+	for (int x = 0; x < m_width; x++)
+	{
+		int xW = fMax(x - 1, 0) * 4;
+		int xE = fMin(x + 1, m_width - 1) * 4;
+		int xC = x * 4;
+
+		__m128 colN  = _mm_loadu_ps(pRowN + xC);
+		__m128 colNE = _mm_loadu_ps(pRowN + xE);
+		__m128 colE  = _mm_loadu_ps(pRowC + xE);
+		__m128 colSE = _mm_loadu_ps(pRowS + xE);
+		__m128 colS  = _mm_loadu_ps(pRowS + xC);
+		__m128 colSW = _mm_loadu_ps(pRowS + xW);
+		__m128 colW  = _mm_loadu_ps(pRowC + xW);
+		__m128 colNW = _mm_loadu_ps(pRowN + xW);
+
+		float gN  = sSumRGB(_mm_mul_ps(sAbs(_mm_sub_ps(colN,  colS)),  scale));
+		float gNE = sSumRGB(_mm_mul_ps(sAbs(_mm_sub_ps(colNE, colSW)), scaleDiag));
+		float gE  = sSumRGB(_mm_mul_ps(sAbs(_mm_sub_ps(colE,  colW)),  scale));
+		float gSE = sSumRGB(_mm_mul_ps(sAbs(_mm_sub_ps(colSE, colNW)), scaleDiag));
+
+		// direction with maximum gradient, ties resolved as in the shader
+		int dir;
+		float mag;
+		if (gNE > gN)
+		{
+			if (gE > gNE)
+			{
+				if (gSE > gE) { dir = 3; mag = gSE; }
+				else          { dir = 2; mag = gE; }
+			}
+			else
+			{
+				if (gSE > gNE) { dir = 3; mag = gSE; }
+				else           { dir = 1; mag = gNE; }
+			}
+		}
+		else
+		{
+			if (gE > gN)
+			{
+				if (gSE > gE) { dir = 3; mag = gSE; }
+				else          { dir = 2; mag = gE; }
+			}
+			else
+			{
+				if (gSE > gN) { dir = 3; mag = gSE; }
+				else          { dir = 0; mag = gN; }
+			}
+		}
+
+		pDst[xC + 0] = mag;
+		pDst[xC + 1] = (float)dir;
+		pDst[xC + 2] = 0.0f;
+		pDst[xC + 3] = 0.0f;
+	}
+}
+
+void FDistanceTransformCPU::_cannySuppress(int y)
+{
+	float* pDst = m_pTarget + (size_t)y * m_width * 4;
+
+	for (int x = 0; x < m_width; x++)
+	{
+		const float* pCenter = _texel(m_pSource, x, y);
+		float mag = pCenter[0];
+		int dir = fMinMax((int)pCenter[1], 0, 3);
+
+		_mm_storeu_ps(pDst + x * 4, _mm_loadu_ps(pCenter));
+
+		for (int i = 0; i < 4; i++)
+		{
+			const int* p = s_suppressPos[dir][i];
+			if (_texel(m_pSource, x + p[0], y + p[1])[0] > mag)
+			{
+				pDst[x * 4] = 0.0f;
+				break;
+			}
+		}
+	}
+}
+
+void FDistanceTransformCPU::_cannyThreshold(int y)
+{
+	float* pDst = m_pTarget + (size_t)y * m_width * 4;
+
+	for (int x = 0; x < m_width; x++)
+	{
+		const float* pPix = _texel(m_pSource, x, y);
+		float* pOut = pDst + x * 4;
+		pOut[0] = pOut[1] = pOut[2] = pOut[3] = 0.0f;
+
+		if (pPix[0] < m_edgeThresholdLow)
+			continue;
+
+		if (pPix[0] > m_edgeThresholdHigh)
+		{
+			pOut[0] = pOut[1] = 1.0f;
+			continue;
+		}
+
+		int gradDir = (int)pPix[1];
+		if (_cannyCheck((gradDir + 2) % 8, x, y) == Confirmed
+			|| _cannyCheck((gradDir + 6) % 8, x, y) == Confirmed)
+		{
+			pOut[0] = 1.0f;
+			continue;
+		}
+
+		pOut[1] = 0.5f;
+		pOut[2] = 1.0f;
+	}
+}
+
+int FDistanceTransformCPU::_cannyCheck(int prevDir, int x, int y) const
+{
+	x += s_dPos[prevDir][0];
+	y += s_dPos[prevDir][1];
+	const float* pPix = _texel(m_pSource, x, y);
+
+	if (pPix[0] > m_edgeThresholdHigh)
+		return Confirmed;
+	if (pPix[0] < m_edgeThresholdLow)
+		return Rejected;
+
+	int dir = 0, nextX = 0, nextY = 0;
+	const float* pNextPix = NULL;
+	int r;
+
+	for (int i = 0; i < PIXEL_FOLLOW_COUNT; i++)
+	{
+		r = _cannyFollow(prevDir, x, y, pPix, dir, nextX, nextY, pNextPix);
+		if (r == Rejected || r == Confirmed)
+			return r;
+
+		prevDir = dir;
+		x = nextX;
+		y = nextY;
+		pPix = pNextPix;
+	}
+
+	return _cannyFollow(prevDir, x, y, pPix, dir, nextX, nextY, pNextPix);
+}
+
+int FDistanceTransformCPU::_cannyFollow(int prevDir, int x, int y, const float* pPix,
+	int& dir, int& nextX, int& nextY, const float*& pNextPix) const
+{
+	int gradDir = (int)pPix[1];
+	int d1 = (gradDir + 2) % 8;
+	int d2 = (gradDir + 6) % 8;
+
+	int x1 = x + s_dPos[d1][0], y1 = y + s_dPos[d1][1];
+	int x2 = x + s_dPos[d2][0], y2 = y + s_dPos[d2][1];
+	const float* pN1 = (prevDir == d2) ? s_zeroTexel : _texel(m_pSource, x1, y1);
+	const float* pN2 = (prevDir == d1) ? s_zeroTexel : _texel(m_pSource, x2, y2);
+
+	if (pN1[0] > m_edgeThresholdHigh || pN2[0] > m_edgeThresholdHigh)
+		return Confirmed;
+	if (pN1[0] < m_edgeThresholdLow && pN2[0] < m_edgeThresholdLow)
+		return Rejected;
+
+	if (pN1[0] > pN2[0])
+	{
+		dir = d1;
+		nextX = x1;
+		nextY = y1;
+		pNextPix = pN1;
+	}
+	else
+	{
+		dir = d2;
+		nextX = x2;
+		nextY = y2;
+		pNextPix = pN2;
+	}
+
+	return Undecided;
+}
+
+void FDistanceTransformCPU::_cannyReduce(int y, int dy)
+{
+	// reduce pass 1 tests the neighbors above, pass 2 those below the pixel
+	float* pDst = m_pTarget + (size_t)y * m_width * 4;
+
+	for (int x = 0; x < m_width; x++)
+	{
+		float m1 = _texel(m_pSource, x - 1, y)[0];
+		float m2 = _texel(m_pSource, x, y + dy)[0];
+		float m3 = _texel(m_pSource, x + 1, y)[0];
+
+		if ((m1 > 0 && m2 > 0) || (m2 > 0 && m3 > 0))
+			_mm_storeu_ps(pDst + x * 4, _mm_setzero_ps());
+		else
+			_mm_storeu_ps(pDst + x * 4, _mm_loadu_ps(_texel(m_pSource, x, y)));
+	}
+}
+
+void FDistanceTransformCPU::_jumpFloodInit(int y)
+{
+	// the seed image is sampled with a border value of 0 outside the image
+	float* pDst = m_pTarget + (size_t)y * m_width * 4;
+
+	for (int x = 0; x < m_width; x++)
+	{
+		float* pOut = pDst + x * 4;
+		float v0 = m_pSource[((size_t)y * m_width + x) * m_seedStride];
+
+		if (v0 > 0.0f)
+		{
+			pOut[0] = 0.0f;
+			pOut[1] = 0.0f;
+			pOut[2] = 0.0f;
+			pOut[3] = v0;
+			continue;
+		}
+
+		float dist0 = NOT_INITIALIZED;
+
+		for (int i = 0; i < 8; i++)
+		{
+			int ox = s_floodPos[i][0] * m_stepSize;
+			int oy = s_floodPos[i][1] * m_stepSize;
+			int sx = x + ox, sy = y + oy;
+
+			if (sx < 0 || sx >= m_width || sy < 0 || sy >= m_height)
+				continue;
+
+			float v = m_pSource[((size_t)sy * m_width + sx) * m_seedStride];
+			if (v > 0.0f)
+			{
+				float fx = (float)ox, fy = (float)oy;
+				float dist = fx * fx + fy * fy;
+				if (dist < dist0)
+				{
+					pOut[0] = fx;
+					pOut[1] = fy;
+					pOut[3] = v;
+					dist0 = dist;
+				}
+			}
+		}
+
+		if (dist0 == NOT_INITIALIZED)
+		{
+			pOut[0] = 0.0f;
+			pOut[1] = 0.0f;
+			pOut[3] = 0.0f;
+		}
+
+		pOut[2] = dist0;
+	}
+}
+
+void FDistanceTransformCPU::_jumpFloodStep(int y)
+{
+	// outside the image the border value (0, 0, NOT_INITIALIZED, 0) is sampled,
+	// which never contributes
+	const float* pSrc = m_pSource + (size_t)y * m_width * 4;
+	float* pDst = m_pTarget + (size_t)y * m_width * 4;
+
+	for (int x = 0; x < m_width; x++)
+	{
+		const float* pV0 = pSrc + x * 4;
+		float* pOut = pDst + x * 4;
+		_mm_storeu_ps(pOut, _mm_loadu_ps(pV0));
+
+		float dist0 = pV0[2];
+		if (dist0 == 0.0f)
+			continue;
+
+		for (int i = 0; i < 8; i++)
+		{
+			int ox = s_floodPos[i][0] * m_stepSize;
+			int oy = s_floodPos[i][1] * m_stepSize;
+			int sx = x + ox, sy = y + oy;
+
+			if (sx < 0 || sx >= m_width || sy < 0 || sy >= m_height)
+				continue;
+
+			const float* pV = m_pSource + ((size_t)sy * m_width + sx) * 4;
+			if (pV[2] < NOT_INITIALIZED)
+			{
+				float dx = pV[0] + (float)ox;
+				float dy = pV[1] + (float)oy;
+				float dist = dx * dx + dy * dy;
+				if (dist < dist0)
+				{
+					pOut[0] = dx;
+					pOut[1] = dy;
+					pOut[3] = pV[3];
+					dist0 = dist;
+				}
+			}
+		}
+
+		pOut[2] = dist0;
+	}
+}
+
+void FDistanceTransformCPU::_packResult(int y)
+{
+	const float* pSrc = m_pSource + (size_t)y * m_width * 4;
+	FDTPixelPacked* pDst = m_pResult + (size_t)y * m_width;
+
+	for (int x = 0; x < m_width; x++)
+	{
+		const float* pV = pSrc + x * 4;
+		FDTPixelPacked& pixel = pDst[x];
+		pixel.offsetX = (qint16)pV[0];
+		pixel.offsetY = (qint16)pV[1];
+		pixel.distance = (qint16)fMin(pV[2], MAX_DISTANCE);
+		pixel.index = -1;
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------
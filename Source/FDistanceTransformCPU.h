@@ -0,0 +1,161 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FDistanceTransformCPU.h
+//  Description		Header file for FDistanceTransformCPU.cpp
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-22 18:03:12 +0200 (Do, 22 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#ifndef FDISTANCETRANSFORMCPU_H
+#define FDISTANCETRANSFORMCPU_H
+
+#include "FTrackMe.h"
+#include "FDTPixel.h"
+#include "FWorkerPool.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FDistanceTransformCPU
+// ----------------------------------------------------------------------------------------------------
+
+/// CPU implementation of the canny edge detection and jump flooding distance transform
+/// passes of FDistanceTransform and FPoseDetector. Each pass follows the corresponding
+/// shader, including the order of the arithmetic and the texture border handling, and the
+/// result is packed like FDistanceTransform::getResult(). The passes are split into blocks of
+/// rows that are processed by the workers of an optional FWorkerPool. Does not use OpenGL.
+class FDistanceTransformCPU : private FWorkerTask
+{
+	//  Constructors and destructor --------------------------------------------
+
+public:
+	/// Default Constructor.
+	FDistanceTransformCPU();
+	/// Virtual destructor.
+	virtual ~FDistanceTransformCPU();
+
+private:
+	FDistanceTransformCPU(const FDistanceTransformCPU& other);
+	FDistanceTransformCPU& operator=(const FDistanceTransformCPU& other);
+
+	//  Public commands --------------------------------------------------------
+
+public:
+	/// Calculates a distance transform on the given seed image with one float per pixel.
+	/// A value of >0 is considered a seed, the value is used as seed index.
+	void calculateDt(const float* pSeedImage, OUT FDTPixelPacked* pResult);
+	/// Same as above, but returns the unpacked result like the float texture of
+	/// FDistanceTransform::result(). The index holds the seed value.
+	void calculateDt(const float* pSeedImage, OUT FDTPixel* pResult);
+	/// Runs canny edge detection on the given RGBA image with 8 bits per channel
+	/// and calculates the distance transform of the detected edges.
+	void calculateCannyDt(const quint8* pImage, OUT FDTPixelPacked* pResult);
+
+	/// Allocates the buffers for the given image size.
+	bool reset(const QSize& imageSize);
+
+	/// Sets the worker pool used to process the passes. If NULL, the
+	/// passes run in the calling thread. The pool must not be used concurrently.
+	void setWorkerPool(FWorkerPool* pPool) { m_pWorkerPool = pPool; }
+
+	// canny
+
+	void setEdgeThresholdLow(float val) { m_edgeThresholdLow = val; }
+	void setEdgeThresholdHigh(float val) { m_edgeThresholdHigh = val; }
+
+	//  Public queries ---------------------------------------------------------
+
+public:
+	/// Returns true if the buffers have been allocated.
+	bool isValid() const { return m_pBuffer[0] != NULL; }
+	/// Returns the image size.
+	const QSize& imageSize() const { return m_imageSize; }
+
+	/// Returns the number of pixels that are not bitwise identical in the two results.
+	static size_t compareResults(const FDTPixelPacked* pResult1, const FDTPixelPacked* pResult2, size_t numPixels);
+
+	//  Internal types ---------------------------------------------------------
+
+private:
+	enum pass_t
+	{
+		UnpackImage,
+		GaussianHorz,
+		GaussianVert,
+		CannyDetect,
+		CannySuppress,
+		CannyThreshold,
+		CannyReduce1,
+		CannyReduce2,
+		JumpFloodInit,
+		JumpFloodStep,
+		PackResult
+	};
+
+	//  Overrides --------------------------------------------------------------
+
+private:
+	virtual void runTask(size_t taskIndex, size_t workerIndex);
+
+	//  Internal functions -----------------------------------------------------
+
+private:
+	void _runPass(pass_t pass, const float* pSource, float* pTarget);
+	void _runCanny(const quint8* pImage);
+	/// Runs the jump flooding passes and returns the buffer holding the float result.
+	/// The result is packed into pResult, if given.
+	const float* _runDistanceTransform(const float* pSeeds, size_t seedStride, FDTPixelPacked* pResult);
+
+	void _unpackImage(int y);
+	void _gaussianHorz(int y);
+	void _gaussianVert(int y);
+	void _cannyDetect(int y);
+	void _cannySuppress(int y);
+	void _cannyThreshold(int y);
+	void _cannyReduce(int y, int dy);
+	void _jumpFloodInit(int y);
+	void _jumpFloodStep(int y);
+	void _packResult(int y);
+
+	int _cannyCheck(int prevDir, int x, int y) const;
+	int _cannyFollow(int prevDir, int x, int y, const float* pPix,
+		int& dir, int& nextX, int& nextY, const float*& pNextPix) const;
+
+	/// Returns the texel at the given position, clamped to the image.
+	const float* _texel(const float* pImage, int x, int y) const {
+		x = fMinMax(x, 0, m_width - 1);
+		y = fMinMax(y, 0, m_height - 1);
+		return pImage + (y * m_width + x) * 4;
+	}
+
+	//  Internal data members --------------------------------------------------
+
+private:
+	static const int ROWS_PER_TASK = 16;
+
+	QSize m_imageSize;
+	int m_width;
+	int m_height;
+	int m_stepCount;
+	int m_maxStepSize;
+
+	float* m_pBuffer[2];
+	FWorkerPool* m_pWorkerPool;
+	float m_unorm8[256];
+
+	// parameter
+	float m_edgeThresholdLow;
+	float m_edgeThresholdHigh;
+
+	// current pass
+	pass_t m_pass;
+	const float* m_pSource;
+	float* m_pTarget;
+	const quint8* m_pImage;
+	FDTPixelPacked* m_pResult;
+	size_t m_seedStride;
+	int m_stepSize;
+};
+
+// ----------------------------------------------------------------------------------------------------
+
+#endif // FDISTANCETRANSFORMCPU_H
@@ -0,0 +1,210 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FFernHistogram.cpp
+//  Description		Implementation of class FFernHistogram
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-24 16:41:05 +0200 (Sa, 24 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#include "FTrackMeStable.h"
+
+#include <algorithm>
+
+#include "FFernHistogram.h"
+#include "FMemoryTracer.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FFernHistogram
+// ----------------------------------------------------------------------------------------------------
+
+static inline bool sEntryOrder(const FFernHistogram::entry_t& a, const FFernHistogram::entry_t& b)
+{
+	return a.bin < b.bin;
+}
+
+// Constructors and destructor ------------------------------------------------------------------------
+
+FFernHistogram::FFernHistogram()
+: m_storage(Sparse),
+  m_numBins(0),
+  m_entryCount(0),
+  m_pData(NULL)
+{
+}
+
+FFernHistogram::~FFernHistogram()
+{
+}
+
+// Public commands ------------------------------------------------------------------------------------
+
+void FFernHistogram::reset(size_t numBins)
+{
+	m_storage = Sparse;
+	m_numBins = numBins;
+	m_entryCount = 0;
+
+	m_sparse.clear();
+	m_dense.clear();
+	_updateData();
+}
+
+void FFernHistogram::increment(size_t bin)
+{
+	F_ASSERT(bin < m_numBins);
+
+	if (isAttached())
+		detach();
+
+	if (m_storage == Dense)
+	{
+		m_dense[bin]++;
+		return;
+	}
+
+	entry_t entry = { (quint32)bin, 1 };
+	std::vector<entry_t>::iterator it =
+		std::lower_bound(m_sparse.begin(), m_sparse.end(), entry, sEntryOrder);
+
+	if (it != m_sparse.end() && it->bin == bin)
+	{
+		it->count++;
+		return;
+	}
+
+	m_sparse.insert(it, entry);
+	m_entryCount = m_sparse.size();
+	_updateData();
+
+	if (m_entryCount > _maxSparseEntries())
+		_makeDense();
+}
+
+void FFernHistogram::setCounts(const quint32* pCounts, size_t numBins)
+{
+	F_ASSERT(pCounts);
+	reset(numBins);
+
+	size_t numEntries = 0;
+	for (size_t i = 0; i < numBins; i++)
+		if (pCounts[i] > 0)
+			numEntries++;
+
+	if (numEntries > _maxSparseEntries())
+	{
+		m_storage = Dense;
+		m_dense.assign(pCounts, pCounts + numBins);
+		m_entryCount = numBins;
+	}
+	else
+	{
+		m_sparse.reserve(numEntries);
+		for (size_t i = 0; i < numBins; i++)
+		{
+			if (pCounts[i] > 0)
+			{
+				entry_t entry = { (quint32)i, pCounts[i] };
+				m_sparse.push_back(entry);
+			}
+		}
+		m_entryCount = numEntries;
+	}
+
+	_updateData();
+}
+
+void FFernHistogram::attach(storage_t storage, const void* pData, size_t entryCount, size_t numBins)
+{
+	F_ASSERT(pData);
+	F_ASSERT(storage == Sparse ? entryCount <= numBins : entryCount == numBins);
+
+	m_sparse.clear();
+	m_dense.clear();
+
+	m_storage = storage;
+	m_numBins = numBins;
+	m_entryCount = entryCount;
+	m_pData = pData;
+}
+
+void FFernHistogram::detach()
+{
+	if (!isAttached())
+		return;
+
+	if (m_storage == Dense)
+	{
+		const quint32* pCounts = (const quint32*)m_pData;
+		m_dense.assign(pCounts, pCounts + m_entryCount);
+	}
+	else
+	{
+		const entry_t* pEntries = (const entry_t*)m_pData;
+		m_sparse.assign(pEntries, pEntries + m_entryCount);
+	}
+
+	_updateData();
+}
+
+// Public queries -------------------------------------------------------------------------------------
+
+quint32 FFernHistogram::count(size_t bin) const
+{
+	F_ASSERT(bin < m_numBins);
+
+	if (m_storage == Dense)
+		return ((const quint32*)m_pData)[bin];
+
+	const entry_t* pBegin = (const entry_t*)m_pData;
+	const entry_t* pEnd = pBegin + m_entryCount;
+	entry_t key = { (quint32)bin, 0 };
+	const entry_t* pEntry = std::lower_bound(pBegin, pEnd, key, sEntryOrder);
+
+	return (pEntry != pEnd && pEntry->bin == bin) ? pEntry->count : 0;
+}
+
+void FFernHistogram::getCounts(quint32* pCounts) const
+{
+	F_ASSERT(pCounts);
+
+	if (m_storage == Dense)
+	{
+		if (m_numBins > 0)
+			memcpy(pCounts, m_pData, m_numBins * sizeof(quint32));
+		return;
+	}
+
+	memset(pCounts, 0, m_numBins * sizeof(quint32));
+
+	const entry_t* pEntries = (const entry_t*)m_pData;
+	for (size_t i = 0; i < m_entryCount; i++)
+		pCounts[pEntries[i].bin] = pEntries[i].count;
+}
+
+// Internal functions ---------------------------------------------------------------------------------
+
+void FFernHistogram::_makeDense()
+{
+	F_ASSERT(m_storage == Sparse && !isAttached());
+
+	m_dense.assign(m_numBins, 0);
+	for (size_t i = 0; i < m_sparse.size(); i++)
+		m_dense[m_sparse[i].bin] = m_sparse[i].count;
+
+	std::vector<entry_t>().swap(m_sparse);
+
+	m_storage = Dense;
+	m_entryCount = m_numBins;
+	_updateData();
+}
+
+const void* FFernHistogram::_ownedData() const
+{
+	if (m_storage == Dense)
+		return m_dense.empty() ? NULL : &m_dense[0];
+
+	return m_sparse.empty() ? NULL : &m_sparse[0];
+}
+
+// ----------------------------------------------------------------------------------------------------
@@ -0,0 +1,129 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FFernHistogram.h
+//  Description		Header file for FFernHistogram.cpp
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-24 16:41:05 +0200 (Sa, 24 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#ifndef FFERNHISTOGRAM_H
+#define FFERNHISTOGRAM_H
+
+#include <vector>
+#include "FTrackMe.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FFernHistogram
+// ----------------------------------------------------------------------------------------------------
+
+/// Frequency counts of the fern descriptor values of a contour class, one bin per row of the
+/// fern table. Classes with few samples have only a few non-zero bins; these are stored as a
+/// list of bins and counts, sorted by bin. When the list grows beyond half the size of the
+/// dense array of counts, the histogram switches to the dense array. The data can also be
+/// attached from a memory mapped database file, it is then copied on the first increment().
+class FFernHistogram
+{
+	//  Public types -----------------------------------------------------------
+
+public:
+	enum storage_t
+	{
+		Sparse = 0,
+		Dense = 1
+	};
+
+	/// Non-zero bin of a sparse histogram.
+	struct entry_t
+	{
+		quint32 bin;
+		quint32 count;
+	};
+
+	//  Constructors and destructor --------------------------------------------
+
+public:
+	/// Default Constructor.
+	FFernHistogram();
+	/// Destructor.
+	~FFernHistogram();
+
+private:
+	FFernHistogram(const FFernHistogram& other);
+	FFernHistogram& operator=(const FFernHistogram& other);
+
+	//  Public commands --------------------------------------------------------
+
+public:
+	/// Removes all counts and sets the number of bins. The histogram starts sparse.
+	void reset(size_t numBins);
+	/// Increments the count of the given bin.
+	void increment(size_t bin);
+	/// Sets the counts from the given array of numBins values. The storage is chosen
+	/// by the number of non-zero bins.
+	void setCounts(const quint32* pCounts, size_t numBins);
+
+	/// Uses the given data without copying. For sparse storage, pData points to entryCount
+	/// values of entry_t, for dense storage to numBins counts. The data must stay valid for
+	/// the lifetime of the histogram or until it is modified.
+	void attach(storage_t storage, const void* pData, size_t entryCount, size_t numBins);
+	/// Copies attached data to memory owned by the histogram.
+	void detach();
+
+	//  Public queries ---------------------------------------------------------
+
+public:
+	/// Returns the count of the given bin.
+	quint32 count(size_t bin) const;
+	/// Writes the counts of all bins to the given array of numBins() values.
+	void getCounts(OUT quint32* pCounts) const;
+
+	/// Returns the storage type.
+	storage_t storage() const { return m_storage; }
+	/// Returns the number of bins.
+	size_t numBins() const { return m_numBins; }
+	/// Returns the number of stored values, i.e. the number of non-zero bins
+	/// if the histogram is sparse, the number of bins otherwise.
+	size_t entryCount() const { return m_entryCount; }
+
+	/// Returns the stored values, see attach().
+	const void* data() const { return m_pData; }
+	/// Returns the non-zero bins of a sparse histogram.
+	const entry_t* sparseData() const { F_ASSERT(m_storage == Sparse); return (const entry_t*)m_pData; }
+	/// Returns the counts of a dense histogram.
+	const quint32* denseData() const { F_ASSERT(m_storage == Dense); return (const quint32*)m_pData; }
+	/// Returns the size of the stored values in bytes.
+	size_t byteSize() const { return sByteSize(m_storage, m_entryCount); }
+	/// Returns true if the data has been attached with attach().
+	bool isAttached() const { return m_pData != NULL && m_pData != _ownedData(); }
+
+	/// Returns the size of the given number of values in bytes.
+	static size_t sByteSize(storage_t storage, size_t entryCount) {
+		return entryCount * (storage == Sparse ? sizeof(entry_t) : sizeof(quint32));
+	}
+
+	//  Internal functions -----------------------------------------------------
+
+private:
+	void _makeDense();
+	const void* _ownedData() const;
+	void _updateData() { m_pData = _ownedData(); }
+
+	/// Sparse histograms switch to dense storage beyond this number of entries.
+	size_t _maxSparseEntries() const { return m_numBins * sizeof(quint32) / (2 * sizeof(entry_t)); }
+
+	//  Internal data members --------------------------------------------------
+
+private:
+	storage_t m_storage;
+	size_t m_numBins;
+	size_t m_entryCount;
+
+	std::vector<entry_t> m_sparse;
+	std::vector<quint32> m_dense;
+	const void* m_pData;
+};
+
+// ----------------------------------------------------------------------------------------------------
+
+#endif // FFERNHISTOGRAM_H
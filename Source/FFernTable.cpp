@@ -0,0 +1,343 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FFernTable.cpp
+//  Description		Implementation of class FFernTable
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-21 15:27:40 +0200 (Mi, 21 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#include "FTrackMeStable.h"
+
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+#include "FContourClass.h"
+
+#include "FFernTable.h"
+#include "FMemoryTracer.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FFernTable
+// ----------------------------------------------------------------------------------------------------
+
+// Constructors and destructor ------------------------------------------------------------------------
+
+FFernTable::FFernTable()
+: m_numFerns(0),
+  m_numBits(0),
+  m_numRows(0),
+  m_stride(0),
+  m_pTable(NULL),
+  m_ownsTable(true)
+{
+}
+
+FFernTable::~FFernTable()
+{
+}
+
+// Public commands ------------------------------------------------------------------------------------
+
+void FFernTable::reset(quint32 numFerns, quint32 numBits)
+{
+	for (size_t i = 0; i < m_classes.size(); i++)
+		m_classes[i]->_attachTable(NULL, 0);
+
+	m_numFerns = numFerns;
+	m_numBits = numBits;
+	m_numRows = sRowCount(numFerns, numBits);
+
+	m_stride = 0;
+	m_table.clear();
+	m_pTable = NULL;
+	m_ownsTable = true;
+	m_classes.clear();
+	m_normalization.clear();
+}
+
+void FFernTable::addClass(FContourClass* pClass)
+{
+	F_ASSERT(pClass);
+	F_ASSERT(pClass->m_numFerns == m_numFerns && pClass->m_numBits == m_numBits);
+
+	size_t column = m_classes.size();
+	if (column == m_stride)
+		_setStride(fMax((size_t)64, m_stride * 2));
+
+	m_classes.push_back(pClass);
+	m_normalization.push_back(0);
+	pClass->_attachTable(this, column);
+	_updateColumn(column);
+}
+
+void FFernTable::updateClass(const FContourClass* pClass, const quint32* pDescriptors)
+{
+	F_ASSERT(pClass && pClass->m_pFernTable == this);
+	size_t column = pClass->m_tableColumn;
+
+	detachTable();
+
+	for (quint32 f = 0; f < m_numFerns; f++)
+	{
+		size_t row = f * m_numBits + pDescriptors[f];
+		F_ASSERT(row < m_numRows);
+		m_table[row * m_stride + column] = sLogCount(pClass->m_histogram.count(row));
+	}
+
+	_updateNormalization(column);
+}
+
+void FFernTable::attachTable(const std::vector<FContourClass*>& classes, const cost_t* pTable, size_t stride)
+{
+	F_ASSERT(pTable && stride % 8 == 0 && stride >= classes.size());
+	reset(m_numFerns, m_numBits);
+
+	m_classes = classes;
+	m_normalization.resize(m_classes.size());
+	for (size_t i = 0; i < m_classes.size(); i++)
+	{
+		F_ASSERT(m_classes[i]->m_numFerns == m_numFerns && m_classes[i]->m_numBits == m_numBits);
+		m_classes[i]->_attachTable(this, i);
+		_updateNormalization(i);
+	}
+
+	m_stride = stride;
+	m_pTable = pTable;
+	m_ownsTable = false;
+}
+
+void FFernTable::detachTable()
+{
+	if (m_ownsTable)
+		return;
+
+	m_table.assign(m_pTable, m_pTable + m_numRows * m_stride);
+	m_pTable = m_table.empty() ? NULL : &m_table[0];
+	m_ownsTable = true;
+}
+
+// Public queries -------------------------------------------------------------------------------------
+
+float FFernTable::logProbability(size_t column, const quint32* pDescriptors) const
+{
+	F_ASSERT(column < m_classes.size());
+
+	quint32 sum = 0;
+	for (quint32 f = 0; f < m_numFerns; f++)
+	{
+		size_t row = f * m_numBits + pDescriptors[f];
+		F_ASSERT(row < m_numRows);
+		sum += m_pTable[row * m_stride + column];
+	}
+
+	return ((float)sum - (float)m_normalization[column]) / (float)COST_SCALE;
+}
+
+void FFernTable::getBestClasses(const quint32* pDescriptors, size_t numResults,
+								FContourClass** ppClassList, float* pLogProbability) const
+{
+	F_ASSERT(ppClassList);
+
+	if (numResults > MAX_DIRECT_RESULTS)
+	{
+		std::vector<classScore_t> scores(numResults);
+		getBestClasses(pDescriptors, 1, numResults, &scores[0]);
+
+		for (size_t k = 0; k < numResults; k++)
+		{
+			ppClassList[k] = scores[k].pClass;
+			if (pLogProbability)
+				pLogProbability[k] = scores[k].logProbability;
+		}
+		return;
+	}
+
+	// single query: the rows are summed in fern order on the stack, nothing is allocated or sorted
+	classScore_t scores[MAX_DIRECT_RESULTS];
+	quint32 best[MAX_DIRECT_RESULTS];
+	quint32 sum[COLUMN_BLOCK];
+
+	for (size_t k = 0; k < numResults; k++)
+	{
+		scores[k].pClass = NULL;
+		best[k] = 0xffffffff;
+	}
+
+	size_t numClasses = m_classes.size();
+	for (size_t c0 = 0; c0 < numClasses && numResults > 0; c0 += COLUMN_BLOCK)
+	{
+		size_t count = fMin((size_t)COLUMN_BLOCK, m_stride - c0);
+		memset(sum, 0, count * sizeof(quint32));
+
+		for (quint32 f = 0; f < m_numFerns; f++)
+		{
+			size_t row = f * m_numBits + pDescriptors[f];
+			F_ASSERT(row < m_numRows);
+			_addRow(m_pTable + row * m_stride + c0, sum, count);
+		}
+
+		_selectBest(sum, c0, fMin(c0 + (size_t)COLUMN_BLOCK, numClasses), numResults, best, scores);
+	}
+
+	for (size_t k = 0; k < numResults; k++)
+	{
+		ppClassList[k] = scores[k].pClass;
+		if (pLogProbability)
+			pLogProbability[k] = scores[k].pClass ? -(float)best[k] / (float)COST_SCALE : -FLT_MAX;
+	}
+}
+
+void FFernTable::getBestClasses(const quint32* pDescriptors, size_t numQueries, size_t numResults,
+								classScore_t* pResults) const
+{
+	F_ASSERT(pResults || numQueries * numResults == 0);
+
+	size_t numScores = numQueries * numResults;
+	std::vector<quint32> best(numScores, 0xffffffff);
+	for (size_t i = 0; i < numScores; i++)
+		pResults[i].pClass = NULL;
+
+	size_t numClasses = m_classes.size();
+	if (numClasses > 0 && numScores > 0)
+	{
+		// rows selected by the queries in table order, the query in the lower 32 bits
+		std::vector<quint64> rows(numQueries * m_numFerns);
+		for (size_t q = 0; q < numQueries; q++)
+		{
+			const quint32* pQuery = pDescriptors + q * m_numFerns;
+			for (quint32 f = 0; f < m_numFerns; f++)
+			{
+				quint64 row = f * m_numBits + pQuery[f];
+				F_ASSERT(row < m_numRows);
+				rows[q * m_numFerns + f] = (row << 32) | q;
+			}
+		}
+		std::sort(rows.begin(), rows.end());
+
+		std::vector<quint32> sum(numQueries * COLUMN_BLOCK);
+
+		for (size_t c0 = 0; c0 < numClasses; c0 += COLUMN_BLOCK)
+		{
+			size_t count = fMin((size_t)COLUMN_BLOCK, m_stride - c0);
+			std::fill(sum.begin(), sum.end(), 0);
+
+			// sum the rows selected by each query over the block of columns
+			for (size_t i = 0; i < rows.size(); i++)
+			{
+				size_t row = (size_t)(rows[i] >> 32);
+				size_t q = (size_t)(rows[i] & 0xffffffff);
+				_addRow(m_pTable + row * m_stride + c0, &sum[q * COLUMN_BLOCK], count);
+			}
+
+			size_t c1 = fMin(c0 + (size_t)COLUMN_BLOCK, numClasses);
+			for (size_t q = 0; q < numQueries; q++)
+				_selectBest(&sum[q * COLUMN_BLOCK], c0, c1, numResults,
+					&best[q * numResults], pResults + q * numResults);
+		}
+	}
+
+	for (size_t i = 0; i < numScores; i++)
+		pResults[i].logProbability = pResults[i].pClass ? -(float)best[i] / (float)COST_SCALE : -FLT_MAX;
+}
+
+// Internal functions ---------------------------------------------------------------------------------
+
+void FFernTable::_selectBest(const quint32* pSum, size_t firstColumn, size_t lastColumn,
+							 size_t numResults, quint32* pBest, classScore_t* pResults) const
+{
+	// select the classes with the lowest cost, on equal cost the first class is kept
+	for (size_t c = firstColumn; c < lastColumn; c++)
+	{
+		// the rounded log-counts may exceed the rounded normalization by a few units
+		quint32 sum = pSum[c - firstColumn];
+		quint32 cost = (m_normalization[c] > sum) ? m_normalization[c] - sum : 0;
+		if (cost >= pBest[numResults - 1])
+			continue;
+
+		size_t k = numResults - 1;
+		for (; k > 0 && cost < pBest[k - 1]; k--)
+		{
+			pBest[k] = pBest[k - 1];
+			pResults[k] = pResults[k - 1];
+		}
+
+		pBest[k] = cost;
+		pResults[k].pClass = m_classes[c];
+	}
+}
+
+void FFernTable::_setStride(size_t stride)
+{
+	F_ASSERT(stride % 8 == 0 && stride >= m_classes.size());
+	std::vector<cost_t> table(m_numRows * stride, 0);
+
+	size_t numClasses = m_classes.size();
+	for (size_t r = 0; r < m_numRows; r++)
+		for (size_t c = 0; c < numClasses; c++)
+			table[r * stride + c] = m_pTable[r * m_stride + c];
+
+	m_table.swap(table);
+	m_pTable = m_table.empty() ? NULL : &m_table[0];
+	m_ownsTable = true;
+	m_stride = stride;
+}
+
+void FFernTable::_updateColumn(size_t column)
+{
+	F_ASSERT(column < m_classes.size());
+	const FContourClass* pClass = m_classes[column];
+
+	detachTable();
+
+	const FFernHistogram& histogram = pClass->m_histogram;
+	F_ASSERT(histogram.numBins() == m_numRows);
+
+	if (histogram.storage() == FFernHistogram::Dense)
+	{
+		const quint32* pFrequency = histogram.denseData();
+		for (size_t r = 0; r < m_numRows; r++)
+			m_table[r * m_stride + column] = sLogCount(pFrequency[r]);
+	}
+	else
+	{
+		// all bins have the log-count of a zero count, i.e. 0, except for the listed ones
+		for (size_t r = 0; r < m_numRows; r++)
+			m_table[r * m_stride + column] = 0;
+
+		const FFernHistogram::entry_t* pEntries = histogram.sparseData();
+		for (size_t i = 0; i < histogram.entryCount(); i++)
+			m_table[pEntries[i].bin * m_stride + column] = sLogCount(pEntries[i].count);
+	}
+
+	_updateNormalization(column);
+}
+
+void FFernTable::_updateNormalization(size_t column)
+{
+	F_ASSERT(column < m_classes.size());
+	const FContourClass* pClass = m_classes[column];
+
+	// Laplace-smoothed posterior of each descriptor value, see FContourClass::exactLogProbability
+	double norm = log((double)pClass->m_classFrequency + (double)pClass->m_numTestsPerFern);
+	m_normalization[column] = (quint32)(m_numFerns * norm * COST_SCALE + 0.5);
+}
+
+void FFernTable::_addRow(const cost_t* pRow, quint32* pSum, size_t count)
+{
+	F_ASSERT(count % 8 == 0);
+	const __m128i zero = _mm_setzero_si128();
+
+	// widen 8 costs to 32 bits and add them to the sums
+	for (size_t i = 0; i < count; i += 8)
+	{
+		__m128i costs = _mm_loadu_si128((const __m128i*)(pRow + i));
+		__m128i* pSumLo = (__m128i*)(pSum + i);
+		__m128i* pSumHi = (__m128i*)(pSum + i + 4);
+
+		_mm_storeu_si128(pSumLo, _mm_add_epi32(_mm_loadu_si128(pSumLo), _mm_unpacklo_epi16(costs, zero)));
+		_mm_storeu_si128(pSumHi, _mm_add_epi32(_mm_loadu_si128(pSumHi), _mm_unpackhi_epi16(costs, zero)));
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------
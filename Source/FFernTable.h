@@ -0,0 +1,170 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FFernTable.h
+//  Description		Header file for FFernTable.cpp
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-21 15:27:40 +0200 (Mi, 21 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#ifndef FFERNTABLE_H
+#define FFERNTABLE_H
+
+#include <vector>
+#include <cmath>
+#include "FTrackMe.h"
+
+class FContourClass;
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FFernTable
+// ----------------------------------------------------------------------------------------------------
+
+/// Packed classifier data for all contour classes of a database. Stores the log-probabilities
+/// of all classes in a single table of rows, one row per fern and descriptor value, with one
+/// column per class. Rows are addressed like the frequency counts of FContourClass, i.e. the
+/// row of fern f and descriptor d is f * numBits + d. The table holds the unnormalized
+/// log-counts log(count + 1) as 16 bit fixed point values scaled by COST_SCALE; the
+/// normalization numFerns * log(classFrequency + numTestsPerFern) is kept per column. The
+/// cost of a class, its negated log-probability, is the normalization minus the sum of one
+/// row per fern. Classifying a descriptor sums the rows over all classes with integer adds and
+/// selects the classes with the lowest cost. An increment of a class only changes the rows of
+/// its descriptors and the normalization of its column.
+class FFernTable
+{
+	//  Public types -----------------------------------------------------------
+
+public:
+	/// Log-count of a table row in units of 1 / COST_SCALE.
+	typedef quint16 cost_t;
+
+	/// Fixed point scale of the log-counts and costs. The log-count of the largest frequency
+	/// count is below 22714, the rounding error is below 0.0005 per fern.
+	static const int COST_SCALE = 1024;
+
+	/// Class selected by a classification and its log-probability.
+	struct classScore_t
+	{
+		FContourClass* pClass;
+		float logProbability;
+	};
+
+	//  Constructors and destructor --------------------------------------------
+
+public:
+	/// Default Constructor.
+	FFernTable();
+	/// Virtual destructor.
+	virtual ~FFernTable();
+
+private:
+	FFernTable(const FFernTable& other);
+	FFernTable& operator=(const FFernTable& other);
+
+	//  Public commands --------------------------------------------------------
+
+public:
+	/// Removes all classes and sets the fern configuration. The classes
+	/// currently in the table are detached and must still be valid.
+	void reset(quint32 numFerns, quint32 numBits);
+
+	/// Appends a column for the given class and fills it from the class' frequency counts.
+	/// The class is attached to the table; its column is updated whenever it is incremented.
+	void addClass(FContourClass* pClass);
+	/// Updates the column of the given class after its frequency counts have been incremented
+	/// for the given descriptors. Only the rows of the descriptors and the normalization of the
+	/// column are recomputed.
+	void updateClass(const FContourClass* pClass, const quint32* pDescriptors);
+	/// Attaches the given classes and uses the given table data without copying, e.g. from
+	/// a memory mapped database file. The data must have the layout returned by tableData()
+	/// and stay valid for the lifetime of the table. The data is copied once, on the first update.
+	void attachTable(const std::vector<FContourClass*>& classes, const cost_t* pTable, size_t stride);
+	/// Copies attached table data to memory owned by the table.
+	void detachTable();
+
+	//  Public queries ---------------------------------------------------------
+
+public:
+	/// Returns the log-probability of the class in the given column given the fern descriptors.
+	float logProbability(size_t column, const quint32* pDescriptors) const;
+
+	/// Writes the numResults most probable classes given the fern descriptors to ppClassList,
+	/// most probable first. Unused entries are set to NULL. If pLogProbability is given, it
+	/// receives the log-probabilities of the returned classes. Can be called concurrently.
+	/// For up to 16 results, no memory is allocated.
+	void getBestClasses(const quint32* pDescriptors, size_t numResults,
+		OUT FContourClass** ppClassList, OUT float* pLogProbability = NULL) const;
+	/// Classifies a batch of queries, each given by numFerns() descriptors in pDescriptors. The
+	/// numResults most probable classes of query i are written to pResults[i * numResults],
+	/// most probable first, with the same selection as above. The rows selected by all queries
+	/// are visited in table order, block of columns by block of columns, so each row is loaded
+	/// once per batch. Can be called concurrently.
+	void getBestClasses(const quint32* pDescriptors, size_t numQueries, size_t numResults,
+		OUT classScore_t* pResults) const;
+
+	/// Returns the number of classes in the table.
+	size_t classCount() const { return m_classes.size(); }
+	/// Returns the class in the given column.
+	FContourClass* classAt(size_t column) const { return m_classes[column]; }
+
+	/// Returns the number of ferns.
+	quint32 numFerns() const { return m_numFerns; }
+	/// Returns the number of bits per fern.
+	quint32 numBits() const { return m_numBits; }
+	/// Returns the number of rows in the table.
+	size_t rowCount() const { return m_numRows; }
+	/// Returns the distance between rows in elements.
+	size_t stride() const { return m_stride; }
+	/// Returns the table data, rowCount() rows of stride() elements.
+	const cost_t* tableData() const { return m_pTable; }
+	/// Returns the size of the table data in bytes.
+	size_t byteSize() const { return m_numRows * m_stride * sizeof(cost_t); }
+	/// Returns false if the table data has been attached with attachTable().
+	bool ownsTable() const { return m_ownsTable; }
+
+	/// Returns the number of rows of a table with the given fern configuration.
+	static size_t sRowCount(quint32 numFerns, quint32 numBits) {
+		return (numFerns > 0) ? (numFerns - 1) * numBits + (1 << numBits) : 0;
+	}
+
+	//  Internal functions -----------------------------------------------------
+
+private:
+	void _setStride(size_t stride);
+	void _updateColumn(size_t column);
+	void _updateNormalization(size_t column);
+	static void _addRow(const cost_t* pRow, quint32* pSum, size_t count);
+	/// Inserts the columns [firstColumn, lastColumn) into the sorted list of the lowest costs.
+	void _selectBest(const quint32* pSum, size_t firstColumn, size_t lastColumn,
+		size_t numResults, quint32* pBest, classScore_t* pResults) const;
+
+	/// Returns the fixed point log-count of a table row with the given frequency count.
+	inline static cost_t sLogCount(quint32 count) {
+		return (cost_t)(log((double)count + 1.0) * COST_SCALE + 0.5);
+	}
+
+	//  Internal data members --------------------------------------------------
+
+private:
+	/// Number of columns summed at a time by the classification, a multiple of 8.
+	static const size_t COLUMN_BLOCK = 512;
+	/// Largest number of results of a single query selected without allocating.
+	static const size_t MAX_DIRECT_RESULTS = 16;
+
+	quint32 m_numFerns;
+	quint32 m_numBits;
+	size_t m_numRows;
+
+	/// Distance between rows in elements, a multiple of 8 and >= the number of classes.
+	size_t m_stride;
+	std::vector<cost_t> m_table;
+	const cost_t* m_pTable;
+	bool m_ownsTable;
+	std::vector<FContourClass*> m_classes;
+	/// Normalization cost of each column, numFerns * log(classFrequency + numTestsPerFern).
+	std::vector<quint32> m_normalization;
+};
+
+// ----------------------------------------------------------------------------------------------------
+
+#endif // FFERNTABLE_H
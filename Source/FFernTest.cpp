@@ -8,7 +8,15 @@
 // ----------------------------------------------------------------------------------------------------
 
 #include "FTrackMeStable.h"
+
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
 #include "FRandom.h"
+
 #include "FFernTest.h"
 #include "FMemoryTracer.h"
 
@@ -16,20 +24,27 @@
 //  Class FFernTest
 // ----------------------------------------------------------------------------------------------------
 
+// Static members -------------------------------------------------------------------------------------
+
+FFernTest::blockFunc_t FFernTest::s_pfGetDescriptorBlock = &FFernTest::_getDescriptorBlockScalar;
+bool FFernTest::s_isInitialized = FFernTest::_selectBest();
+
 // Constructors and destructor ------------------------------------------------------------------------
 
 FFernTest::FFernTest()
 : m_numFerns(0),
   m_numBits(0),
   m_patchSize(0, 0),
-  m_pPos(NULL)
+  m_pPos(NULL),
+  m_tableStride(0)
 {
 }
 
 FFernTest::FFernTest(size_t numFerns, size_t numBits, const QSize& patchSize)
 : m_numFerns(numFerns),
   m_numBits(numBits),
-  m_patchSize(patchSize)
+  m_patchSize(patchSize),
+  m_tableStride(0)
 {
 	m_pPos = new quint32[m_numFerns * m_numBits * 2];
 	create(-1);
@@ -80,6 +95,8 @@ void FFernTest::create(int seed /* = -1 */)
 
 		m_pPos[i] = y * mx + x;
 	}
+
+	_buildTables();
 }
 
 void FFernTest::create(size_t numFerns, size_t numBits, const QSize& patchSize, int seed /* = -1 */)
@@ -106,6 +123,8 @@ void FFernTest::serialize(FArchive& ar)
 		m_pPos = new quint32[N];
 		for (quint32 i = 0; i < N; i++)
 			ar >> m_pPos[i];
+
+		_buildTables();
 	}
 	else
 	{
@@ -121,6 +140,51 @@ void FFernTest::serialize(FArchive& ar)
 	//dump();
 }
 
+void FFernTest::setSSE2Enabled(bool enabled)
+{
+	if (enabled && isSSE2Supported())
+		s_pfGetDescriptorBlock = &FFernTest::_getDescriptorBlockSSE2;
+	else
+		s_pfGetDescriptorBlock = &FFernTest::_getDescriptorBlockScalar;
+}
+
+// Public queries -------------------------------------------------------------------------------------
+
+void FFernTest::getDescriptor(const float* pPatch, quint32* pResult) const
+{
+	F_ASSERT(pPatch);
+	F_ASSERT(m_tableStride > 0 || m_numFerns == 0);
+
+	for (quint32 f = 0; f < m_numFerns; f += 4)
+		_getDescriptorBlock(pPatch, f, pResult);
+}
+
+void FFernTest::getDescriptors(const float* const* ppPatches, size_t numPatches, quint32* pResult) const
+{
+	F_ASSERT(ppPatches || numPatches == 0);
+	F_ASSERT(m_tableStride > 0 || m_numFerns == 0);
+
+	// the table rows of a block of ferns stay in the cache while all patches are processed
+	for (quint32 f = 0; f < m_numFerns; f += 4)
+		for (size_t i = 0; i < numPatches; i++)
+			_getDescriptorBlock(ppPatches[i], f, pResult + i * m_numFerns);
+}
+
+bool FFernTest::isSSE2Supported()
+{
+	int info[4] = { 0, 0, 0, 0 };
+#ifdef _MSC_VER
+	__cpuid(info, 1);
+#else
+	unsigned int a, b, c, d;
+	if (__get_cpuid(1, &a, &b, &c, &d))
+		info[3] = (int)d;
+#endif
+
+	// EDX bit 26: SSE2
+	return (info[3] & (1 << 26)) != 0;
+}
+
 #ifdef QT_DEBUG
 void FFernTest::dump(QDebug& debug) const
 {
@@ -142,4 +206,91 @@ void FFernTest::dump(QDebug& debug) const
 }
 #endif
 
+// Internal functions ---------------------------------------------------------------------------------
+
+void FFernTest::_buildTables()
+{
+	m_tableStride = (m_numFerns + 3) & ~3u;
+
+	// padding ferns compare location 0 with itself, which never sets a bit
+	m_tablePos0.assign(m_tableStride * m_numBits, 0);
+	m_tablePos1.assign(m_tableStride * m_numBits, 0);
+
+	for (quint32 f = 0; f < m_numFerns; f++)
+	{
+		for (quint32 b = 0; b < m_numBits; b++)
+		{
+			quint32 i = b * m_tableStride + f;
+			testIndex(f, b, m_tablePos0[i], m_tablePos1[i]);
+		}
+	}
+}
+
+bool FFernTest::_selectBest()
+{
+	setSSE2Enabled(true);
+	return true;
+}
+
+void FFernTest::_getDescriptorBlockSSE2(const float* pPatch, quint32 fern, quint32* pResult) const
+{
+	const __m128 zero = _mm_setzero_ps();
+	const quint32* pPos0 = &m_tablePos0[fern];
+	const quint32* pPos1 = &m_tablePos1[fern];
+
+	// each lane accumulates the descriptor of one fern, a set bit is added by
+	// subtracting the all-ones compare mask from the shifted descriptor
+	__m128i dc = _mm_setzero_si128();
+
+	for (quint32 b = 0; b < m_numBits; b++)
+	{
+		__m128 d0 = _mm_setr_ps(pPatch[pPos0[0]], pPatch[pPos0[1]], pPatch[pPos0[2]], pPatch[pPos0[3]]);
+		__m128 d1 = _mm_setr_ps(pPatch[pPos1[0]], pPatch[pPos1[1]], pPatch[pPos1[2]], pPatch[pPos1[3]]);
+		__m128 isSet = _mm_and_ps(_mm_cmpge_ps(d0, zero), _mm_cmpgt_ps(d1, d0));
+
+		dc = _mm_sub_epi32(_mm_slli_epi32(dc, 1), _mm_castps_si128(isSet));
+		pPos0 += m_tableStride;
+		pPos1 += m_tableStride;
+	}
+
+	if (fern + 4 <= m_numFerns)
+	{
+		_mm_storeu_si128((__m128i*)(pResult + fern), dc);
+	}
+	else
+	{
+		quint32 block[4];
+		_mm_storeu_si128((__m128i*)block, dc);
+		for (quint32 f = fern; f < m_numFerns; f++)
+			pResult[f] = block[f - fern];
+	}
+}
+
+void FFernTest::_getDescriptorBlockScalar(const float* pPatch, quint32 fern, quint32* pResult) const
+{
+	quint32 numFerns = fMin(m_numFerns - fern, 4u);
+
+	for (quint32 f = 0; f < numFerns; f++)
+	{
+		const quint32* pPos0 = &m_tablePos0[fern + f];
+		const quint32* pPos1 = &m_tablePos1[fern + f];
+		quint32 dc = 0;
+
+		for (quint32 b = 0; b < m_numBits; b++)
+		{
+			float d0 = pPatch[*pPos0];
+			float d1 = pPatch[*pPos1];
+
+			dc <<= 1;
+			if (d0 >= 0.0f && d1 > d0)
+				dc++;
+
+			pPos0 += m_tableStride;
+			pPos1 += m_tableStride;
+		}
+
+		pResult[fern + f] = dc;
+	}
+}
+
 // ----------------------------------------------------------------------------------------------------
\ No newline at end of file
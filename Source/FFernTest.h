@@ -10,6 +10,8 @@
 #ifndef FFERNTEST_H
 #define FFERNTEST_H
 
+#include <vector>
+
 #include "FTrackMe.h"
 #include "FArchive.h"
 
@@ -18,7 +20,10 @@
 // ----------------------------------------------------------------------------------------------------
 
 /// Holds a binary test pattern for F ferns x B fern-bits, i.e. a total of F x B x 2 randomly
-/// created, Gaussian-distributed test locations for a patch of given size.
+/// created, Gaussian-distributed test locations for a patch of given size. The tests are
+/// additionally kept in tables ordered by bit and fern, from which the descriptors of four
+/// ferns are evaluated at a time. A scalar and an SSE2 implementation of the evaluation are
+/// available, the SSE2 one is selected at startup if the CPU supports it.
 class FFernTest
 {
 	//  Constructors and destructor --------------------------------------------
@@ -48,6 +53,11 @@ public:
 	/// Serialization.
 	void serialize(FArchive& ar);
 
+	/// Selects the SSE2 or the scalar implementation of the descriptor evaluation, both yield
+	/// the same descriptors. Falls back to the scalar implementation if SSE2 is not supported
+	/// by the CPU. Not thread-safe, call only while no descriptors are evaluated.
+	static void setSSE2Enabled(bool enabled);
+
 #ifdef QT_DEBUG
 	/// Writes information about the internal state to the given debug object.
 	void dump(QDebug& debug) const;
@@ -70,6 +80,14 @@ public:
 		posIndex1 = m_pPos[tableIndex+1];
 	}
 
+	/// Runs all binary tests on the given patch and writes the descriptor of each fern to the
+	/// given array. A bit is set if the first location holds a value >= 0 and the second
+	/// location holds a larger value. The first test of a fern yields the most significant bit.
+	void getDescriptor(const float* pPatch, quint32* pResult) const;
+	/// Runs all binary tests on each of the given patches. The descriptors of patch i are
+	/// written to pResult[i * numFerns()]. The tables are traversed once for all patches.
+	void getDescriptors(const float* const* ppPatches, size_t numPatches, quint32* pResult) const;
+
 	/// Returns the total number of ferns.
 	quint32 numFerns() const { return m_numFerns; }
 	/// Returns the total number of bits per fern.
@@ -80,6 +98,30 @@ public:
 	/// Returns the size of the patch the tests are performed within.
 	const QSize& patchSize() const { return m_patchSize; }
 
+	/// Returns true if the SSE2 implementation is used.
+	static bool isSSE2Enabled() { return s_pfGetDescriptorBlock == &FFernTest::_getDescriptorBlockSSE2; }
+	/// Returns true if SSE2 is supported by the CPU.
+	static bool isSSE2Supported();
+
+	//  Internal types ---------------------------------------------------------
+
+private:
+	typedef void (FFernTest::*blockFunc_t)(const float* pPatch, quint32 fern, quint32* pResult) const;
+
+	//  Internal functions -----------------------------------------------------
+
+private:
+	/// Rebuilds the test tables from the test locations.
+	void _buildTables();
+	/// Evaluates the descriptors of four ferns starting at the given fern.
+	void _getDescriptorBlock(const float* pPatch, quint32 fern, quint32* pResult) const {
+		(this->*s_pfGetDescriptorBlock)(pPatch, fern, pResult);
+	}
+	void _getDescriptorBlockScalar(const float* pPatch, quint32 fern, quint32* pResult) const;
+	void _getDescriptorBlockSSE2(const float* pPatch, quint32 fern, quint32* pResult) const;
+
+	static bool _selectBest();
+
 	//  Internal data members --------------------------------------------------
 
 private:
@@ -88,6 +130,14 @@ private:
 	QSize m_patchSize;
 
 	quint32* m_pPos;
+
+	// test locations ordered by bit, then by fern, padded to a multiple of four ferns
+	quint32 m_tableStride;
+	std::vector<quint32> m_tablePos0;
+	std::vector<quint32> m_tablePos1;
+
+	static blockFunc_t s_pfGetDescriptorBlock;
+	static bool s_isInitialized;
 };
 	
 // ----------------------------------------------------------------------------------------------------
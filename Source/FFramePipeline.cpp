@@ -0,0 +1,286 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FFramePipeline.cpp
+//  Description		Implementation of class FFramePipeline
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-10-11 14:05:22 +0200 (Di, 11 Okt 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#include "FTrackMeStable.h"
+
+#include <QThread>
+#include "FStreamSource.h"
+
+#include "FFramePipeline.h"
+#include "FMemoryTracer.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FFramePipeline::FDecoder
+// ----------------------------------------------------------------------------------------------------
+
+class FFramePipeline::FDecoder : public QThread
+{
+public:
+	FDecoder(FFramePipeline* pPipeline) : m_pPipeline(pPipeline) { }
+
+protected:
+	virtual void run() { m_pPipeline->_decoderLoop(); }
+
+private:
+	FFramePipeline* m_pPipeline;
+};
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FFramePipeline
+// ----------------------------------------------------------------------------------------------------
+
+// Constructors and destructor ------------------------------------------------------------------------
+
+FFramePipeline::FFramePipeline()
+: m_pSource(NULL),
+  m_pDecoder(NULL),
+  m_mode(Automatic),
+  m_activeMode(Throughput),
+  m_queueLength(4),
+  m_loop(false),
+  m_queueHead(0),
+  m_queueCount(0),
+  m_capacity(0),
+  m_isAtEnd(false),
+  m_decodeBusy(0.0),
+  m_droppedCount(0),
+  m_stage(FPipelineStatistics::Upload),
+  m_stageStart(0.0),
+  m_lastFinish(0.0),
+  m_wantExit(false)
+{
+	memset(m_stageTime, 0, sizeof(m_stageTime));
+}
+
+FFramePipeline::~FFramePipeline()
+{
+	stop();
+}
+
+// Public commands ------------------------------------------------------------------------------------
+
+bool FFramePipeline::start(FStreamSource* pSource, bool loop)
+{
+	F_ASSERT(pSource);
+	stop();
+
+	FStreamSource::source_t sourceType = pSource->sourceType();
+	bool isLive = (sourceType == FStreamSource::LiveVideo || sourceType == FStreamSource::DecklinkVideo);
+
+	if (!pSource->isOpen() || sourceType == FStreamSource::Image)
+		return false;
+
+	m_pSource = pSource;
+	m_loop = loop && !isLive;
+	m_activeMode = m_mode;
+	if (m_activeMode == Automatic)
+		m_activeMode = isLive ? Latency : Throughput;
+
+	// in latency mode, a newly decoded frame replaces the one waiting
+	m_capacity = (m_activeMode == Latency) ? 1 : m_queueLength;
+	m_queue.assign(m_capacity, frame_t());
+	m_queueHead = 0;
+	m_queueCount = 0;
+	m_isAtEnd = false;
+	m_wantExit = false;
+
+	m_decodeBusy = 0.0;
+	m_droppedCount = 0;
+	m_lastFinish = 0.0;
+	m_clock.start();
+
+	m_pDecoder = new FDecoder(this);
+	m_pDecoder->start();
+	return true;
+}
+
+void FFramePipeline::stop()
+{
+	if (!m_pDecoder)
+		return;
+
+	m_lock.lock();
+	m_wantExit = true;
+	m_frameTaken.wakeAll();
+	m_lock.unlock();
+
+	m_pDecoder->wait(ULONG_MAX);
+	F_SAFE_DELETE(m_pDecoder);
+
+	m_queue.clear();
+	m_queueCount = 0;
+	m_pSource = NULL;
+}
+
+bool FFramePipeline::take(frame_t& frame, double timeout /* = 0.0 */)
+{
+	F_ASSERT(isRunning());
+
+	m_lock.lock();
+
+	if (m_queueCount == 0 && !m_isAtEnd && timeout > 0.0)
+		m_frameQueued.wait(&m_lock, (unsigned long)(timeout * 1000.0));
+
+	if (m_queueCount == 0)
+	{
+		m_lock.unlock();
+		return false;
+	}
+
+	// skip to the newest frame, older frames are dropped before they are uploaded
+	if (m_activeMode == Latency)
+	{
+		while (m_queueCount > 1)
+		{
+			m_queue[m_queueHead].image = QImage();
+			m_queueHead = (m_queueHead + 1) % m_capacity;
+			m_queueCount--;
+			m_droppedCount++;
+		}
+	}
+
+	frame = m_queue[m_queueHead];
+	m_queue[m_queueHead].image = QImage();
+	m_queueHead = (m_queueHead + 1) % m_capacity;
+	m_queueCount--;
+
+	m_frameTaken.wakeAll();
+	m_lock.unlock();
+
+	memset(m_stageTime, 0, sizeof(m_stageTime));
+	return true;
+}
+
+void FFramePipeline::beginStage(FPipelineStatistics::stage_t stage)
+{
+	m_stage = stage;
+	m_stageStart = m_clock.time();
+}
+
+void FFramePipeline::endStage()
+{
+	m_stageTime[m_stage] += m_clock.time() - m_stageStart;
+}
+
+void FFramePipeline::finishFrame(const frame_t& frame, FPipelineStatistics* pStats)
+{
+	double now = m_clock.time();
+	double interval = now - ((m_lastFinish > 0.0) ? m_lastFinish : frame.timeDecoded);
+	m_lastFinish = now;
+
+	m_lock.lock();
+	double decodeBusy = m_decodeBusy;
+	m_decodeBusy = 0.0;
+	int queueDepth = (int)m_queueCount;
+	quint32 droppedCount = m_droppedCount;
+	m_lock.unlock();
+
+	if (!pStats)
+		return;
+
+	m_stageTime[FPipelineStatistics::Decode] = frame.timeDecode;
+
+	for (size_t i = 0; i < FPipelineStatistics::NumStages; i++)
+	{
+		double busy = (i == FPipelineStatistics::Decode) ? decodeBusy : m_stageTime[i];
+		pStats->time[i] = m_stageTime[i];
+		pStats->occupancy[i] = (interval > 0.0) ? fMin(busy / interval, 1.0) : 0.0;
+	}
+
+	pStats->latency = now - frame.timeDecoded;
+	pStats->frameInterval = interval;
+	pStats->queueDepth = queueDepth;
+	pStats->framesDropped = droppedCount;
+}
+
+// Public queries -------------------------------------------------------------------------------------
+
+bool FFramePipeline::isAtEnd()
+{
+	m_lock.lock();
+	bool result = m_isAtEnd && m_queueCount == 0;
+	m_lock.unlock();
+
+	return result;
+}
+
+// Internal functions ---------------------------------------------------------------------------------
+
+void FFramePipeline::_decoderLoop()
+{
+	m_lock.lock();
+
+	while (true)
+	{
+		// in latency mode, decoding never waits, the frame waiting is replaced
+		while (!m_wantExit && m_activeMode != Latency && m_queueCount == m_capacity)
+			m_frameTaken.wait(&m_lock);
+
+		if (m_wantExit)
+			break;
+
+		m_lock.unlock();
+
+		frame_t frame;
+		double start = m_clock.time();
+		bool result = _decode(frame);
+		frame.timeDecoded = m_clock.time();
+		frame.timeDecode = frame.timeDecoded - start;
+
+		m_lock.lock();
+		m_decodeBusy += frame.timeDecode;
+
+		if (!result)
+		{
+			m_isAtEnd = true;
+			m_frameQueued.wakeAll();
+			break;
+		}
+
+		if (m_queueCount == m_capacity)
+		{
+			m_queue[m_queueHead].image = QImage();
+			m_queueHead = (m_queueHead + 1) % m_capacity;
+			m_queueCount--;
+			m_droppedCount++;
+		}
+
+		m_queue[(m_queueHead + m_queueCount) % m_capacity] = frame;
+		m_queueCount++;
+		m_frameQueued.wakeAll();
+	}
+
+	m_lock.unlock();
+}
+
+bool FFramePipeline::_decode(frame_t& frame)
+{
+	if (!m_pSource->hasNewFrame())
+		m_pSource->next();
+
+	if (!m_pSource->hasNewFrame())
+	{
+		if (!m_loop)
+			return false;
+
+		m_pSource->toBegin();
+		frame.isRestart = true;
+
+		if (!m_pSource->hasNewFrame())
+			return false;
+	}
+
+	m_pSource->getFrame(frame.image);
+	frame.frameIndex = m_pSource->frameIndex();
+	frame.source = m_pSource->statistics();
+
+	return !frame.image.isNull();
+}
+
+// ----------------------------------------------------------------------------------------------------
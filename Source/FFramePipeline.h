@@ -0,0 +1,163 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FFramePipeline.h
+//  Description		Header file for FFramePipeline.cpp
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-10-11 14:05:22 +0200 (Di, 11 Okt 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#ifndef FFRAMEPIPELINE_H
+#define FFRAMEPIPELINE_H
+
+#include <vector>
+#include <QImage>
+#include <QMutex>
+#include <QWaitCondition>
+#include "FTrackMe.h"
+#include "FStopWatch.h"
+#include "FFrameStatistics.h"
+
+class FStreamSource;
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FFramePipeline
+// ----------------------------------------------------------------------------------------------------
+
+/// Runs the decode stage of the frame processing in a thread of its own. The frames are read
+/// from the stream source into a bounded queue, the stages using OpenGL (upload, preprocess,
+/// track, present) are run by the processing thread, which takes the frames from the queue.
+/// In throughput mode, every frame is processed in order and decoding waits while the queue
+/// is full. In latency mode, the oldest frame is dropped if the queue is full and the
+/// processing thread always takes the newest frame, skipping the others before upload.
+/// The stream source must not be accessed by other threads while the pipeline is running.
+class FFramePipeline
+{
+	//  Public types -----------------------------------------------------------
+
+public:
+	enum mode_t
+	{
+		/// Latency mode for live streams, throughput mode for files.
+		Automatic,
+		Throughput,
+		Latency
+	};
+
+	struct frame_t
+	{
+		frame_t() : frameIndex(0), isRestart(false), timeDecoded(0.0), timeDecode(0.0) { }
+
+		QImage image;
+		size_t frameIndex;
+		/// True for the first frame after the source has wrapped around to the begin.
+		bool isRestart;
+		/// Pipeline time when the frame has been queued.
+		double timeDecoded;
+		/// Time in seconds spent reading the frame from the source.
+		double timeDecode;
+		FSourceStatistics source;
+	};
+
+	//  Constructors and destructor --------------------------------------------
+
+public:
+	/// Default Constructor.
+	FFramePipeline();
+	/// Virtual destructor. Stops the pipeline.
+	virtual ~FFramePipeline();
+
+private:
+	FFramePipeline(const FFramePipeline& other);
+	FFramePipeline& operator=(const FFramePipeline& other);
+
+	//  Public commands --------------------------------------------------------
+
+public:
+	/// Starts decoding frames from the given source, beginning with its current frame if it
+	/// has not been read yet, e.g. after seeking, otherwise with the next frame. If loop is
+	/// true, a movie or sequence restarts at the begin, otherwise decoding ends with the
+	/// last frame. Returns false if the source cannot be decoded ahead (single images).
+	bool start(FStreamSource* pSource, bool loop);
+	/// Stops decoding and discards the queued frames. The source is left at the last
+	/// frame decoded, which may be ahead of the last frame taken.
+	void stop();
+
+	/// Takes the next frame from the queue, waits up to the given time in seconds if the
+	/// queue is empty. Returns false if no frame is available. In latency mode, the frames
+	/// older than the newest are dropped.
+	bool take(frame_t& frame, double timeout = 0.0);
+
+	/// Starts timing the given stage of the processing thread.
+	void beginStage(FPipelineStatistics::stage_t stage);
+	/// Ends timing the current stage.
+	void endStage();
+	/// Completes the timing of the frame taken last and fills in the statistics.
+	void finishFrame(const frame_t& frame, FPipelineStatistics* pStats);
+
+	/// Sets the mode used from the next start.
+	void setMode(mode_t mode) { m_mode = mode; }
+	/// Sets the number of frames the queue can hold in throughput mode, used from the next start.
+	/// In latency mode, a single frame is held.
+	void setQueueLength(size_t length) { m_queueLength = fMax(length, (size_t)1); }
+
+	//  Public queries ---------------------------------------------------------
+
+public:
+	/// Returns true if the decode stage is running.
+	bool isRunning() const { return m_pDecoder != NULL; }
+	/// Returns true if decoding has reached the end of the source and the queue is empty.
+	bool isAtEnd();
+	/// Returns the mode set.
+	mode_t mode() const { return m_mode; }
+	/// Returns the mode in effect since the last start.
+	mode_t activeMode() const { return m_activeMode; }
+	/// Returns the number of frames dropped since the last start.
+	quint32 droppedFrameCount() const { return m_droppedCount; }
+
+	//  Internal types ---------------------------------------------------------
+
+private:
+	class FDecoder;
+
+	//  Internal functions -----------------------------------------------------
+
+private:
+	void _decoderLoop();
+	bool _decode(frame_t& frame);
+
+	//  Internal data members --------------------------------------------------
+
+private:
+	FStreamSource* m_pSource;
+	FDecoder* m_pDecoder;
+
+	mode_t m_mode;
+	mode_t m_activeMode;
+	size_t m_queueLength;
+	bool m_loop;
+
+	std::vector<frame_t> m_queue;
+	size_t m_queueHead;
+	size_t m_queueCount;
+	size_t m_capacity;
+	bool m_isAtEnd;
+
+	FStopWatch m_clock;
+	double m_decodeBusy;
+	quint32 m_droppedCount;
+
+	FPipelineStatistics::stage_t m_stage;
+	double m_stageStart;
+	double m_stageTime[FPipelineStatistics::NumStages];
+	double m_lastFinish;
+
+	bool m_wantExit;
+	QMutex m_lock;
+	QWaitCondition m_frameQueued;
+	QWaitCondition m_frameTaken;
+};
+
+// ----------------------------------------------------------------------------------------------------
+
+#endif // FFRAMEPIPELINE_H
@@ -39,6 +39,8 @@ struct FTrackerStatistics
 	double timeSearch;
 	double timeOptimizationA;
 	double timeOptimizationB;
+	/// Time of the optimization using the alternative Jacobian method (benchmark only).
+	double timeOptimizationRef;
 
 	double variance[7];
 
@@ -55,15 +57,116 @@ struct FDetectorStatistics
 		memset(this, 0, sizeof(FDetectorStatistics));
 	}
 
+	/// Time of the canny edge detection and distance transform if run on the CPU.
+	double timePreprocessing;
 	double timeContourExtraction;
 	double timeContourNormalization;
 	double timeContourAlignment;
 	double timePoseReconstruction;
 
+	/// Wall time of the parallel contour matching (part of timeContourAlignment).
+	double timeContourMatching;
+	/// Per-stage times of the contour matching, summed over all candidates and workers.
+	double timePatchWarp;
+	double timeClassification;
+	double timeHomographyFit;
+
+	int numContours;
+	int numWorkers;
 	int numPoses;
 	int poseUsed;
 };
 
+// ----------------------------------------------------------------------------------------------------
+//  Struct FReadbackStatistics
+// ----------------------------------------------------------------------------------------------------
+
+/// Time in seconds the processing thread waited for asynchronous GPU readbacks.
+struct FReadbackStatistics
+{
+	FReadbackStatistics() {
+		memset(this, 0, sizeof(FReadbackStatistics));
+	}
+
+	double stallSearchResult;
+	double stallDistanceTransform;
+	/// Stall of the playout readback, reported with the following frame.
+	double stallPlayout;
+};
+
+// ----------------------------------------------------------------------------------------------------
+//  Struct FSourceStatistics
+// ----------------------------------------------------------------------------------------------------
+
+/// Reading of the source frame, only filled in for image sequences.
+struct FSourceStatistics
+{
+	FSourceStatistics() {
+		memset(this, 0, sizeof(FSourceStatistics));
+	}
+
+	/// Time in seconds spent decoding the frame in a decoder thread.
+	double timeDecode;
+	/// Time in seconds the processing thread waited for the frame.
+	double stallRead;
+	/// Number of decoded frames ready after the frame.
+	int queueDepth;
+};
+
+// ----------------------------------------------------------------------------------------------------
+//  Struct FPlayoutStatistics
+// ----------------------------------------------------------------------------------------------------
+
+/// Frame counts of the playout since it has been started, reported with the following frame.
+struct FPlayoutStatistics
+{
+	FPlayoutStatistics() {
+		memset(this, 0, sizeof(FPlayoutStatistics));
+	}
+
+	quint32 framesWritten;
+	/// Frames dropped because the queue was full or writing failed.
+	quint32 framesDropped;
+	/// Frames queued but not yet written.
+	quint32 framesPending;
+};
+
+// ----------------------------------------------------------------------------------------------------
+//  Struct FPipelineStatistics
+// ----------------------------------------------------------------------------------------------------
+
+/// Stages of the frame pipeline, only filled in while playing, see FFramePipeline. The occupancy
+/// of a stage is the time it was busy relative to the interval between two processed frames.
+/// The decode stage includes waiting for a live capture device.
+struct FPipelineStatistics
+{
+	FPipelineStatistics() {
+		memset(this, 0, sizeof(FPipelineStatistics));
+	}
+
+	enum stage_t
+	{
+		Decode					= 0,
+		Upload					= 1,
+		Preprocess				= 2,
+		Track					= 3,
+		Present					= 4,
+		NumStages				= 5
+	};
+
+	double time[NumStages];
+	double occupancy[NumStages];
+
+	/// Time in seconds from the end of decoding to the end of presenting the frame.
+	double latency;
+	/// Time in seconds since the previous frame has been processed.
+	double frameInterval;
+	/// Number of decoded frames waiting in the queue.
+	int queueDepth;
+	/// Frames dropped in latency mode since playing has been started.
+	quint32 framesDropped;
+};
+
 // ----------------------------------------------------------------------------------------------------
 //  Struct FFrameStatistics
 // ----------------------------------------------------------------------------------------------------
@@ -78,6 +181,10 @@ struct FFrameStatistics
 
 	FTrackerStatistics tracker;
 	FDetectorStatistics detector;
+	FReadbackStatistics readback;
+	FSourceStatistics source;
+	FPlayoutStatistics playout;
+	FPipelineStatistics pipeline;
 
 	double finalPose[7];
 	double finalPoseSmooth[7];
@@ -16,9 +16,4 @@
 //  Class FGlobalConstants
 // ----------------------------------------------------------------------------------------------------
 
-// Static members -------------------------------------------------------------------------------------
-
-float* FGlobalConstants::pLevmarDetectionWorkspace = NULL;
-double* FGlobalConstants::pLevmarTrackingWorkspace = NULL;
-
 // ----------------------------------------------------------------------------------------------------
\ No newline at end of file
@@ -48,11 +48,6 @@ public:
 	/// Pose detection: The number of bits per fern used by the classifier.
 	static const size_t NUM_BITS = 11;
 
-	// TODO: Dirty hack!
-	static float* pLevmarDetectionWorkspace;
-	static double* pLevmarTrackingWorkspace;
-
-
 	//  Internal functions -----------------------------------------------------
 
 private:
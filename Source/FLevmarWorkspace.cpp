@@ -0,0 +1,81 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FLevmarWorkspace.cpp
+//  Description		Implementation of class FLevmarWorkspace
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-19 11:02:17 +0200 (Mo, 19 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#include "FTrackMeStable.h"
+
+#include "FLevmarWorkspace.h"
+#include "FMemoryTracer.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FLevmarWorkspace
+// ----------------------------------------------------------------------------------------------------
+
+// Static members -------------------------------------------------------------------------------------
+
+QThreadStorage<FLevmarWorkspace::arena_t*> FLevmarWorkspace::s_threadArenas;
+
+// Constructors and destructor ------------------------------------------------------------------------
+
+FLevmarWorkspace::FLevmarWorkspace(size_t numElements, size_t elementSize)
+: m_pData(NULL),
+  m_pArena(NULL),
+  m_pPrivateData(NULL)
+{
+	// capacity is counted in doubles to keep the memory aligned for both precisions
+	size_t numDoubles = (numElements * elementSize + sizeof(double) - 1) / sizeof(double);
+
+	arena_t* pArena = _threadArena();
+
+	if (pArena->isInUse)
+	{
+		// nested solver call in the same thread, use a private buffer
+		F_TRACE("FLevmarWorkspace - Arena in use, allocating private workspace");
+		m_pPrivateData = new double[numDoubles];
+		m_pData = m_pPrivateData;
+		return;
+	}
+
+	if (pArena->capacity < numDoubles)
+	{
+		delete[] pArena->pData;
+		pArena->pData = new double[numDoubles];
+		pArena->capacity = numDoubles;
+	}
+
+	pArena->isInUse = true;
+	m_pArena = pArena;
+	m_pData = pArena->pData;
+}
+
+FLevmarWorkspace::~FLevmarWorkspace()
+{
+	if (m_pArena)
+		m_pArena->isInUse = false;
+
+	F_SAFE_DELETE_ARRAY(m_pPrivateData);
+}
+
+// Public queries -------------------------------------------------------------------------------------
+
+size_t FLevmarWorkspace::threadCapacity()
+{
+	return _threadArena()->capacity * sizeof(double);
+}
+
+// Internal functions ---------------------------------------------------------------------------------
+
+FLevmarWorkspace::arena_t* FLevmarWorkspace::_threadArena()
+{
+	if (!s_threadArenas.hasLocalData())
+		s_threadArenas.setLocalData(new arena_t());
+
+	return s_threadArenas.localData();
+}
+
+// ----------------------------------------------------------------------------------------------------
@@ -0,0 +1,83 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FLevmarWorkspace.h
+//  Description		Header file for FLevmarWorkspace.cpp
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-19 11:02:17 +0200 (Mo, 19 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#ifndef FLEVMARWORKSPACE_H
+#define FLEVMARWORKSPACE_H
+
+#include "FTrackMe.h"
+#include <QThreadStorage>
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FLevmarWorkspace
+// ----------------------------------------------------------------------------------------------------
+
+/// Scoped workspace for a levmar solver call. Each thread owns a workspace arena which is handed
+/// to the solver calls of that thread. The arena only grows, so after the first calls no more
+/// memory is allocated. Solvers running in different threads never share a workspace.
+///
+/// Usage:
+///     FLevmarWorkspace workspace(LM_DER_WORKSZ(numParams, numData), sizeof(float));
+///     slevmar_der(..., workspace.floatData(), ...);
+class FLevmarWorkspace
+{
+	//  Constructors and destructor --------------------------------------------
+
+public:
+	/// Acquires the workspace of the calling thread with room for at least
+	/// numElements elements of the given size in bytes.
+	FLevmarWorkspace(size_t numElements, size_t elementSize);
+	/// Releases the workspace.
+	~FLevmarWorkspace();
+
+	//  Public queries ---------------------------------------------------------
+
+public:
+	/// Returns the workspace memory for single precision solvers.
+	float* floatData() const { return static_cast<float*>(m_pData); }
+	/// Returns the workspace memory for double precision solvers.
+	double* doubleData() const { return static_cast<double*>(m_pData); }
+
+	/// Returns the size of the calling thread's arena in bytes.
+	static size_t threadCapacity();
+
+	//  Internal types ---------------------------------------------------------
+
+private:
+	struct arena_t
+	{
+		arena_t() : pData(NULL), capacity(0), isInUse(false) { }
+		~arena_t() { delete[] pData; }
+
+		double* pData;
+		size_t capacity;
+		bool isInUse;
+	};
+
+	//  Internal functions -----------------------------------------------------
+
+private:
+	FLevmarWorkspace(const FLevmarWorkspace&);
+	FLevmarWorkspace& operator=(const FLevmarWorkspace&);
+
+	static arena_t* _threadArena();
+
+	//  Internal data members --------------------------------------------------
+
+private:
+	/// One arena per thread, deleted when the thread finishes.
+	static QThreadStorage<arena_t*> s_threadArenas;
+
+	void* m_pData;
+	arena_t* m_pArena;
+	double* m_pPrivateData;
+};
+
+// ----------------------------------------------------------------------------------------------------
+
+#endif // FLEVMARWORKSPACE_H
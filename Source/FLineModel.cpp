@@ -9,6 +9,7 @@
 
 #include "FTrackMeStable.h"
 
+#include "FLineModelKernels.h"
 #include "FLineModel.h"
 #include "FMemoryTracer.h"
 
@@ -19,24 +20,10 @@
 // Constructors and destructor ------------------------------------------------------------------------
 
 FLineModel::FLineModel()
-: m_numValidSamples(0),
+: m_numCandidates(0),
+  m_numValidSamples(0),
   m_method(MultipleHypotheses)
 {
-	// clear candidate list
-	for (size_t e = 0, ne = m_edges.size(); e < ne; e++)
-	{
-		m_edges[e].sampleCount = 0;
-		for (size_t s = 0; s < FGlobalConstants::MAX_SAMPLES_PER_EDGE; s++)
-		{
-			sample_t& sample = m_edges[e].samples[s];
-
-			sample.candidateCount = 0;
-			sample.validCandidateCount = 0;
-			sample.bestValidCandidate = 0;
-			sample.isInlier = true;
-			sample.wasPresent = false;
-		}
-	}
 }
 
 FLineModel::~FLineModel()
@@ -47,30 +34,47 @@ FLineModel::~FLineModel()
 
 void FLineModel::transform(const FMatrix4f& matMV, const FMatrix4f& matMVP)
 {
-	for (size_t i = 0, ni = m_edges.size(); i < ni; i++)
+	size_t ne = m_edges.size();
+	if (ne == 0)
+		return;
+
+	// project edge end points and face normal markers
+	size_t numProjected = FaceNormal0 * ne;
+	FLineModelKernels::transformPoints(matMVP,
+		&m_pointX[0], &m_pointY[0], &m_pointZ[0], &m_pointW[0],
+		&m_homX[0], &m_homY[0], &m_homZ[0], &m_homW[0],
+		&m_imageX[0], &m_imageY[0], numProjected);
+
+	// transform face normals to view space
+	FLineModelKernels::transformPoints(matMV,
+		&m_pointX[numProjected], &m_pointY[numProjected], &m_pointZ[numProjected], &m_pointW[numProjected],
+		&m_homX[numProjected], &m_homY[numProjected], &m_homZ[numProjected], &m_homW[numProjected],
+		NULL, NULL, (NUM_POINT_BLOCKS - FaceNormal0) * ne);
+
+	for (size_t i = 0; i < ne; i++)
 	{
-		// transform line start and end points and calculate line normal
+		// copy results and calculate line normal
 		edge_t& edge = m_edges[i];
-		
-		FVector4f mp0h = matMVP * edge.modelPoint[0];
-		FVector4f mp1h = matMVP * edge.modelPoint[1];
-	
-		edge.imagePoint[0].set(mp0h.x() / mp0h.w(), mp0h.y() / mp0h.w());
-		edge.imagePoint[1].set(mp1h.x() / mp1h.w(), mp1h.y() / mp1h.w());
-		edge.imageNormal = (edge.imagePoint[1] - edge.imagePoint[0]).normal().normalize();
-		edge.homImage[0] = mp0h;
-		edge.homImage[1] = mp1h;
 
-		edge.faceNormalTransformed[0] = matMV * edge.faceNormal[0];
-		edge.faceNormalTransformed[1] = matMV * edge.faceNormal[1];
+		size_t s = EdgeStart * ne + i;
+		size_t e = EdgeEnd * ne + i;
+		edge.homImage[0].set(m_homX[s], m_homY[s], m_homZ[s], m_homW[s]);
+		edge.homImage[1].set(m_homX[e], m_homY[e], m_homZ[e], m_homW[e]);
+		edge.imagePoint[0].set(m_imageX[s], m_imageY[s]);
+		edge.imagePoint[1].set(m_imageX[e], m_imageY[e]);
+		edge.imageNormal = (edge.imagePoint[1] - edge.imagePoint[0]).normal().normalize();
 
-		FVector4f ctr = (edge.modelPoint[0] + edge.modelPoint[1]) * 0.5f;
-		FVector4f pn0 = matMVP * (ctr + edge.faceNormal[0] * 2.0f);
-		FVector4f pn1 = matMVP * (ctr + edge.faceNormal[1] * 2.0f);
-		ctr = matMVP * ctr;
-		edge.faceNormalImageStart.set(ctr.x() / ctr.w(), ctr.y() / ctr.w());
-		edge.faceNormalImageEnd[0].set(pn0.x() / pn0.w(), pn0.y() / pn0.w());
-		edge.faceNormalImageEnd[1].set(pn1.x() / pn1.w(), pn1.y() / pn1.w());
+		size_t n0 = FaceNormal0 * ne + i;
+		size_t n1 = FaceNormal1 * ne + i;
+		edge.faceNormalTransformed[0].set(m_homX[n0], m_homY[n0], m_homZ[n0], m_homW[n0]);
+		edge.faceNormalTransformed[1].set(m_homX[n1], m_homY[n1], m_homZ[n1], m_homW[n1]);
+
+		size_t mb = MarkerBase * ne + i;
+		size_t m0 = MarkerEnd0 * ne + i;
+		size_t m1 = MarkerEnd1 * ne + i;
+		edge.faceNormalImageStart.set(m_imageX[mb], m_imageY[mb]);
+		edge.faceNormalImageEnd[0].set(m_imageX[m0], m_imageY[m0]);
+		edge.faceNormalImageEnd[1].set(m_imageX[m1], m_imageY[m1]);
 	}
 }
 
@@ -86,74 +90,71 @@ void FLineModel::markOutliers(float distanceLimit)
 {
 	m_numValidSamples = 0;
 
-	for (size_t e = 0, ne = m_edges.size(); e < ne; e++)
+	for (size_t i = 0, n = m_activeSamples.size(); i < n; i++)
 	{
-		edge_t& edge = m_edges[e];
+		sample_t& sample = m_samples[m_activeSamples[i]];
+		F_ASSERT(sample.bestValidCandidate - sample.firstCandidate < sample.validCandidateCount);
 
-		for (size_t s = 0, ns = edge.sampleCount; s < ns; s++)
-		{
-			sample_t& sample = edge.samples[s];
-			if (sample.validCandidateCount > 0)
-			{
-				candidate_t& cand = sample.candidates[sample.bestValidCandidate];
-				F_ASSERT(cand.isValid);
+		float signedDist = m_candSignedDistance[sample.bestValidCandidate];
+		float absDist = fabsf(signedDist);
 
-				if (cand.absDistance < distanceLimit)
-				{
-					sample.isInlier = true;
-					m_cost[m_numValidSamples] = cand.signedDistance;
-					m_absCost[m_numValidSamples] = cand.absDistance;
-					m_numValidSamples++;
-				}
-				else
-				{
-					sample.isInlier = false;
-				}
-			}
+		if (absDist < distanceLimit)
+		{
+			sample.isInlier = true;
+			m_cost[m_numValidSamples] = signedDist;
+			m_absCost[m_numValidSamples] = absDist;
+			m_numValidSamples++;
+		}
+		else
+		{
+			sample.isInlier = false;
 		}
 	}
 }
 
-void FLineModel::updateJacobian(const FMatrix4f& mvpMatrix)
+void FLineModel::resetOutliers()
 {
-	calculateHypothesis();
-	_updateJacobian(mvpMatrix);
+	for (size_t i = 0, n = m_activeSamples.size(); i < n; i++)
+		m_samples[m_activeSamples[i]].isInlier = true;
+}
+
+void FLineModel::updateJacobian(const FMatrix4f* pMatDerivMVP, size_t numParams)
+{
+	_updateJacobian(pMatDerivMVP, numParams);
 }
 
 void FLineModel::beginAddCandidates()
 {
 	// clear candidate list
 	for (size_t e = 0, ne = m_edges.size(); e < ne; e++)
-	{
 		m_edges[e].sampleCount = 0;
-		for (size_t s = 0; s < FGlobalConstants::MAX_SAMPLES_PER_EDGE; s++)
-		{
-			sample_t& sample = m_edges[e].samples[s];
 
-			sample.isInlier = true;
-			sample.wasPresent = (sample.candidateCount > 0 && sample.isInlier);
+	for (size_t i = 0, n = m_samples.size(); i < n; i++)
+	{
+		sample_t& sample = m_samples[i];
 
-			sample.candidateCount = 0;
-			sample.validCandidateCount = 0;
-			sample.bestValidCandidate = 0;
-		}
+		sample.isInlier = true;
+		sample.wasPresent = (sample.candidateCount > 0);
+
+		sample.firstCandidate = 0;
+		sample.candidateCount = 0;
+		sample.validCandidateCount = 0;
+		sample.bestValidCandidate = 0;
 	}
+
+	m_numCandidates = 0;
+	m_candPositionX.clear();
+	m_candPositionY.clear();
+	m_candEdgeResponse.clear();
+	m_candColorMatch.clear();
+	m_candSignedDistance.clear();
+	m_activeSamples.clear();
 }
 
 void FLineModel::endAddCandidates()
 {
-	m_numValidSamples = 0;
-
-	for (size_t e = 0, ne = m_edges.size(); e < ne; e++)
-	{
-		edge_t& edge = m_edges[e];
-		for (size_t s = 0, ns = edge.sampleCount; s < ns; s++)
-		{
-			sample_t& sample = edge.samples[s];
-			if (sample.validCandidateCount > 0)
-				m_numValidSamples++;
-		}
-	}
+	// samples with at least one valid candidate have been collected by addCandidate()
+	m_numValidSamples = m_activeSamples.size();
 
 	//F_TRACE(QString("FLineModel::endAddCandidates - Data count: %1").arg(m_validDataCount));
 }
@@ -198,19 +199,19 @@ void FLineModel::drawCandidates(FGLCanvas& canvas)
 
 		for (size_t s = 0, ns = edge.sampleCount; s < ns; s++)
 		{
-			sample_t& sample = edge.samples[s];
-			for (size_t c = 0, nc = sample.candidateCount; c < nc; c++)
+			const sample_t& sample = m_samples[e * FGlobalConstants::MAX_SAMPLES_PER_EDGE + s];
+			for (size_t c = sample.firstCandidate, nc = c + sample.candidateCount; c < nc; c++)
 			{
-				candidate_t& cand = sample.candidates[c];
+				FVector2f position(m_candPositionX[c], m_candPositionY[c]);
 
-				float t = direction * (cand.position - edge.imagePoint[0]);
-				canvas.addLine(FLine2f(edge.imagePoint[0] + t * direction, cand.position), FColor::colorLightGray);
+				float t = direction * (position - edge.imagePoint[0]);
+				canvas.addLine(FLine2f(edge.imagePoint[0] + t * direction, position), FColor::colorLightGray);
 				canvas.addMarker(edge.imagePoint[0] + t * direction, 1.5f, FColor::colorLightGray);
 
 				FColor col = (sample.bestValidCandidate == c) ? FColor(1.0f, 0.8f, 0.0f) : FColor(0.3f, 0.8f, 0.0f);
-				if (cand.colorMatch == 0.0f)
+				if (m_candColorMatch[c] == 0.0f)
 					col = FColor(0.0f, 0.5f, 1.0f);
-				else if (cand.colorMatch == -1.0f)
+				else if (m_candColorMatch[c] == -1.0f)
 					col = FColor(1.0f, 0.2f, 0.8f);
 
 				if (!sample.wasPresent)
@@ -218,7 +219,7 @@ void FLineModel::drawCandidates(FGLCanvas& canvas)
 				if (!sample.isInlier)
 					col = FColor(0.5f, 0.3f, 0.6f);
 
-				canvas.addMarker(cand.position.x(), cand.position.y(), 1.5f, col);
+				canvas.addMarker(position.x(), position.y(), 1.5f, col);
 			}
 		}
 	}
@@ -237,11 +238,12 @@ void FLineModel::drawReferenceColors(FGLCanvas& canvas)
 
 			for (size_t s = 0, ns = edge.sampleCount; s < ns; s++)
 			{
-				sample_t& sample = edge.samples[s];
+				const sample_t& sample = m_samples[i * FGlobalConstants::MAX_SAMPLES_PER_EDGE + s];
 				if (sample.validCandidateCount > 0 /* && sample.isInlier */)
 				{
-					candidate_t& cand = sample.candidates[sample.bestValidCandidate];
-					float t = direction * (cand.position - edge.imagePoint[0]);
+					size_t c = sample.bestValidCandidate;
+					FVector2f position(m_candPositionX[c], m_candPositionY[c]);
+					float t = direction * (position - edge.imagePoint[0]);
 					FVector2f base = edge.imagePoint[0] + t * direction;
 					FVector2f p0 = base + edge.imageNormal * 10.0f;
 					FVector2f p1 = base - edge.imageNormal * 10.0f;
@@ -278,12 +280,21 @@ void FLineModel::create()
 	F_ASSERT(m_solidMesh.isValid());
 	F_ASSERT(!m_edges.empty());
 
-	size_t maxDataCount = m_edges.size()
-		* FGlobalConstants::MAX_SAMPLES_PER_EDGE
-		* FGlobalConstants::MAX_CANDIDATES_PER_SAMPLE;
+	size_t maxSampleCount = m_edges.size() * FGlobalConstants::MAX_SAMPLES_PER_EDGE;
+	size_t maxDataCount = maxSampleCount * FGlobalConstants::MAX_CANDIDATES_PER_SAMPLE;
 	m_cost.resize(maxDataCount);
 	m_absCost.resize(maxDataCount);
-	m_jacobian.resize(maxDataCount * 6);
+	m_jacobian.resize(maxDataCount * MAX_POSE_PARAMS);
+
+	// Reserve the candidate store so adding candidates never reallocates
+	m_candPositionX.reserve(maxDataCount);
+	m_candPositionY.reserve(maxDataCount);
+	m_candEdgeResponse.reserve(maxDataCount);
+	m_candColorMatch.reserve(maxDataCount);
+	m_candSignedDistance.reserve(maxDataCount);
+	m_activeSamples.reserve(maxSampleCount);
+
+	_createPointData();
 
 	// Create line list for OpenGL
 	m_lines.resize(m_edges.size());
@@ -308,11 +319,19 @@ void FLineModel::create()
 
 	// Set sample and candidate count to zero for all edges
 	for (size_t i = 0, n = m_edges.size(); i < n; i++)
-	{
 		m_edges[i].sampleCount = 0;
-		for (size_t j = 0; j < FGlobalConstants::MAX_SAMPLES_PER_EDGE; j++)
-			m_edges[i].samples[j].candidateCount = 0;
-	}
+
+	sample_t emptySample;
+	emptySample.firstCandidate = 0;
+	emptySample.candidateCount = 0;
+	emptySample.validCandidateCount = 0;
+	emptySample.bestValidCandidate = 0;
+	emptySample.isInlier = true;
+	emptySample.wasPresent = false;
+	m_samples.assign(maxSampleCount, emptySample);
+
+	m_numCandidates = 0;
+	m_numValidSamples = 0;
 }
 
 void FLineModel::release()
@@ -322,6 +341,19 @@ void FLineModel::release()
 	m_lineBuffer.release();
 	m_lines.clear();
 	m_edges.clear();
+	m_samples.clear();
+
+	m_pointX.clear(); m_pointY.clear(); m_pointZ.clear(); m_pointW.clear();
+	m_homX.clear(); m_homY.clear(); m_homZ.clear(); m_homW.clear();
+	m_imageX.clear(); m_imageY.clear();
+
+	m_numCandidates = 0;
+	m_candPositionX.clear();
+	m_candPositionY.clear();
+	m_candEdgeResponse.clear();
+	m_candColorMatch.clear();
+	m_candSignedDistance.clear();
+	m_activeSamples.clear();
 }
 
 // Public queries -------------------------------------------------------------------------------------
@@ -350,16 +382,16 @@ void FLineModel::dump(QDebug& debug) const
 
 		for (size_t s = 0, ns = edge.sampleCount; s < ns; s++)
 		{
-			const sample_t& sample = edge.samples[s];
+			const sample_t& sample = m_samples[e * FGlobalConstants::MAX_SAMPLES_PER_EDGE + s];
 			debug << "\n   Sample #" << s << " has " << sample.candidateCount
 				<< " (" << sample.validCandidateCount << " valid) edge candidates, best: "
-				<< sample.bestValidCandidate;
+				<< (sample.bestValidCandidate - sample.firstCandidate);
 
 			for (size_t c = 0, nc = sample.candidateCount; c < nc; c++)
 			{
-				const candidate_t& cand = sample.candidates[c];
-				debug << "\n      Candidate #" << c << ", Strength: " << cand.edgeResponse
-					<< ", ColorMatch: " << cand.colorMatch << ", Dist: " << cand.signedDistance;
+				size_t cId = sample.firstCandidate + c;
+				debug << "\n      Candidate #" << c << ", Strength: " << m_candEdgeResponse[cId]
+					<< ", ColorMatch: " << m_candColorMatch[cId] << ", Dist: " << m_candSignedDistance[cId];
 			}
 		}
 	}
@@ -372,46 +404,37 @@ void FLineModel::_calculateSingleHypothesis()
 {
 	m_numValidSamples = 0;
 
-	for (size_t e = 0, ne = m_edges.size(); e < ne; e++)
+	for (size_t i = 0, n = m_activeSamples.size(); i < n; i++)
 	{
-		edge_t& edge = m_edges[e];
-
-		for (size_t s = 0, ns = edge.sampleCount; s < ns; s++)
+		size_t slotId = m_activeSamples[i];
+		sample_t& sample = m_samples[slotId];
+		if (!sample.isInlier)
+			continue;
+
+		const edge_t& edge = m_edges[slotId / FGlobalConstants::MAX_SAMPLES_PER_EDGE];
+
+		// valid candidates are stored at the front of the sample's candidate range
+		size_t c0 = sample.firstCandidate;
+		size_t nc = sample.validCandidateCount;
+		FLineModelKernels::signedDistances(&m_candPositionX[c0], &m_candPositionY[c0],
+			&m_candSignedDistance[c0], nc, edge.imagePoint[0], edge.imageNormal);
+
+		size_t bestCandId = c0;
+		float maxEdgeResponse = 0.0f;
+		for (size_t c = c0; c < c0 + nc; c++)
 		{
-			sample_t& sample = edge.samples[s];
-			if (sample.validCandidateCount > 0 && sample.isInlier)
+			if (m_candEdgeResponse[c] > maxEdgeResponse)
 			{
-				size_t bestCandId = 0;
-				float minSquareDist = FLT_MAX;
-				float minSignedDist = FLT_MAX;
-				float maxEdgeResponse = 0.0f;
-				for (size_t c = 0, nc = sample.candidateCount; c < nc; c++)
-				{
-					candidate_t& cand = sample.candidates[c];
-					if (cand.isValid)
-					{
-						float sd = (cand.position - edge.imagePoint[0]) * edge.imageNormal;
-						cand.signedDistance = sd;
-						cand.absDistance = fabsf(sd);
-						float dd = sd * sd;
-						if (cand.edgeResponse > maxEdgeResponse)
-						{
-							bestCandId = c;
-							minSquareDist = dd;
-							minSignedDist = sd;
-							maxEdgeResponse = cand.edgeResponse;
-						}
-					}
-				}
-
-				F_ASSERT(minSquareDist < FLT_MAX); // at least one valid candidate has been found
-				sample.bestValidCandidate = bestCandId;
-				m_cost[m_numValidSamples] = minSignedDist;
-				m_absCost[m_numValidSamples] = fabs(minSignedDist);
-				m_numValidSamples++;
-
-			} // END IF (sample.validCandidates > 0)
+				bestCandId = c;
+				maxEdgeResponse = m_candEdgeResponse[c];
+			}
 		}
+
+		float minSignedDist = m_candSignedDistance[bestCandId];
+		sample.bestValidCandidate = bestCandId;
+		m_cost[m_numValidSamples] = minSignedDist;
+		m_absCost[m_numValidSamples] = fabsf(minSignedDist);
+		m_numValidSamples++;
 	}
 }
 
@@ -419,114 +442,123 @@ void FLineModel::_calculateBestHypothesis()
 {
 	m_numValidSamples = 0;
 
-	for (size_t e = 0, ne = m_edges.size(); e < ne; e++)
+	for (size_t i = 0, n = m_activeSamples.size(); i < n; i++)
 	{
-		edge_t& edge = m_edges[e];
-
-		for (size_t s = 0, ns = edge.sampleCount; s < ns; s++)
-		{
-			sample_t& sample = edge.samples[s];
-			if (sample.validCandidateCount > 0 && sample.isInlier)
-			{
-				size_t bestCandId = 0;
-				float minSquareDist = FLT_MAX;
-				float minSignedDist = FLT_MAX;
-				for (size_t c = 0, nc = sample.candidateCount; c < nc; c++)
-				{
-					candidate_t& cand = sample.candidates[c];
-					if (cand.isValid)
-					{
-						float sd = (cand.position - edge.imagePoint[0]) * edge.imageNormal;
-						cand.signedDistance = sd;
-						cand.absDistance = fabsf(sd);
-						float dd = sd * sd;
-						if (dd < minSquareDist)
-						{
-							bestCandId = c;
-							minSquareDist = dd;
-							minSignedDist = sd;
-						}
-					}
-				}
-
-				F_ASSERT(minSquareDist < FLT_MAX); // at least one valid candidate has been found
-				sample.bestValidCandidate = bestCandId;
-				m_cost[m_numValidSamples] = minSignedDist;
-				m_absCost[m_numValidSamples] = fabs(minSignedDist);
-				m_numValidSamples++;
-
-			} // END IF (sample.validCandidates > 0)
-		}
+		size_t slotId = m_activeSamples[i];
+		sample_t& sample = m_samples[slotId];
+		if (!sample.isInlier)
+			continue;
+
+		const edge_t& edge = m_edges[slotId / FGlobalConstants::MAX_SAMPLES_PER_EDGE];
+
+		// valid candidates are stored at the front of the sample's candidate range,
+		// find the one closest to the projected edge
+		size_t c0 = sample.firstCandidate;
+		F_ASSERT(sample.validCandidateCount > 0);
+		size_t bestCandId = c0 + FLineModelKernels::signedDistances(&m_candPositionX[c0], &m_candPositionY[c0],
+			&m_candSignedDistance[c0], sample.validCandidateCount, edge.imagePoint[0], edge.imageNormal);
+
+		float minSignedDist = m_candSignedDistance[bestCandId];
+		sample.bestValidCandidate = bestCandId;
+		m_cost[m_numValidSamples] = minSignedDist;
+		m_absCost[m_numValidSamples] = fabsf(minSignedDist);
+		m_numValidSamples++;
 	}
 }
 
-void FLineModel::_updateJacobian(const FMatrix4f& mvp)
+void FLineModel::_updateJacobian(const FMatrix4f* pMatDerivMVP, size_t numParams)
 {
+	// The cost of a sample is the signed distance of its best candidate c from the
+	// projected edge (p0, p1) with unit normal n. Differentiating the distance with
+	// respect to a pose parameter yields
+	//     d(cost) = -((1 - u) * dp0 + u * dp1) * n
+	// where u is the relative position of the candidate's foot point on the edge,
+	// i.e. the derivative is the normal displacement of the foot point. The change
+	// of the normal direction drops out because n and dn are orthogonal.
+	// Expects transform() and calculateHypothesis() to be called for the current pose.
+
+	F_ASSERT(numParams <= MAX_POSE_PARAMS);
+
+	FVector2f dp0[MAX_POSE_PARAMS];
+	FVector2f dp1[MAX_POSE_PARAMS];
+	FVector2f dir;
+	float invLen2 = 0.0f;
+	size_t currentEdge = size_t(-1);
 	size_t dataIndex = 0;
 
-	float scale = 1.0f;
-	float invScale = 1.0f / scale;
+	for (size_t i = 0, n = m_activeSamples.size(); i < n; i++)
+	{
+		size_t slotId = m_activeSamples[i];
+		const sample_t& sample = m_samples[slotId];
+		if (!sample.isInlier)
+			continue;
 
-	FVector4f g1(1.0f, 0.0f, 0.0f, 0.0f);
-	FVector4f g2(0.0f, 1.0f, 0.0f, 0.0f);
-	FVector4f g3(0.0f, 0.0f, 1.0f, 0.0f);
+		size_t e = slotId / FGlobalConstants::MAX_SAMPLES_PER_EDGE;
+		const edge_t& edge = m_edges[e];
 
-	for (size_t i = 0, ni = m_edges.size(); i < ni; i++)
-	{
-		edge_t& edge = m_edges[i];
+		if (e != currentEdge)
+		{
+			// derivatives of the projected edge end points
+			for (size_t j = 0; j < numParams; j++)
+			{
+				dp0[j] = _homogenizeDerivative(edge.homImage[0], pMatDerivMVP[j] * edge.modelPoint[0]);
+				dp1[j] = _homogenizeDerivative(edge.homImage[1], pMatDerivMVP[j] * edge.modelPoint[1]);
+			}
+
+			dir = edge.imagePoint[1] - edge.imagePoint[0];
+			float len2 = dir * dir;
+			invLen2 = len2 > 0.0f ? 1.0f / len2 : 0.0f;
+			currentEdge = e;
+		}
 
-		FVector4f m_g1 = mvp * (g1 * scale);
-		FVector4f m_g2 = mvp * (g2 * scale);
-		FVector4f m_g3 = mvp * (g3 * scale);
+		size_t c = sample.bestValidCandidate;
+		FVector2f position(m_candPositionX[c], m_candPositionY[c]);
+		float u = ((position - edge.imagePoint[0]) * dir) * invLen2;
 
-		FVector2f p0_g1 = edge.imagePoint[0] + _homogenizeDerivative(edge.homImage[0], m_g1);
-		FVector2f p1_g1 = edge.imagePoint[1] + _homogenizeDerivative(edge.homImage[1], m_g1);
-		FVector2f n_g1 = (p1_g1 - p0_g1).normal().normalize();
+		for (size_t j = 0; j < numParams; j++)
+		{
+			FVector2f dp = (1.0f - u) * dp0[j] + u * dp1[j];
+			m_jacobian[dataIndex++] = -(dp * edge.imageNormal);
+		}
+	}
 
-		FVector2f p0_g2 = edge.imagePoint[0] + _homogenizeDerivative(edge.homImage[0], m_g2);
-		FVector2f p1_g2 = edge.imagePoint[1] + _homogenizeDerivative(edge.homImage[1], m_g2);
-		FVector2f n_g2 = (p1_g2 - p0_g2).normal().normalize();
+	F_ASSERT(dataIndex == m_numValidSamples * numParams);
+}
 
-		FVector2f p0_g3 = edge.imagePoint[0] + _homogenizeDerivative(edge.homImage[0], m_g3);
-		FVector2f p1_g3 = edge.imagePoint[1] + _homogenizeDerivative(edge.homImage[1], m_g3);
-		FVector2f n_g3 = (p1_g3 - p0_g3).normal().normalize();
+void FLineModel::_createPointData()
+{
+	size_t ne = m_edges.size();
+	size_t numPoints = NUM_POINT_BLOCKS * ne;
 
-		FVector4f m0_g4(0.0f, -edge.modelPoint[0].z(), edge.modelPoint[0].y(), 0.0f);
-		FVector4f m1_g4(0.0f, -edge.modelPoint[1].z(), edge.modelPoint[1].y(), 0.0f);
-		FVector2f p0_g4 = edge.imagePoint[0] + _homogenizeDerivative(edge.homImage[0], mvp * (m0_g4 * scale));
-		FVector2f p1_g4 = edge.imagePoint[1] + _homogenizeDerivative(edge.homImage[1], mvp * (m1_g4 * scale));
-		FVector2f n_g4 = (p1_g4 - p0_g4).normal().normalize();
+	m_pointX.resize(numPoints); m_pointY.resize(numPoints);
+	m_pointZ.resize(numPoints); m_pointW.resize(numPoints);
+	m_homX.resize(numPoints); m_homY.resize(numPoints);
+	m_homZ.resize(numPoints); m_homW.resize(numPoints);
+	m_imageX.resize(numPoints); m_imageY.resize(numPoints);
 
-		FVector4f m0_g5(edge.modelPoint[0].z(), 0.0f, -edge.modelPoint[0].x(), 0.0f);
-		FVector4f m1_g5(edge.modelPoint[1].z(), 0.0f, -edge.modelPoint[1].x(), 0.0f);
-		FVector2f p0_g5 = edge.imagePoint[0] + _homogenizeDerivative(edge.homImage[0], mvp * (m0_g5 * scale));
-		FVector2f p1_g5 = edge.imagePoint[1] + _homogenizeDerivative(edge.homImage[1], mvp * (m1_g5 * scale));
-		FVector2f n_g5 = (p1_g5 - p0_g5).normal().normalize();
+	for (size_t i = 0; i < ne; i++)
+	{
+		const edge_t& edge = m_edges[i];
+		FVector4f ctr = (edge.modelPoint[0] + edge.modelPoint[1]) * 0.5f;
 
-		FVector4f m0_g6(-edge.modelPoint[0].y(), edge.modelPoint[0].x(), 0.0f, 0.0f);
-		FVector4f m1_g6(-edge.modelPoint[1].y(), edge.modelPoint[1].x(), 0.0f, 0.0f);
-		FVector2f p0_g6 = edge.imagePoint[0] + _homogenizeDerivative(edge.homImage[0], mvp * (m0_g6 * scale));
-		FVector2f p1_g6 = edge.imagePoint[1] + _homogenizeDerivative(edge.homImage[1], mvp * (m1_g6 * scale));
-		FVector2f n_g6 = (p1_g6 - p0_g6).normal().normalize();
+		FVector4f points[NUM_POINT_BLOCKS];
+		points[EdgeStart] = edge.modelPoint[0];
+		points[EdgeEnd] = edge.modelPoint[1];
+		points[MarkerBase] = ctr;
+		points[MarkerEnd0] = ctr + edge.faceNormal[0] * 2.0f;
+		points[MarkerEnd1] = ctr + edge.faceNormal[1] * 2.0f;
+		points[FaceNormal0] = edge.faceNormal[0];
+		points[FaceNormal1] = edge.faceNormal[1];
 
-		for (size_t s = 0, ns = edge.sampleCount; s < ns; s++)
+		for (size_t b = 0; b < NUM_POINT_BLOCKS; b++)
 		{
-			sample_t& sample = edge.samples[s];
-			if (sample.candidateCount == 0)
-				continue;
-
-			candidate_t& cand = sample.candidates[sample.bestValidCandidate];
-
-			m_jacobian[dataIndex++] = invScale * (fabsf((cand.position - p0_g1) * n_g1) - cand.signedDistance);
-			m_jacobian[dataIndex++] = invScale * (fabsf((cand.position - p0_g2) * n_g2) - cand.signedDistance);
-			m_jacobian[dataIndex++] = invScale * (fabsf((cand.position - p0_g3) * n_g3) - cand.signedDistance);
-			m_jacobian[dataIndex++] = invScale * (fabsf((cand.position - p0_g4) * n_g4) - cand.signedDistance);
-			m_jacobian[dataIndex++] = invScale * (fabsf((cand.position - p0_g5) * n_g5) - cand.signedDistance);
-			m_jacobian[dataIndex++] = invScale * (fabsf((cand.position - p0_g6) * n_g6) - cand.signedDistance);
+			size_t k = b * ne + i;
+			m_pointX[k] = points[b].x();
+			m_pointY[k] = points[b].y();
+			m_pointZ[k] = points[b].z();
+			m_pointW[k] = points[b].w();
 		}
 	}
-
-	F_ASSERT(dataIndex == m_numValidSamples * 6);
 }
 
 // ----------------------------------------------------------------------------------------------------
\ No newline at end of file
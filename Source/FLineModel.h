@@ -32,19 +32,12 @@ public:
 	{
 	};
 
-	struct candidate_t
-	{
-		FVector2f position;
-		float edgeResponse;
-		float colorMatch;
-		float signedDistance;
-		float absDistance;
-		bool isValid;
-	};
-
+	/// Per-sample data. The candidates of a sample are stored in the model's packed candidate
+	/// arrays in the range [firstCandidate, firstCandidate + candidateCount). Valid candidates
+	/// are kept at the front of the range.
 	struct sample_t
 	{
-		size_t slotId;
+		size_t firstCandidate;
 		size_t candidateCount;
 		size_t validCandidateCount;
 		size_t bestValidCandidate;
@@ -52,7 +45,6 @@ public:
 		bool isInlier;
 		bool wasPresent;
 
-		candidate_t candidates[FGlobalConstants::MAX_CANDIDATES_PER_SAMPLE];
 		FPixelRGBA32f refColor0;
 		FPixelRGBA32f refColor1;
 	};
@@ -94,7 +86,6 @@ public:
 		FVector2f faceNormalImageEnd[2];
 		float samplingDensity;
 		size_t sampleCount;
-		sample_t samples[FGlobalConstants::MAX_SAMPLES_PER_EDGE];
 	};
 
 	struct glLine_t
@@ -120,9 +111,13 @@ public:
 	typedef std::vector<glLine_t> lineVec_t;
 	typedef std::vector<edge_t> edgeVec_t;
 	typedef std::vector<sample_t> sampleVec_t;
-	typedef std::vector<candidate_t> candidateVec_t;
 	typedef std::vector<face_t> faceVec_t;
+	typedef std::vector<float> floatVec_t;
 	typedef std::vector<double> doubleVec_t;
+	typedef std::vector<size_t> indexVec_t;
+
+	/// Maximum number of pose parameters the Jacobian is calculated for.
+	static const size_t MAX_POSE_PARAMS = 7;
 
 	//  Public enumerations ----------------------------------------------------
 
@@ -151,14 +146,18 @@ public:
 	
 	void calculateHypothesis();
 	void markOutliers(float distanceLimit);
+	/// Marks all samples as inliers, e.g. to repeat an optimization on the same candidates.
+	void resetOutliers();
 
-	/// Updates the Jacobian matrix based on the current transform matrix.
-	void updateJacobian(const FMatrix4f& mvpMatrix);
+	/// Updates the Jacobian matrix of the cost vector with respect to the pose parameters.
+	/// Expects the derivatives of the model-view-projection matrix for each parameter.
+	void updateJacobian(const FMatrix4f* pMatDerivMVP, size_t numParams);
 	
 	
 	/// Starts to add candidates. Clears the list of edge candidates.
 	void beginAddCandidates();
 	/// Adds a candidate edge point belonging to the given line index and sample index.
+	/// All candidates of a sample must be added consecutively.
 	inline void addCandidate(size_t lineId, size_t sampleId,
 		const FVector2f& position, float edgeStrength, float colorDifference);
 	/// Adds the reference colors for a sample.
@@ -189,9 +188,9 @@ public:
 	/// Counts the total number of samples for all edges.
 	size_t sampleCount() const;
 	
-	/// Copies the Jacobian matrix to the given array.
-	inline void getJacobian(double* pJac) const {
-		for (int i = 0; i < m_numValidSamples * 6; i++)
+	/// Copies the Jacobian matrix (row-major, one row per data point) to the given array.
+	inline void getJacobian(double* pJac, size_t numParams) const {
+		for (size_t i = 0, n = m_numValidSamples * numParams; i < n; i++)
 			pJac[i] = m_jacobian[i];
 	}
 	/// Copies the cost vector to the given double array.
@@ -207,18 +206,17 @@ public:
 
 		for (size_t e = 0, ne = m_edges.size(); e < ne; e++)
 		{
-			const edge_t& edge = m_edges[e];
-			for (size_t s = 0, ns = edge.sampleCount; s < ns; s++)
+			size_t slot0 = e * FGlobalConstants::MAX_SAMPLES_PER_EDGE;
+			for (size_t s = 0, ns = m_edges[e].sampleCount; s < ns; s++)
 			{
-				const sample_t& sample = edge.samples[s];
+				const sample_t& sample = m_samples[slot0 + s];
 
 				float residual = 1.0f;
 
 				if (sample.validCandidateCount > 0 && sample.isInlier)
-					residual = imr * (sample.candidates[sample.bestValidCandidate].absDistance - 1.0f);
+					residual = imr * (fabsf(m_candSignedDistance[sample.bestValidCandidate]) - 1.0f);
 
-				size_t id = e * FGlobalConstants::MAX_SAMPLES_PER_EDGE + s;
-				pResidualData[id] = fMax(0.0f, fMin(1.0f, residual));
+				pResidualData[slot0 + s] = fMax(0.0f, fMin(1.0f, residual));
 			}
 		}
 	}
@@ -261,6 +259,10 @@ public:
 	const lineVec_t& lines() const { return m_lines; }
 	/// Const access to the edge array.
 	const edgeVec_t& edges() const { return m_edges; }
+	/// Const access to the sample with the given index on the given edge.
+	const sample_t& sample(size_t edgeId, size_t sampleId) const {
+		return m_samples[edgeId * FGlobalConstants::MAX_SAMPLES_PER_EDGE + sampleId];
+	}
 
 	/// The number of edges/lines of the model.
 	size_t edgeCount() const { return m_edges.size(); }
@@ -288,7 +290,9 @@ private:
 	void _markOutliersSingleHypothesis(float distanceLimit);
 	void _markOutliersBestHypothesis(float distanceLimit);
 
-	void _updateJacobian(const FMatrix4f& mvp);
+	void _updateJacobian(const FMatrix4f* pMatDerivMVP, size_t numParams);
+	void _createPointData();
+	inline void _swapCandidates(size_t a, size_t b);
 
 	inline FVector2f _homogenizeDerivative(const FVector4f& p, const FVector4f& dp)
 	{
@@ -308,8 +312,38 @@ private:
 	
 	lineVec_t      m_lines;
 	edgeVec_t      m_edges;
+	sampleVec_t    m_samples;
 	faceVec_t      m_faces;
 
+	// Model points in structure-of-arrays layout, grouped in blocks of edge count size:
+	// edge start, edge end, face normal marker base, marker end 0 and 1, face normal 0 and 1
+	enum pointBlock_t
+	{
+		EdgeStart,
+		EdgeEnd,
+		MarkerBase,
+		MarkerEnd0,
+		MarkerEnd1,
+		FaceNormal0,
+		FaceNormal1,
+		NUM_POINT_BLOCKS,
+	};
+
+	floatVec_t     m_pointX, m_pointY, m_pointZ, m_pointW;
+	floatVec_t     m_homX, m_homY, m_homZ, m_homW;
+	floatVec_t     m_imageX, m_imageY;
+
+	// Packed candidates of the current frame (structure of arrays), stored sample by sample
+	size_t         m_numCandidates;
+	floatVec_t     m_candPositionX;
+	floatVec_t     m_candPositionY;
+	floatVec_t     m_candEdgeResponse;
+	floatVec_t     m_candColorMatch;
+	floatVec_t     m_candSignedDistance;
+
+	// Slot ids of all samples with at least one valid candidate, in ascending order
+	indexVec_t     m_activeSamples;
+
 	size_t         m_numValidSamples;
 	doubleVec_t    m_jacobian;
 	doubleVec_t    m_cost;
@@ -326,32 +360,47 @@ void FLineModel::addCandidate(size_t edgeId, size_t sampleId,
 	F_ASSERT(edgeId < m_edges.size());
 	F_ASSERT(sampleId < FGlobalConstants::MAX_SAMPLES_PER_EDGE);
 
+	size_t slotId = edgeId * FGlobalConstants::MAX_SAMPLES_PER_EDGE + sampleId;
 	edge_t& edge = m_edges[edgeId];
-	sample_t& sample = edge.samples[sampleId];
-	sample.slotId = edgeId * FGlobalConstants::MAX_SAMPLES_PER_EDGE + sampleId;
+	sample_t& sample = m_samples[slotId];
 	edge.sampleCount = fMax(edge.sampleCount, sampleId + 1);
 
+	if (sample.candidateCount == 0)
+		sample.firstCandidate = m_numCandidates;
+
+	// candidates of a sample must occupy a contiguous range
+	F_ASSERT(sample.firstCandidate + sample.candidateCount == m_numCandidates);
+
 	if (sample.candidateCount >= FGlobalConstants::MAX_CANDIDATES_PER_SAMPLE)
 	{
 		F_TRACE("FLineModel::addCandidate - Maximum number of candidates reached");
 		return;
 	}
 
-	size_t cId = sample.candidateCount;
+	size_t cId = m_numCandidates++;
 	sample.candidateCount++;
-	candidate_t& cand = sample.candidates[cId];
 
-	cand.position = position;
-	cand.edgeResponse = edgeStrength;
-	cand.colorMatch = colorMatch;
+	m_candPositionX.push_back(position.x());
+	m_candPositionY.push_back(position.y());
+	m_candEdgeResponse.push_back(edgeStrength);
+	m_candColorMatch.push_back(colorMatch);
+	m_candSignedDistance.push_back(0.0f);
 
-	if (!sample.wasPresent || cand.colorMatch > 0.0f)
+	if (!sample.wasPresent || colorMatch > 0.0f)
 	{
-		cand.isValid = true;
+		// move valid candidate to the end of the valid range of the sample
+		size_t vId = sample.firstCandidate + sample.validCandidateCount;
+		if (vId != cId)
+			_swapCandidates(vId, cId);
+
+		if (sample.validCandidateCount == 0)
+		{
+			F_ASSERT(m_activeSamples.empty() || m_activeSamples.back() < slotId);
+			m_activeSamples.push_back(slotId);
+		}
+
 		sample.validCandidateCount++;
 	}
-	else
-		cand.isValid = false;
 }
 
 void FLineModel::addSampleColors(size_t edgeId, size_t sampleId,
@@ -360,11 +409,20 @@ void FLineModel::addSampleColors(size_t edgeId, size_t sampleId,
 	F_ASSERT(edgeId < m_edges.size());
 	F_ASSERT(sampleId < FGlobalConstants::MAX_SAMPLES_PER_EDGE);
 
-	sample_t& sample = m_edges[edgeId].samples[sampleId];
+	sample_t& sample = m_samples[edgeId * FGlobalConstants::MAX_SAMPLES_PER_EDGE + sampleId];
 
 	sample.refColor0 = color0;
 	sample.refColor1 = color1;
 }
+
+void FLineModel::_swapCandidates(size_t a, size_t b)
+{
+	std::swap(m_candPositionX[a], m_candPositionX[b]);
+	std::swap(m_candPositionY[a], m_candPositionY[b]);
+	std::swap(m_candEdgeResponse[a], m_candEdgeResponse[b]);
+	std::swap(m_candColorMatch[a], m_candColorMatch[b]);
+	std::swap(m_candSignedDistance[a], m_candSignedDistance[b]);
+}
 	
 // ----------------------------------------------------------------------------------------------------
 
@@ -0,0 +1,182 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FLineModelBenchmark.cpp
+//  Description		Implementation of class FLineModelBenchmark
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-18 16:12:40 +0200 (So, 18 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#include "FTrackMeStable.h"
+#include "FRandom.h"
+#include "FStopWatch.h"
+
+#include "FCamera.h"
+#include "FBoxModel.h"
+#include "FStudioModelVirtEco.h"
+
+#include "FLineModelBenchmark.h"
+#include "FMemoryTracer.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FLineModelBenchmark
+// ----------------------------------------------------------------------------------------------------
+
+// Constructors and destructor ------------------------------------------------------------------------
+
+FLineModelBenchmark::FLineModelBenchmark()
+: m_iterations(2000),
+  m_seed(1234)
+{
+}
+
+FLineModelBenchmark::~FLineModelBenchmark()
+{
+}
+
+// Public commands ------------------------------------------------------------------------------------
+
+void FLineModelBenchmark::run()
+{
+	FCamera camera;
+	camera.setTranslation(FVector3f(0.0f, 0.0f, -225.0f));
+	camera.setRotation(FVector3f(27.0f, 0.0f, 0.0f));
+	camera.resetPose();
+
+	FMatrix4f matMV, matP, matMVP;
+	camera.getModelViewStart(matMV);
+	camera.getProjectionStart(matP);
+	matMVP = matP * matMV;
+
+	FBoxModel boxModel;
+	boxModel.setSize(100.0f, 20.0f, 100.0f);
+	boxModel.create();
+	_runModel(&boxModel, "FBoxModel", matMV, matMVP);
+
+	FStudioModelVirtEco studioModel;
+	studioModel.create();
+	_runModel(&studioModel, "FStudioModelVirtEco", matMV, matMVP);
+}
+
+// Internal functions ---------------------------------------------------------------------------------
+
+void FLineModelBenchmark::_runModel(FLineModel* pModel, const QString& modelName,
+									const FMatrix4f& matMV, const FMatrix4f& matMVP)
+{
+	F_ASSERT(pModel);
+	if (!pModel->isValid() || pModel->edgeCount() == 0)
+	{
+		fWarning("Benchmark", QString("%1: Failed to create model").arg(modelName));
+		return;
+	}
+
+	FLineModelKernels::instructionSet_t activeSet = FLineModelKernels::instructionSet();
+
+	_addCandidates(pModel, matMV, matMVP);
+
+	// reference result with the scalar kernels
+	FLineModelKernels::setInstructionSet(FLineModelKernels::Scalar);
+	pModel->transform(matMV, matMVP);
+	pModel->calculateHypothesis();
+	size_t numData = pModel->costVectorSize();
+	std::vector<double> refCost(numData + 1), cost(numData + 1);
+	pModel->getCostVector(&refCost[0]);
+
+	fInfo("Benchmark", QString("%1: %2 edges, %3 samples, %4 iterations")
+		.arg(modelName).arg(pModel->edgeCount()).arg(numData).arg(m_iterations));
+
+	double refTime = 0.0;
+
+	for (int i = FLineModelKernels::Scalar; i <= FLineModelKernels::SSE; i++)
+	{
+		FLineModelKernels::instructionSet_t set = (FLineModelKernels::instructionSet_t)i;
+		if (!FLineModelKernels::isSupported(set))
+			continue;
+
+		FLineModelKernels::setInstructionSet(set);
+
+		double transformTime = _timeTransform(pModel, matMV, matMVP);
+		double hypothesisTime = _timeHypothesis(pModel);
+		double totalTime = transformTime + hypothesisTime;
+		if (set == FLineModelKernels::Scalar)
+			refTime = totalTime;
+
+		// compare result to reference
+		pModel->getCostVector(&cost[0]);
+		double maxDeviation = 0.0;
+		for (size_t k = 0; k < numData; k++)
+			maxDeviation = fMax(maxDeviation, fabs(cost[k] - refCost[k]));
+
+		double us = 1.0e6 / m_iterations;
+		fInfo("Benchmark", QString("   %1: transform %2 us, hypothesis %3 us, speedup %4, max deviation %5")
+			.arg(FLineModelKernels::toString(set), -6)
+			.arg(transformTime * us, 0, 'f', 2).arg(hypothesisTime * us, 0, 'f', 2)
+			.arg(totalTime > 0.0 ? refTime / totalTime : 0.0, 0, 'f', 2).arg(maxDeviation));
+	}
+
+	FLineModelKernels::setInstructionSet(activeSet);
+}
+
+void FLineModelBenchmark::_addCandidates(FLineModel* pModel,
+										 const FMatrix4f& matMV, const FMatrix4f& matMVP)
+{
+	// project the model and scatter candidates along the normals of the projected edges
+	pModel->transform(matMV, matMVP);
+
+	FRandom rand;
+	rand.setSeed(m_seed);
+
+	const FLineModel::edgeVec_t& edges = pModel->edges();
+	size_t maxSamples = FGlobalConstants::MAX_SAMPLES_PER_EDGE;
+	size_t maxCandidates = FGlobalConstants::MAX_CANDIDATES_PER_SAMPLE;
+	float searchRange = FGlobalConstants::SEARCH_LINE_LENGTH * 0.5f;
+
+	pModel->beginAddCandidates();
+
+	for (size_t e = 0, ne = edges.size(); e < ne; e++)
+	{
+		const FLineModel::edge_t& edge = edges[e];
+		FVector2f p0 = edge.imagePoint[0];
+		FVector2f dir = edge.imagePoint[1] - p0;
+
+		for (size_t s = 0; s < maxSamples; s++)
+		{
+			FVector2f base = p0 + dir * ((s + 0.5f) / maxSamples);
+			size_t numCandidates = (size_t)(rand.uniformDouble() * maxCandidates);
+
+			for (size_t c = 0; c < numCandidates; c++)
+			{
+				float offset = (float)(rand.uniformDouble() * 2.0 - 1.0) * searchRange;
+				FVector2f position = base + edge.imageNormal * offset;
+				pModel->addCandidate(e, s, position, (float)rand.uniformDouble(), 1.0f);
+			}
+		}
+	}
+
+	pModel->endAddCandidates();
+}
+
+double FLineModelBenchmark::_timeTransform(FLineModel* pModel,
+										   const FMatrix4f& matMV, const FMatrix4f& matMVP)
+{
+	FStopWatch stopWatch;
+	stopWatch.start();
+
+	for (size_t i = 0; i < m_iterations; i++)
+		pModel->transform(matMV, matMVP);
+
+	return stopWatch.stop();
+}
+
+double FLineModelBenchmark::_timeHypothesis(FLineModel* pModel)
+{
+	FStopWatch stopWatch;
+	stopWatch.start();
+
+	for (size_t i = 0; i < m_iterations; i++)
+		pModel->calculateHypothesis();
+
+	return stopWatch.stop();
+}
+
+// ----------------------------------------------------------------------------------------------------
@@ -0,0 +1,65 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FLineModelBenchmark.h
+//  Description		Header file for FLineModelBenchmark.cpp
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-18 16:12:40 +0200 (So, 18 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#ifndef FLINEMODELBENCHMARK_H
+#define FLINEMODELBENCHMARK_H
+
+#include "FTrackMe.h"
+#include "FlowMath.h"
+#include "FLineModelKernels.h"
+
+class FLineModel;
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FLineModelBenchmark
+// ----------------------------------------------------------------------------------------------------
+
+/// Micro-benchmark for the line model kernels. Evaluates the box and the ECO studio model with
+/// synthetic edge candidates and compares the timings of the available kernel implementations.
+/// Requires a current OpenGL context, as the models create their GL resources.
+class FLineModelBenchmark
+{
+	//  Constructors and destructor --------------------------------------------
+
+public:
+	/// Default Constructor.
+	FLineModelBenchmark();
+	/// Virtual destructor.
+	virtual ~FLineModelBenchmark();
+
+	//  Public commands --------------------------------------------------------
+
+public:
+	/// Runs the benchmark for all models and writes the results to the log.
+	void run();
+
+	/// Sets the number of evaluations per model and implementation.
+	void setIterations(size_t iterations) { m_iterations = iterations; }
+	/// Sets the seed used to generate the edge candidates.
+	void setSeed(int seed) { m_seed = seed; }
+
+	//  Internal functions -----------------------------------------------------
+
+private:
+	void _runModel(FLineModel* pModel, const QString& modelName,
+		const FMatrix4f& matMV, const FMatrix4f& matMVP);
+	void _addCandidates(FLineModel* pModel, const FMatrix4f& matMV, const FMatrix4f& matMVP);
+	double _timeTransform(FLineModel* pModel, const FMatrix4f& matMV, const FMatrix4f& matMVP);
+	double _timeHypothesis(FLineModel* pModel);
+
+	//  Internal data members --------------------------------------------------
+
+private:
+	size_t m_iterations;
+	int m_seed;
+};
+
+// ----------------------------------------------------------------------------------------------------
+
+#endif // FLINEMODELBENCHMARK_H
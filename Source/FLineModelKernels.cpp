@@ -0,0 +1,269 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FLineModelKernels.cpp
+//  Description		Implementation of class FLineModelKernels
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-18 16:12:40 +0200 (So, 18 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#include "FTrackMeStable.h"
+
+#include <xmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#include "FLineModelKernels.h"
+#include "FMemoryTracer.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FLineModelKernels
+// ----------------------------------------------------------------------------------------------------
+
+// Static members -------------------------------------------------------------------------------------
+
+FLineModelKernels::instructionSet_t FLineModelKernels::s_instructionSet = FLineModelKernels::Scalar;
+FLineModelKernels::transformFunc_t FLineModelKernels::s_pfTransformPoints
+	= &FLineModelKernels::_transformPointsScalar;
+FLineModelKernels::distanceFunc_t FLineModelKernels::s_pfSignedDistances
+	= &FLineModelKernels::_signedDistancesScalar;
+bool FLineModelKernels::s_isInitialized = FLineModelKernels::_selectBest();
+
+// Public commands ------------------------------------------------------------------------------------
+
+void FLineModelKernels::transformPoints(const FMatrix4f& mat,
+	const float* pX, const float* pY, const float* pZ, const float* pW,
+	float* pHX, float* pHY, float* pHZ, float* pHW, float* pIX, float* pIY, size_t count)
+{
+	// copy matrix to a row-major array, independent of the storage order of FMatrix4f
+	float m[16];
+	for (size_t r = 0; r < 4; r++)
+		for (size_t c = 0; c < 4; c++)
+			m[r * 4 + c] = mat[r][c];
+
+	s_pfTransformPoints(m, pX, pY, pZ, pW, pHX, pHY, pHZ, pHW, pIX, pIY, count);
+}
+
+void FLineModelKernels::setInstructionSet(instructionSet_t instructionSet)
+{
+	if (!isSupported(instructionSet))
+		instructionSet = Scalar;
+
+	switch (instructionSet)
+	{
+	case SSE:
+		s_pfTransformPoints = &_transformPointsSSE;
+		s_pfSignedDistances = &_signedDistancesSSE;
+		break;
+	default:
+		s_pfTransformPoints = &_transformPointsScalar;
+		s_pfSignedDistances = &_signedDistancesScalar;
+		break;
+	}
+
+	s_instructionSet = instructionSet;
+}
+
+// Public queries -------------------------------------------------------------------------------------
+
+bool FLineModelKernels::isSupported(instructionSet_t instructionSet)
+{
+	if (instructionSet == Scalar)
+		return true;
+
+	int info[4] = { 0, 0, 0, 0 };
+#ifdef _MSC_VER
+	__cpuid(info, 1);
+#else
+	unsigned int a, b, c, d;
+	if (__get_cpuid(1, &a, &b, &c, &d))
+		info[3] = (int)d;
+#endif
+
+	// EDX bit 25: SSE
+	if (instructionSet == SSE)
+		return (info[3] & (1 << 25)) != 0;
+
+	return false;
+}
+
+QString FLineModelKernels::toString(instructionSet_t instructionSet)
+{
+	switch (instructionSet)
+	{
+	case Scalar: return QString("Scalar");
+	case SSE:    return QString("SSE");
+	default:     return QString("Unknown");
+	}
+}
+
+// Internal functions ---------------------------------------------------------------------------------
+
+bool FLineModelKernels::_selectBest()
+{
+	setInstructionSet(SSE);
+	return true;
+}
+
+void FLineModelKernels::_transformPointsScalar(const float* m,
+	const float* pX, const float* pY, const float* pZ, const float* pW,
+	float* pHX, float* pHY, float* pHZ, float* pHW, float* pIX, float* pIY, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		float x = pX[i], y = pY[i], z = pZ[i], w = pW[i];
+
+		float hx = m[0]  * x + m[1]  * y + m[2]  * z + m[3]  * w;
+		float hy = m[4]  * x + m[5]  * y + m[6]  * z + m[7]  * w;
+		float hz = m[8]  * x + m[9]  * y + m[10] * z + m[11] * w;
+		float hw = m[12] * x + m[13] * y + m[14] * z + m[15] * w;
+
+		pHX[i] = hx; pHY[i] = hy; pHZ[i] = hz; pHW[i] = hw;
+
+		if (pIX)
+		{
+			pIX[i] = hx / hw;
+			pIY[i] = hy / hw;
+		}
+	}
+}
+
+void FLineModelKernels::_transformPointsSSE(const float* m,
+	const float* pX, const float* pY, const float* pZ, const float* pW,
+	float* pHX, float* pHY, float* pHZ, float* pHW, float* pIX, float* pIY, size_t count)
+{
+	__m128 mat[16];
+	for (size_t k = 0; k < 16; k++)
+		mat[k] = _mm_set1_ps(m[k]);
+
+	// four points per iteration
+	size_t n4 = count & ~size_t(3);
+	for (size_t i = 0; i < n4; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(pX + i);
+		__m128 y = _mm_loadu_ps(pY + i);
+		__m128 z = _mm_loadu_ps(pZ + i);
+		__m128 w = _mm_loadu_ps(pW + i);
+
+		__m128 hx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mat[0], x), _mm_mul_ps(mat[1], y)),
+			_mm_add_ps(_mm_mul_ps(mat[2], z), _mm_mul_ps(mat[3], w)));
+		__m128 hy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mat[4], x), _mm_mul_ps(mat[5], y)),
+			_mm_add_ps(_mm_mul_ps(mat[6], z), _mm_mul_ps(mat[7], w)));
+		__m128 hz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mat[8], x), _mm_mul_ps(mat[9], y)),
+			_mm_add_ps(_mm_mul_ps(mat[10], z), _mm_mul_ps(mat[11], w)));
+		__m128 hw = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mat[12], x), _mm_mul_ps(mat[13], y)),
+			_mm_add_ps(_mm_mul_ps(mat[14], z), _mm_mul_ps(mat[15], w)));
+
+		_mm_storeu_ps(pHX + i, hx);
+		_mm_storeu_ps(pHY + i, hy);
+		_mm_storeu_ps(pHZ + i, hz);
+		_mm_storeu_ps(pHW + i, hw);
+
+		if (pIX)
+		{
+			_mm_storeu_ps(pIX + i, _mm_div_ps(hx, hw));
+			_mm_storeu_ps(pIY + i, _mm_div_ps(hy, hw));
+		}
+	}
+
+	// remaining points
+	if (n4 < count)
+	{
+		_transformPointsScalar(m, pX + n4, pY + n4, pZ + n4, pW + n4,
+			pHX + n4, pHY + n4, pHZ + n4, pHW + n4,
+			pIX ? pIX + n4 : NULL, pIY ? pIY + n4 : NULL, count - n4);
+	}
+}
+
+size_t FLineModelKernels::_signedDistancesScalar(const float* pX, const float* pY, float* pDistance,
+	size_t count, float p0x, float p0y, float nx, float ny)
+{
+	size_t minIndex = 0;
+	float minSquareDist = FLT_MAX;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		float sd = (pX[i] - p0x) * nx + (pY[i] - p0y) * ny;
+		pDistance[i] = sd;
+
+		float dd = sd * sd;
+		if (dd < minSquareDist)
+		{
+			minIndex = i;
+			minSquareDist = dd;
+		}
+	}
+
+	return minIndex;
+}
+
+size_t FLineModelKernels::_signedDistancesSSE(const float* pX, const float* pY, float* pDistance,
+	size_t count, float p0x, float p0y, float nx, float ny)
+{
+	if (count < 4)
+		return _signedDistancesScalar(pX, pY, pDistance, count, p0x, p0y, nx, ny);
+
+	__m128 vp0x = _mm_set1_ps(p0x);
+	__m128 vp0y = _mm_set1_ps(p0y);
+	__m128 vnx = _mm_set1_ps(nx);
+	__m128 vny = _mm_set1_ps(ny);
+
+	// per-lane minimum; indices are kept as floats (exact for the small counts used here)
+	__m128 minDist = _mm_set1_ps(FLT_MAX);
+	__m128 minIndex = _mm_setzero_ps();
+	__m128 index = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	__m128 four = _mm_set1_ps(4.0f);
+
+	size_t n4 = count & ~size_t(3);
+	for (size_t i = 0; i < n4; i += 4)
+	{
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(pX + i), vp0x);
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(pY + i), vp0y);
+		__m128 sd = _mm_add_ps(_mm_mul_ps(dx, vnx), _mm_mul_ps(dy, vny));
+		_mm_storeu_ps(pDistance + i, sd);
+
+		__m128 dd = _mm_mul_ps(sd, sd);
+		__m128 mask = _mm_cmplt_ps(dd, minDist);
+		minDist = _mm_or_ps(_mm_and_ps(mask, dd), _mm_andnot_ps(mask, minDist));
+		minIndex = _mm_or_ps(_mm_and_ps(mask, index), _mm_andnot_ps(mask, minIndex));
+		index = _mm_add_ps(index, four);
+	}
+
+	// reduce lanes, prefer the lower index if distances are equal
+	float laneDist[4], laneIndex[4];
+	_mm_storeu_ps(laneDist, minDist);
+	_mm_storeu_ps(laneIndex, minIndex);
+
+	size_t bestIndex = (size_t)laneIndex[0];
+	float bestDist = laneDist[0];
+	for (size_t k = 1; k < 4; k++)
+	{
+		size_t laneBest = (size_t)laneIndex[k];
+		if (laneDist[k] < bestDist || (laneDist[k] == bestDist && laneBest < bestIndex))
+		{
+			bestIndex = laneBest;
+			bestDist = laneDist[k];
+		}
+	}
+
+	// remaining points
+	for (size_t i = n4; i < count; i++)
+	{
+		float sd = (pX[i] - p0x) * nx + (pY[i] - p0y) * ny;
+		pDistance[i] = sd;
+
+		float dd = sd * sd;
+		if (dd < bestDist)
+		{
+			bestIndex = i;
+			bestDist = dd;
+		}
+	}
+
+	return bestIndex;
+}
+
+// ----------------------------------------------------------------------------------------------------
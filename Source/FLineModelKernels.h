@@ -0,0 +1,106 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FLineModelKernels.h
+//  Description		Header file for FLineModelKernels.cpp - Batch kernels for line model evaluation.
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-18 16:12:40 +0200 (So, 18 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#ifndef FLINEMODELKERNELS_H
+#define FLINEMODELKERNELS_H
+
+#include "FTrackMe.h"
+#include "FlowMath.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FLineModelKernels
+// ----------------------------------------------------------------------------------------------------
+
+/// Provides the inner loops of the line model evaluation (point transformation, candidate distances)
+/// as batch kernels operating on structure-of-arrays data. A scalar and an SSE implementation are
+/// available, the fastest one supported by the CPU is selected at startup.
+class FLineModelKernels
+{
+	//  Public types -----------------------------------------------------------
+
+public:
+	enum instructionSet_t
+	{
+		Scalar,
+		SSE,
+	};
+
+	//  Public commands --------------------------------------------------------
+
+public:
+	/// Transforms count points given in structure-of-arrays layout by the given matrix and writes
+	/// the homogeneous results to pHX, pHY, pHZ, pHW. If pIX and pIY are not NULL, the results
+	/// are divided by w and the image coordinates are written to pIX and pIY.
+	static void transformPoints(const FMatrix4f& mat,
+		const float* pX, const float* pY, const float* pZ, const float* pW,
+		float* pHX, float* pHY, float* pHZ, float* pHW, float* pIX, float* pIY, size_t count);
+
+	/// Calculates the signed distances of count points to the line through p0 with the unit normal n
+	/// and writes them to pDistance. Returns the index of the point closest to the line
+	/// (the first one if several points have the same distance).
+	static size_t signedDistances(const float* pX, const float* pY, float* pDistance, size_t count,
+		const FVector2f& p0, const FVector2f& n) {
+		return s_pfSignedDistances(pX, pY, pDistance, count, p0.x(), p0.y(), n.x(), n.y());
+	}
+
+	/// Selects the implementation used by the kernels. Falls back to the scalar
+	/// implementation if the given instruction set is not supported by the CPU.
+	/// Not thread-safe, call only while no kernels are running.
+	static void setInstructionSet(instructionSet_t instructionSet);
+
+	//  Public queries ---------------------------------------------------------
+
+	/// Returns the instruction set used by the kernels.
+	static instructionSet_t instructionSet() { return s_instructionSet; }
+	/// Returns true if the given instruction set is supported by the CPU.
+	static bool isSupported(instructionSet_t instructionSet);
+	/// Returns the name of the given instruction set.
+	static QString toString(instructionSet_t instructionSet);
+
+	//  Internal types ---------------------------------------------------------
+
+private:
+	typedef void (*transformFunc_t)(const float* pMat,
+		const float* pX, const float* pY, const float* pZ, const float* pW,
+		float* pHX, float* pHY, float* pHZ, float* pHW, float* pIX, float* pIY, size_t count);
+
+	typedef size_t (*distanceFunc_t)(const float* pX, const float* pY, float* pDistance,
+		size_t count, float p0x, float p0y, float nx, float ny);
+
+	//  Internal functions -----------------------------------------------------
+
+private:
+	FLineModelKernels();
+
+	static bool _selectBest();
+
+	static void _transformPointsScalar(const float* pMat,
+		const float* pX, const float* pY, const float* pZ, const float* pW,
+		float* pHX, float* pHY, float* pHZ, float* pHW, float* pIX, float* pIY, size_t count);
+	static void _transformPointsSSE(const float* pMat,
+		const float* pX, const float* pY, const float* pZ, const float* pW,
+		float* pHX, float* pHY, float* pHZ, float* pHW, float* pIX, float* pIY, size_t count);
+
+	static size_t _signedDistancesScalar(const float* pX, const float* pY, float* pDistance,
+		size_t count, float p0x, float p0y, float nx, float ny);
+	static size_t _signedDistancesSSE(const float* pX, const float* pY, float* pDistance,
+		size_t count, float p0x, float p0y, float nx, float ny);
+
+	//  Internal data members --------------------------------------------------
+
+private:
+	static instructionSet_t s_instructionSet;
+	static transformFunc_t s_pfTransformPoints;
+	static distanceFunc_t s_pfSignedDistances;
+	static bool s_isInitialized;
+};
+
+// ----------------------------------------------------------------------------------------------------
+
+#endif // FLINEMODELKERNELS_H
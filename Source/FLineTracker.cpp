@@ -10,6 +10,7 @@
 #include "FTrackMeStable.h"
 
 #include "levmar.h"
+#include "FLevmarWorkspace.h"
 #include "FLevmarTermReason.h"
 #include "FGenericModel.h"
 
@@ -33,7 +34,6 @@ FLineTracker::FLineTracker()
   m_sigmaParallel(/* 1.2f */ 3.5f),
   m_sigmaOrthogonal(/*0.3f */ 0.5f),
   m_pBlurFilter(NULL),
-  m_pSearchResult(NULL),
   m_transferSize(0, 0),
   m_pStatistics(NULL),
   m_bufIndex(0),
@@ -53,7 +53,6 @@ FLineTracker::~FLineTracker()
 {
 	F_SAFE_DELETE(m_pModel);
 	F_SAFE_DELETE_ARRAY(m_pBlurFilter);
-	F_SAFE_DELETE_ARRAY(m_pSearchResult);
 	F_SAFE_DELETE_ARRAY(m_pResidualData);
 	F_SAFE_DELETE_ARRAY(m_pColorMemoryData);
 }
@@ -100,6 +99,7 @@ void FLineTracker::optimizePose()
 	if (!m_pModel)
 		return;
 
+	_gatherCandidates();
 	_drawInitialPose(); // for display only
 
 	if (m_trackerState != FLineTrackerState::Disabled)
@@ -119,6 +119,9 @@ void FLineTracker::optimizePose()
 				m_usePrevPose = false;
 			}
 
+			if (m_jacobianBenchmarkEnabled && m_pStatistics)
+				_benchmarkOptimization();
+
 			m_trackingError = _optimizePose();
 			
 			if (m_trackerState == FLineTrackerState::Tracking)
@@ -419,9 +422,8 @@ void FLineTracker::_modelChanged_resetGL()
 	m_bufResidualData.createAllocate(numBytes, FGLUsage::DynamicDraw);
 	m_texResidualData.createAttach(m_bufResidualData, FGLPixelFormat::R32_Float);
 
-	// Host memory for search results
-	F_SAFE_DELETE_ARRAY(m_pSearchResult);
-	m_pSearchResult = new FPixelRGBA32f[m_transferSize.width() * m_transferSize.height()];
+	// Pixel buffers for reading back the search results
+	m_searchReadback.create(m_transferSize.width() * m_transferSize.height() * sizeof(FPixelRGBA32f));
 
 	// Clear first intermediate/color buffer
 	m_fbModelSearchIntermediate.attachColorTexture(m_fbTexModelSearchIntermediate[0], 0);
@@ -503,6 +505,8 @@ void FLineTracker::_initParameters()
 	m_estimatorLimit = 8.0f;
 	m_rejectionFactorA = 3.0f;
 	m_rejectionFactorB = 1.0f;
+	m_jacobianType = FiniteDifferences;
+	m_jacobianBenchmarkEnabled = false;
 }
 
 void FLineTracker::_searchCandidates()
@@ -647,15 +651,40 @@ void FLineTracker::_searchCandidates()
 	F_GLERROR_ASSERT;
 
 	
-	// -------- COPY RESULTS TO HOST, GATHER CANDIDATES --------
+	// -------- START COPYING RESULTS TO HOST --------
 
 
 	// Swap intermediate/color buffer
 	m_bufIndex = 1 - m_bufIndex;
 
-	// Retrieve edge candidates from rendered image
-	F_ASSERT(m_pSearchResult);
-	m_fbTexModelSearchResult.read(FGLDataFormat::RGBA, FGLDataType::Float, m_pSearchResult);
+	// Drop a result that has not been gathered, then start the readback
+	while (m_searchReadback.pendingCount() > 0)
+		m_searchReadback.discard();
+
+	m_searchReadback.readTexture(m_fbTexModelSearchResult, FGLDataFormat::RGBA, FGLDataType::Float);
+}
+
+void FLineTracker::_gatherCandidates()
+{
+	// Retrieve edge candidates from rendered image; without a search result,
+	// the candidates of the previous frame must not be optimized
+	if (m_searchReadback.pendingCount() == 0)
+	{
+		m_pModel->beginAddCandidates();
+		m_pModel->endAddCandidates();
+		return;
+	}
+
+	FStopWatch stopWatch;
+	stopWatch.start();
+
+	const FPixelRGBA32f* pSearchResult = (const FPixelRGBA32f*)m_searchReadback.map();
+	if (!pSearchResult)
+	{
+		m_pModel->beginAddCandidates();
+		m_pModel->endAddCandidates();
+		return;
+	}
 
 	bool colTolEnabled = m_colorToleranceEnabled;
 	int tx = m_transferSize.width();
@@ -666,8 +695,8 @@ void FLineTracker::_searchCandidates()
 
 	for (int x = 0; x < tx; x++)
 	{
-		FPixelRGBA32f& refColor0 = m_pSearchResult[x];
-		FPixelRGBA32f& refColor1 = m_pSearchResult[lastLine + x];
+		const FPixelRGBA32f& refColor0 = pSearchResult[x];
+		const FPixelRGBA32f& refColor1 = pSearchResult[lastLine + x];
 		bool firstCandidate = true;
 
 		int edgeId = x / FGlobalConstants::MAX_SAMPLES_PER_EDGE;
@@ -675,7 +704,7 @@ void FLineTracker::_searchCandidates()
 
 		for (int y = 1; y < ty - 1; y++)
 		{
-			FPixelRGBA32f& pixel = m_pSearchResult[y * tx + x];
+			const FPixelRGBA32f& pixel = pSearchResult[y * tx + x];
 			if (pixel.r != 0.0f) // edge candidate found
 			{
 				bool colorOk = (pixel.r > 0.0f);
@@ -693,7 +722,11 @@ void FLineTracker::_searchCandidates()
 		}
 	}
 
+	m_searchReadback.unmap();
 	m_pModel->endAddCandidates();
+
+	if (m_pStatistics)
+		m_pStatistics->timeSearch += stopWatch.stop();
 }
 
 float FLineTracker::_optimizePose()
@@ -737,13 +770,8 @@ float FLineTracker::_optimizePose()
 	int numParameter = m_pCamera->focalDistanceEnabled() ? 7 : 6;
 	double opts[] = { 1e-3, 1e-17, 1e-17, 1e-17, 1e-3 }; // tau, eps1, eps2, eps3, delta
 	double lmInfo[LM_INFO_SZ];
-	double* pBuffer = FGlobalConstants::pLevmarTrackingWorkspace;
-
-	//int method = 2; double c = extraCostAverage + 4.0 * extraCostSD;
-	int method = m_estimatorType; double c = m_estimatorLimit;
 
-	int iter = dlevmar_dif(FLineTracker::sLevmarUpdate,
-		poseParams, NULL, numParameter, dataCountB, 50, opts, lmInfo, pBuffer, pCovar, (void*)this, method, c);
+	int iter = _runLevmar(poseParams, numParameter, dataCountB, opts, lmInfo, pCovar);
 
 	double optACostMedian, optACostMean, optACostSD, optBCostMedian, optBCostMean, optBCostSD;
 	optBCostMedian = optBCostMean = optBCostSD = 0.0;
@@ -767,8 +795,7 @@ float FLineTracker::_optimizePose()
 
 		double poseParams[] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
 
-		int iter = dlevmar_dif(FLineTracker::sLevmarUpdate,
-			poseParams, NULL, numParameter, dataCountC, 50, opts, lmInfo, pBuffer, pCovar, (void*)this, method, c);
+		int iter = _runLevmar(poseParams, numParameter, dataCountC, opts, lmInfo, pCovar);
 
 		m_pModel->getCost(optBCostMedian, optBCostMean, optBCostSD);
 		
@@ -813,6 +840,54 @@ float FLineTracker::_optimizePose()
 	return optBCostMean > 0.0 ? optBCostMean : optACostMean;
 }
 
+int FLineTracker::_runLevmar(double* pPoseParams, int numParams, int numData,
+							double* pOpts, double* pInfo, double* pCovar)
+{
+	// the finite difference solver needs the larger workspace
+	FLevmarWorkspace workspace(m_jacobianType == Analytic
+		? LM_DER_WORKSZ(numParams, numData) : LM_DIF_WORKSZ(numParams, numData), sizeof(double));
+	double* pBuffer = workspace.doubleData();
+
+	//int method = 2; double c = extraCostAverage + 4.0 * extraCostSD;
+	int method = m_estimatorType; double c = m_estimatorLimit;
+
+	if (m_jacobianType == Analytic)
+	{
+		return dlevmar_der(FLineTracker::sLevmarUpdate, FLineTracker::sLevmarJacobian,
+			pPoseParams, NULL, numParams, numData, 50, pOpts, pInfo, pBuffer, pCovar, (void*)this, method, c);
+	}
+
+	return dlevmar_dif(FLineTracker::sLevmarUpdate,
+		pPoseParams, NULL, numParams, numData, 50, pOpts, pInfo, pBuffer, pCovar, (void*)this, method, c);
+}
+
+void FLineTracker::_benchmarkOptimization()
+{
+	// Runs the optimization with the other Jacobian method first and records its time
+	// as reference. Camera and outlier state are restored afterwards, so the regular
+	// optimization starts from the same data.
+
+	F_ASSERT(m_pStatistics);
+
+	FCamera savedCamera(*m_pCamera);
+	FTrackerStatistics* pStats = m_pStatistics;
+	jacobian_t jacobianType = m_jacobianType;
+
+	m_pStatistics = NULL;
+	m_jacobianType = (jacobianType == Analytic) ? FiniteDifferences : Analytic;
+
+	FStopWatch stopWatch;
+	stopWatch.start();
+	_optimizePose();
+	pStats->timeOptimizationRef = stopWatch.stop();
+
+	m_jacobianType = jacobianType;
+	m_pStatistics = pStats;
+
+	*m_pCamera = savedCamera;
+	m_pModel->resetOutliers();
+}
+
 void FLineTracker::_updateColorStatistics()
 {
 	// Uses the final pose after the optimization has been run.
@@ -971,9 +1046,25 @@ void FLineTracker::_levmarUpdate(double* pPoseParams, double* hx, int m, int n)
 	m_pModel->getCostVector(hx);
 }
 
-void FLineTracker::_levmarJacobian(double* pParams, double* jac, int m, int n)
+void FLineTracker::_levmarJacobian(double* pPoseParams, double* jac, int m, int n)
 {
-	F_ASSERT(!"Jacobian not implemented correctly yet");
+	F_ASSERT(n == m_pModel->costVectorSize());
+	F_ASSERT(m <= FLineModel::MAX_POSE_PARAMS);
+
+	FMatrix4f matMV_Current, matP_Current, matMVP_Current;
+	FMatrix4f matDerivMVP[FCamera::NUM_PARAM];
+
+	m_pCamera->updatePose(pPoseParams);
+
+	m_pCamera->getModelViewCurrent(matMV_Current);
+	m_pCamera->getProjectionCurrent(matP_Current);
+	matMVP_Current = matP_Current * matMV_Current;
+	m_pCamera->getDerivativesMVPCurrent(matDerivMVP);
+
+	m_pModel->transform(matMV_Current, matMVP_Current);
+	m_pModel->calculateHypothesis();
+	m_pModel->updateJacobian(matDerivMVP, m);
+	m_pModel->getJacobian(jac, m);
 }
 
 void FLineTracker::_drawInitialPose()
@@ -20,6 +20,7 @@
 #include "FStopWatch.h"
 #include "FFrameStatistics.h"
 #include "FLineTrackerState.h"
+#include "FAsyncReadback.h"
 
 // ----------------------------------------------------------------------------------------------------
 //  Class FLineTracker
@@ -41,6 +42,16 @@ private:
 		((FLineTracker*)pData)->_levmarJacobian(p, j, m, n);
 	}
 
+	//  Public enumerations ----------------------------------------------------
+
+public:
+	/// Method used to calculate the Jacobian during pose optimization.
+	enum jacobian_t
+	{
+		FiniteDifferences,
+		Analytic,
+	};
+
 	//  Constructors and destructor --------------------------------------------
 
 public:
@@ -52,10 +63,11 @@ public:
 	//  Public commands --------------------------------------------------------
 
 public:
-	/// Runs the edge candidate search on the GPU.
+	/// Runs the edge candidate search on the GPU. The search result is read back
+	/// asynchronously, other GPU work can be issued before calling optimizePose().
 	void searchCandidates(const FGLTextureRect& currentFrame, const FGLTextureRect& previousFrame,
 		FTrackerStatistics* pStats = NULL);
-	/// Optimizes the pose based on the candidates found in the previous step.
+	/// Collects the candidates found in the previous step and optimizes the pose.
 	void optimizePose();
 
 	/// Resets the tracker and prepares for the given frame size.
@@ -80,6 +92,8 @@ public:
 	FLineTrackerState state() const { return m_trackerState; }
 	/// Returns the last optimization error.
 	float error() const { return m_trackingError; }
+	/// Returns the time in seconds spent waiting for the last search result readback.
+	double readbackStallTime() const { return m_searchReadback.lastStallTime(); }
 
 	/// Returns the depth texture from solid model rendering.
 	const FGLTextureRect& depthPass() const { return m_fbTexModelDepth; }
@@ -120,6 +134,8 @@ public:
 	void setEstimatorLimit(double val) { m_estimatorLimit = val; }
 	void setRejectionFactorA(double val) { m_rejectionFactorA = val; }
 	void setRejectionFactorB(double val) { m_rejectionFactorB = val; }
+	void setJacobianType(int val) { m_jacobianType = (jacobian_t)val; }
+	void setJacobianBenchmarkEnabled(bool state) { m_jacobianBenchmarkEnabled = state; }
 
 	//  Internal functions -----------------------------------------------------
 
@@ -130,7 +146,11 @@ private:
 	void _modelChanged_resetGL();
 
 	void _searchCandidates();
+	void _gatherCandidates();
 	float _optimizePose();
+	int _runLevmar(double* pPoseParams, int numParams, int numData,
+		double* pOpts, double* pInfo, double* pCovar);
+	void _benchmarkOptimization();
 	void _updateColorStatistics();
 	void _resetColorStatistics();
 
@@ -197,7 +217,7 @@ protected:
 	FGLBuffer m_bufResidualData;
 	FGLTextureBuffer m_texResidualData;
 
-	FPixelRGBA32f* m_pSearchResult;
+	FAsyncReadback m_searchReadback;
 
 	FGLBuffer m_bufModelTransform;
 
@@ -234,6 +254,8 @@ protected:
 	float     m_estimatorLimit;
 	float     m_rejectionFactorA;
 	float     m_rejectionFactorB;
+	jacobian_t m_jacobianType;
+	bool      m_jacobianBenchmarkEnabled;
 
 	// parameter uniform locations
 	int m_uSearchRange;
@@ -141,7 +141,7 @@ void FMainWindow::onOpenMediaFile()
 {
 	QString filePath = QFileDialog::getOpenFileName(
 		this, "Open Media File", QString(),
-		"Images (*.tif *.jpg *.png *.bmp);;Movies (*.avi *.mp4 *.mov)");
+		"Images (*.tif *.jpg *.png *.bmp);;Movies (*.y4m *.raw *.avi *.mp4 *.mov)");
 
 	if (!filePath.isEmpty())
 		emit openMediaFile(filePath);
@@ -167,7 +167,7 @@ void FMainWindow::onStreamProperties()
 void FMainWindow::onStartPlayout()
 {
 	QString filePath = QFileDialog::getSaveFileName(
-		this, "Select Playout File", QString(), "JPEG Images (*.jpg)");
+		this, "Select Playout File", QString(), "JPEG Images (*.jpg);;Raw Movies (*.raw);;Y4M Movies (*.y4m)");
 
 	if (!filePath.isEmpty())
 		emit startPlayout(filePath);
@@ -178,6 +178,12 @@ void FMainWindow::onStopPlayout()
 	emit stopPlayout();
 }
 
+void FMainWindow::onPipelineMode(QAction* pMenuItem)
+{
+	if (pMenuItem)
+		emit pipelineModeChanged(pMenuItem->data().toInt());
+}
+
 void FMainWindow::onStartStatisticsLog()
 {
 	QString filePath = QFileDialog::getSaveFileName(
@@ -199,6 +205,11 @@ void FMainWindow::onTraining()
 	m_pTrainingWindow->show();
 }
 
+void FMainWindow::onLineModelBenchmark()
+{
+	emit runLineModelBenchmark();
+}
+
 void FMainWindow::onShowAbout()
 {
 	F_SAFE_DELETE(m_pDialogAbout);
@@ -239,10 +250,22 @@ QMenu* FMainWindow::onCreateMenu(QMenuBar* pMenuBar)
 	pMenuFile->addAction("Start Playout...", this, SLOT(onStartPlayout()));
 	pMenuFile->addAction("Stop Playout", this, SLOT(onStopPlayout()));
 	pMenuFile->addSeparator();
+
+	QMenu* pMenuPipeline = pMenuFile->addMenu("Pipeline Mode");
+	QActionGroup* pPipelineModes = new QActionGroup(pMenuPipeline);
+	pPipelineModes->addAction(pMenuPipeline->addAction("Automatic"))->setData(FFramePipeline::Automatic);
+	pPipelineModes->addAction(pMenuPipeline->addAction("Throughput"))->setData(FFramePipeline::Throughput);
+	pPipelineModes->addAction(pMenuPipeline->addAction("Low Latency"))->setData(FFramePipeline::Latency);
+	foreach (QAction* pAction, pPipelineModes->actions())
+		pAction->setCheckable(true);
+	pPipelineModes->actions().first()->setChecked(true);
+	connect(pMenuPipeline, SIGNAL(triggered(QAction*)), this, SLOT(onPipelineMode(QAction*)));
+	pMenuFile->addSeparator();
 	pMenuFile->addAction("Start Statistics Log...", this, SLOT(onStartStatisticsLog()));
 	pMenuFile->addAction("Stop Statistics Log", this, SLOT(onStopStatisticsLog()));
 	pMenuFile->addSeparator();
 	pMenuFile->addAction("Training...", this, SLOT(onTraining()), QKeySequence("Ctrl+T"));
+	pMenuFile->addAction("Line Model Benchmark", this, SLOT(onLineModelBenchmark()));
 	pMenuFile->addSeparator();
 	pMenuFile->addAction("&Quit", this, SLOT(close()), QKeySequence("Ctrl+Q"));
 
@@ -309,6 +332,10 @@ void FMainWindow::_createStreamProcessor()
 		pProcessor, SLOT(startPlayout(QString)));
 	connect(this, SIGNAL(stopPlayout()),
 		pProcessor, SLOT(stopPlayout()));
+	connect(this, SIGNAL(pipelineModeChanged(int)),
+		pProcessor, SLOT(setPipelineMode(int)));
+	connect(this, SIGNAL(runLineModelBenchmark()),
+		pProcessor, SLOT(runLineModelBenchmark()));
 	connect(this, SIGNAL(keyPressed(FKeyboardState)),
 		pProcessor, SLOT(keyPressed(FKeyboardState)));
 
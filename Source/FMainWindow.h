@@ -61,9 +61,11 @@ protected slots:
 	void onStreamProperties();
 	void onStartPlayout();
 	void onStopPlayout();
+	void onPipelineMode(QAction* pMenuItem);
 	void onStartStatisticsLog();
 	void onStopStatisticsLog();
 	void onTraining();
+	void onLineModelBenchmark();
 	void onShowAbout();
 
 signals:
@@ -71,6 +73,8 @@ signals:
 	void openMediaStream(int ordinal, QSize imageSize);
 	void startPlayout(QString filePath);
 	void stopPlayout();
+	void pipelineModeChanged(int mode);
+	void runLineModelBenchmark();
 
 	//  Internal functions -----------------------------------------------------
 
@@ -0,0 +1,299 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FMovieReader.cpp
+//  Description		Implementation of class FMovieReader
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-10-06 09:31:47 +0200 (Do, 06 Okt 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#include "FTrackMeStable.h"
+
+#include <QFileInfo>
+
+#include "FMovieReader.h"
+#include "FMemoryTracer.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Helper functions
+// ----------------------------------------------------------------------------------------------------
+
+static inline quint8 sClamp(int value)
+{
+	return (quint8)((value < 0) ? 0 : ((value > 255) ? 255 : value));
+}
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FMovieReader
+// ----------------------------------------------------------------------------------------------------
+
+// Constructors and destructor ------------------------------------------------------------------------
+
+FMovieReader::FMovieReader()
+: m_format(Unknown),
+  m_frameSize(0, 0),
+  m_frameRate(0.0),
+  m_sourceFrameBytes(0),
+  m_chroma(Chroma420),
+  m_isFullRange(false),
+  m_pMapped(NULL),
+  m_currentIndex(0),
+  m_pCurrentFrame(NULL)
+{
+}
+
+FMovieReader::~FMovieReader()
+{
+	close();
+}
+
+// Public commands ------------------------------------------------------------------------------------
+
+bool FMovieReader::open(const QString& filePath)
+{
+	close();
+
+	m_file.setFileName(filePath);
+	if (!m_file.open(QIODevice::ReadOnly))
+		return false;
+
+	QString suffix = QFileInfo(filePath).suffix();
+	bool result = false;
+
+	if (suffix.compare("raw", Qt::CaseInsensitive) == 0)
+		result = _openRaw();
+	else if (suffix.compare("y4m", Qt::CaseInsensitive) == 0)
+		result = _openY4M();
+
+	if (!result || m_frameOffsets.empty())
+	{
+		close();
+		return false;
+	}
+
+	F_TRACE(QString("FMovieReader::open - %1 x %2, %3 frames")
+		.arg(m_frameSize.width()).arg(m_frameSize.height()).arg(m_frameOffsets.size()));
+	return true;
+}
+
+void FMovieReader::close()
+{
+	_unmap();
+
+	if (m_file.isOpen())
+		m_file.close();
+
+	m_format = Unknown;
+	m_frameSize = QSize(0, 0);
+	m_frameRate = 0.0;
+	m_frameOffsets.clear();
+	m_sourceFrameBytes = 0;
+	m_frameBuffer.clear();
+}
+
+const quint8* FMovieReader::frame(size_t index)
+{
+	F_ASSERT(isOpen() && index < m_frameOffsets.size());
+	if (!isOpen() || index >= m_frameOffsets.size())
+		return NULL;
+
+	if (m_pCurrentFrame && index == m_currentIndex)
+		return m_pCurrentFrame;
+
+	_unmap();
+
+	m_pMapped = m_file.map(m_frameOffsets[index], (qint64)m_sourceFrameBytes);
+	if (!m_pMapped)
+		return NULL;
+
+	if (m_format == Raw)
+	{
+		// the mapped frame is returned as it is, the view is kept until the next frame
+		m_pCurrentFrame = m_pMapped;
+	}
+	else
+	{
+		_convertY4M(m_pMapped, &m_frameBuffer[0]);
+		_unmap();
+		m_pCurrentFrame = &m_frameBuffer[0];
+	}
+
+	m_currentIndex = index;
+	return m_pCurrentFrame;
+}
+
+// Public queries -------------------------------------------------------------------------------------
+
+bool FMovieReader::isSupported(const QString& filePath)
+{
+	QString suffix = QFileInfo(filePath).suffix();
+	return suffix.compare("raw", Qt::CaseInsensitive) == 0
+		|| suffix.compare("y4m", Qt::CaseInsensitive) == 0;
+}
+
+// Internal functions ---------------------------------------------------------------------------------
+
+bool FMovieReader::_openRaw()
+{
+	FRawMovieHeader header;
+	if (m_file.read((char*)&header, sizeof(FRawMovieHeader)) != sizeof(FRawMovieHeader))
+		return false;
+
+	if (!header.isValid() || header.width == 0 || header.height == 0)
+		return false;
+
+	m_format = Raw;
+	m_frameSize = QSize((int)header.width, (int)header.height);
+	m_frameRate = header.frameRateDen ? (double)header.frameRateNum / header.frameRateDen : 0.0;
+	m_sourceFrameBytes = frameByteCount();
+
+	// incomplete frames at the end of the file are ignored
+	qint64 numFrames = (m_file.size() - header.headerSize) / (qint64)m_sourceFrameBytes;
+	for (qint64 i = 0; i < numFrames; i++)
+		m_frameOffsets.push_back(header.headerSize + i * (qint64)m_sourceFrameBytes);
+
+	return true;
+}
+
+bool FMovieReader::_openY4M()
+{
+	QByteArray headerLine = m_file.readLine(1024);
+	if (!headerLine.startsWith("YUV4MPEG2 ") || !headerLine.endsWith('\n'))
+		return false;
+
+	int width = 0, height = 0;
+	m_chroma = Chroma420;
+	m_isFullRange = false;
+	m_frameRate = 25.0;
+
+	QList<QByteArray> tokens = headerLine.trimmed().split(' ');
+	for (int i = 1; i < tokens.size(); i++)
+	{
+		const QByteArray& token = tokens[i];
+		if (token.isEmpty())
+			continue;
+
+		QByteArray value = token.mid(1);
+		switch (token[0])
+		{
+		case 'W':
+			width = value.toInt();
+			break;
+		case 'H':
+			height = value.toInt();
+			break;
+		case 'F':
+			{
+				QList<QByteArray> rate = value.split(':');
+				if (rate.size() == 2 && rate[1].toInt() > 0)
+					m_frameRate = rate[0].toDouble() / rate[1].toDouble();
+			}
+			break;
+		case 'C':
+			if (value.startsWith("420"))
+				m_chroma = Chroma420;
+			else if (value == "444")
+				m_chroma = Chroma444;
+			else if (value == "mono")
+				m_chroma = ChromaMono;
+			else
+				return false;
+			break;
+		case 'X':
+			if (value == "COLORRANGE=FULL")
+				m_isFullRange = true;
+			break;
+		}
+	}
+
+	if (width <= 0 || height <= 0)
+		return false;
+
+	m_format = Y4M;
+	m_frameSize = QSize(width, height);
+	m_frameBuffer.resize(frameByteCount());
+
+	size_t lumaBytes = (size_t)width * height;
+	if (m_chroma == Chroma420)
+		m_sourceFrameBytes = lumaBytes + 2 * (size_t)((width + 1) / 2) * ((height + 1) / 2);
+	else if (m_chroma == Chroma444)
+		m_sourceFrameBytes = 3 * lumaBytes;
+	else
+		m_sourceFrameBytes = lumaBytes;
+
+	// each frame starts with a FRAME line, which may carry parameters
+	qint64 fileSize = m_file.size();
+	qint64 offset = headerLine.size();
+
+	while (m_file.seek(offset))
+	{
+		QByteArray frameLine = m_file.readLine(256);
+		if (!frameLine.startsWith("FRAME") || !frameLine.endsWith('\n'))
+			break;
+
+		qint64 dataOffset = offset + frameLine.size();
+		if (dataOffset + (qint64)m_sourceFrameBytes > fileSize)
+			break;
+
+		m_frameOffsets.push_back(dataOffset);
+		offset = dataOffset + m_sourceFrameBytes;
+	}
+
+	return true;
+}
+
+void FMovieReader::_unmap()
+{
+	if (m_pMapped)
+		m_file.unmap(m_pMapped);
+
+	m_pMapped = NULL;
+	m_pCurrentFrame = NULL;
+}
+
+void FMovieReader::_convertY4M(const quint8* pSource, quint8* pTarget) const
+{
+	int nx = m_frameSize.width();
+	int ny = m_frameSize.height();
+	int shift = (m_chroma == Chroma420) ? 1 : 0;
+	int cx = (nx + shift) >> shift;
+	int cy = (ny + shift) >> shift;
+
+	const quint8* pY = pSource;
+	const quint8* pU = pY + nx * ny;
+	const quint8* pV = pU + cx * cy;
+
+	// BT.601 coefficients in 16.16 fixed point, limited range unless tagged otherwise
+	int yOffset = m_isFullRange ? 0 : 16;
+	int yScale = m_isFullRange ? 65536 : 76309;
+	int rv = m_isFullRange ? 91881 : 104597;
+	int gu = m_isFullRange ? 22554 : 25675;
+	int gv = m_isFullRange ? 46802 : 53279;
+	int bu = m_isFullRange ? 116130 : 132201;
+
+	for (int y = 0; y < ny; y++)
+	{
+		const quint8* pRowY = pY + y * nx;
+		const quint8* pRowU = pU + (y >> shift) * cx;
+		const quint8* pRowV = pV + (y >> shift) * cx;
+		quint8* pDst = pTarget + y * nx * 4;
+
+		for (int x = 0; x < nx; x++, pDst += 4)
+		{
+			int c = (pRowY[x] - yOffset) * yScale + 32768;
+			int u = 0, v = 0;
+			if (m_chroma != ChromaMono)
+			{
+				u = pRowU[x >> shift] - 128;
+				v = pRowV[x >> shift] - 128;
+			}
+
+			pDst[0] = sClamp((c + bu * u) >> 16);
+			pDst[1] = sClamp((c - gu * u - gv * v) >> 16);
+			pDst[2] = sClamp((c + rv * v) >> 16);
+			pDst[3] = 255;
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------
@@ -0,0 +1,157 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FMovieReader.h
+//  Description		Header file for FMovieReader.cpp
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-10-06 09:31:47 +0200 (Do, 06 Okt 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#ifndef FMOVIEREADER_H
+#define FMOVIEREADER_H
+
+#include <vector>
+#include <QFile>
+#include <QSize>
+
+#include "FTrackMe.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Struct FRawMovieHeader
+// ----------------------------------------------------------------------------------------------------
+
+/// Header of a raw movie file. The header is followed by the frames in the memory layout of
+/// QImage::Format_ARGB32 (bytes B, G, R, A), top row first, without padding. All fields are
+/// stored little endian.
+struct FRawMovieHeader
+{
+	FRawMovieHeader() {
+		memcpy(magic, "FRAWMOV1", 8);
+		headerSize = sizeof(FRawMovieHeader);
+		width = height = frameCount = 0;
+		frameRateNum = 25;
+		frameRateDen = 1;
+	}
+
+	/// Returns true if the magic and the header size match.
+	bool isValid() const {
+		return memcmp(magic, "FRAWMOV1", 8) == 0 && headerSize >= sizeof(FRawMovieHeader);
+	}
+
+	char magic[8];
+	/// Offset of the first frame in bytes.
+	quint32 headerSize;
+	quint32 width;
+	quint32 height;
+	/// Number of frames written, informative only; the frame count is given by the file size.
+	quint32 frameCount;
+	quint32 frameRateNum;
+	quint32 frameRateDen;
+};
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FMovieReader
+// ----------------------------------------------------------------------------------------------------
+
+/// Reads the frames of an uncompressed movie file. Supported are raw movie files (.raw, see
+/// FRawMovieHeader) and YUV4MPEG2 files (.y4m) with 4:2:0, 4:4:4 or mono planes of 8 bits.
+/// The frames are memory mapped one at a time, the offset of each frame is known after
+/// opening the file, so any frame can be accessed in constant time. Raw frames are returned
+/// directly from the mapped file, Y4M frames are converted to BGRA.
+class FMovieReader
+{
+	//  Public types -----------------------------------------------------------
+
+public:
+	enum format_t
+	{
+		Unknown,
+		Raw,
+		Y4M
+	};
+
+	//  Constructors and destructor --------------------------------------------
+
+public:
+	/// Default Constructor.
+	FMovieReader();
+	/// Virtual destructor.
+	virtual ~FMovieReader();
+
+private:
+	FMovieReader(const FMovieReader& other);
+	FMovieReader& operator=(const FMovieReader& other);
+
+	//  Public commands --------------------------------------------------------
+
+public:
+	/// Opens the given movie file and reads the frame offsets. Returns false if the file
+	/// cannot be read or its format is not supported.
+	bool open(const QString& filePath);
+	/// Closes the movie file.
+	void close();
+
+	/// Returns the frame with the given index in QImage::Format_ARGB32 layout, top row first.
+	/// The data is valid until the next call or until the file is closed. Returns NULL on failure.
+	const quint8* frame(size_t index);
+
+	//  Public queries ---------------------------------------------------------
+
+public:
+	/// Returns true if a movie file is open.
+	bool isOpen() const { return m_format != Unknown; }
+	/// Returns the format of the movie file.
+	format_t format() const { return m_format; }
+	/// Returns the number of frames.
+	size_t frameCount() const { return m_frameOffsets.size(); }
+	/// Returns the width and height of a frame.
+	const QSize& frameSize() const { return m_frameSize; }
+	/// Returns the size of a returned frame in bytes.
+	size_t frameByteCount() const { return (size_t)m_frameSize.width() * m_frameSize.height() * 4; }
+	/// Returns the frame rate in frames per second.
+	double frameRate() const { return m_frameRate; }
+
+	/// Returns true if the file extension denotes a supported movie format.
+	static bool isSupported(const QString& filePath);
+
+	//  Internal types ---------------------------------------------------------
+
+private:
+	enum chroma_t
+	{
+		Chroma420,
+		Chroma444,
+		ChromaMono
+	};
+
+	//  Internal functions -----------------------------------------------------
+
+private:
+	bool _openRaw();
+	bool _openY4M();
+	void _unmap();
+	void _convertY4M(const quint8* pSource, quint8* pTarget) const;
+
+	//  Internal data members --------------------------------------------------
+
+private:
+	QFile m_file;
+	format_t m_format;
+	QSize m_frameSize;
+	double m_frameRate;
+	std::vector<qint64> m_frameOffsets;
+	size_t m_sourceFrameBytes;
+
+	// Y4M
+	chroma_t m_chroma;
+	bool m_isFullRange;
+	std::vector<quint8> m_frameBuffer;
+
+	uchar* m_pMapped;
+	size_t m_currentIndex;
+	const quint8* m_pCurrentFrame;
+};
+
+// ----------------------------------------------------------------------------------------------------
+
+#endif // FMOVIEREADER_H
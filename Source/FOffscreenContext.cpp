@@ -0,0 +1,254 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FOffscreenContext.cpp
+//  Description		Implementation of class FOffscreenContext
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-10-13 16:42:10 +0200 (Do, 13 Okt 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#include "FTrackMeStable.h"
+
+#include "FlowGL.h"
+#ifdef Q_OS_WIN
+#include <QWidget>
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "FOffscreenContext.h"
+#include "FMemoryTracer.h"
+
+#ifndef Q_OS_WIN
+// EGL_KHR_create_context, core in EGL 1.5
+#ifndef EGL_CONTEXT_MAJOR_VERSION_KHR
+#define EGL_CONTEXT_MAJOR_VERSION_KHR				0x3098
+#define EGL_CONTEXT_MINOR_VERSION_KHR				0x30FB
+#define EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR			0x30FD
+#define EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR		0x00000001
+#endif
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA				0x31DD
+#endif
+
+typedef EGLDisplay (EGLAPIENTRY *FPFEGLGETPLATFORMDISPLAY)(EGLenum, void*, const EGLint*);
+#endif
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FOffscreenContext
+// ----------------------------------------------------------------------------------------------------
+
+// Constructors and destructor ------------------------------------------------------------------------
+
+FOffscreenContext::FOffscreenContext()
+#ifdef Q_OS_WIN
+: m_pWindow(NULL),
+  m_pContext(NULL)
+#else
+: m_display(EGL_NO_DISPLAY),
+  m_surface(EGL_NO_SURFACE),
+  m_context(EGL_NO_CONTEXT)
+#endif
+{
+}
+
+FOffscreenContext::~FOffscreenContext()
+{
+	release();
+}
+
+// Public commands ------------------------------------------------------------------------------------
+
+#ifdef Q_OS_WIN
+
+bool FOffscreenContext::create(int majorVersion, int minorVersion, const QSize& size)
+{
+	release();
+
+	// the context needs a native window, which is never shown
+	m_pWindow = new QWidget();
+	m_pWindow->setAttribute(Qt::WA_DontShowOnScreen);
+	m_pWindow->resize(size);
+	m_pWindow->winId();
+
+	FGLContextSettings settings;
+	settings.setVersion(majorVersion, minorVersion);
+
+	m_pContext = new FGLContext();
+	if (!m_pContext->create(settings, m_pWindow))
+	{
+		m_errorString = QString("Failed to create an OpenGL %1.%2 context")
+			.arg(majorVersion).arg(minorVersion);
+		release();
+		return false;
+	}
+
+	m_pContext->makeCurrent();
+	m_errorString.clear();
+	return true;
+}
+
+void FOffscreenContext::makeCurrent()
+{
+	if (m_pContext)
+		m_pContext->makeCurrent();
+}
+
+void FOffscreenContext::release()
+{
+	F_SAFE_DELETE(m_pContext);
+	F_SAFE_DELETE(m_pWindow);
+}
+
+#else
+
+bool FOffscreenContext::create(int majorVersion, int minorVersion, const QSize& size)
+{
+	release();
+
+	// prefer Mesa's surfaceless platform, which needs neither a display server nor a GPU
+	EGLDisplay display = EGL_NO_DISPLAY;
+	FPFEGLGETPLATFORMDISPLAY pfGetPlatformDisplay =
+		(FPFEGLGETPLATFORMDISPLAY)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (pfGetPlatformDisplay)
+		display = pfGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+	{
+		m_errorString = "Failed to open an EGL display";
+		return false;
+	}
+
+	m_display = display;
+
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		m_errorString = "The EGL implementation does not support desktop OpenGL";
+		release();
+		return false;
+	}
+
+	EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_NONE
+	};
+
+	EGLConfig config = NULL;
+	EGLint configCount = 0;
+	bool hasPbuffer = eglChooseConfig(display, configAttributes, &config, 1, &configCount)
+		&& configCount > 0;
+
+	if (!hasPbuffer)
+	{
+		// all rendering goes to framebuffer objects, a context without surface will do
+		configAttributes[1] = 0;
+		if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount)
+			|| configCount == 0)
+		{
+			m_errorString = "No EGL configuration for OpenGL rendering";
+			release();
+			return false;
+		}
+	}
+
+	EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION_KHR, majorVersion,
+		EGL_CONTEXT_MINOR_VERSION_KHR, minorVersion,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+		EGL_NONE
+	};
+
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT)
+	{
+		m_errorString = QString("Failed to create an OpenGL %1.%2 context")
+			.arg(majorVersion).arg(minorVersion);
+		release();
+		return false;
+	}
+
+	m_context = context;
+
+	if (hasPbuffer)
+	{
+		EGLint surfaceAttributes[] = {
+			EGL_WIDTH, fMax(size.width(), 1),
+			EGL_HEIGHT, fMax(size.height(), 1),
+			EGL_NONE
+		};
+
+		m_surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+	}
+
+	if (!eglMakeCurrent(display, (EGLSurface)m_surface, (EGLSurface)m_surface, context))
+	{
+		m_errorString = "Failed to make the EGL context current";
+		release();
+		return false;
+	}
+
+	// GLEW must be built with GLEW_EGL to resolve the entry points of an EGL context
+	FGLContext::initGlew();
+
+	m_errorString.clear();
+	return true;
+}
+
+void FOffscreenContext::makeCurrent()
+{
+	if (m_context != EGL_NO_CONTEXT)
+		eglMakeCurrent((EGLDisplay)m_display, (EGLSurface)m_surface,
+			(EGLSurface)m_surface, (EGLContext)m_context);
+}
+
+void FOffscreenContext::release()
+{
+	if (m_display == EGL_NO_DISPLAY)
+		return;
+
+	EGLDisplay display = (EGLDisplay)m_display;
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+	if (m_context != EGL_NO_CONTEXT)
+		eglDestroyContext(display, (EGLContext)m_context);
+	if (m_surface != EGL_NO_SURFACE)
+		eglDestroySurface(display, (EGLSurface)m_surface);
+
+	eglTerminate(display);
+
+	m_display = EGL_NO_DISPLAY;
+	m_surface = EGL_NO_SURFACE;
+	m_context = EGL_NO_CONTEXT;
+}
+
+#endif
+
+// Public queries -------------------------------------------------------------------------------------
+
+bool FOffscreenContext::isValid() const
+{
+#ifdef Q_OS_WIN
+	return m_pContext != NULL;
+#else
+	return m_context != EGL_NO_CONTEXT;
+#endif
+}
+
+QString FOffscreenContext::platformName()
+{
+#ifdef Q_OS_WIN
+	return "WGL";
+#else
+	return "EGL";
+#endif
+}
+
+// ----------------------------------------------------------------------------------------------------
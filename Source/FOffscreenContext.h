@@ -0,0 +1,87 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FOffscreenContext.h
+//  Description		Header file for FOffscreenContext.cpp
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-10-13 16:42:10 +0200 (Do, 13 Okt 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#ifndef FOFFSCREENCONTEXT_H
+#define FOFFSCREENCONTEXT_H
+
+#include <QSize>
+#include <QString>
+#include "FTrackMe.h"
+
+#ifdef Q_OS_WIN
+class QWidget;
+class FGLContext;
+#endif
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FOffscreenContext
+// ----------------------------------------------------------------------------------------------------
+
+/// OpenGL context for rendering without a visible window, used by the batch runners. All
+/// rendering goes to framebuffer objects, the context only provides the GL state.
+/// On Windows, the context is created by FGLContext on a native window which is never shown;
+/// without an interactive desktop session, e.g. in a service, only the GDI OpenGL 1.1 is
+/// available and a Mesa opengl32.dll must be deployed next to the executable.
+/// Elsewhere, the context is created through EGL with a pbuffer surface, or without a surface
+/// if the EGL implementation provides no pbuffer configuration. No display server is needed,
+/// e.g. Mesa's llvmpipe with EGL_PLATFORM=surfaceless runs on a headless build machine.
+class FOffscreenContext
+{
+	//  Constructors and destructor --------------------------------------------
+
+public:
+	/// Default Constructor.
+	FOffscreenContext();
+	/// Virtual destructor.
+	virtual ~FOffscreenContext();
+
+private:
+	FOffscreenContext(const FOffscreenContext& other);
+	FOffscreenContext& operator=(const FOffscreenContext& other);
+
+	//  Public commands --------------------------------------------------------
+
+public:
+	/// Creates a core profile context of the given version and makes it current
+	/// for the calling thread. Returns false and sets errorString() on failure.
+	bool create(int majorVersion, int minorVersion, const QSize& size);
+	/// Makes the context current for the calling thread.
+	void makeCurrent();
+	/// Destroys the context and its surface.
+	void release();
+
+	//  Public queries ---------------------------------------------------------
+
+	/// Returns true if the context has been created.
+	bool isValid() const;
+	/// Returns the reason of the last failure of create().
+	const QString& errorString() const { return m_errorString; }
+
+	/// Returns the name of the window system interface used to create the context.
+	static QString platformName();
+
+	//  Internal data members --------------------------------------------------
+
+private:
+#ifdef Q_OS_WIN
+	QWidget* m_pWindow;
+	FGLContext* m_pContext;
+#else
+	// EGLDisplay, EGLSurface and EGLContext, the EGL headers are not exposed
+	void* m_display;
+	void* m_surface;
+	void* m_context;
+#endif
+
+	QString m_errorString;
+};
+
+// ----------------------------------------------------------------------------------------------------
+
+#endif // FOFFSCREENCONTEXT_H
@@ -632,6 +632,17 @@ void FParameterController::_initialize()
 	connect(pRejectionLimitB, SIGNAL(scalarValueChanged(double, int)), m_pEngine,
 		SLOT(setTrackerRejectionFactorB(double)), Qt::DirectConnection);
 
+	QStringList jacobianOpts;
+	jacobianOpts << "Finite Differences" << "Analytic";
+	FPTItemOption* pOptJacobian = new FPTItemOption("Jacobian", QStringList(), pGroupMoreOpt);
+	pOptJacobian->setOptions(jacobianOpts);
+	pOptJacobian->selectOption(0);
+	connect(pOptJacobian, SIGNAL(optionChanged(int, int)), m_pEngine, SLOT(setTrackerJacobianType(int)));
+
+	FPTItemSwitch* pJacobianBenchmark = new FPTItemSwitch("Jacobian Benchmark", pGroupMoreOpt);
+	connect(pJacobianBenchmark, SIGNAL(stateChanged(bool, int)), m_pEngine,
+		SLOT(setTrackerJacobianBenchmark(bool)), Qt::DirectConnection);
+
 	FPTItemGroup* pGroupDetection = new FPTItemGroup("Contour Detection", pRootItem, true);
 
 	FPTItemGroup* pGroupGeneral = new FPTItemGroup("General", pGroupDetection, true);
@@ -666,6 +677,13 @@ void FParameterController::_initialize()
 	pEdgeThresholdHigh->setValue(0.07);
 	connect(pEdgeThresholdHigh, SIGNAL(scalarValueChanged(double, int)), m_pEngine,
 		SLOT(setEdgeThresholdHigh(double)), Qt::DirectConnection);
+
+	FPTItemOption* pPreprocessing = new FPTItemOption("Preprocessing", QStringList(), pGroupCanny);
+	QStringList optionsBackend;
+	optionsBackend << "GPU" << "CPU";
+	pPreprocessing->setOptions(optionsBackend);
+	connect(pPreprocessing, SIGNAL(optionChanged(int, int)), m_pEngine,
+		SLOT(setDetectionBackend(int)), Qt::DirectConnection);
 	
 
 	FPTItemGroup* pGroupPoseDetection = new FPTItemGroup("Template Fitting", pGroupDetection, true);
@@ -687,6 +705,13 @@ void FParameterController::_initialize()
 	connect(pFixedTypeId, SIGNAL(optionChanged(int, int)), m_pEngine,
 		SLOT(setDetectionFixedTypeId(int)), Qt::DirectConnection);
 
+	FPTItemOption* pWorkerCount = new FPTItemOption("Worker Threads", QStringList(), pGroupPoseDetection);
+	QStringList options4;
+	options4 << "Auto" << "1" << "2" << "3" << "4" << "5" << "6" << "7" << "8";
+	pWorkerCount->setOptions(options4);
+	connect(pWorkerCount, SIGNAL(optionChanged(int, int)), m_pEngine,
+		SLOT(setDetectionWorkerCount(int)), Qt::DirectConnection);
+
 
 	FPTItemGroup* pGroupContourModel = new FPTItemGroup("Contour Model Pose", pGroupDetection, true);
 
@@ -13,6 +13,7 @@
 #include <algorithm>
 #include "Eigen/Dense"
 #include "levmar.h"
+#include "FLevmarWorkspace.h"
 #include "FPoseDetector.h"
 #include "FMemoryTracer.h"
 
@@ -35,6 +36,8 @@ FPoseDetector::FPoseDetector()
   m_slotSize(64, 64),
   m_pClassifierData(NULL),
   m_pStatistics(NULL),
+  m_workerCount(0),
+  m_matchPass(WarpPass),
   m_edgeThresholdLow(0.02f),
   m_edgeThresholdHigh(0.07f),
   m_warpErrorThreshold(3.0f),
@@ -45,6 +48,8 @@ FPoseDetector::FPoseDetector()
   m_poseCount(0)
 {
 	F_VERIFY(_initGL());
+	m_distanceTransformCPU.setWorkerPool(&m_workerPool);
+	m_contourFinder.setWorkerPool(&m_workerPool);
 	_changePatchSize(m_patchSize);
 	_updateContourRelativePose();
 }
@@ -63,6 +68,29 @@ void FPoseDetector::preprocess(const FGLTextureRect& inputImage)
 	m_distanceTransform.calculateDt(m_texBuffer[0]);
 }
 
+void FPoseDetector::preprocess(const quint8* pImage, FDTPixelPacked* pResult,
+	FDetectorStatistics* pStats /* = NULL */)
+{
+	FStopWatch stopWatch;
+	stopWatch.start();
+
+	m_workerPool.setWorkerCount(m_workerCount);
+	m_distanceTransformCPU.calculateCannyDt(pImage, pResult);
+
+	if (pStats)
+		pStats->timePreprocessing = stopWatch.stop();
+}
+
+void FPoseDetector::startPreprocessingReadback()
+{
+	m_distanceTransform.readResult(m_dtReadback);
+}
+
+bool FPoseDetector::finishPreprocessingReadback(FDTPixelPacked* pData)
+{
+	return m_dtReadback.finish(pData);
+}
+
 void FPoseDetector::detect(const FGLTextureRect& inputImage, FDetectorStatistics* pStats /* = NULL */)
 {
 	if (!m_pClassifierData)
@@ -76,7 +104,7 @@ void FPoseDetector::detect(const FGLTextureRect& inputImage, FDetectorStatistics
 
 	_runCanny(inputImage);
 	m_distanceTransform.calculateDt(m_texBuffer[0]);
-	m_contourFinder.findContours(m_distanceTransform.result());
+	m_contourFinder.findContours(m_distanceTransform);
 	
 	if (m_pStatistics)
 	{
@@ -98,7 +126,7 @@ void FPoseDetector::detect(const FGLTextureRect& inputImage, FDetectorStatistics
 	F_GLERROR_ASSERT;
 }
 
-void FPoseDetector::detect(FDTPixel* pDTImage, FDetectorStatistics* pStats /* = NULL */)
+void FPoseDetector::detect(FDTPixelPacked* pDTImage, FDetectorStatistics* pStats /* = NULL */)
 {
 	if (!m_pClassifierData)
 		return;
@@ -130,7 +158,7 @@ void FPoseDetector::detectVerify(const FGLTextureRect& contourImage)
 
 	glViewport(0, 0, m_frameSize.width(), m_frameSize.height());
 	m_distanceTransform.calculateDt(contourImage);
-	m_contourFinder.findContours(m_distanceTransform.result());
+	m_contourFinder.findContours(m_distanceTransform);
 	_matchContours();
 
 	FGLFramebuffer::bindDefault();
@@ -151,6 +179,10 @@ bool FPoseDetector::reset(const QSize& frameSize)
 		return false;
 	if (!m_distanceTransform.reset(m_frameSize))
 		return false;
+	if (!m_distanceTransformCPU.reset(m_frameSize))
+		return false;
+	if (!m_dtReadback.create(m_frameSize.width() * m_frameSize.height() * sizeof(FDTPixelPacked)))
+		return false;
 	if (!m_contourFinder.reset(m_frameSize))
 		return false;
 
@@ -170,23 +202,25 @@ bool FPoseDetector::reset(const QSize& frameSize)
 
 bool FPoseDetector::loadClassifierData(const QString& dataFilePath)
 {
-	QFile file(dataFilePath);
-	if (!file.open(QIODevice::ReadOnly))
+	FStopWatch stopWatch;
+	stopWatch.start();
+
+	FContourDatabase* pDatabase = new FContourDatabase();
+	if (!pDatabase->load(dataFilePath))
 	{
-		fWarning("Pose Detector", QString("Failed to open classifier data file: %1").arg(dataFilePath));
+		fWarning("Pose Detector", QString("Failed to load classifier data file: %1").arg(dataFilePath));
+		F_SAFE_DELETE(pDatabase);
 		return false;
 	}
 
-	FArchive ar(&file, false);
-
 	if (m_ownDatabase)
 		F_SAFE_DELETE(m_pClassifierData);
 
 	m_ownDatabase = true;
-	m_pClassifierData = new FContourDatabase();
-	m_pClassifierData->serialize(ar);
+	m_pClassifierData = pDatabase;
 
-	fInfo("Pose Detector", QString("Classifier data loaded: %1").arg(dataFilePath));
+	fInfo("Pose Detector", QString("Classifier data loaded: %1 (%2, %3 ms)").arg(dataFilePath)
+		.arg(pDatabase->isMapped() ? "mapped" : "legacy format").arg(stopWatch.stop() * 1000.0, 0, 'f', 1));
 
 	_initializeDatabase();
 	return true;
@@ -208,7 +242,7 @@ void FPoseDetector::setClassifierData(FContourDatabase* pDatabase)
 
 // Public queries -------------------------------------------------------------------------------------
 
-void FPoseDetector::getPreprocessingResult(FDTPixel* pData)
+void FPoseDetector::getPreprocessingResult(FDTPixelPacked* pData)
 {
 	m_distanceTransform.getResult(pData);
 }
@@ -299,6 +333,16 @@ void FPoseDetector::drawDetectedPose()
 	*/
 }
 
+// Overrides ------------------------------------------------------------------------------------------
+
+void FPoseDetector::runTask(size_t taskIndex, size_t workerIndex)
+{
+	if (m_matchPass == WarpPass)
+		_warpContour(taskIndex);
+	else
+		_matchContour(taskIndex);
+}
+
 // Internal functions ---------------------------------------------------------------------------------
 
 void FPoseDetector::_initializeDatabase()
@@ -391,16 +435,47 @@ void FPoseDetector::_matchContours()
 	for (size_t i = 0; i < typeCount; i++)
 		m_contour[i].clear();
 
-	// iterate over all detected contours, assign matches to contour types
-	for (quint32 i = 0; i < m_contourFinder.contourCount(); i++)
-	{
-		const FContour* pContour = m_contourFinder.contourAt(i);
-		F_ASSERT(pContour->isNormalized());
-		_matchContour(pContour, i);
-	}
+	// warp and fit all detected contours in parallel, each task writes to its own result slot;
+	// the patches are classified in between as a single batch
+	m_workerPool.setWorkerCount(m_workerCount);
+	size_t contourCount = m_contourFinder.contourCount();
+
+	FStopWatch matchWatch;
+	matchWatch.start();
+	m_matchPass = WarpPass;
+	m_workerPool.run(this, contourCount);
+
+	FStopWatch classifyWatch;
+	classifyWatch.start();
+	const FContourPatch* patches[FGlobalConstants::MAX_CONTOUR_CANDIDATES];
+	for (size_t i = 0; i < contourCount; i++)
+		patches[i] = &m_patch[i];
+	m_pClassifierData->getBestClassCandidates(patches, contourCount, MAX_CLASS_CANDIDATES, m_classScores);
+	double classificationTime = classifyWatch.stop();
+
+	m_matchPass = FitPass;
+	m_workerPool.run(this, contourCount);
+	double matchTime = matchWatch.stop();
+
+	// assign matches to contour types in candidate order, independent of the task schedule
+	for (size_t i = 0; i < contourCount; i++)
+		_mergeMatchResult(i);
 
 	if (m_pStatistics)
 	{
+		m_pStatistics->numContours = (int)contourCount;
+		m_pStatistics->numWorkers = (int)m_workerPool.workerCount();
+		m_pStatistics->timeContourMatching = matchTime;
+		m_pStatistics->timePatchWarp = 0.0;
+		m_pStatistics->timeClassification = classificationTime;
+		m_pStatistics->timeHomographyFit = 0.0;
+
+		for (size_t i = 0; i < contourCount; i++)
+		{
+			m_pStatistics->timePatchWarp += m_matchResult[i].timePatchWarp;
+			m_pStatistics->timeHomographyFit += m_matchResult[i].timeHomographyFit;
+		}
+
 		m_pStatistics->timeContourAlignment = m_stopWatch.stop();
 		m_stopWatch.reset();
 		m_stopWatch.start();
@@ -585,9 +660,10 @@ void FPoseDetector::_matchContours()
 	float params[] = { 0.0f, 0.0f, 0.0f };
 	float lmInfo[LM_INFO_SZ];
 	float opts[] = { 1e-3, 1e-6, 1e-6, 1e-6, 1e-6 }; // tau, eps1, eps2, eps3, delta
+	FLevmarWorkspace workspace(LM_DIF_WORKSZ(1, numData), sizeof(float));
 
 	int iter = slevmar_dif(sLevmarUpdate, params, NULL, 1, numData, 50,
-		NULL, lmInfo, NULL, NULL, (void*)this, 0, 0.0f);
+		NULL, lmInfo, workspace.floatData(), NULL, (void*)this, 0, 0.0f);
 
 	contourInfo_t& info = m_contour[bestFA_id];
 	info.alignAngle = params[0];
@@ -611,57 +687,82 @@ void FPoseDetector::_matchContours()
 	*/
 }
 
-void FPoseDetector::_matchContour(const FContour* pContour, size_t candidateIndex)
+void FPoseDetector::_warpContour(size_t candidateIndex)
 {
-	F_ASSERT(m_pClassifierData);
-	F_CONSOLE("\nCONTOUR MATCHING, CANDIDATE NO. " << candidateIndex);
+	// runs in a worker thread: read shared data only, write to the candidate's own slots
+	F_ASSERT(candidateIndex < FGlobalConstants::MAX_CONTOUR_CANDIDATES);
+
+	const FContour* pContour = m_contourFinder.contourAt(candidateIndex);
+	F_ASSERT(pContour->isNormalized());
+
+	matchResult_t& result = m_matchResult[candidateIndex];
+	result.pContour = pContour;
+	result.pClass = NULL;
+	result.meanSquareError = FLT_MAX;
+
+	FStopWatch stopWatch;
+	stopWatch.start();
 
 	// create a patch for the contour
-	m_patch[candidateIndex].warpImage(m_contourFinder.dtImage(), m_frameSize.width(),
-		m_frameSize.height(), pContour);
+	FContourPatch& patch = m_patch[candidateIndex];
+	patch.warpImage(m_contourFinder.dtImage(), m_frameSize.width(), m_frameSize.height(), pContour);
+
+	result.timePatchWarp = stopWatch.stop();
+}
+
+void FPoseDetector::_matchContour(size_t candidateIndex)
+{
+	// runs in a worker thread: read shared data only, write to the candidate's own slots
+	F_ASSERT(candidateIndex < FGlobalConstants::MAX_CONTOUR_CANDIDATES);
 
-	FContourClass* classList[MAX_CLASS_CANDIDATES];
-	FMatrix3f homography[MAX_CLASS_CANDIDATES];
-	float bestMSE = FLT_MAX;
-	int bestIndex = -1;
+	matchResult_t& result = m_matchResult[candidateIndex];
+	const FContour* pContour = result.pContour;
 
-	// get the 3 best candidates using the descriptor from the normalized patch
-	m_pClassifierData->getBestClassCandidates(m_patch[candidateIndex], classList);
+	FStopWatch stopWatch;
+	stopWatch.start();
 
-	// try to align to each of the candidate templates
+	// try to align to each of the best candidates found by the classification
+	const FContourDatabase::classScore_t* pScores = &m_classScores[candidateIndex * MAX_CLASS_CANDIDATES];
 	for (int i = 0; i < MAX_CLASS_CANDIDATES; i++)
 	{
-		if (classList[i])
+		FContourClass* pClass = pScores[i].pClass;
+		if (pClass)
 		{
 			float info[3];
-			classList[i]->matchContour(pContour, homography[i], info);
+			FMatrix3f homography;
+			pClass->matchContour(pContour, homography, info);
 			float mse = (info[2] < 0.25f) ? 1000.0f : info[0];
-			
-			F_CONSOLE("Match candidate " << i << "(template #"
-				<< classList[i]->templateIndex() <<"): MSE = " << info[0] << " -> "
-				<< (mse < m_warpErrorThreshold ? "ACCEPT" : "reject"));
 
-			if (mse < bestMSE)
+			if (mse < result.meanSquareError)
 			{
-				bestMSE = mse;
-				bestIndex = i;
+				result.pClass = pClass;
+				result.homography = homography;
+				result.meanSquareError = mse;
 			}
 		}
 	}
 
-	if (bestMSE < m_warpErrorThreshold)
+	result.timeHomographyFit = stopWatch.stop();
+}
+
+void FPoseDetector::_mergeMatchResult(size_t candidateIndex)
+{
+	const matchResult_t& result = m_matchResult[candidateIndex];
+
+	if (result.pClass && result.meanSquareError < m_warpErrorThreshold)
 	{
-		F_CONSOLE("Best candidate: "<< bestIndex << ", MSE: " << bestMSE);
+		size_t typeId = result.pClass->templateIndex();
+		F_CONSOLE("\nCONTOUR MATCHING, CANDIDATE NO. " << candidateIndex
+			<< " - template #" << typeId << ", MSE: " << result.meanSquareError);
 
-		size_t typeId = classList[bestIndex]->templateIndex();
 		contourInfo_t& info = m_contour[typeId];
-		if (info.pClass == NULL || bestMSE < info.meanSquareError)
+		if (info.pClass == NULL || result.meanSquareError < info.meanSquareError)
 		{
 			info.pPatch = &m_patch[candidateIndex];
-			info.pContour = pContour;
-			info.pClass = classList[bestIndex];
-			info.homography = homography[bestIndex];
-			info.meanSquareError = bestMSE;
+			info.pContour = result.pContour;
+			info.pClass = result.pClass;
+			info.homography = result.homography;
+			info.meanSquareError = result.meanSquareError;
 		}
 	}
 }
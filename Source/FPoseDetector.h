@@ -15,15 +15,18 @@
 #include "FlowGL.h"
 #include "FStopWatch.h"
 #include "FDistanceTransform.h"
+#include "FDistanceTransformCPU.h"
+#include "FAsyncReadback.h"
 #include "FContourFinder.h"
 #include "FContourDatabase.h"
 #include "FFrameStatistics.h"
+#include "FWorkerPool.h"
 
 // ----------------------------------------------------------------------------------------------------
 //  Class FPoseDetector
 // ----------------------------------------------------------------------------------------------------
 
-class FPoseDetector
+class FPoseDetector : private FWorkerTask
 {
 	//  Static callbacks -------------------------------------------------------
 
@@ -65,6 +68,25 @@ private:
 		float alignAngle;
 	};
 
+	/// Result of matching a single contour candidate, written by the worker threads.
+	struct matchResult_t
+	{
+		const FContour* pContour;
+		FContourClass* pClass;
+		FMatrix3f homography;
+		float meanSquareError;
+
+		double timePatchWarp;
+		double timeHomographyFit;
+	};
+
+	/// Work done by the worker pool while matching contour candidates.
+	enum matchPass_t
+	{
+		WarpPass,
+		FitPass
+	};
+
 	// sort predicates
 	static bool contourInfoSortByAmbiguity(contourInfo_t* pInfo1, contourInfo_t* pInfo2) {
 		return pInfo1->pClass->poseAmbiguity() < pInfo2->pClass->poseAmbiguity();
@@ -86,13 +108,22 @@ public:
 	/// Pre-processes the given image on the GPU, i.e. runs canny edge
 	/// detection and distance transform.
 	void preprocess(const FGLTextureRect& inputImage);
+	/// Pre-processes the given RGBA image with 8 bits per channel on the CPU and writes
+	/// the distance transform to the given array. Uses the contour matching workers.
+	void preprocess(const quint8* pImage, OUT FDTPixelPacked* pResult, FDetectorStatistics* pStats = NULL);
+
+	/// Starts reading back the result of the GPU preprocessing step asynchronously.
+	void startPreprocessingReadback();
+	/// Waits for the readback issued by startPreprocessingReadback() and copies the
+	/// result to the given array. Returns false if no readback is pending.
+	bool finishPreprocessingReadback(FDTPixelPacked* pData);
 
 	/// Detects the existence and pose of the current model in the given image.
 	/// Returns true if the detection was successful.
 	void detect(const FGLTextureRect& inputImage, FDetectorStatistics* pStats = NULL);
 
 	/// Detector start for multi threaded application. Expects a precalculated DT map.
-	void detect(FDTPixel* pDTImage, FDetectorStatistics* pStats = NULL);
+	void detect(FDTPixelPacked* pDTImage, FDetectorStatistics* pStats = NULL);
 
 	/// Detector start for verification of the training database. Expects
 	/// a texture with a contour drawing.
@@ -101,17 +132,27 @@ public:
 	/// Resets the pose detector and sets the frame size of the internal pipeline.
 	bool reset(const QSize& frameSize);
 
-	/// Loads classifier data for pose detection.
+	/// Loads classifier data for pose detection. Databases in the mapped format are used
+	/// directly from the file, databases in the legacy format are imported.
 	bool loadClassifierData(const QString& dataFilePath);
 	/// Uses the classifier data from the given database.
 	void setClassifierData(FContourDatabase* pDatabase);
 
 	//  PARAMETER
 
-	void setEdgeThresholdLow(float val) { m_edgeThresholdLow = val; }
-	void setEdgeThresholdHigh(float val) { m_edgeThresholdHigh = val; }
+	void setEdgeThresholdLow(float val) {
+		m_edgeThresholdLow = val;
+		m_distanceTransformCPU.setEdgeThresholdLow(val);
+	}
+	void setEdgeThresholdHigh(float val) {
+		m_edgeThresholdHigh = val;
+		m_distanceTransformCPU.setEdgeThresholdHigh(val);
+	}
 	void setMSEThreshold(float val) { m_warpErrorThreshold = val; }
 	void setFixedTypeId(int val) { m_fixedTypeId = val; }
+	/// Sets the number of threads used for contour matching, 0 uses all cores.
+	/// The change takes effect with the next detection run.
+	void setWorkerCount(size_t count) { m_workerCount = count; }
 
 	void setContourPosition(const FVector3f& pos) {
 		m_contourPosition = pos;
@@ -132,7 +173,11 @@ public:
 	bool isValid() const { return m_isValid; }
 
 	/// Copies the result of the preprocessing step to the given array.
-	void getPreprocessingResult(FDTPixel* pData);
+	void getPreprocessingResult(FDTPixelPacked* pData);
+	/// Returns true if an asynchronous readback of the preprocessing result is pending.
+	bool isPreprocessingReadbackPending() const { return m_dtReadback.pendingCount() > 0; }
+	/// Returns the time in seconds spent waiting for the last preprocessing readback.
+	double readbackStallTime() const { return m_dtReadback.lastStallTime(); }
 
 	//  RESULTS FROM INTERMEDIATE PROCESSING STEPS
 
@@ -166,13 +211,21 @@ public:
 	float poseFittingError(size_t index) { return m_detectedPoseInfo[index]->meanSquareError; }
 	float poseReconstructionAngle(size_t index) { return m_detectedPoseInfo[index]->reconstructionAngle; }
 
+	//  Overrides --------------------------------------------------------------
+
+private:
+	/// Warps or matches contour candidate taskIndex, called by the worker pool.
+	virtual void runTask(size_t taskIndex, size_t workerIndex);
+
 	//  Internal functions -----------------------------------------------------
 
 private:
 	void _initializeDatabase();
 	void _runCanny(const FGLTextureRect& inputImage);
 	void _matchContours();
-	void _matchContour(const FContour* pContour, size_t candidateIndex);
+	void _warpContour(size_t candidateIndex);
+	void _matchContour(size_t candidateIndex);
+	void _mergeMatchResult(size_t candidateIndex);
 	float _reconstructPose(contourInfo_t& contour);
 	void _levmarUpdate(float* p, float* hx, int m, int n);
 	void _decomposeHomography(const FMatrix3f& homography, FMatrix3f& rotation, FVector3f& translation);
@@ -195,6 +248,8 @@ private:
 	QSize m_slotSize;
 
 	FDistanceTransform m_distanceTransform;
+	FDistanceTransformCPU m_distanceTransformCPU;
+	FAsyncReadback m_dtReadback;
 	FContourFinder m_contourFinder;
 	FContourDatabase* m_pClassifierData;
 	FCameraMetrics m_cameraMetrics;
@@ -203,6 +258,13 @@ private:
 	FDetectorStatistics* m_pStatistics;
 	FStopWatch m_stopWatch;
 
+	// Contour matching
+	FWorkerPool m_workerPool;
+	size_t m_workerCount;
+	matchPass_t m_matchPass;
+	matchResult_t m_matchResult[FGlobalConstants::MAX_CONTOUR_CANDIDATES];
+	FContourDatabase::classScore_t m_classScores[FGlobalConstants::MAX_CONTOUR_CANDIDATES * MAX_CLASS_CANDIDATES];
+
 	// Temporary
 	FContourPatch m_patch[FGlobalConstants::MAX_CONTOUR_CANDIDATES];
 	contourInfo_t m_contour[FGlobalConstants::MAX_TEMPLATES];
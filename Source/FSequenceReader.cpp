@@ -0,0 +1,237 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FSequenceReader.cpp
+//  Description		Implementation of class FSequenceReader
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-10-04 17:52:08 +0200 (Di, 04 Okt 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#include "FTrackMeStable.h"
+
+#include <QThread>
+#include "FStopWatch.h"
+
+#include "FSequenceReader.h"
+#include "FMemoryTracer.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FSequenceReader::FDecoder
+// ----------------------------------------------------------------------------------------------------
+
+class FSequenceReader::FDecoder : public QThread
+{
+public:
+	FDecoder(FSequenceReader* pReader) : m_pReader(pReader) { }
+
+protected:
+	virtual void run() { m_pReader->_decoderLoop(); }
+
+private:
+	FSequenceReader* m_pReader;
+};
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FSequenceReader
+// ----------------------------------------------------------------------------------------------------
+
+// Constructors and destructor ------------------------------------------------------------------------
+
+FSequenceReader::FSequenceReader()
+: m_firstFrame(0),
+  m_nextFrame(0),
+  m_generation(0),
+  m_wantExit(false)
+{
+}
+
+FSequenceReader::~FSequenceReader()
+{
+	close();
+}
+
+// Public commands ------------------------------------------------------------------------------------
+
+void FSequenceReader::open(const QStringList& filePaths, size_t ringSize /* = 8 */,
+						   size_t decoderCount /* = 0 */)
+{
+	close();
+
+	// leave a core to the processing thread
+	if (decoderCount == 0)
+		decoderCount = (size_t)fMinMax(QThread::idealThreadCount() - 1, 1, 4);
+
+	m_filePaths = filePaths;
+	m_slots.assign(fMax(ringSize, (size_t)1), slot_t());
+	m_firstFrame = 0;
+	m_nextFrame = 0;
+	m_wantExit = false;
+
+	for (size_t i = 0; i < decoderCount; i++)
+	{
+		FDecoder* pDecoder = new FDecoder(this);
+		m_decoders.push_back(pDecoder);
+		pDecoder->start();
+	}
+}
+
+void FSequenceReader::close()
+{
+	if (!m_decoders.empty())
+	{
+		m_lock.lock();
+		m_wantExit = true;
+		m_workAvailable.wakeAll();
+		m_lock.unlock();
+
+		for (size_t i = 0; i < m_decoders.size(); i++)
+		{
+			m_decoders[i]->wait(ULONG_MAX);
+			delete m_decoders[i];
+		}
+
+		m_decoders.clear();
+	}
+
+	m_filePaths.clear();
+	m_slots.clear();
+}
+
+bool FSequenceReader::read(size_t index, QImage& image, FSourceStatistics* pStats /* = NULL */)
+{
+	F_ASSERT(isOpen() && index < frameCount());
+
+	FStopWatch stopWatch;
+	stopWatch.start();
+
+	m_lock.lock();
+	size_t ringSize = m_slots.size();
+
+	if (index < m_firstFrame || index >= m_firstFrame + ringSize)
+	{
+		// seek, the frames in flight belong to the previous generation and are discarded
+		m_generation++;
+		for (size_t i = 0; i < ringSize; i++)
+		{
+			m_slots[i].state = Empty;
+			m_slots[i].image = QImage();
+		}
+
+		m_nextFrame = index;
+	}
+	else
+	{
+		// release the frames skipped since the last read
+		for (size_t f = m_firstFrame; f < index; f++)
+		{
+			slot_t& slot = _slot(f);
+			if (slot.frame == f && slot.generation == m_generation)
+			{
+				slot.state = Empty;
+				slot.image = QImage();
+			}
+		}
+
+		m_nextFrame = fMax(m_nextFrame, index);
+	}
+
+	m_firstFrame = index;
+	m_workAvailable.wakeAll();
+
+	slot_t& slot = _slot(index);
+	while (!_isDone(slot, index))
+		m_frameReady.wait(&m_lock);
+
+	image = slot.image;
+	bool result = (slot.state == Ready);
+
+	if (pStats)
+	{
+		pStats->timeDecode = slot.decodeTime;
+		pStats->queueDepth = 0;
+		for (size_t f = index + 1; f < index + ringSize; f++)
+			if (_isDone(_slot(f), f))
+				pStats->queueDepth++;
+	}
+
+	m_lock.unlock();
+
+	if (pStats)
+		pStats->stallRead = stopWatch.stop();
+
+	return result;
+}
+
+// Public queries -------------------------------------------------------------------------------------
+
+bool FSequenceReader::decode(const QString& filePath, QImage& image)
+{
+	image.load(filePath);
+	if (image.isNull())
+		return false;
+
+	if (image.format() != QImage::Format_ARGB32)
+		image = image.convertToFormat(QImage::Format_ARGB32);
+
+	return !image.isNull();
+}
+
+// Internal functions ---------------------------------------------------------------------------------
+
+void FSequenceReader::_decoderLoop()
+{
+	m_lock.lock();
+
+	while (true)
+	{
+		while (!m_wantExit && !_hasPendingFrame())
+			m_workAvailable.wait(&m_lock);
+
+		if (m_wantExit)
+			break;
+
+		// claim the next frame, the slot can only be reused for a frame beyond the ring
+		size_t frame = m_nextFrame++;
+		quint32 generation = m_generation;
+		QString filePath = m_filePaths[(int)frame];
+
+		slot_t& slot = _slot(frame);
+		slot.frame = frame;
+		slot.generation = generation;
+		slot.state = Decoding;
+		slot.image = QImage();
+		m_lock.unlock();
+
+		FStopWatch stopWatch;
+		stopWatch.start();
+		QImage image;
+		bool result = decode(filePath, image);
+		double decodeTime = stopWatch.stop();
+
+		m_lock.lock();
+
+		// the reader may have moved on while decoding
+		if (slot.frame == frame && slot.generation == generation)
+		{
+			slot.state = result ? Ready : Failed;
+			slot.image = image;
+			slot.decodeTime = decodeTime;
+			m_frameReady.wakeAll();
+		}
+	}
+
+	m_lock.unlock();
+}
+
+bool FSequenceReader::_hasPendingFrame() const
+{
+	return m_nextFrame < m_firstFrame + m_slots.size() && m_nextFrame < frameCount();
+}
+
+bool FSequenceReader::_isDone(const slot_t& slot, size_t frame) const
+{
+	return slot.frame == frame && slot.generation == m_generation
+		&& (slot.state == Ready || slot.state == Failed);
+}
+
+// ----------------------------------------------------------------------------------------------------
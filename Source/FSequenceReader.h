@@ -0,0 +1,122 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FSequenceReader.h
+//  Description		Header file for FSequenceReader.cpp
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-10-04 17:52:08 +0200 (Di, 04 Okt 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#ifndef FSEQUENCEREADER_H
+#define FSEQUENCEREADER_H
+
+#include <vector>
+#include <QImage>
+#include <QStringList>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include "FTrackMe.h"
+#include "FFrameStatistics.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FSequenceReader
+// ----------------------------------------------------------------------------------------------------
+
+/// Reads a sequence of image files ahead of the current frame. A small pool of decoder threads
+/// loads the frames following the last one read into a ring of decoded images, until the ring
+/// is full. Reading a frame within the ring advances it, reading any other frame restarts the
+/// decoding at that frame. Frames still being decoded for the old position are discarded.
+/// The images are converted to QImage::Format_ARGB32.
+class FSequenceReader
+{
+	//  Constructors and destructor --------------------------------------------
+
+public:
+	/// Default Constructor.
+	FSequenceReader();
+	/// Virtual destructor. Stops the decoder threads.
+	virtual ~FSequenceReader();
+
+private:
+	FSequenceReader(const FSequenceReader& other);
+	FSequenceReader& operator=(const FSequenceReader& other);
+
+	//  Public commands --------------------------------------------------------
+
+public:
+	/// Starts reading the given files, starting with the first one. The ring holds the given
+	/// number of frames. A decoder count of 0 chooses the count based on the processor cores.
+	void open(const QStringList& filePaths, size_t ringSize = 8, size_t decoderCount = 0);
+	/// Stops the decoder threads and releases all frames.
+	void close();
+
+	/// Returns the frame with the given index, blocks until the frame is decoded.
+	/// Returns false if the file could not be read. The statistics are written to pStats, if given.
+	bool read(size_t index, OUT QImage& image, OUT FSourceStatistics* pStats = NULL);
+
+	//  Public queries ---------------------------------------------------------
+
+public:
+	/// Returns true if a sequence is open.
+	bool isOpen() const { return !m_decoders.empty(); }
+	/// Returns the number of frames in the sequence.
+	size_t frameCount() const { return (size_t)m_filePaths.size(); }
+	/// Returns the number of frames held in the ring.
+	size_t ringSize() const { return m_slots.size(); }
+
+	/// Loads the given image file and converts it to QImage::Format_ARGB32.
+	static bool decode(const QString& filePath, OUT QImage& image);
+
+	//  Internal types ---------------------------------------------------------
+
+private:
+	class FDecoder;
+
+	enum slotState_t
+	{
+		Empty,
+		Decoding,
+		Ready,
+		Failed
+	};
+
+	struct slot_t
+	{
+		slot_t() : frame(0), generation(0), state(Empty), decodeTime(0.0) { }
+
+		size_t frame;
+		quint32 generation;
+		slotState_t state;
+		QImage image;
+		double decodeTime;
+	};
+
+	//  Internal functions -----------------------------------------------------
+
+private:
+	void _decoderLoop();
+	bool _hasPendingFrame() const;
+	bool _isDone(const slot_t& slot, size_t frame) const;
+	slot_t& _slot(size_t frame) { return m_slots[frame % m_slots.size()]; }
+
+	//  Internal data members --------------------------------------------------
+
+private:
+	QStringList m_filePaths;
+	std::vector<slot_t> m_slots;
+	std::vector<FDecoder*> m_decoders;
+
+	QMutex m_lock;
+	QWaitCondition m_workAvailable;
+	QWaitCondition m_frameReady;
+
+	size_t m_firstFrame;
+	size_t m_nextFrame;
+	quint32 m_generation;
+	bool m_wantExit;
+};
+
+// ----------------------------------------------------------------------------------------------------
+
+#endif // FSEQUENCEREADER_H
@@ -37,7 +37,7 @@ FStatisticsView::FStatisticsView(QWidget* pParent, Qt::WindowFlags flags)
 
 	m_statList.resize(HISTORY_SIZE);
 
-	for (int i = 0; i < 7; i++)
+	for (int i = 0; i < 8; i++)
 		m_timeSum[i] = 0.0;
 }
 
@@ -104,6 +104,7 @@ void FStatisticsView::updateStatistics(FFrameStatistics stats)
 	m_timeSum[4] -= m_statList[m_listIndex].detector.timeContourNormalization * 1000.0;
 	m_timeSum[5] -= m_statList[m_listIndex].detector.timeContourAlignment * 1000.0;
 	m_timeSum[6] -= m_statList[m_listIndex].detector.timePoseReconstruction * 1000.0;
+	m_timeSum[7] -= m_statList[m_listIndex].tracker.timeOptimizationRef * 1000.0;
 
 	m_statList[m_listIndex] = stats;
 
@@ -114,6 +115,7 @@ void FStatisticsView::updateStatistics(FFrameStatistics stats)
 	m_timeSum[4] += m_statList[m_listIndex].detector.timeContourNormalization * 1000.0;
 	m_timeSum[5] += m_statList[m_listIndex].detector.timeContourAlignment * 1000.0;
 	m_timeSum[6] += m_statList[m_listIndex].detector.timePoseReconstruction * 1000.0;
+	m_timeSum[7] += m_statList[m_listIndex].tracker.timeOptimizationRef * 1000.0;
 
 	update();
 }
@@ -175,7 +177,45 @@ void FStatisticsView::_writeLog(const FFrameStatistics& stats)
 		stream << stats.tracker.variance[i] << tab;
 	}
 
-	stream << maxVar;
+	stream << maxVar << tab;
+
+	// optimization time, reference time of alternative Jacobian method (if benchmark is enabled)
+	stream << (stats.tracker.timeOptimizationA + stats.tracker.timeOptimizationB) * 1000.0 << tab;
+	stream << stats.tracker.timeOptimizationRef * 1000.0 << tab;
+
+	// contour matching: wall time, summed stage times, candidates and workers
+	stream << stats.detector.timeContourMatching * 1000.0 << tab;
+	stream << stats.detector.timePatchWarp * 1000.0 << tab;
+	stream << stats.detector.timeClassification * 1000.0 << tab;
+	stream << stats.detector.timeHomographyFit * 1000.0 << tab;
+	stream << stats.detector.numContours << tab << stats.detector.numWorkers << tab;
+
+	// preprocessing time (CPU backend only)
+	stream << stats.detector.timePreprocessing * 1000.0 << tab;
+
+	// readback stall times
+	stream << stats.readback.stallSearchResult * 1000.0 << tab;
+	stream << stats.readback.stallDistanceTransform * 1000.0 << tab;
+	stream << stats.readback.stallPlayout * 1000.0 << tab;
+
+	// image sequence decoding: decode time, read stall, frames decoded ahead
+	stream << stats.source.timeDecode * 1000.0 << tab;
+	stream << stats.source.stallRead * 1000.0 << tab;
+	stream << stats.source.queueDepth << tab;
+
+	// playout frame counts
+	stream << stats.playout.framesWritten << tab;
+	stream << stats.playout.framesDropped << tab;
+	stream << stats.playout.framesPending << tab;
+
+	// pipeline stage times and occupancy, latency, queue depth and frames dropped
+	for (size_t i = 0; i < FPipelineStatistics::NumStages; i++)
+		stream << stats.pipeline.time[i] * 1000.0 << tab << stats.pipeline.occupancy[i] << tab;
+
+	stream << stats.pipeline.latency * 1000.0 << tab;
+	stream << stats.pipeline.frameInterval * 1000.0 << tab;
+	stream << stats.pipeline.queueDepth << tab;
+	stream << stats.pipeline.framesDropped;
 
 	// endline
 	stream << endl;
@@ -231,14 +271,15 @@ void FStatisticsView::_paintFramework(QPainter& painter)
 	painter.drawText(_headerText(8.0), "Parameter Value          Variance");
 
 
-	QString timeText = QString("Calculation Time [milliseconds] - Search: %1  |  Opt A: %2  |  Opt B: %3   ---   Extr: %4  |  Norm: %5  |  Fit: %6  |  Pose: %7")
+	QString timeText = QString("Calculation Time [milliseconds] - Search: %1  |  Opt A: %2  |  Opt B: %3  |  Ref: %8   ---   Extr: %4  |  Norm: %5  |  Fit: %6  |  Pose: %7")
 		.arg(m_timeSum[0] / HISTORY_SIZE, 0, 'f', 1)
 		.arg(m_timeSum[1] / HISTORY_SIZE, 0, 'f', 1)
 		.arg(m_timeSum[2] / HISTORY_SIZE, 0, 'f', 1)
 		.arg(m_timeSum[3] / HISTORY_SIZE, 0, 'f', 1)
 		.arg(m_timeSum[4] / HISTORY_SIZE, 0, 'f', 1)
 		.arg(m_timeSum[5] / HISTORY_SIZE, 0, 'f', 1)
-		.arg(m_timeSum[6] / HISTORY_SIZE, 0, 'f', 1);
+		.arg(m_timeSum[6] / HISTORY_SIZE, 0, 'f', 1)
+		.arg(m_timeSum[7] / HISTORY_SIZE, 0, 'f', 1);
 	painter.drawText(_contentText(5.0), timeText);
 
 	painter.setPen(QColor(200, 200, 200));
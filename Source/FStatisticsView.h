@@ -86,7 +86,7 @@ private:
 	size_t m_listIndex;
 	std::vector<FFrameStatistics> m_statList;
 
-	double m_timeSum[7];
+	double m_timeSum[8];
 
 	// log file
 	QString m_logFilePath;
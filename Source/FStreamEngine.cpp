@@ -8,7 +8,6 @@
 // ----------------------------------------------------------------------------------------------------
 
 #include "FTrackMeStable.h"
-#include "levmar.h"
 #include "FDetectorThread.h"
 
 #include "FStreamEngine.h"
@@ -26,18 +25,15 @@ FStreamEngine::FStreamEngine(QObject* pParent /* = NULL */)
   m_pPoseDetector(NULL),
   m_pDetectorThread(NULL),
   m_pDTBuffer(NULL),
+  m_pImageBuffer(NULL),
   m_detectionEnabled(true),
+  m_cpuPreprocessing(false),
   m_detectionAlwaysOn(false),
   m_wantRedraw(false),
   m_frameSize(0, 0),
   m_frameIndex(0),
   m_undistFactor(0.0f, 0.0f)
 {
-	// TODO: Dirty hack!
-	FGlobalConstants::pLevmarDetectionWorkspace = new float[LM_DER_WORKSZ(8, 4096)];
-	FGlobalConstants::pLevmarTrackingWorkspace = new double[LM_DIF_WORKSZ(7, 4096)];
-
-
 	m_pLineTracker = new FLineTracker();
 	m_pLineTracker->setCamera(&m_camera);
 	m_pPoseDetector = new FPoseDetector();
@@ -59,12 +55,9 @@ FStreamEngine::~FStreamEngine()
 	m_pDetectorThread->stop();
 	F_SAFE_DELETE(m_pDetectorThread);
 	F_SAFE_DELETE_ARRAY(m_pDTBuffer);
+	F_SAFE_DELETE_ARRAY(m_pImageBuffer);
 	F_SAFE_DELETE(m_pLineTracker);
 	F_SAFE_DELETE(m_pPoseDetector);
-
-	// TODO: Dirty hack!
-	F_SAFE_DELETE_ARRAY(FGlobalConstants::pLevmarDetectionWorkspace);
-	F_SAFE_DELETE_ARRAY(FGlobalConstants::pLevmarTrackingWorkspace);
 }
 
 // Public commands ------------------------------------------------------------------------------------
@@ -79,7 +72,9 @@ void FStreamEngine::reset(const QSize& frameSize)
 	m_pPoseDetector->reset(frameSize);
 
 	F_SAFE_DELETE_ARRAY(m_pDTBuffer);
-	m_pDTBuffer = new FDTPixel[frameSize.width() * frameSize.height()];	
+	m_pDTBuffer = new FDTPixelPacked[frameSize.width() * frameSize.height()];	
+	F_SAFE_DELETE_ARRAY(m_pImageBuffer);
+	m_pImageBuffer = new quint8[frameSize.width() * frameSize.height() * 4];
 
 	_resetGL();
 
@@ -89,13 +84,23 @@ void FStreamEngine::reset(const QSize& frameSize)
 
 void FStreamEngine::processFrame(const FGLTextureRect& inputFrame, FFrameStatistics* pStats /* = NULL */)
 {
-	m_inputFrame = inputFrame;
+	preprocessFrame(inputFrame);
+	trackFrame(pStats);
+}
 
-	size_t prevIndex = m_frameIndex;
+void FStreamEngine::preprocessFrame(const FGLTextureRect& inputFrame)
+{
+	m_inputFrame = inputFrame;
 	m_frameIndex = (m_frameIndex + 1) % FRAME_BUFFER_SIZE;
 
 	_radialUndistort();
 	glFlush();
+}
+
+void FStreamEngine::trackFrame(FFrameStatistics* pStats /* = NULL */)
+{
+	const FGLTextureRect& inputFrame = m_inputFrame;
+	size_t prevIndex = (m_frameIndex - 1 + FRAME_BUFFER_SIZE) % FRAME_BUFFER_SIZE;
 
 	m_pLineTracker->searchCandidates(
 		m_texPreprocessed[m_frameIndex], m_texPreprocessed[prevIndex], &pStats->tracker);
@@ -107,17 +112,40 @@ void FStreamEngine::processFrame(const FGLTextureRect& inputFrame, FFrameStatist
 		if (pStats)
 			pStats->detector = m_pDetectorThread->statistics();
 
-		m_pPoseDetector->getPreprocessingResult(m_pDTBuffer);
-		m_pDetectorThread->processFrame(m_pDTBuffer);
+		if (m_cpuPreprocessing)
+		{
+			// the detector thread runs canny edges and distance transform on the CPU
+			inputFrame.read(FGLDataFormat::RGBA, FGLDataType::UnsignedByte, m_pImageBuffer);
+			m_pDetectorThread->processFrame(m_pImageBuffer, m_pDTBuffer);
+		}
+		else if (m_pPoseDetector->finishPreprocessingReadback(m_pDTBuffer))
+		{
+			// readback of the previous frame's distance transform
+			m_pDetectorThread->processFrame(m_pDTBuffer);
+
+			if (pStats)
+				pStats->readback.stallDistanceTransform = m_pPoseDetector->readbackStallTime();
+		}
 	}
 
 	// run preprocessing stage of detector on GPU (canny edges, distance transform)
-	m_pPoseDetector->preprocess(inputFrame);
-	glFlush();
+	if (!m_cpuPreprocessing)
+	{
+		m_pPoseDetector->preprocess(inputFrame);
+
+		// read back the result while the detector is idle, it is handed over with the next frame
+		if (m_pDetectorThread->isIdle() && !m_pPoseDetector->isPreprocessingReadbackPending())
+			m_pPoseDetector->startPreprocessingReadback();
+
+		glFlush();
+	}
 
-	// optimize pose on line tracker
+	// optimize pose on line tracker, the search result readback has overlapped with the preprocessing
 	m_pLineTracker->optimizePose();
 
+	if (pStats)
+		pStats->readback.stallSearchResult = m_pLineTracker->readbackStallTime();
+
 	if (pStats)
 		pStats->tracker.state = m_pLineTracker->state();
 
@@ -465,6 +493,15 @@ void FStreamEngine::setTrackerRejectionFactorB(double val) {
 	m_wantRedraw = true;
 }
 
+void FStreamEngine::setTrackerJacobianType(int val) {
+	m_pLineTracker->setJacobianType(val);
+	m_wantRedraw = true;
+}
+
+void FStreamEngine::setTrackerJacobianBenchmark(bool val) {
+	m_pLineTracker->setJacobianBenchmarkEnabled(val);
+}
+
 void FStreamEngine::setDetectionEnabled(bool val) {
 	m_detectionEnabled = val;
 	m_wantRedraw = true;
@@ -494,6 +531,16 @@ void FStreamEngine::setDetectionFixedTypeId(int val) {
 	m_pPoseDetector->setFixedTypeId(val - 1);
 }
 
+void FStreamEngine::setDetectionWorkerCount(int val) {
+	// option 0 is "Auto", the other options are the thread counts
+	m_pPoseDetector->setWorkerCount((size_t)fMax(0, val));
+}
+
+void FStreamEngine::setDetectionBackend(int val) {
+	// option 0 is "GPU", option 1 is "CPU"
+	m_cpuPreprocessing = (val == 1);
+}
+
 void FStreamEngine::setDetectionContourPosition(FVector3d position) {
 	m_pPoseDetector->setContourPosition(position);
 	m_wantRedraw = true;
@@ -46,8 +46,12 @@ public:
 	/// Resets the engine and specifies the frame size.
 	void reset(const QSize& frameSize);
 
-	/// Processes the given frame.
+	/// Processes the given frame, runs preprocessFrame() and trackFrame().
 	void processFrame(const FGLTextureRect& inputFrame, FFrameStatistics* pStats = NULL);
+	/// Undistorts the given frame, the first stage of processing.
+	void preprocessFrame(const FGLTextureRect& inputFrame);
+	/// Tracks and detects the pose in the frame given to preprocessFrame().
+	void trackFrame(FFrameStatistics* pStats = NULL);
 	/// Sets the tracker to its initial pose.
 	void resetPose();
 
@@ -190,6 +194,8 @@ public slots:
 	void setTrackerEstimatorLimit(double val);
 	void setTrackerRejectionFactorA(double val);
 	void setTrackerRejectionFactorB(double val);
+	void setTrackerJacobianType(int val);
+	void setTrackerJacobianBenchmark(bool val);
 
 	void setDetectionEnabled(bool val);
 	void setDetectionAlwaysOn(bool val);
@@ -199,6 +205,8 @@ public slots:
 
 	void setDetectionMSEThreshold(double val);
 	void setDetectionFixedTypeId(int val);
+	void setDetectionWorkerCount(int val);
+	void setDetectionBackend(int val);
 	void setDetectionContourPosition(FVector3d position);
 	void setDetectionContourRotation(FVector3d rotation);
 	void setDetectionContourScale(double scale);
@@ -252,9 +260,11 @@ protected:
 	FLineTracker* m_pLineTracker;
 	FPoseDetector* m_pPoseDetector;
 	FDetectorThread* m_pDetectorThread;
-	FDTPixel* m_pDTBuffer;
+	FDTPixelPacked* m_pDTBuffer;
+	quint8* m_pImageBuffer;
 
 	bool m_detectionEnabled;
+	bool m_cpuPreprocessing;
 	bool m_detectionAlwaysOn;
 	bool m_wantRedraw;
 };
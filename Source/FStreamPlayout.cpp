@@ -9,161 +9,390 @@
 
 #include "FTrackMeStable.h"
 
+#include <QThread>
+#include <QFileInfo>
 #include "FlowGLDefs.h"
 #include "FGLFramebuffer.h"
+#include "FMovieReader.h"
 
 #include "FStreamPlayout.h"
 #include "FMemoryTracer.h"
 
+// ----------------------------------------------------------------------------------------------------
+//  Helper functions
+// ----------------------------------------------------------------------------------------------------
+
+static inline quint8 sClamp(int value)
+{
+	return (quint8)((value < 0) ? 0 : ((value > 255) ? 255 : value));
+}
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FStreamPlayout::FEncoder
+// ----------------------------------------------------------------------------------------------------
+
+class FStreamPlayout::FEncoder : public QThread
+{
+public:
+	FEncoder(FStreamPlayout* pPlayout, size_t encoderIndex)
+		: m_pPlayout(pPlayout), m_encoderIndex(encoderIndex) { }
+
+protected:
+	virtual void run() { m_pPlayout->_encoderLoop(m_encoderIndex); }
+
+private:
+	FStreamPlayout* m_pPlayout;
+	size_t m_encoderIndex;
+};
+
 // ----------------------------------------------------------------------------------------------------
 //  Class FStreamPlayout
 // ----------------------------------------------------------------------------------------------------
 
 // Constructors and destructor ------------------------------------------------------------------------
 
-FStreamPlayout::FStreamPlayout(QObject* pParent /* = NULL */)
-: QThread(pParent),
-  m_wantExit(false),
-  m_readIndex(0),
-  m_writeIndex(0),
-  m_playoutFrameIndex(0),
-  m_jpegQuality(90)
+FStreamPlayout::FStreamPlayout()
+: m_sink(JpegSequence),
+  m_nextSlot(0),
+  m_nextClaim(0),
+  m_encoderCount(0),
+  m_queueLength(32),
+  m_jpegQuality(90),
+  m_frameRate(25.0),
+  m_queuedCount(0),
+  m_writtenCount(0),
+  m_failedCount(0),
+  m_droppedCount(0),
+  m_nextWrite(0),
+  m_wantExit(false)
 {
-	m_frameQueue.resize(32);
 }
 
 FStreamPlayout::~FStreamPlayout()
 {
+	stop();
 }
 
 // Public commands ------------------------------------------------------------------------------------
 
-void FStreamPlayout::start(const QString& filePath, const QSize& frameSize)
+bool FStreamPlayout::start(const QString& filePath, const QSize& frameSize, sink_t sink /* = JpegSequence */)
 {
 	F_ASSERT(!isRunning());
 	if (isRunning())
-		return;
+		return false;
 
 	F_ASSERT(!frameSize.isEmpty());
 	F_ASSERT(!filePath.isEmpty());
 
-	for (size_t i = 0; i < m_frameQueue.size(); ++i)
-		m_frameQueue[i] = QImage(frameSize.width(), frameSize.height(),	QImage::Format_ARGB32);
-	m_frameBuffer = QImage(frameSize.width(), frameSize.height(),	QImage::Format_ARGB32);
-
-	m_readIndex = m_writeIndex = 0;
-	m_playoutFrameIndex = 0;
-
 	m_frameSize = frameSize;
 	m_baseFilePath = filePath;
+	m_sink = sink;
+
+	m_queuedCount = m_writtenCount = m_failedCount = m_droppedCount = 0;
+	m_nextWrite = 0;
+
+	if (m_sink != JpegSequence)
+	{
+		m_file.setFileName(filePath);
+		if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate) || !_writeHeader(0))
+		{
+			fWarning("Playout", QString("Failed to create movie file: %1").arg(filePath));
+			m_file.close();
+			return false;
+		}
+	}
+
+	m_slots.assign(m_queueLength, slot_t());
+	for (size_t i = 0; i < m_slots.size(); ++i)
+		m_slots[i].image = QImage(frameSize.width(), frameSize.height(), QImage::Format_ARGB32);
+	m_nextSlot = m_nextClaim = 0;
+
+	size_t frameBytes = (size_t)frameSize.width() * frameSize.height() * 4;
+	m_readback.create(frameBytes);
+
+	// the processing thread and the GL driver keep one core busy
+	size_t encoderCount = m_encoderCount;
+	if (encoderCount == 0)
+		encoderCount = (size_t)fMinMax(QThread::idealThreadCount() - 1, 1, 4);
+
+	// per-encoder buffers: flipped image for JPEG, FRAME line and planes or rows for movies
+	size_t bufferBytes = (m_sink == Y4MMovie) ? 6 + (size_t)frameSize.width() * frameSize.height() * 3 : frameBytes;
+	m_encoderBuffers.assign(encoderCount, std::vector<quint8>(m_sink == JpegSequence ? 0 : bufferBytes));
+	m_encoderImages.resize(encoderCount);
+	for (size_t i = 0; i < encoderCount; ++i)
+	{
+		if (m_sink == JpegSequence)
+			m_encoderImages[i] = QImage(frameSize.width(), frameSize.height(), QImage::Format_ARGB32);
+	}
 
 	m_wantExit = false;
-	QThread::start(QThread::LowPriority);
+	for (size_t i = 0; i < encoderCount; ++i)
+	{
+		FEncoder* pEncoder = new FEncoder(this, i);
+		m_encoders.push_back(pEncoder);
+		pEncoder->start(QThread::LowPriority);
+	}
+
+	return true;
 }
 
 void FStreamPlayout::stop()
 {
-	if (isRunning())
+	if (!isRunning())
+		return;
+
+	if (m_readback.pendingCount() > 0)
+		_queuePendingFrame();
+	m_readback.release();
+
+	// the encoders finish the queued frames before they exit
+	m_lock.lock();
+	m_wantExit = true;
+	m_frameQueued.wakeAll();
+	m_lock.unlock();
+
+	for (size_t i = 0; i < m_encoders.size(); ++i)
 	{
-		m_wantExit = true;
-		m_waitForFrame.wakeAll();
-		wait(2000);
-		terminate();
-		wait();
-
-		for (size_t i = 0; i < m_frameQueue.size(); ++i)
-			m_frameQueue[i] = QImage();
+		m_encoders[i]->wait(ULONG_MAX);
+		delete m_encoders[i];
 	}
+
+	m_encoders.clear();
+
+	if (m_sink != JpegSequence)
+	{
+		if (m_sink == RawMovie && m_file.seek(0))
+			_writeHeader(m_writtenCount);
+		m_file.close();
+	}
+
+	F_CONSOLE("Playout stopped: " << m_writtenCount << " frames written, "
+		<< m_droppedCount << " dropped, " << m_failedCount << " failed");
+
+	m_slots.clear();
+	m_encoderBuffers.clear();
+	m_encoderImages.clear();
 }
 
 void FStreamPlayout::writeFrame(const FGLTextureRect& frame)
 {
-	m_objectLock.lock();
-	
-	size_t writeIndex = (m_writeIndex + 1) % m_frameQueue.size();
-	if (writeIndex == m_readIndex)
+	slot_t* pSlot = _beginQueue();
+	if (!pSlot)
+		return;
+
+	frame.read(FGLDataFormat::BGRA, FGLDataType::UnsignedByte, pSlot->image.bits());
+	_endQueue(pSlot);
+}
+
+void FStreamPlayout::writeBackbuffer()
+{
+	// queue the frame read with the previous call, its transfer had a frame's time to complete
+	if (m_readback.pendingCount() > 0)
+		_queuePendingFrame();
+
+	FGLFramebuffer::bindDefault();
+	m_readback.readFramebuffer(m_frameSize, FGLDataFormat::BGRA, FGLDataType::UnsignedByte);
+	F_GLERROR_ASSERT;
+}
+
+// Public queries -------------------------------------------------------------------------------------
+
+FStreamPlayout::sink_t FStreamPlayout::sinkForFile(const QString& filePath)
+{
+	QString suffix = QFileInfo(filePath).suffix();
+	if (suffix.compare("raw", Qt::CaseInsensitive) == 0)
+		return RawMovie;
+	if (suffix.compare("y4m", Qt::CaseInsensitive) == 0)
+		return Y4MMovie;
+
+	return JpegSequence;
+}
+
+// Internal functions ---------------------------------------------------------------------------------
+
+FStreamPlayout::slot_t* FStreamPlayout::_beginQueue()
+{
+	// the slot at the write position is only reused when its frame has been encoded
+	m_lock.lock();
+	slot_t* pSlot = &m_slots[m_nextSlot];
+	if (pSlot->state != Free)
+	{
+		m_droppedCount++;
+		pSlot = NULL;
+	}
+	m_lock.unlock();
+
+	return pSlot;
+}
+
+void FStreamPlayout::_endQueue(slot_t* pSlot)
+{
+	m_lock.lock();
+	pSlot->frameIndex = m_queuedCount++;
+	pSlot->state = Queued;
+	m_nextSlot = (m_nextSlot + 1) % m_slots.size();
+	m_lock.unlock();
+
+	m_frameQueued.wakeOne();
+}
+
+void FStreamPlayout::_queuePendingFrame()
+{
+	slot_t* pSlot = _beginQueue();
+	if (!pSlot)
 	{
-		m_objectLock.unlock();
+		m_readback.discard();
 		return;
 	}
 
-	m_writeIndex = writeIndex;
-	frame.read(FGLDataFormat::BGRA, FGLDataType::Float, m_frameQueue[m_writeIndex].bits());
+	m_readback.finish(pSlot->image.bits());
+	_endQueue(pSlot);
+}
+
+void FStreamPlayout::_encoderLoop(size_t encoderIndex)
+{
+	m_lock.lock();
+
+	while (true)
+	{
+		while (!m_wantExit && m_slots[m_nextClaim].state != Queued)
+			m_frameQueued.wait(&m_lock);
+
+		// on exit, the queue is drained first
+		slot_t& slot = m_slots[m_nextClaim];
+		if (slot.state != Queued)
+			break;
+
+		slot.state = Encoding;
+		m_nextClaim = (m_nextClaim + 1) % m_slots.size();
+		m_lock.unlock();
 
-	m_objectLock.unlock();
-	m_waitForFrame.wakeAll();
+		_encode(slot, encoderIndex);
+
+		m_lock.lock();
+	}
+
+	m_lock.unlock();
 }
 
-void FStreamPlayout::writeBackbuffer()
+void FStreamPlayout::_encode(slot_t& slot, size_t encoderIndex)
 {
-	m_objectLock.lock();
+	quint32 frameIndex = slot.frameIndex;
 
-	size_t writeIndex = (m_writeIndex + 1) % m_frameQueue.size();
-	if (writeIndex == m_readIndex)
+	if (m_sink == JpegSequence)
 	{
-		m_objectLock.unlock();
+		QImage& image = m_encoderImages[encoderIndex];
+		_flipRows(slot.image, image.bits());
+		_releaseSlot(slot);
+
+		QString filePath = QString("%1_%2.jpg")
+			.arg(m_baseFilePath).arg((int)frameIndex, 4, 10, QLatin1Char('0'));
+		bool result = image.save(filePath, "JPEG", m_jpegQuality);
+
+		m_lock.lock();
+		if (result)
+			m_writtenCount++;
+		else
+			m_failedCount++;
+		m_lock.unlock();
 		return;
 	}
 
-	m_objectLock.unlock();
+	std::vector<quint8>& buffer = m_encoderBuffers[encoderIndex];
+	if (m_sink == RawMovie)
+		_flipRows(slot.image, &buffer[0]);
+	else
+		_convertY4M(slot.image, &buffer[0]);
 
-	glFinish();
-	FGLFramebuffer::bindDefault();
-	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
-	glReadPixels(0, 0, m_frameSize.width(), m_frameSize.height(), FGLDataFormat::BGRA,
-		FGLDataType::UnsignedByte, m_frameQueue[writeIndex].bits());
-	glFinish();
-	F_GLERROR_ASSERT;
+	_releaseSlot(slot);
+	_writeOrdered(frameIndex, &buffer[0], buffer.size());
+}
 
-	m_objectLock.lock();
-	m_writeIndex = writeIndex;
-	m_objectLock.unlock();
+void FStreamPlayout::_releaseSlot(slot_t& slot)
+{
+	m_lock.lock();
+	slot.state = Free;
+	m_lock.unlock();
+}
 
-	m_waitForFrame.wakeAll();
+void FStreamPlayout::_writeOrdered(quint32 frameIndex, const quint8* pData, size_t numBytes)
+{
+	m_lock.lock();
+	while (m_nextWrite != frameIndex)
+		m_frameWritten.wait(&m_lock);
+	m_lock.unlock();
+
+	// it is this encoder's turn, no other encoder accesses the file
+	bool result = (m_file.write((const char*)pData, (qint64)numBytes) == (qint64)numBytes);
+
+	m_lock.lock();
+	if (result)
+		m_writtenCount++;
+	else
+		m_failedCount++;
+	m_nextWrite++;
+	m_lock.unlock();
+
+	m_frameWritten.wakeAll();
 }
 
-// Overrides ------------------------------------------------------------------------------------------
+void FStreamPlayout::_flipRows(const QImage& source, quint8* pTarget) const
+{
+	// the readback is bottom-up
+	int ny = source.height();
+	size_t rowBytes = (size_t)source.width() * 4;
+
+	for (int y = 0; y < ny; ++y)
+		memcpy(pTarget + y * rowBytes, source.scanLine(ny - 1 - y), rowBytes);
+}
 
-void FStreamPlayout::run()
+void FStreamPlayout::_convertY4M(const QImage& source, quint8* pTarget) const
 {
-	m_objectLock.lock();
+	// full range BT.601, 4:4:4 planes to keep the overlays sharp
+	int nx = source.width();
+	int ny = source.height();
+	size_t planeBytes = (size_t)nx * ny;
 
-	while(true)
-	{
-		if (m_wantExit)
-		{
-			m_objectLock.unlock();
-			return;
-		}
+	memcpy(pTarget, "FRAME\n", 6);
+	quint8* pY = pTarget + 6;
+	quint8* pU = pY + planeBytes;
+	quint8* pV = pU + planeBytes;
 
-		m_waitForFrame.wait(&m_objectLock);
+	for (int y = 0; y < ny; ++y)
+	{
+		// the readback is bottom-up, the rows are flipped while converting
+		const quint8* pSrc = source.scanLine(ny - 1 - y);
+		size_t offset = (size_t)y * nx;
 
-		while(m_readIndex != m_writeIndex)
+		for (int x = 0; x < nx; ++x, pSrc += 4)
 		{
-			m_readIndex = (m_readIndex + 1) % m_frameQueue.size();
-			m_objectLock.unlock();
-
-			size_t stride = m_frameQueue[m_readIndex].bytesPerLine();
-			size_t lines = m_frameQueue[m_readIndex].height();
-			quint8* pSrc = m_frameQueue[m_readIndex].bits();
-			quint8* pDst = m_frameBuffer.bits();
-
-			for (size_t y0 = 0, y1 = lines - 1; y0 < lines; ++y0, --y1)
-			{
-				size_t yy0 = y0 * stride;
-				size_t yy1 = y1 * stride;
-				for (size_t x = 0; x < stride; ++x)
-					pDst[yy1 + x] = pSrc[yy0 + x];
-			}
-
-			QString filePath = QString("%1_%2.jpg")
-				.arg(m_baseFilePath).arg((int)m_playoutFrameIndex, 4, 10, QLatin1Char('0'));
-			m_frameBuffer.save(filePath, "JPEG", m_jpegQuality);
-			m_playoutFrameIndex++;
-
-			m_objectLock.lock();
+			int b = pSrc[0], g = pSrc[1], r = pSrc[2];
+			pY[offset + x] = sClamp((19595 * r + 38470 * g + 7471 * b + 32768) >> 16);
+			pU[offset + x] = sClamp((-11059 * r - 21709 * g + 32768 * b + (128 << 16) + 32768) >> 16);
+			pV[offset + x] = sClamp((32768 * r - 27439 * g - 5329 * b + (128 << 16) + 32768) >> 16);
 		}
 	}
 }
 
-// ----------------------------------------------------------------------------------------------------
\ No newline at end of file
+bool FStreamPlayout::_writeHeader(quint32 frameCount)
+{
+	if (m_sink == RawMovie)
+	{
+		FRawMovieHeader header;
+		header.width = (quint32)m_frameSize.width();
+		header.height = (quint32)m_frameSize.height();
+		header.frameCount = frameCount;
+		header.frameRateNum = (quint32)(m_frameRate * 1000.0 + 0.5);
+		header.frameRateDen = 1000;
+
+		return m_file.write((const char*)&header, sizeof(FRawMovieHeader)) == sizeof(FRawMovieHeader);
+	}
+
+	QByteArray header = QString("YUV4MPEG2 W%1 H%2 F%3:1000 Ip A1:1 C444 XCOLORRANGE=FULL\n")
+		.arg(m_frameSize.width()).arg(m_frameSize.height())
+		.arg((int)(m_frameRate * 1000.0 + 0.5)).toAscii();
+
+	return m_file.write(header) == header.size();
+}
+
+// ----------------------------------------------------------------------------------------------------
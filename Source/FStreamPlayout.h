@@ -11,64 +11,160 @@
 #define FSTREAMPLAYOUT_H
 
 #include <vector>
-#include <QThread>
 #include <QImage>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
 #include "FTrackMe.h"
 #include "FGLTextureRect.h"
+#include "FAsyncReadback.h"
 
 // ----------------------------------------------------------------------------------------------------
 //  Class FStreamPlayout
 // ----------------------------------------------------------------------------------------------------
 
-class FStreamPlayout : public QThread
+/// Writes the rendered frames to disk. The frames are read back from OpenGL into a queue and
+/// encoded by a pool of encoder threads. The rows are flipped from OpenGL to top-down order
+/// while encoding. Frames are written as a sequence of JPEG images, or as a raw or Y4M movie,
+/// see FMovieReader. Movie frames are written in order, even if encoded in parallel. If the
+/// queue is full, the new frame is dropped and counted.
+class FStreamPlayout
 {
+	//  Public types -----------------------------------------------------------
+
+public:
+	enum sink_t
+	{
+		JpegSequence,
+		RawMovie,
+		Y4MMovie
+	};
+
 	//  Constructors and destructor --------------------------------------------
 
 public:
 	/// Default Constructor.
-	FStreamPlayout(QObject* pParent = NULL);
-	/// Virtual destructor.
+	FStreamPlayout();
+	/// Virtual destructor. Stops the playout.
 	virtual ~FStreamPlayout();
 
+private:
+	FStreamPlayout(const FStreamPlayout& other);
+	FStreamPlayout& operator=(const FStreamPlayout& other);
+
 	//  Public commands --------------------------------------------------------
 
 public:
-	void start(const QString& filePath, const QSize& frameSize);
+	/// Starts the playout. For a JPEG sequence, the frames are saved as <filePath>_0000.jpg,
+	/// etc., for a movie the file is created at the given path.
+	bool start(const QString& filePath, const QSize& frameSize, sink_t sink = JpegSequence);
+	/// Encodes the frames still queued and stops the playout.
 	void stop();
 
 	void writeFrame(const FGLTextureRect& frame);
+	/// Starts reading the back buffer asynchronously. The frame is queued
+	/// with the next call to writeBackbuffer() or stop().
 	void writeBackbuffer();
 
+	/// Sets the number of encoder threads used from the next start, 0 chooses
+	/// the number based on the processor cores.
+	void setEncoderCount(size_t count) { m_encoderCount = count; }
+	/// Sets the number of frames the queue can hold, used from the next start.
+	void setQueueLength(size_t length) { m_queueLength = fMax(length, (size_t)1); }
+	/// Sets the quality of JPEG images in the range [0, 100].
+	void setJpegQuality(int quality) { m_jpegQuality = quality; }
+	/// Sets the frame rate stored in movie files.
+	void setFrameRate(double fps) { m_frameRate = fps; }
+
 	//  Public queries ---------------------------------------------------------
 
+public:
+	/// Returns true if the playout has been started.
+	bool isRunning() const { return !m_encoders.empty(); }
+	/// Returns the time in seconds spent waiting for the last back buffer readback.
+	double readbackStallTime() const { return m_readback.lastStallTime(); }
+
+	/// Returns the number of frames written since the start.
+	quint32 writtenFrameCount() const { return m_writtenCount; }
+	/// Returns the number of frames dropped because the queue was full or writing failed.
+	quint32 droppedFrameCount() const { return m_droppedCount + m_failedCount; }
+	/// Returns the number of frames queued but not yet written.
+	quint32 pendingFrameCount() const { return m_queuedCount - m_writtenCount - m_failedCount; }
 
-	//  Overrides --------------------------------------------------------------
+	/// Returns the sink matching the extension of the given file path.
+	static sink_t sinkForFile(const QString& filePath);
 
-protected:
-	virtual void run();
+	//  Internal types ---------------------------------------------------------
+
+private:
+	class FEncoder;
+
+	enum slotState_t
+	{
+		Free,
+		Queued,
+		Encoding
+	};
+
+	struct slot_t
+	{
+		slot_t() : frameIndex(0), state(Free) { }
+
+		QImage image;
+		quint32 frameIndex;
+		slotState_t state;
+	};
 
 	//  Internal functions -----------------------------------------------------
 
 private:
+	slot_t* _beginQueue();
+	void _endQueue(slot_t* pSlot);
+	void _queuePendingFrame();
+
+	void _encoderLoop(size_t encoderIndex);
+	void _encode(slot_t& slot, size_t encoderIndex);
+	void _releaseSlot(slot_t& slot);
+	void _writeOrdered(quint32 frameIndex, const quint8* pData, size_t numBytes);
+
+	void _flipRows(const QImage& source, quint8* pTarget) const;
+	void _convertY4M(const QImage& source, quint8* pTarget) const;
+	bool _writeHeader(quint32 frameCount);
 
 	//  Internal data members --------------------------------------------------
 
 private:
 	QSize m_frameSize;
 	QString m_baseFilePath;
-	std::vector<QImage> m_frameQueue;
-	QImage m_frameBuffer;
-	size_t m_readIndex;
-	size_t m_writeIndex;
-	size_t m_playoutFrameIndex;
+	sink_t m_sink;
+	QFile m_file;
 
+	std::vector<slot_t> m_slots;
+	size_t m_nextSlot;
+	size_t m_nextClaim;
+	FAsyncReadback m_readback;
+
+	std::vector<FEncoder*> m_encoders;
+	std::vector< std::vector<quint8> > m_encoderBuffers;
+	std::vector<QImage> m_encoderImages;
+
+	size_t m_encoderCount;
+	size_t m_queueLength;
 	int m_jpegQuality;
+	double m_frameRate;
+
+	quint32 m_queuedCount;
+	quint32 m_writtenCount;
+	quint32 m_failedCount;
+	quint32 m_droppedCount;
+	quint32 m_nextWrite;
 
 	bool m_wantExit;
-	QMutex m_objectLock;
-	QWaitCondition m_waitForFrame;
+	QMutex m_lock;
+	QWaitCondition m_frameQueued;
+	QWaitCondition m_frameWritten;
 };
-	
+
 // ----------------------------------------------------------------------------------------------------
 
-#endif // FSTREAMPLAYOUT_H
\ No newline at end of file
+#endif // FSTREAMPLAYOUT_H
@@ -17,6 +17,7 @@
 #include "FGenericModel.h"
 #include "FBoxModel.h"
 #include "FStudioModelVirtEco.h"
+#include "FLineModelBenchmark.h"
 
 #include "FStreamProcessor.h"
 #include "FMemoryTracer.h"
@@ -36,12 +37,16 @@ FStreamProcessor::FStreamProcessor(QObject* pParent /* = NULL */)
   m_isInitialized(false),
   m_mediaState(NoSource),
   m_frameDuration(0.1),
+  m_sourceFrameCount(0),
   m_playoutEnabled(false)
 {
 }
 
 FStreamProcessor::~FStreamProcessor()
 {
+	// the decode stage reads from the source
+	m_framePipeline.stop();
+
 	F_SAFE_DELETE(m_pSource);
 	F_SAFE_DELETE(m_pEngine);
 	F_SAFE_DELETE(m_pViewer);
@@ -51,6 +56,12 @@ FStreamProcessor::~FStreamProcessor()
 
 bool FStreamProcessor::process()
 {
+	if (m_framePipeline.isRunning())
+	{
+		_processPipeline();
+		return true; // keep running
+	}
+
 	bool needRedraw = false;
 
 	if ((m_mediaState == Playing && m_timer.isElapsed()) || m_mediaState == Streaming)
@@ -80,6 +91,8 @@ bool FStreamProcessor::process()
 		if (m_sourceFrame.isValid())
 		{
 			m_statistics.frameNumber = m_pSource->frameIndex();
+			m_statistics.source = m_pSource->statistics();
+			m_statistics.pipeline = FPipelineStatistics();
 			m_pEngine->processFrame(m_sourceFrame, &m_statistics);
 			needRedraw = true;
 		}
@@ -90,10 +103,7 @@ bool FStreamProcessor::process()
 		if (needRedraw)
 		{
 			emit statisticsUpdated(m_statistics);
-			m_pViewer->redraw();
-
-			if (m_playoutEnabled)
-				m_playoutEngine.writeBackbuffer();
+			_presentFrame();
 		}
 	}
 	else
@@ -266,7 +276,9 @@ void FStreamProcessor::selectModel(int modelIndex)
 void FStreamProcessor::openMediaFile(QString filePath)
 {
 	F_TRACE("FStreamProcessor::openMediaFile");
+	m_framePipeline.stop();
 	m_pSource->openFile(filePath);
+	_cacheSourceInfo();
 
 	if (!m_pSource->isOpen())
 	{
@@ -286,7 +298,9 @@ void FStreamProcessor::openMediaFile(QString filePath)
 void FStreamProcessor::openMediaStream(int ordinal, QSize imageSize)
 {
 	F_TRACE("FStreamProcessor::openMediaStream");
+	m_framePipeline.stop();
 	m_pSource->openStream(ordinal, imageSize);
+	_cacheSourceInfo();
 
 	if (!m_pSource->isOpen())
 	{
@@ -305,12 +319,19 @@ void FStreamProcessor::openMediaStream(int ordinal, QSize imageSize)
 	m_pEngine->reset(frameSize);
 	m_pViewer->reset(frameSize);
 	emit frameSizeChanged(frameSize);
+
+	_startPipeline();
 }
 
 void FStreamProcessor::showStreamProperties()
 {
+	// the dialog changes the capture device, the decode stage must not read from it meanwhile
+	_stopPipeline();
+
 	if (m_pSource->isOpen() && m_pSource->sourceType() == FStreamSource::LiveVideo)
 		m_pSource->showStreamProperties();
+
+	_startPipeline();
 }
 
 void FStreamProcessor::playMedia()
@@ -319,6 +340,7 @@ void FStreamProcessor::playMedia()
 	{
 		_changeMediaState(Playing);
 		m_timer.start(0.1);
+		_startPipeline();
 	}
 }
 
@@ -326,6 +348,7 @@ void FStreamProcessor::stopMedia()
 {
 	if (m_mediaState == Playing)
 	{
+		_stopPipeline();
 		_changeMediaState(Stopped);
 	}
 }
@@ -334,8 +357,10 @@ void FStreamProcessor::previousFrame()
 {
 	if (m_pSource->isOpen())
 	{
+		_stopPipeline();
 		m_pSource->previous();
 		_changeMediaState(m_mediaState);
+		_startPipeline();
 	}
 }
 
@@ -343,8 +368,10 @@ void FStreamProcessor::nextFrame()
 {
 	if (m_pSource->isOpen())
 	{
+		_stopPipeline();
 		m_pSource->next();
 		_changeMediaState(m_mediaState);
+		_startPipeline();
 	}
 }
 
@@ -352,9 +379,11 @@ void FStreamProcessor::firstFrame()
 {
 	if (m_pSource->isOpen())
 	{
+		_stopPipeline();
 		m_pSource->toBegin();
 		_changeMediaState(m_mediaState);
 		m_pEngine->resetPose();
+		_startPipeline();
 	}
 }
 
@@ -362,8 +391,10 @@ void FStreamProcessor::lastFrame()
 {
 	if (m_pSource->isOpen())
 	{
+		_stopPipeline();
 		m_pSource->toEnd();
 		_changeMediaState(m_mediaState);
+		_startPipeline();
 	}
 }
 
@@ -379,21 +410,36 @@ void FStreamProcessor::setViewMode(quint32 mode)
 	m_pViewer->redraw();
 }
 
+void FStreamProcessor::setPipelineMode(int mode)
+{
+	F_ASSERT(mode >= FFramePipeline::Automatic && mode <= FFramePipeline::Latency);
+	m_framePipeline.setMode((FFramePipeline::mode_t)mode);
+
+	if (m_framePipeline.isRunning())
+	{
+		_stopPipeline();
+		_startPipeline();
+	}
+}
+
 void FStreamProcessor::startPlayout(QString filePath)
 {
 	if (m_playoutEnabled)
 		return;
 
-	int dotPos = filePath.indexOf('.');
-	QString playoutFilePath;
+	// movies are written to the given file, images are numbered after the base name
+	FStreamPlayout::sink_t sink = FStreamPlayout::sinkForFile(filePath);
+	QString playoutFilePath = filePath;
 
-	if (dotPos >= 0)
-		playoutFilePath = filePath.left(dotPos);
-	else
-		playoutFilePath = filePath;
+	if (sink == FStreamPlayout::JpegSequence)
+	{
+		int dotPos = filePath.indexOf('.');
+		if (dotPos >= 0)
+			playoutFilePath = filePath.left(dotPos);
+	}
 
-	m_playoutEngine.start(playoutFilePath, m_pViewer->frameSize());
-	m_playoutEnabled = true;
+	m_playoutEngine.setFrameRate(1.0 / m_frameDuration);
+	m_playoutEnabled = m_playoutEngine.start(playoutFilePath, m_pViewer->frameSize(), sink);
 }
 
 void FStreamProcessor::stopPlayout()
@@ -405,6 +451,13 @@ void FStreamProcessor::stopPlayout()
 	m_playoutEnabled = false;
 }
 
+void FStreamProcessor::runLineModelBenchmark()
+{
+	// runs in the processing thread, where the GL context is current
+	FLineModelBenchmark benchmark;
+	benchmark.run();
+}
+
 void FStreamProcessor::keyStateChanged(FKeyboardState keyState)
 {
 	if (keyState.eventType() == QEvent::KeyPress)
@@ -435,17 +488,111 @@ void FStreamProcessor::_changeMediaState(mediaState_t state)
 	{
 		info = "";
 	}
+	else if (m_framePipeline.isRunning())
+	{
+		// the source is read by the decode stage and ahead of the frame processed
+		info = QString("%1\nFrame %2 of %3")
+			.arg(m_sourceName)
+			.arg(m_statistics.frameNumber + 1)
+			.arg(m_sourceFrameCount);
+	}
 	else if (m_pSource->isOpen())
 	{
 		info = QString("%1\nFrame %2 of %3")
-			.arg(m_pSource->sourceName())
+			.arg(m_sourceName)
 			.arg(m_pSource->frameIndex() + 1)
-			.arg(m_pSource->frameCount());
+			.arg(m_sourceFrameCount);
 	}
 	else
-		info = QString("Error while opening/reading media\n%1").arg(m_pSource->sourceName());
+		info = QString("Error while opening/reading media\n%1").arg(m_sourceName);
 
 	emit mediaStateChanged(info);
 }
 
+void FStreamProcessor::_cacheSourceInfo()
+{
+	m_sourceName = m_pSource->sourceName();
+	m_sourceFrameCount = m_pSource->frameCount();
+}
+
+void FStreamProcessor::_startPipeline()
+{
+	if (m_mediaState != Playing && m_mediaState != Streaming)
+		return;
+
+	// a movie or sequence restarts at the begin when played to the end
+	m_framePipeline.start(m_pSource, true);
+}
+
+void FStreamProcessor::_stopPipeline()
+{
+	if (!m_framePipeline.isRunning())
+		return;
+
+	m_framePipeline.stop();
+
+	// the source has been decoded ahead, return to the frame processed last
+	if (m_pSource->frameIndex() != m_statistics.frameNumber)
+		m_pSource->toPosition(m_statistics.frameNumber);
+}
+
+void FStreamProcessor::_processPipeline()
+{
+	if (m_mediaState == Playing && !m_timer.isElapsed())
+		return;
+
+	// wait briefly for the decode stage instead of spinning
+	FFramePipeline::frame_t frame;
+	if (!m_framePipeline.take(frame, 0.01))
+	{
+		if (m_framePipeline.isAtEnd())
+		{
+			_stopPipeline();
+			_changeMediaState(Stopped);
+		}
+		return;
+	}
+
+	m_timer.start(m_frameDuration);
+	if (frame.isRestart)
+		m_pEngine->resetPose();
+
+	m_statistics.frameNumber = frame.frameIndex;
+	m_statistics.source = frame.source;
+	_changeMediaState(Playing);
+
+	m_framePipeline.beginStage(FPipelineStatistics::Upload);
+	m_sourceFrame.loadFromImage(frame.image);
+	m_framePipeline.endStage();
+
+	m_framePipeline.beginStage(FPipelineStatistics::Preprocess);
+	m_pEngine->preprocessFrame(m_sourceFrame);
+	m_framePipeline.endStage();
+
+	m_framePipeline.beginStage(FPipelineStatistics::Track);
+	m_pEngine->trackFrame(&m_statistics);
+	m_framePipeline.endStage();
+
+	m_framePipeline.beginStage(FPipelineStatistics::Present);
+	_presentFrame();
+	m_framePipeline.endStage();
+
+	m_framePipeline.finishFrame(frame, &m_statistics.pipeline);
+	emit statisticsUpdated(m_statistics);
+}
+
+void FStreamProcessor::_presentFrame()
+{
+	m_pViewer->redraw();
+
+	if (m_playoutEnabled)
+	{
+		m_playoutEngine.writeBackbuffer();
+		m_statistics.readback.stallPlayout = m_playoutEngine.readbackStallTime();
+		m_statistics.playout.framesWritten = m_playoutEngine.writtenFrameCount();
+		m_statistics.playout.framesDropped = m_playoutEngine.droppedFrameCount();
+		m_statistics.playout.framesPending = m_playoutEngine.pendingFrameCount();
+	}
+}
+
 // ----------------------------------------------------------------------------------------------------
\ No newline at end of file
@@ -16,6 +16,7 @@
 #include "FTimer.h"
 
 #include "FStreamPlayout.h"
+#include "FFramePipeline.h"
 #include "FFrameStatistics.h"
 #include "FKeyboardState.h"
 #include "FMouseState.h"
@@ -75,10 +76,13 @@ public slots:
 
 	void setPlaybackSpeed(float fps);
 	void setViewMode(quint32 mode);
+	void setPipelineMode(int mode);
 
 	void startPlayout(QString filePath);
 	void stopPlayout();
 
+	void runLineModelBenchmark();
+
 	void keyStateChanged(FKeyboardState keyState);
 	void mouseStateChanged(FMouseState mouseState);
 	void windowSizeChanged(QSize newSize);
@@ -108,6 +112,11 @@ signals:
 
 private:
 	void _changeMediaState(mediaState_t state);
+	void _cacheSourceInfo();
+	void _startPipeline();
+	void _stopPipeline();
+	void _processPipeline();
+	void _presentFrame();
 
 	//  Internal data members --------------------------------------------------
 
@@ -125,6 +134,9 @@ private:
 	FRenderWidget* m_pRenderWidget;
 
 	FGLTextureRect m_sourceFrame;	
+	FFramePipeline m_framePipeline;
+	QString m_sourceName;
+	size_t m_sourceFrameCount;
 
 	FStreamPlayout m_playoutEngine;
 	bool m_playoutEnabled;
@@ -32,7 +32,8 @@ FStreamSource::FStreamSource(QObject* pParent /* = NULL */)
   m_isOpen(false),
   m_hasFrame(false),
   m_hasNewFrame(false),
-  m_pCaptureDevice(NULL)
+  m_pCaptureDevice(NULL),
+  m_pMovieFrame(NULL)
 {
 	FCaptureManager* pCapManager = FCaptureManager::instance();
 	m_captureDevices = pCapManager->videoCaptureDeviceList();
@@ -61,20 +62,26 @@ bool FStreamSource::openFile(const QString& filePath)
 
 	if (_isImageFile(info))
 	{
-		QString firstFileName;
+		bool result;
 		if (_initSequence(info))
 		{
 			m_sourceType = ImageSequence;
-			firstFileName = _getFrameFileName(m_sourceName, m_frameOffset);
+
+			QStringList filePaths;
+			for (size_t i = 0; i < m_frameCount; i++)
+				filePaths << _getFrameFileName(m_sourceName, i + m_frameOffset);
+
+			m_sequenceReader.open(filePaths);
+			result = _readSequenceFrame();
 		}
 		else
 		{
 			m_sourceType = Image;
 			m_frameCount = 1;
-			firstFileName = m_sourceName;
+			result = _readImage(m_sourceName);
 		}
 
-		if (!_readImage(firstFileName))
+		if (!result)
 		{
 			close();
 			return false;
@@ -85,8 +92,25 @@ bool FStreamSource::openFile(const QString& filePath)
 	}
 	else if (_isMovieFile(info))
 	{
-		F_ASSERT(!"Not yet implemented");
-		return false;
+		if (!m_movieReader.open(m_sourceName))
+		{
+			fWarning("Stream Source", QString("Movie format not supported: %1").arg(m_sourceName));
+			close();
+			return false;
+		}
+
+		m_sourceType = Movie;
+		m_frameCount = m_movieReader.frameCount();
+		m_frameSize = m_movieReader.frameSize();
+
+		if (!_readMovieFrame())
+		{
+			close();
+			return false;
+		}
+
+		m_isOpen = true;
+		return true;
 	}
 
 	F_ASSERT(!"FStreamSource::open - Neither an image nor a movie file");
@@ -138,6 +162,8 @@ void FStreamSource::close()
 {
 	if (m_sourceType == Movie)
 	{
+		m_movieReader.close();
+		m_pMovieFrame = NULL;
 	}
 	else if (m_sourceType == LiveVideo)
 	{
@@ -152,6 +178,8 @@ void FStreamSource::close()
 	{
 	}
 
+	m_sequenceReader.close();
+	m_statistics = FSourceStatistics();
 	m_currentFrame = QImage();
 	m_sourceName.clear();
 	m_sourceType = Image;
@@ -181,15 +209,7 @@ void FStreamSource::next()
 	if (m_frameIndex < m_frameCount - 1)
 	{
 		m_frameIndex++;
-		if (m_sourceType == ImageSequence)
-		{
-			_readImage(_getFrameFileName(m_sourceName, m_frameIndex + m_frameOffset));
-			return;
-		}
-		else if (m_sourceType == Movie)
-		{
-			F_ASSERT(false); // TODO: Implement retrieve next movie frame
-		}
+		_readFrame();
 	}
 }
 
@@ -202,15 +222,7 @@ void FStreamSource::previous()
 	if (m_frameIndex > 0)
 	{
 		m_frameIndex--;
-		if (m_sourceType == ImageSequence)
-		{
-			_readImage(_getFrameFileName(m_sourceName, m_frameIndex + m_frameOffset));
-			return;
-		}
-		else if (m_sourceType == LiveVideo)
-		{
-			_readLiveFrame();
-		}
+		_readFrame();
 	}
 }
 
@@ -221,11 +233,7 @@ void FStreamSource::toBegin()
 		return;
 
 	m_frameIndex = 0;
-	if (m_sourceType == ImageSequence)
-	{
-		_readImage(_getFrameFileName(m_sourceName, m_frameIndex + m_frameOffset));
-		return;
-	}
+	_readFrame();
 }
 
 void FStreamSource::toEnd()
@@ -235,11 +243,7 @@ void FStreamSource::toEnd()
 		return;
 
 	m_frameIndex = m_frameCount - 1;
-	if (m_sourceType == ImageSequence)
-	{
-		_readImage(_getFrameFileName(m_sourceName, m_frameIndex + m_frameOffset));
-		return;
-	}
+	_readFrame();
 }
 
 void FStreamSource::toPosition(size_t frame)
@@ -249,11 +253,7 @@ void FStreamSource::toPosition(size_t frame)
 		return;
 
 	m_frameIndex = fMinMax(frame, (size_t)0, m_frameCount - 1);
-	if (m_sourceType == ImageSequence)
-	{
-		_readImage(_getFrameFileName(m_sourceName, m_frameIndex + m_frameOffset));
-		return;
-	}
+	_readFrame();
 }
 
 void FStreamSource::showStreamProperties()
@@ -268,47 +268,68 @@ void FStreamSource::showStreamProperties()
 
 void FStreamSource::getFrame(QImage& image)
 {
-	F_ASSERT(m_hasFrame && !m_currentFrame.isNull());
+	F_ASSERT(m_hasFrame);
 	if (!m_hasFrame)
 		return;
 
-	image = m_currentFrame;
+	// the mapped movie frame is only valid until the next frame
+	if (m_sourceType == Movie)
+		image = _movieFrameImage().copy();
+	else
+		image = m_currentFrame;
+
 	m_hasNewFrame = false;
 }
 
 void FStreamSource::getFrame(FGLTexture2D& texture)
 {
 	F_ASSERT(texture.isValid());
-	F_ASSERT(m_hasFrame && !m_currentFrame.isNull());
+	F_ASSERT(m_hasFrame);
 	if (!m_hasFrame)
 		return;
 
-	texture.loadFromImage(m_currentFrame);
+	if (m_sourceType == Movie)
+		texture.loadFromImage(_movieFrameImage());
+	else
+		texture.loadFromImage(m_currentFrame);
+
 	m_hasNewFrame = false;
 }
 
 void FStreamSource::getFrame(FGLTextureRect& texture)
 {
 	F_ASSERT(texture.isValid());
-	F_ASSERT(m_hasFrame && !m_currentFrame.isNull());
+	F_ASSERT(m_hasFrame);
 	if (!m_hasFrame)
 		return;
 
-	texture.loadFromImage(m_currentFrame);
+	if (m_sourceType == Movie)
+		texture.loadFromImage(_movieFrameImage());
+	else
+		texture.loadFromImage(m_currentFrame);
+
 	m_hasNewFrame = false;
 }
 
 void FStreamSource::getFrame(void* pBuffer, size_t bufferSize)
 {
-	F_ASSERT(m_hasFrame && !m_currentFrame.isNull());
+	F_ASSERT(m_hasFrame);
 	if (!m_hasFrame)
 		return;
 
-	size_t bytes = fMin(bufferSize, (size_t)m_currentFrame.byteCount());
-	memcpy(pBuffer, m_currentFrame.bits(), bytes);
+	// the frame of a sequence is shared with the reader, do not detach
+	const QImage& frame = m_currentFrame;
+	const void* pFrame = (m_sourceType == Movie) ? (const void*)m_pMovieFrame : (const void*)frame.bits();
+	size_t bytes = fMin(bufferSize, frameByteCount());
+	memcpy(pBuffer, pFrame, bytes);
 	m_hasNewFrame = false;
 }
 
+size_t FStreamSource::frameByteCount() const
+{
+	return (size_t)m_frameSize.width() * m_frameSize.height() * 4;
+}
+
 QString FStreamSource::sourceName() const
 {
 	int lastSlash = m_sourceName.lastIndexOf('/');
@@ -363,16 +384,55 @@ bool FStreamSource::_readImage(const QString& filePath)
 	//F_TRACE(QString("FStreamSource::_readImage - Reading file: %1").arg(filePath));
 
 	m_hasFrame = m_hasNewFrame = false;
-	m_currentFrame.load(filePath);
-	
-	if (m_currentFrame.isNull())
+	QImage image;
+	if (!FSequenceReader::decode(filePath, image))
+	{
+		m_currentFrame = QImage();
 		return false;
+	}
+
+	return _setFrame(image);
+}
+
+bool FStreamSource::_readFrame()
+{
+	if (m_sourceType == ImageSequence)
+		return _readSequenceFrame();
+	else if (m_sourceType == Movie)
+		return _readMovieFrame();
 
-	if (m_currentFrame.format() != QImage::Format_ARGB32)
-		m_currentFrame = m_currentFrame.convertToFormat(QImage::Format_ARGB32);
+	return false;
+}
 
-	if (m_currentFrame.isNull())
+bool FStreamSource::_readSequenceFrame()
+{
+	m_hasFrame = m_hasNewFrame = false;
+	QImage image;
+	if (!m_sequenceReader.read(m_frameIndex, image, &m_statistics))
+	{
+		m_currentFrame = QImage();
 		return false;
+	}
+
+	return _setFrame(image);
+}
+
+bool FStreamSource::_readMovieFrame()
+{
+	m_pMovieFrame = m_movieReader.frame(m_frameIndex);
+	m_hasFrame = m_hasNewFrame = (m_pMovieFrame != NULL);
+	return m_hasFrame;
+}
+
+QImage FStreamSource::_movieFrameImage() const
+{
+	// wraps the frame without copying
+	return QImage(m_pMovieFrame, m_frameSize.width(), m_frameSize.height(), QImage::Format_ARGB32);
+}
+
+bool FStreamSource::_setFrame(const QImage& image)
+{
+	m_currentFrame = image;
 
 	if (!m_frameSize.isNull())
 	{
@@ -467,7 +527,8 @@ bool FStreamSource::_isMovieFile(const QFileInfo& fileInfo)
 	QString ext = fileInfo.suffix();
 	return (ext.compare("avi", Qt::CaseInsensitive) == 0
 		|| ext.compare("mp4", Qt::CaseInsensitive) == 0
-		|| ext.compare("mov", Qt::CaseInsensitive) == 0);
+		|| ext.compare("mov", Qt::CaseInsensitive) == 0
+		|| FMovieReader::isSupported(fileInfo.fileName()));
 }
 
 bool FStreamSource::_readLiveFrame()
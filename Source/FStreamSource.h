@@ -17,6 +17,8 @@
 #include "FGLTexture2D.h"
 #include "FGLTextureRect.h"
 #include "FVideoCaptureDeviceInfo.h"
+#include "FSequenceReader.h"
+#include "FMovieReader.h"
 
 class FVideoCaptureDevice;
 
@@ -25,7 +27,8 @@ class FVideoCaptureDevice;
 // ----------------------------------------------------------------------------------------------------
 
 /// Reads from an image stream. This can be a live video source (webcam, etc.), a movie file
-/// or a sequence of still images.
+/// or a sequence of still images. The frames of a sequence are decoded ahead in worker threads,
+/// movies are read from uncompressed files, see FMovieReader.
 class FStreamSource : public QObject
 {
 	Q_OBJECT;
@@ -111,6 +114,8 @@ public:
 	const QSize& frameSize() const { return m_frameSize; }
 	/// Returns the frame size in bytes.
 	size_t frameByteCount() const;
+	/// Returns the statistics of reading the current frame.
+	const FSourceStatistics& statistics() const { return m_statistics; }
 
 	/// Returns a list of video capture devices.
 	QStringList captureDeviceList() const;
@@ -120,6 +125,11 @@ public:
 private:
 	QString _getFrameFileName(const QString& filePath, size_t index);
 	bool _readImage(const QString& filePath);
+	bool _readFrame();
+	bool _readSequenceFrame();
+	bool _readMovieFrame();
+	QImage _movieFrameImage() const;
+	bool _setFrame(const QImage& image);
 	bool _initSequence(const QFileInfo& fileInfo);
 	void _scanForDigits(const QString& filePath, int& firstPos, int& lastPos);
 	bool _isImageFile(const QFileInfo& fileInfo);
@@ -146,6 +156,11 @@ private:
 
 	QImage m_currentFrame;
 	FPixelRGBA8u* m_pCurrentFrame;
+
+	FSequenceReader m_sequenceReader;
+	FMovieReader m_movieReader;
+	const quint8* m_pMovieFrame;
+	FSourceStatistics m_statistics;
 };
 	
 // ----------------------------------------------------------------------------------------------------
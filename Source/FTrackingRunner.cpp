@@ -0,0 +1,473 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FTrackingRunner.cpp
+//  Description		Implementation of class FTrackingRunner
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-10-13 16:42:10 +0200 (Do, 13 Okt 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#include "FTrackMeStable.h"
+
+#include <QFileInfo>
+#ifdef Q_OS_WIN
+#include <ObjBase.h>
+#endif
+#include "FlowGL.h"
+#include "FOffscreenContext.h"
+#include "FStreamSource.h"
+#include "FStreamEngine.h"
+#include "FFramePipeline.h"
+#include "FStopWatch.h"
+
+#include "FTrackingRunner.h"
+#include "FMemoryTracer.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Helper functions
+// ----------------------------------------------------------------------------------------------------
+
+static const char* sStageName[FPipelineStatistics::NumStages] = {
+	"Decode", "Upload", "Preprocess", "Track", "Present"
+};
+
+static inline void sUninitializeCom()
+{
+#ifdef Q_OS_WIN
+	CoUninitialize();
+#endif
+}
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FTrackingRunner
+// ----------------------------------------------------------------------------------------------------
+
+// Constructors and destructor ------------------------------------------------------------------------
+
+FTrackingRunner::FTrackingRunner()
+: m_firstFrame(0),
+  m_maxFrames(0),
+  m_queueLength(8),
+  m_detectionEnabled(true),
+  m_focalDistance(0.0),
+  m_isBinary(false),
+  m_recordCount(0),
+  m_trackedCount(0),
+  m_sumTimeSearch(0.0),
+  m_sumTimeOptimization(0.0),
+  m_sumLatency(0.0)
+{
+	for (int i = 0; i < CameraSettingCount; i++)
+		m_hasCamera[i] = false;
+
+	for (int i = 0; i < FPipelineStatistics::NumStages; i++)
+		m_sumStageTime[i] = m_sumOccupancy[i] = 0.0;
+}
+
+FTrackingRunner::~FTrackingRunner()
+{
+	_closeOutput();
+}
+
+// Public commands ------------------------------------------------------------------------------------
+
+int FTrackingRunner::run(const QStringList& arguments)
+{
+	QTextStream out(stdout);
+
+	if (!_parseArguments(arguments))
+	{
+		out << usage();
+		return 1;
+	}
+
+#ifdef Q_OS_WIN
+	// the stream source enumerates the capture devices through COM
+	CoInitializeEx(NULL, 0);
+#endif
+
+	FStreamSource source;
+	if (!source.openFile(m_inputFilePath) || source.sourceType() == FStreamSource::Image)
+	{
+		out << "Failed to open sequence or movie: " << m_inputFilePath << endl;
+		sUninitializeCom();
+		return 2;
+	}
+
+	if (m_firstFrame > 0)
+		source.toPosition(m_firstFrame);
+
+	// nothing is presented, the context only needs to be current
+	QSize frameSize = source.frameSize();
+	FOffscreenContext context;
+	if (!context.create(3, 3, frameSize))
+	{
+		out << FOffscreenContext::platformName() << ": " << context.errorString() << endl;
+		sUninitializeCom();
+		return 2;
+	}
+
+	int result = 0;
+
+	{
+		FStreamEngine engine;
+		engine.loadLineModel(m_modelFilePath);
+		if (!engine.lineModel())
+		{
+			out << "Failed to load line model: " << m_modelFilePath << endl;
+			result = 2;
+		}
+		else if (!_openOutput())
+		{
+			out << "Failed to create " << m_outputFilePath << endl;
+			result = 2;
+		}
+		else
+		{
+			if (!m_databaseFilePath.isEmpty())
+				engine.loadClassifierDatabase(m_databaseFilePath);
+
+			engine.reset(frameSize);
+			_applyParameters(engine);
+
+			FGLTextureRect inputFrame;
+			inputFrame.create();
+
+			// every frame is tracked, decoding runs ahead in its own thread
+			FFramePipeline pipeline;
+			pipeline.setMode(FFramePipeline::Throughput);
+			pipeline.setQueueLength(m_queueLength);
+			pipeline.start(&source, false);
+
+			out << "Tracking " << source.sourceName() << ", " << frameSize.width() << " x "
+				<< frameSize.height() << ", " << source.frameCount() << " frames" << endl;
+
+			FStopWatch stopWatch;
+			stopWatch.start();
+
+			FFrameStatistics stats;
+			FFramePipeline::frame_t frame;
+
+			while (m_maxFrames == 0 || m_recordCount < m_maxFrames)
+			{
+				if (!pipeline.take(frame, 1.0))
+				{
+					if (pipeline.isAtEnd())
+						break;
+					continue;
+				}
+
+				stats.frameNumber = frame.frameIndex;
+				stats.source = frame.source;
+
+				pipeline.beginStage(FPipelineStatistics::Upload);
+				inputFrame.loadFromImage(frame.image);
+				pipeline.endStage();
+
+				pipeline.beginStage(FPipelineStatistics::Preprocess);
+				engine.preprocessFrame(inputFrame);
+				pipeline.endStage();
+
+				pipeline.beginStage(FPipelineStatistics::Track);
+				engine.trackFrame(&stats);
+				pipeline.endStage();
+
+				// nothing is presented, writing the record is part of the frame interval
+				pipeline.finishFrame(frame, &stats.pipeline);
+				_writeRecord(stats);
+				_addSummary(stats);
+			}
+
+			double seconds = stopWatch.stop();
+			pipeline.stop();
+
+			_closeOutput();
+			_printSummary(seconds);
+			out << "Records saved: " << m_outputFilePath << endl;
+		}
+	}
+
+	source.close();
+	context.release();
+	sUninitializeCom();
+
+	return result;
+}
+
+// Public queries -------------------------------------------------------------------------------------
+
+bool FTrackingRunner::isRequested(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+		if (qstrcmp(argv[i], "--track") == 0)
+			return true;
+
+	return false;
+}
+
+QString FTrackingRunner::usage()
+{
+	return QString(
+		"Usage: TrackMe --track --input <file> --model <file> --output <file> [options]\n"
+		"  --input <file>            first image of a sequence, or a raw or Y4M movie\n"
+		"  --model <file>            line model to track\n"
+		"  --database <file>         classifier data for pose detection\n"
+		"  --output <file>           pose and statistics per frame, CSV or binary (.bin)\n"
+		"  --first <n>               index of the first frame tracked (0)\n"
+		"  --frames <n>              number of frames tracked, 0 for all (0)\n"
+		"  --queue <n>               number of frames decoded ahead (8)\n"
+		"  --detection <0|1>         pose detection if tracking fails (1)\n"
+		"  --camera-position <x,y,z> initial camera position\n"
+		"  --camera-rotation <x,y,z> initial camera rotation in degrees\n"
+		"  --focal-distance <mm>     camera focal distance\n"
+		"Requires an OpenGL 3.3 driver. On Windows without an interactive desktop session,\n"
+		"deploy a Mesa opengl32.dll next to TrackMe.exe. Elsewhere the context is created\n"
+		"through EGL without a display server, e.g. Mesa llvmpipe with EGL_PLATFORM=surfaceless.\n");
+}
+
+// Internal functions ---------------------------------------------------------------------------------
+
+bool FTrackingRunner::_parseArguments(const QStringList& arguments)
+{
+	QTextStream out(stdout);
+
+	for (int i = 1; i < arguments.size(); i++)
+	{
+		const QString& option = arguments[i];
+		if (option == "--track")
+			continue;
+
+		if (i + 1 >= arguments.size())
+		{
+			out << "Missing value: " << option << endl;
+			return false;
+		}
+
+		const QString& value = arguments[++i];
+		bool ok = true;
+
+		if (option == "--input")
+			m_inputFilePath = value;
+		else if (option == "--model")
+			m_modelFilePath = value;
+		else if (option == "--database")
+			m_databaseFilePath = value;
+		else if (option == "--output")
+			m_outputFilePath = value;
+		else if (option == "--first")
+			m_firstFrame = value.toUInt(&ok);
+		else if (option == "--frames")
+			m_maxFrames = value.toUInt(&ok);
+		else if (option == "--queue")
+			m_queueLength = value.toUInt(&ok);
+		else if (option == "--detection")
+			m_detectionEnabled = value.toInt(&ok) != 0;
+		else if (option == "--camera-position")
+			ok = m_hasCamera[CameraPosition] = _parseVector(value, m_camera[CameraPosition]);
+		else if (option == "--camera-rotation")
+			ok = m_hasCamera[CameraRotation] = _parseVector(value, m_camera[CameraRotation]);
+		else if (option == "--focal-distance")
+			m_focalDistance = value.toDouble(&ok);
+		else
+		{
+			out << "Unknown option: " << option << endl;
+			return false;
+		}
+
+		if (!ok)
+		{
+			out << "Invalid value for " << option << ": " << value << endl;
+			return false;
+		}
+	}
+
+	if (m_inputFilePath.isEmpty() || m_modelFilePath.isEmpty())
+	{
+		out << "An input file and a line model are required" << endl;
+		return false;
+	}
+
+	if (m_outputFilePath.isEmpty())
+	{
+		out << "An output file is required" << endl;
+		return false;
+	}
+
+	m_queueLength = fMax(m_queueLength, (quint32)1);
+	return true;
+}
+
+bool FTrackingRunner::_parseVector(const QString& text, FVector3d& result) const
+{
+	QStringList values = text.split(',');
+	if (values.size() != 3)
+		return false;
+
+	bool ok[3];
+	result.set(values[0].toDouble(&ok[0]), values[1].toDouble(&ok[1]), values[2].toDouble(&ok[2]));
+	return ok[0] && ok[1] && ok[2];
+}
+
+void FTrackingRunner::_applyParameters(FStreamEngine& engine) const
+{
+	engine.setDetectionEnabled(m_detectionEnabled);
+
+	if (m_hasCamera[CameraPosition])
+		engine.setCameraTranslation(m_camera[CameraPosition]);
+	if (m_hasCamera[CameraRotation])
+		engine.setCameraRotation(m_camera[CameraRotation]);
+	if (m_focalDistance > 0.0)
+		engine.setCameraFocalDistance(m_focalDistance);
+
+	engine.resetPose();
+}
+
+bool FTrackingRunner::_openOutput()
+{
+	m_isBinary = QFileInfo(m_outputFilePath).suffix().compare("bin", Qt::CaseInsensitive) == 0;
+	m_recordCount = 0;
+
+	m_outputFile.setFileName(m_outputFilePath);
+	if (!m_outputFile.open(m_isBinary ? QIODevice::WriteOnly : QIODevice::WriteOnly | QIODevice::Text))
+		return false;
+
+	if (m_isBinary)
+	{
+		// the record count is updated when the file is closed
+		FTrackingRecordHeader header;
+		header.recordSize = sizeof(FTrackingRecord);
+		return m_outputFile.write((const char*)&header, sizeof(header)) == sizeof(header);
+	}
+
+	m_csvStream.setDevice(&m_outputFile);
+	m_csvStream << "Frame,State,NumPoses,PoseUsed,"
+		"Pos X,Pos Y,Pos Z,Rot X,Rot Y,Rot Z,Lens,"
+		"Smooth Pos X,Smooth Pos Y,Smooth Pos Z,Smooth Rot X,Smooth Rot Y,Smooth Rot Z,Smooth Lens,"
+		"Error Start,Error Prediction,Error Optimization A,Error Optimization B,"
+		"Search,Optimization A,Optimization B";
+
+	for (int i = 0; i < FPipelineStatistics::NumStages; i++)
+		m_csvStream << "," << sStageName[i];
+
+	m_csvStream << ",Latency" << endl;
+	return true;
+}
+
+void FTrackingRunner::_writeRecord(const FFrameStatistics& stats)
+{
+	FTrackingRecord record;
+	record.frameNumber = (quint32)stats.frameNumber;
+	record.trackerState = (quint32)(FLineTrackerState::state_t)stats.tracker.state;
+	record.numPoses = stats.detector.numPoses;
+	record.poseUsed = stats.detector.poseUsed;
+
+	for (size_t i = 0; i < 7; i++)
+	{
+		record.finalPose[i] = stats.finalPose[i];
+		record.finalPoseSmooth[i] = stats.finalPoseSmooth[i];
+	}
+
+	for (size_t i = 0; i < FTrackerStatistics::NumStages; i++)
+		record.errorMean[i] = (float)stats.tracker.errorMean[i];
+
+	record.timeSearch = (float)(stats.tracker.timeSearch * 1000.0);
+	record.timeOptimizationA = (float)(stats.tracker.timeOptimizationA * 1000.0);
+	record.timeOptimizationB = (float)(stats.tracker.timeOptimizationB * 1000.0);
+
+	for (size_t i = 0; i < FPipelineStatistics::NumStages; i++)
+		record.timeStage[i] = (float)(stats.pipeline.time[i] * 1000.0);
+	record.latency = (float)(stats.pipeline.latency * 1000.0);
+
+	m_recordCount++;
+
+	if (m_isBinary)
+	{
+		m_outputFile.write((const char*)&record, sizeof(FTrackingRecord));
+		return;
+	}
+
+	QTextStream& stream = m_csvStream;
+	stream << record.frameNumber << "," << record.trackerState << ","
+		<< record.numPoses << "," << record.poseUsed;
+
+	for (size_t i = 0; i < 7; i++)
+		stream << "," << record.finalPose[i];
+	for (size_t i = 0; i < 7; i++)
+		stream << "," << record.finalPoseSmooth[i];
+	for (size_t i = 0; i < FTrackerStatistics::NumStages; i++)
+		stream << "," << record.errorMean[i];
+
+	stream << "," << record.timeSearch << "," << record.timeOptimizationA
+		<< "," << record.timeOptimizationB;
+
+	for (size_t i = 0; i < FPipelineStatistics::NumStages; i++)
+		stream << "," << record.timeStage[i];
+
+	stream << "," << record.latency << endl;
+}
+
+void FTrackingRunner::_closeOutput()
+{
+	if (!m_outputFile.isOpen())
+		return;
+
+	if (m_isBinary)
+	{
+		FTrackingRecordHeader header;
+		header.recordSize = sizeof(FTrackingRecord);
+		header.recordCount = m_recordCount;
+
+		if (m_outputFile.seek(0))
+			m_outputFile.write((const char*)&header, sizeof(header));
+	}
+	else
+	{
+		m_csvStream.flush();
+		m_csvStream.setDevice(NULL);
+	}
+
+	m_outputFile.close();
+}
+
+void FTrackingRunner::_addSummary(const FFrameStatistics& stats)
+{
+	if (stats.tracker.state == FLineTrackerState::Tracking)
+		m_trackedCount++;
+
+	for (int i = 0; i < FPipelineStatistics::NumStages; i++)
+	{
+		m_sumStageTime[i] += stats.pipeline.time[i];
+		m_sumOccupancy[i] += stats.pipeline.occupancy[i];
+	}
+
+	m_sumTimeSearch += stats.tracker.timeSearch;
+	m_sumTimeOptimization += stats.tracker.timeOptimizationA + stats.tracker.timeOptimizationB;
+	m_sumLatency += stats.pipeline.latency;
+}
+
+void FTrackingRunner::_printSummary(double seconds) const
+{
+	QTextStream out(stdout);
+	double n = fMax((double)m_recordCount, 1.0);
+
+	out << QString("%1 frames in %2 s, %3 frames/s, %4 frames tracked (%5 %)")
+		.arg(m_recordCount).arg(seconds, 0, 'f', 2)
+		.arg(seconds > 0.0 ? m_recordCount / seconds : 0.0, 0, 'f', 1)
+		.arg(m_trackedCount).arg(100.0 * m_trackedCount / n, 0, 'f', 1) << endl;
+
+	out << "Stage           Time (ms)  Occupancy" << endl;
+	for (int i = 0; i < FPipelineStatistics::NumStages; i++)
+	{
+		out << QString("  %1 %2 %3 %")
+			.arg(sStageName[i], -12)
+			.arg(1000.0 * m_sumStageTime[i] / n, 10, 'f', 2)
+			.arg(100.0 * m_sumOccupancy[i] / n, 9, 'f', 1) << endl;
+	}
+
+	out << QString("Search %1 ms, optimization %2 ms, latency %3 ms")
+		.arg(1000.0 * m_sumTimeSearch / n, 0, 'f', 2)
+		.arg(1000.0 * m_sumTimeOptimization / n, 0, 'f', 2)
+		.arg(1000.0 * m_sumLatency / n, 0, 'f', 2) << endl;
+}
+
+// ----------------------------------------------------------------------------------------------------
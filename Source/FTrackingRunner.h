@@ -0,0 +1,178 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FTrackingRunner.h
+//  Description		Header file for FTrackingRunner.cpp
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-10-13 16:42:10 +0200 (Do, 13 Okt 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#ifndef FTRACKINGRUNNER_H
+#define FTRACKINGRUNNER_H
+
+#include <QStringList>
+#include <QFile>
+#include <QTextStream>
+#include "FTrackMe.h"
+#include "FlowMath.h"
+#include "FFrameStatistics.h"
+
+class FStreamEngine;
+
+// ----------------------------------------------------------------------------------------------------
+//  Struct FTrackingRecordHeader
+// ----------------------------------------------------------------------------------------------------
+
+/// Header of a binary tracking record file. The header is followed by one FTrackingRecord per
+/// processed frame, each recordSize bytes long. All fields are stored little endian.
+struct FTrackingRecordHeader
+{
+	FTrackingRecordHeader() {
+		memcpy(magic, "FTRKREC1", 8);
+		headerSize = sizeof(FTrackingRecordHeader);
+		recordSize = 0;
+		recordCount = 0;
+		reserved = 0;
+	}
+
+	/// Returns true if the magic and the header size match.
+	bool isValid() const {
+		return memcmp(magic, "FTRKREC1", 8) == 0 && headerSize >= sizeof(FTrackingRecordHeader);
+	}
+
+	char magic[8];
+	/// Offset of the first record in bytes.
+	quint32 headerSize;
+	quint32 recordSize;
+	/// Number of records written, informative only; the count is given by the file size.
+	quint32 recordCount;
+	quint32 reserved;
+};
+
+// ----------------------------------------------------------------------------------------------------
+//  Struct FTrackingRecord
+// ----------------------------------------------------------------------------------------------------
+
+/// Pose and timing of a tracked frame. Times are in milliseconds.
+struct FTrackingRecord
+{
+	FTrackingRecord() {
+		memset(this, 0, sizeof(FTrackingRecord));
+	}
+
+	quint32 frameNumber;
+	/// The tracker state, see FLineTrackerState::state_t.
+	quint32 trackerState;
+	qint32 numPoses;
+	qint32 poseUsed;
+
+	/// Camera position, rotation and focal length.
+	double finalPose[7];
+	double finalPoseSmooth[7];
+
+	float errorMean[FTrackerStatistics::NumStages];
+	float timeSearch;
+	float timeOptimizationA;
+	float timeOptimizationB;
+	float timeStage[FPipelineStatistics::NumStages];
+	float latency;
+};
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FTrackingRunner
+// ----------------------------------------------------------------------------------------------------
+
+/// Batch tracking from the command line. Tracks the frames of a movie or image sequence as fast
+/// as possible and writes the pose and statistics of each frame to a CSV file, or to a binary
+/// file if the output file has the extension .bin, see FTrackingRecord. Started with
+///   TrackMe --track --input <file> --model <file> --output <file> [options]
+/// See usage() for the options. A summary of the throughput and the stage times is written
+/// to the standard output. The OpenGL context is an FOffscreenContext, which needs no visible
+/// window and, outside Windows, no display server.
+class FTrackingRunner
+{
+	//  Constructors and destructor --------------------------------------------
+
+public:
+	/// Default Constructor.
+	FTrackingRunner();
+	/// Virtual destructor.
+	virtual ~FTrackingRunner();
+
+private:
+	FTrackingRunner(const FTrackingRunner& other);
+	FTrackingRunner& operator=(const FTrackingRunner& other);
+
+	//  Public commands --------------------------------------------------------
+
+public:
+	/// Parses the given command line arguments and runs the tracking.
+	/// Returns 0 on success, 1 for invalid arguments and 2 if the tracking failed.
+	int run(const QStringList& arguments);
+
+	//  Public queries ---------------------------------------------------------
+
+	/// Returns true if the command line requests batch tracking.
+	static bool isRequested(int argc, char* argv[]);
+	/// Returns the description of the command line options.
+	static QString usage();
+
+	//  Internal types ---------------------------------------------------------
+
+private:
+	enum cameraSetting_t
+	{
+		CameraPosition,
+		CameraRotation,
+		CameraSettingCount
+	};
+
+	//  Internal functions -----------------------------------------------------
+
+private:
+	bool _parseArguments(const QStringList& arguments);
+	bool _parseVector(const QString& text, OUT FVector3d& result) const;
+	void _applyParameters(FStreamEngine& engine) const;
+
+	bool _openOutput();
+	void _writeRecord(const FFrameStatistics& stats);
+	void _closeOutput();
+
+	void _addSummary(const FFrameStatistics& stats);
+	void _printSummary(double seconds) const;
+
+	//  Internal data members --------------------------------------------------
+
+private:
+	QString m_inputFilePath;
+	QString m_modelFilePath;
+	QString m_databaseFilePath;
+	QString m_outputFilePath;
+
+	quint32 m_firstFrame;
+	quint32 m_maxFrames;
+	quint32 m_queueLength;
+	bool m_detectionEnabled;
+
+	// camera, only the given settings are applied
+	FVector3d m_camera[CameraSettingCount];
+	bool m_hasCamera[CameraSettingCount];
+	double m_focalDistance;
+
+	QFile m_outputFile;
+	QTextStream m_csvStream;
+	bool m_isBinary;
+	quint32 m_recordCount;
+
+	// summary
+	quint32 m_trackedCount;
+	double m_sumStageTime[FPipelineStatistics::NumStages];
+	double m_sumOccupancy[FPipelineStatistics::NumStages];
+	double m_sumTimeSearch;
+	double m_sumTimeOptimization;
+	double m_sumLatency;
+};
+
+// ----------------------------------------------------------------------------------------------------
+
+#endif // FTRACKINGRUNNER_H
@@ -11,15 +11,73 @@
 
 #include "FContourModel.h"
 #include "FDistanceTransform.h"
+#include "FDistanceTransformCPU.h"
 #include "FContourFinder.h"
 #include "FContourDatabase.h"
 #include "FContourClass.h"
 #include "FPatchSizePreset.h"
 #include "FPoseDetector.h"
+#include "FStopWatch.h"
 
 #include "FTrainingEngine.h"
 #include "FMemoryTracer.h"
 
+// ----------------------------------------------------------------------------------------------------
+//  Batch training types
+// ----------------------------------------------------------------------------------------------------
+
+/// Normalized contour extracted during batch training, together with its warped patch
+/// and the candidate classes selected from the classes existing at the start of the batch.
+struct FTrainingEngine::batchSample_t
+{
+	batchSample_t(const QSize& patchSize) : patch(patchSize), poseIndex(0), numSelected(0) { }
+
+	FContour contour;
+	FContourPatch patch;
+	size_t poseIndex;
+	size_t numSelected;
+	FContourDatabase::candidateList_t candidates;
+};
+
+/// Fit of a sample to one of its candidate classes.
+struct FTrainingEngine::batchFit_t
+{
+	size_t sampleIndex;
+	size_t candidateIndex;
+};
+
+/// Extracts the contours of a single rendered pose.
+class FTrainingEngine::FExtractionTask : public FWorkerTask
+{
+public:
+	FExtractionTask(FTrainingEngine* pEngine) : m_pEngine(pEngine), m_poseIndex(0) { }
+	void setPoseIndex(size_t poseIndex) { m_poseIndex = poseIndex; }
+
+	virtual void runTask(size_t taskIndex, size_t workerIndex) {
+		m_pEngine->_extractSamples(m_poseIndex);
+	}
+
+private:
+	FTrainingEngine* m_pEngine;
+	size_t m_poseIndex;
+};
+
+/// Fits the samples to their candidate classes, one fit per task.
+class FTrainingEngine::FFittingTask : public FWorkerTask
+{
+public:
+	FFittingTask(FTrainingEngine* pEngine) : m_pEngine(pEngine) { }
+
+	virtual void runTask(size_t taskIndex, size_t workerIndex) {
+		const batchFit_t& fit = m_pEngine->m_batchFits[taskIndex];
+		batchSample_t* pSample = m_pEngine->m_batchSamples[fit.sampleIndex];
+		m_pEngine->m_pDatabase->fitCandidate(&pSample->contour, pSample->candidates[fit.candidateIndex]);
+	}
+
+private:
+	FTrainingEngine* m_pEngine;
+};
+
 // ----------------------------------------------------------------------------------------------------
 //  Class FTrainingEngine
 // ----------------------------------------------------------------------------------------------------
@@ -35,22 +93,48 @@ FTrainingEngine::FTrainingEngine(QWidget* pView, QObject* pParent /* = NULL */)
   m_patchSize(64, 64),
   m_viewSize(1024, 768),
   m_pView(pView),
+  m_randomSeed(-1),
   m_pModel(NULL),
   m_pDatabase(NULL),
+  m_pDistanceTransform(NULL),
+  m_pContourFinder(NULL),
+  m_pDistanceTransformCPU(NULL),
   m_pStatistics(NULL),
   m_trainingRun(0),
-  m_warpErrorThreshold(2.0f)
+  m_warpErrorThreshold(2.0f),
+  m_fitCandidateCount(8),
+  m_earlyExitEnabled(true),
+  m_batchSize(1),
+  m_pBatchFinder(NULL),
+  m_batchSampleCount(0),
+  m_checkpointInterval(0),
+  m_lastCheckpointRun(0)
 
 {
-	F_ASSERT(pView);
-	_initGL();
+	if (m_pView)
+		_initGL();
 
 	m_cameraMetrics.setApertureSize(FVector2f(36.0f, 36.0f));
 	m_cameraMetrics.setFocalLength(35.0f);
 	m_cameraMetrics.setImageSize(m_trainingCanvasSize);
 
-	m_pDistanceTransform = new FDistanceTransform();
-	m_pDistanceTransform->reset(m_trainingCanvasSize);
+	if (m_pView)
+	{
+		m_pDistanceTransform = new FDistanceTransform();
+		m_pDistanceTransform->reset(m_trainingCanvasSize);
+	}
+	else
+	{
+		// the rendering runs in the calling thread while a worker extracts the contours,
+		// the CPU distance transform uses a pool of its own
+		m_pDistanceTransformCPU = new FDistanceTransformCPU();
+		m_pDistanceTransformCPU->reset(m_trainingCanvasSize);
+		m_pDistanceTransformCPU->setWorkerPool(&m_renderPool);
+
+		size_t numPixels = m_trainingCanvasSize.width() * m_trainingCanvasSize.height();
+		m_seedImage.resize(numPixels);
+		m_dtImage.resize(numPixels);
+	}
 
 	m_pContourFinder = new FContourFinder();
 	m_pContourFinder->reset(m_trainingCanvasSize);
@@ -61,6 +145,9 @@ FTrainingEngine::FTrainingEngine(QWidget* pView, QObject* pParent /* = NULL */)
 		m_pSlotClass[i] = NULL;
 	}
 
+	m_pBatchImage[0] = NULL;
+	m_pBatchImage[1] = NULL;
+
 	m_pStatistics = new FTrainingStatistics();
 }
 
@@ -69,25 +156,34 @@ FTrainingEngine::~FTrainingEngine()
 	F_SAFE_DELETE(m_pStatistics);
 	F_SAFE_DELETE(m_pContourFinder);
 	F_SAFE_DELETE(m_pDistanceTransform);
+	F_SAFE_DELETE(m_pDistanceTransformCPU);
 	F_SAFE_DELETE(m_pDatabase);
 
 	F_SAFE_DELETE(m_pPoseDetector);
 	F_SAFE_DELETE_ARRAY(m_pDTImage);
 
-	m_glContext.release();
+	for (size_t i = 0; i < m_batchSamples.size(); i++)
+		delete m_batchSamples[i];
+	F_SAFE_DELETE(m_pBatchFinder);
+	F_SAFE_DELETE_ARRAY(m_pBatchImage[0]);
+	F_SAFE_DELETE_ARRAY(m_pBatchImage[1]);
+
+	if (m_pView)
+		m_glContext.release();
 }
 
 // Public commands ------------------------------------------------------------------------------------
 
 void FTrainingEngine::clear()
 {
-	m_randGen = FRandom();
+	_resetRandom();
 }
 
 void FTrainingEngine::loadContourModel(const QString& modelFilePath)
 {
-	m_randGen = FRandom();
+	_resetRandom();
 	m_trainingRun = 0;
+	m_dataFilePath.clear();
 
 	F_SAFE_DELETE(m_pDatabase);
 	m_pDatabase = new FContourDatabase();
@@ -98,7 +194,10 @@ void FTrainingEngine::loadContourModel(const QString& modelFilePath)
 	{
 		m_pModel = m_pDatabase->contourModel();
 		m_pDatabase->setWarpErrorThreshold(m_warpErrorThreshold);
+		m_pDatabase->setFitCandidateCount(m_fitCandidateCount);
+		m_pDatabase->setEarlyExitEnabled(m_earlyExitEnabled);
 		m_pDatabase->setTrainingParameter(m_params);
+		m_pDatabase->setJournalingEnabled(m_checkpointInterval > 0);
 		
 		// initial run with neutral pose
 		runOnce();
@@ -123,20 +222,25 @@ void FTrainingEngine::loadContourModel(const QString& modelFilePath)
 
 bool FTrainingEngine::loadClassifierData(const QString& dataFilePath)
 {
-	QFile file(dataFilePath);
-	if (!file.open(QIODevice::ReadOnly))
+	FContourDatabase* pDatabase = new FContourDatabase();
+	if (!pDatabase->load(dataFilePath))
 	{
-		emit postMessage(QString("Failed to open classifier data file: %1").arg(dataFilePath));
+		emit postMessage(QString("Failed to load classifier data file: %1").arg(dataFilePath));
+		F_SAFE_DELETE(pDatabase);
 		return false;
 	}
 
-	FArchive ar(&file, false);
 	F_SAFE_DELETE(m_pDatabase);
-	m_pDatabase = new FContourDatabase();
-	m_pDatabase->serialize(ar);
+	m_pDatabase = pDatabase;
 	m_pModel = m_pDatabase->contourModel();
 	m_params = m_pDatabase->trainingParameter();
 	m_warpErrorThreshold = m_pDatabase->warpErrorThreshold();
+	m_pDatabase->setFitCandidateCount(m_fitCandidateCount);
+	m_pDatabase->setEarlyExitEnabled(m_earlyExitEnabled);
+	m_pDatabase->setJournalingEnabled(m_checkpointInterval > 0);
+
+	m_dataFilePath = dataFilePath;
+	m_lastCheckpointRun = m_trainingRun;
 
 	emit postDatabaseInfo(QString("Database loaded: %1\nContour model: %2")
 		.arg(dataFilePath).arg(m_pModel->filePath()));
@@ -154,17 +258,16 @@ bool FTrainingEngine::saveClassifierData(const QString& dataFilePath)
 	if (!m_pDatabase)
 		return false;
 
-	QFile file(dataFilePath);
-	if (!file.open(QIODevice::WriteOnly))
+	m_pDatabase->setTrainingParameter(m_params);
+
+	if (!m_pDatabase->save(dataFilePath))
 	{
-		emit postMessage(QString("Failed to create classifier data file: %1").arg(dataFilePath));
+		emit postMessage(QString("Failed to save classifier data file: %1").arg(dataFilePath));
 		return false;
 	}
 
-	m_pDatabase->setTrainingParameter(m_params);
-
-	FArchive ar(&file, false);
-	m_pDatabase->serialize(ar);
+	m_dataFilePath = dataFilePath;
+	m_lastCheckpointRun = m_trainingRun;
 
 	emit postDatabaseInfo(QString("Database saved: %1\nContour model: %2")
 		.arg(dataFilePath).arg(m_pModel->filePath()));
@@ -173,6 +276,41 @@ bool FTrainingEngine::saveClassifierData(const QString& dataFilePath)
 	return true;
 }
 
+bool FTrainingEngine::checkpointClassifierData()
+{
+	if (!m_pDatabase || m_dataFilePath.isEmpty())
+		return false;
+
+	m_lastCheckpointRun = m_trainingRun;
+	size_t numEntries = m_pDatabase->pendingJournalCount();
+
+	FStopWatch stopWatch;
+	stopWatch.start();
+
+	if (!m_pDatabase->checkpoint(m_dataFilePath))
+	{
+		emit postMessage(QString("Failed to checkpoint classifier data file: %1").arg(m_dataFilePath));
+		return false;
+	}
+
+	double ms = stopWatch.stop() * 1000.0;
+	if (numEntries > 0)
+		emit postMessage(QString("Classifier data checkpoint: %1 changes, %2 ms").arg(numEntries).arg(ms, 0, 'f', 1));
+	return true;
+}
+
+bool FTrainingEngine::convertClassifierData(const QString& sourceFilePath, const QString& targetFilePath)
+{
+	if (!FContourDatabase::convert(sourceFilePath, targetFilePath))
+	{
+		emit postMessage(QString("Failed to convert classifier data: %1").arg(sourceFilePath));
+		return false;
+	}
+
+	emit postMessage(QString("Classifier data converted: %1 -> %2").arg(sourceFilePath).arg(targetFilePath));
+	return true;
+}
+
 void FTrainingEngine::runOnce()
 {
 	if (!m_pDatabase || !m_pDatabase->isValid())
@@ -190,6 +328,7 @@ void FTrainingEngine::runOnce()
 	_generatePose(randomPose);
 	_drawContourModel(randomPose);
 	_processContours(randomPose);
+	_autoCheckpoint();
 
 	if (m_pStatistics)
 	{
@@ -202,6 +341,74 @@ void FTrainingEngine::runOnce()
 
 		m_pStatistics->totalClassCount = m_pDatabase->totalClassCount();
 		m_pStatistics->totalSampleCount = m_pDatabase->totalSampleCount();
+		m_pStatistics->totalFitCount = m_pDatabase->totalFitCount();
+		m_pStatistics->totalSkippedFitCount = m_pDatabase->totalSkippedFitCount();
+
+		emit postStatistics(*m_pStatistics);
+	}
+}
+
+void FTrainingEngine::runBatch(size_t numPoses)
+{
+	if (!m_pDatabase || !m_pDatabase->isValid() || numPoses == 0)
+		return;
+
+	if (!m_pBatchFinder)
+	{
+		m_pBatchFinder = new FContourFinder();
+		m_pBatchFinder->reset(m_trainingCanvasSize);
+
+		size_t numPixels = m_trainingCanvasSize.width() * m_trainingCanvasSize.height();
+		m_pBatchImage[0] = new FDTPixel[numPixels];
+		m_pBatchImage[1] = new FDTPixel[numPixels];
+	}
+
+	if (m_pStatistics)
+		m_pStatistics->clear();
+
+	// classes existing at the start of the batch are fitted in parallel
+	size_t numTypes = m_pDatabase->contourCount();
+	m_batchClassCount.resize(numTypes);
+	for (size_t i = 0; i < numTypes; i++)
+		m_batchClassCount[i] = m_pDatabase->classCount(i);
+
+	m_batchPoses.resize(numPoses);
+	m_batchSampleCount = 0;
+
+	// render the next pose while a worker extracts the contours of the previous one
+	FExtractionTask extractionTask(this);
+
+	for (size_t k = 0; k < numPoses; k++)
+	{
+		m_trainingRun++;
+		_generatePose(m_batchPoses[k]);
+		_drawContourModel(m_batchPoses[k], m_pBatchImage[k % 2]);
+
+		m_workerPool.wait();
+		extractionTask.setPoseIndex(k);
+		m_workerPool.start(&extractionTask, 1);
+	}
+
+	m_workerPool.wait();
+
+	_fitSamples();
+	_mergeSamples();
+	_autoCheckpoint();
+
+	if (m_pStatistics)
+	{
+		m_pStatistics->runCount = m_trainingRun;
+
+		for (size_t i = 0; i < numTypes; i++)
+		{
+			m_pStatistics->contour[i].classCount = m_pDatabase->classCount(i);
+			m_pStatistics->contour[i].sampleCount = m_pDatabase->sampleCount(i);
+		}
+
+		m_pStatistics->totalClassCount = m_pDatabase->totalClassCount();
+		m_pStatistics->totalSampleCount = m_pDatabase->totalSampleCount();
+		m_pStatistics->totalFitCount = m_pDatabase->totalFitCount();
+		m_pStatistics->totalSkippedFitCount = m_pDatabase->totalSkippedFitCount();
 
 		emit postStatistics(*m_pStatistics);
 	}
@@ -212,13 +419,20 @@ void FTrainingEngine::testOnce(QTextStream& protocol)
 	if (!m_pDatabase || !m_pDatabase->isValid())
 		return;
 
+	// the pose detector requires OpenGL
+	if (!m_pView)
+	{
+		emit postMessage("Pose tests are not available without OpenGL");
+		return;
+	}
+
 	if (!m_pPoseDetector)
 	{
 		m_pPoseDetector = new FPoseDetector();
 		m_pPoseDetector->reset(m_trainingCanvasSize);
 		m_pPoseDetector->setClassifierData(m_pDatabase);
 
-		m_pDTImage = new FDTPixel[m_trainingCanvasSize.width() * m_trainingCanvasSize.height()];
+		m_pDTImage = new FDTPixelPacked[m_trainingCanvasSize.width() * m_trainingCanvasSize.height()];
 	}
 
 	F_ASSERT(m_pPoseDetector);
@@ -245,11 +459,7 @@ void FTrainingEngine::testOnce(QTextStream& protocol)
 
 	// run pose estimation
 	_drawContourModel(randomPose);
-	m_pDistanceTransform->result().read(FGLDataFormat::RGBA, FGLDataType::Float, m_pDTImage);
-	size_t n = m_trainingCanvasSize.width() * m_trainingCanvasSize.height();
-	for (size_t i = 0; i < n; i++)
-		m_pDTImage[i].index = 0.0f;
-
+	m_pDistanceTransform->getResult(m_pDTImage);
 	m_pPoseDetector->detect(m_pDTImage);
 	size_t pc = m_pPoseDetector->poseCount();
 
@@ -287,15 +497,52 @@ void FTrainingEngine::testOnce(QTextStream& protocol)
 	protocol << "\n";
 }
 
+void FTrainingEngine::startClassificationCheck()
+{
+	if (!m_pDatabase)
+		return;
+
+	m_pDatabase->resetQuantizationCheck();
+	m_pDatabase->setQuantizationCheckEnabled(true);
+}
+
+QString FTrainingEngine::finishClassificationCheck()
+{
+	if (!m_pDatabase)
+		return QString();
+
+	m_pDatabase->setQuantizationCheckEnabled(false);
+	FContourDatabase::quantizationCheck_t check = m_pDatabase->quantizationCheck();
+	float n = (float)fMax(check.queryCount, (size_t)1);
+
+	return QString("Classification check: %1 patches, same best class: %2%, same candidates: %3%")
+		.arg(check.queryCount)
+		.arg(check.sameBestCount * 100.0f / n, 0, 'f', 2)
+		.arg(check.sameCandidatesCount * 100.0f / n, 0, 'f', 2);
+}
+
 void FTrainingEngine::setParameters(const FTrainingParameter& params)
 {
 	m_params = params;
 	updateView();
 }
 
+void FTrainingEngine::setRandomSeed(int seed)
+{
+	m_randomSeed = seed;
+	_resetRandom();
+}
+
+void FTrainingEngine::setCheckpointInterval(quint32 numRuns)
+{
+	m_checkpointInterval = numRuns;
+	if (m_pDatabase)
+		m_pDatabase->setJournalingEnabled(m_checkpointInterval > 0);
+}
+
 void FTrainingEngine::updateView()
 {
-	if (!m_pDatabase || !m_pDatabase->isValid())
+	if (!m_pView || !m_pDatabase || !m_pDatabase->isValid())
 		return;
 
 	m_glContext.makeCurrent();
@@ -320,7 +567,7 @@ void FTrainingEngine::updateView()
 	{
 		if (m_pSlotClass[i])
 		{
-			m_patch[i].drawToTexture(m_texTemplateView[i]);
+			m_pSlotPatch[i]->drawToTexture(m_texTemplateView[i]);
 			m_pSlotClass[i]->contourTemplate().drawToTexture(m_texTemplateView[i+8],
 				m_pSlotContour[i], &m_slotHomography[i]);
 
@@ -351,6 +598,11 @@ QString FTrainingEngine::databaseInfo() const
 	return info;
 }
 
+bool FTrainingEngine::hasDatabase() const
+{
+	return m_pDatabase && m_pDatabase->isValid();
+}
+
 // Public slots ---------------------------------------------------------------------------------------
 
 void FTrainingEngine::setParamCamPositionMin(FVector3d val)
@@ -417,8 +669,61 @@ void FTrainingEngine::setParamWarpErrorThreshold(double val)
 	F_CONSOLE("Warp mean square error threshold: " << val);
 }
 
+void FTrainingEngine::setParamFitCandidates(int index)
+{
+	// options: all, 4, 8, 16, 32
+	m_fitCandidateCount = (index > 0) ? ((size_t)2 << index) : 0;
+	if (m_pDatabase)
+		m_pDatabase->setFitCandidateCount(m_fitCandidateCount);
+
+	F_CONSOLE("Fit candidates per insertion: " << m_fitCandidateCount);
+}
+
+void FTrainingEngine::setParamEarlyExit(bool val)
+{
+	m_earlyExitEnabled = val;
+	if (m_pDatabase)
+		m_pDatabase->setEarlyExitEnabled(val);
+
+	F_CONSOLE("Early exit fitting: " << val);
+}
+
+void FTrainingEngine::setParamBatchSize(int index)
+{
+	// options: off, 8, 16, 32, 64
+	m_batchSize = (index > 0) ? ((size_t)4 << index) : 1;
+	F_CONSOLE("Training batch size: " << m_batchSize);
+}
+
+void FTrainingEngine::setParamWorkerCount(int index)
+{
+	// options: auto, 1 - 8
+	m_workerPool.setWorkerCount((size_t)index);
+	m_renderPool.setWorkerCount((size_t)index);
+	F_CONSOLE("Training worker threads: " << m_workerPool.workerCount());
+}
+
+void FTrainingEngine::setParamCheckpointInterval(int index)
+{
+	// options: off, 100, 1000, 10000 runs
+	quint32 numRuns = 0;
+	for (int i = 0; i < index; i++)
+		numRuns = numRuns ? numRuns * 10 : 100;
+
+	setCheckpointInterval(numRuns);
+
+	F_CONSOLE("Training checkpoint interval: " << m_checkpointInterval);
+}
+
 // Internal functions ---------------------------------------------------------------------------------
 
+void FTrainingEngine::_resetRandom()
+{
+	m_randGen = FRandom();
+	if (m_randomSeed >= 0)
+		m_randGen.setSeed(m_randomSeed);
+}
+
 void FTrainingEngine::_generatePose(FCameraPose& cameraPose)
 {
 	if (m_trainingRun <= 1)
@@ -447,7 +752,7 @@ void FTrainingEngine::_generatePose(FCameraPose& cameraPose)
 		m_pStatistics->currentPose = cameraPose;
 }
 
-void FTrainingEngine::_drawContourModel(const FCameraPose& cameraPose)
+void FTrainingEngine::_drawContourModel(const FCameraPose& cameraPose, FDTPixel* pResult /* = NULL */)
 {
 	if (!m_pModel)
 		return;
@@ -458,6 +763,14 @@ void FTrainingEngine::_drawContourModel(const FCameraPose& cameraPose)
 	m_cameraMetrics.getGLProjectionMatrix(matProjGL);
 
 	matProjGL *= matMV;
+
+	if (!m_pView)
+	{
+		m_pModel->rasterize(matProjGL, m_trainingCanvasSize, &m_seedImage[0]);
+		m_pDistanceTransformCPU->calculateDt(&m_seedImage[0], pResult ? pResult : &m_dtImage[0]);
+		return;
+	}
+
 	matProjGL.transpose(); // OpenGL needs a column-major matrix layout
 	m_bufTransform.write(matProjGL.ptr(), 16 * sizeof(float));
 
@@ -471,6 +784,9 @@ void FTrainingEngine::_drawContourModel(const FCameraPose& cameraPose)
 	m_pModel->draw();
 
 	m_pDistanceTransform->calculateDt(m_texContour);
+
+	if (pResult)
+		m_pDistanceTransform->result().read(FGLDataFormat::RGBA, FGLDataType::Float, pResult);
 }
 
 void FTrainingEngine::_processContours(const FCameraPose& cameraPose)
@@ -478,7 +794,11 @@ void FTrainingEngine::_processContours(const FCameraPose& cameraPose)
 	for (size_t i = 0; i < FGlobalConstants::MAX_TEMPLATES; i++)
 		m_pSlotClass[i] = NULL;
 
-	m_pContourFinder->findContoursTraining(m_pDistanceTransform->result(), *m_pModel);
+	if (m_pView)
+		m_pContourFinder->findContoursTraining(m_pDistanceTransform->result());
+	else
+		m_pContourFinder->findContoursTraining(&m_dtImage[0]);
+
 	quint32 numContours = m_pContourFinder->contourCount();
 
 	for (quint32 i = 0; i < numContours; i++)
@@ -495,31 +815,127 @@ void FTrainingEngine::_processContours(const FCameraPose& cameraPose)
 
 			if (tId < MAX_DISPLAY_SLOTS)
 			{
+				m_pSlotPatch[tId] = &m_patch[tId];
 				m_pSlotClass[tId] = m_pDatabase->lastClass();
 				m_slotHomography[tId] = m_pDatabase->lastHomography();
 				m_pSlotContour[tId] = pContour;
 			}
 
-			if (m_pStatistics)
-			{
-				m_pStatistics->contour[tId].isPresent = true;
-				m_pStatistics->contour[tId].normalizationScale = pContour->scale();
-				m_pStatistics->contour[tId].normalizationAngle = pContour->rotationAngle();
-				m_pStatistics->contour[tId].isMatch = !inserted;
-				m_pStatistics->contour[tId].meanSquaredError = m_pDatabase->lastMeanSquaredError();
-				m_pStatistics->contour[tId].scaledMSE = m_pDatabase->lastScaledMSE();
-				m_pStatistics->contour[tId].fittingAccuracy = m_pDatabase->fittingAccuracy(tId);
-				m_pStatistics->contour[tId].poseAmbiguity = m_pDatabase->poseAmbiguity(tId);
-			}
+			_updateStatistics(tId, pContour, !inserted);
 		}
 	}
 }
 
+void FTrainingEngine::_extractSamples(size_t poseIndex)
+{
+	m_pBatchFinder->findContoursTraining(m_pBatchImage[poseIndex % 2]);
+	quint32 numContours = m_pBatchFinder->contourCount();
+
+	for (quint32 i = 0; i < numContours; i++)
+	{
+		const FContour* pContour = m_pBatchFinder->contourAt(i);
+		if (!pContour->isNormalized())
+			continue;
+
+		if (m_batchSampleCount == m_batchSamples.size())
+			m_batchSamples.push_back(new batchSample_t(m_patchSize));
+
+		// the sample keeps a copy of the contour, the finder is reused for the next pose
+		batchSample_t* pSample = m_batchSamples[m_batchSampleCount++];
+		pSample->contour = *pContour;
+		pSample->poseIndex = poseIndex;
+
+		if (pSample->patch.patchSize() != m_patchSize)
+			pSample->patch.setPatchSize(m_patchSize);
+
+		pSample->patch.warpImage(m_pBatchFinder->dtImage(), m_trainingCanvasSize.width(),
+			m_trainingCanvasSize.height(), &pSample->contour);
+
+		// the database does not change before the batch is merged
+		pSample->numSelected = m_batchClassCount[pSample->contour.index()];
+		m_pDatabase->selectCandidates(&pSample->contour, pSample->numSelected, pSample->candidates);
+	}
+}
+
+void FTrainingEngine::_fitSamples()
+{
+	// the candidates selected from the classes existing at batch start are fitted in parallel,
+	// the fits do not depend on each other because class templates never change
+	m_batchFits.clear();
+
+	for (size_t s = 0; s < m_batchSampleCount; s++)
+	{
+		for (size_t c = 0; c < m_batchSamples[s]->candidates.size(); c++)
+		{
+			batchFit_t fit;
+			fit.sampleIndex = s;
+			fit.candidateIndex = c;
+			m_batchFits.push_back(fit);
+		}
+	}
+
+	FFittingTask fittingTask(this);
+	m_workerPool.run(&fittingTask, m_batchFits.size());
+}
+
+void FTrainingEngine::_mergeSamples()
+{
+	for (size_t i = 0; i < FGlobalConstants::MAX_TEMPLATES; i++)
+		m_pSlotClass[i] = NULL;
+
+	size_t lastPose = m_batchPoses.size() - 1;
+
+	// insert in extraction order, the classes created within the batch are fitted here
+	for (size_t s = 0; s < m_batchSampleCount; s++)
+	{
+		batchSample_t* pSample = m_batchSamples[s];
+		const FContour* pContour = &pSample->contour;
+		size_t tId = pContour->index();
+
+		bool inserted = m_pDatabase->insertContourPose(pSample->patch, pContour,
+			m_batchPoses[pSample->poseIndex], pSample->candidates, pSample->numSelected);
+
+		// view and statistics show the last pose of the batch
+		if (pSample->poseIndex != lastPose)
+			continue;
+
+		if (tId < MAX_DISPLAY_SLOTS)
+		{
+			m_pSlotPatch[tId] = &pSample->patch;
+			m_pSlotClass[tId] = m_pDatabase->lastClass();
+			m_slotHomography[tId] = m_pDatabase->lastHomography();
+			m_pSlotContour[tId] = pContour;
+		}
+
+		_updateStatistics(tId, pContour, !inserted);
+	}
+}
+
+void FTrainingEngine::_updateStatistics(size_t tId, const FContour* pContour, bool isMatch)
+{
+	if (!m_pStatistics)
+		return;
+
+	m_pStatistics->contour[tId].isPresent = true;
+	m_pStatistics->contour[tId].normalizationScale = pContour->scale();
+	m_pStatistics->contour[tId].normalizationAngle = pContour->rotationAngle();
+	m_pStatistics->contour[tId].isMatch = isMatch;
+	m_pStatistics->contour[tId].meanSquaredError = m_pDatabase->lastMeanSquaredError();
+	m_pStatistics->contour[tId].scaledMSE = m_pDatabase->lastScaledMSE();
+	m_pStatistics->contour[tId].fittingAccuracy = m_pDatabase->fittingAccuracy(tId);
+	m_pStatistics->contour[tId].poseAmbiguity = m_pDatabase->poseAmbiguity(tId);
+	m_pStatistics->contour[tId].fitCount = m_pDatabase->lastFitCount();
+	m_pStatistics->contour[tId].skippedFitCount = m_pDatabase->lastSkippedFitCount();
+}
+
 void FTrainingEngine::_viewPose(int poseType)
 {
 	if (m_pDatabase)
 		m_pDatabase->setTrainingParameter(m_params);
 
+	if (!m_pView)
+		return;
+
 	FCameraPose pose;
 	
 	if (poseType == 1)
@@ -533,6 +949,13 @@ void FTrainingEngine::_viewPose(int poseType)
 	updateView();
 }
 
+void FTrainingEngine::_autoCheckpoint()
+{
+	if (m_checkpointInterval > 0 && !m_dataFilePath.isEmpty()
+		&& m_trainingRun - m_lastCheckpointRun >= m_checkpointInterval)
+		checkpointClassifierData();
+}
+
 void FTrainingEngine::_initGL()
 {
 	FGLContextSettings settings;
@@ -20,9 +20,11 @@
 #include "FContourPatch.h"
 #include "FTrainingStatistics.h"
 #include "FArchive.h"
+#include "FWorkerPool.h"
 
 class FContourModel;
 class FDistanceTransform;
+class FDistanceTransformCPU;
 class FContourFinder;
 class FContourDatabase;
 class FContourClass;
@@ -39,7 +41,9 @@ class FTrainingEngine : public QObject
 	//  Constructors and destructor --------------------------------------------
 
 public:
-	/// Default Constructor.
+	/// Constructor, the engine view is drawn to the given widget. If pView is NULL, the engine
+	/// runs without OpenGL: the contour model is rasterized and the distance transform is
+	/// calculated on the CPU, there is no view and testOnce() is not available.
 	FTrainingEngine(QWidget* pView, QObject* pParent = NULL);
 	/// Virtual destructor.
 	virtual ~FTrainingEngine();
@@ -56,16 +60,37 @@ public:
 	bool loadClassifierData(const QString& dataFilePath);
 	/// Saves the current training data.
 	bool saveClassifierData(const QString& dataFilePath);
+	/// Appends the changes since the last save or checkpoint to the journal of the data file
+	/// loaded or saved last, see FContourDatabase::checkpoint(). Called periodically during
+	/// training if a checkpoint interval is set.
+	bool checkpointClassifierData();
+	/// Converts a training data file to the current format.
+	bool convertClassifierData(const QString& sourceFilePath, const QString& targetFilePath);
 
 	/// Single run of the training engine. Draws a random pose and
 	/// incrementally trains the classifier.
 	void runOnce();
+	/// Runs the training engine for the given number of random poses. Rendering and contour
+	/// extraction are pipelined, the fitting of the contours to the existing classes is
+	/// distributed among the worker threads. The resulting database is the same as after
+	/// calling runOnce() numPoses times, independent of the number of workers.
+	void runBatch(size_t numPoses);
 	/// Single run of pose verifying test. Draws a random pose and
 	/// tests the estimation quality of the database.
 	void testOnce(QTextStream& protocol);
+	/// Starts comparing the classifications of the test runs with the exact log-probabilities
+	/// of the frequency counts, see FContourDatabase::setQuantizationCheckEnabled().
+	void startClassificationCheck();
+	/// Stops the comparison and returns a report of the classification agreement.
+	QString finishClassificationCheck();
 
 	/// Sets the parameters to be used for training.
 	void setParameters(const FTrainingParameter& params);
+	/// Sets the seed of the random poses, used whenever the random generator is reset, i.e. when
+	/// a contour model is loaded. If -1, the default sequence is used.
+	void setRandomSeed(int seed);
+	/// Sets the number of training runs between automatic checkpoints, 0 disables checkpoints.
+	void setCheckpointInterval(quint32 numRuns);
 
 	/// Redraws the OpenGL view area.
 	void updateView();
@@ -76,8 +101,14 @@ public:
 	const FTrainingParameter& parameters() const { return m_params; }
 	/// Returns the statistics of the last run.
 	const FTrainingStatistics* statistics() const { return m_pStatistics; }
+	/// Returns the number of poses per training step, 1 if batch training is off.
+	size_t batchSize() const { return m_batchSize; }
 	/// Returns an info dump about the database.
 	QString databaseInfo() const;
+	/// Returns true if a database is loaded and ready for training.
+	bool hasDatabase() const;
+	/// Returns true if the engine runs without OpenGL.
+	bool isHeadless() const { return m_pView == NULL; }
 
 	/// Returns the size of the training canvas.
 	const QSize& canvasSize() const { return m_trainingCanvasSize; }
@@ -100,6 +131,12 @@ public slots:
 	void setParamTemplateSize(int index);
 	void setParamPatchSize(int index);
 	void setParamWarpErrorThreshold(double val);
+	void setParamFitCandidates(int index);
+	void setParamEarlyExit(bool val);
+
+	void setParamBatchSize(int index);
+	void setParamWorkerCount(int index);
+	void setParamCheckpointInterval(int index);
 
 	//  Signals ----------------------------------------------------------------
 
@@ -108,13 +145,29 @@ signals:
 	void postStatistics(FTrainingStatistics statistics);
 	void postDatabaseInfo(QString info);
 
+	//  Internal types ---------------------------------------------------------
+
+private:
+	struct batchSample_t;
+	struct batchFit_t;
+	class FExtractionTask;
+	class FFittingTask;
+
 	//  Internal functions -----------------------------------------------------
 
 private:
+	void _resetRandom();
 	void _generatePose(FCameraPose& pose);
-	void _drawContourModel(const FCameraPose& pose);
+	/// Draws the contour model and calculates its distance transform. The float result is
+	/// copied to pResult if given; without OpenGL it is written to m_dtImage otherwise.
+	void _drawContourModel(const FCameraPose& pose, OUT FDTPixel* pResult = NULL);
 	void _processContours(const FCameraPose& pose);
+	void _extractSamples(size_t poseIndex);
+	void _fitSamples();
+	void _mergeSamples();
+	void _updateStatistics(size_t tId, const FContour* pContour, bool isMatch);
 	void _viewPose(int poseType);
+	void _autoCheckpoint();
 
 	void _initGL();
 
@@ -128,29 +181,55 @@ private:
 	QWidget* m_pView;
 
 	FRandom m_randGen;
+	int m_randomSeed;
 	const FContourModel* m_pModel;
 	FTrainingParameter m_params;
 	FCameraMetrics m_cameraMetrics;
 	FContourDatabase* m_pDatabase;
 	quint32 m_trainingRun;
 	float m_warpErrorThreshold;
+	size_t m_fitCandidateCount;
+	bool m_earlyExitEnabled;
 
 	FDistanceTransform* m_pDistanceTransform;
 	FContourFinder* m_pContourFinder;
 
+	// Training without OpenGL
+	FDistanceTransformCPU* m_pDistanceTransformCPU;
+	FWorkerPool m_renderPool;
+	std::vector<float> m_seedImage;
+	std::vector<FDTPixel> m_dtImage;
+
 	// Last used patch and class for viewing only
 	FContourPatch m_patch[FGlobalConstants::MAX_TEMPLATES];
 
 	static const size_t MAX_DISPLAY_SLOTS = 8;
+	FContourPatch* m_pSlotPatch[MAX_DISPLAY_SLOTS];
 	const FContourClass* m_pSlotClass[FGlobalConstants::MAX_TEMPLATES];
 	const FContour* m_pSlotContour[MAX_DISPLAY_SLOTS];
 	FMatrix3f m_slotHomography[MAX_DISPLAY_SLOTS];
 
 	FTrainingStatistics* m_pStatistics;
 
+	// Batch training
+	size_t m_batchSize;
+	FWorkerPool m_workerPool;
+	FContourFinder* m_pBatchFinder;
+	FDTPixel* m_pBatchImage[2];
+	std::vector<FCameraPose> m_batchPoses;
+	std::vector<batchSample_t*> m_batchSamples;
+	size_t m_batchSampleCount;
+	std::vector<batchFit_t> m_batchFits;
+	std::vector<size_t> m_batchClassCount;
+
+	// Checkpoints
+	QString m_dataFilePath;
+	quint32 m_checkpointInterval;
+	quint32 m_lastCheckpointRun;
+
 	// Quality measurement
 	FPoseDetector* m_pPoseDetector;
-	FDTPixel* m_pDTImage;
+	FDTPixelPacked* m_pDTImage;
 
 	// OpenGL
 
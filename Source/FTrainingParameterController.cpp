@@ -119,6 +119,42 @@ void FTrainingParameterController::_initialize()
 	pErrorThres->setDragSpeed(0.02f);
 	connect(pErrorThres, SIGNAL(scalarValueChanged(double, int)), m_pEngine,
 		SLOT(setParamWarpErrorThreshold(double)), Qt::DirectConnection);
+
+	FPTItemOption* pFitCandidates = new FPTItemOption("Fit Candidates", QStringList(), pGroupDatabase);
+	QStringList candidateOpts;
+	candidateOpts << "All" << "4" << "8" << "16" << "32";
+	pFitCandidates->setOptions(candidateOpts);
+	pFitCandidates->selectOption(2);
+	connect(pFitCandidates, SIGNAL(optionChanged(int, int)), m_pEngine,
+		SLOT(setParamFitCandidates(int)), Qt::DirectConnection);
+
+	FPTItemSwitch* pEarlyExit = new FPTItemSwitch("Early Exit", pGroupDatabase);
+	pEarlyExit->setState(true);
+	connect(pEarlyExit, SIGNAL(stateChanged(bool, int)), m_pEngine,
+		SLOT(setParamEarlyExit(bool)), Qt::DirectConnection);
+
+	FPTItemGroup* pGroupBatch = new FPTItemGroup("Batch Training", pGroupTraining, true);
+
+	FPTItemOption* pBatchSize = new FPTItemOption("Batch Size", QStringList(), pGroupBatch);
+	QStringList batchOpts;
+	batchOpts << "Off" << "8" << "16" << "32" << "64";
+	pBatchSize->setOptions(batchOpts);
+	connect(pBatchSize, SIGNAL(optionChanged(int, int)), m_pEngine,
+		SLOT(setParamBatchSize(int)), Qt::DirectConnection);
+
+	FPTItemOption* pWorkerCount = new FPTItemOption("Worker Threads", QStringList(), pGroupBatch);
+	QStringList workerOpts;
+	workerOpts << "Auto" << "1" << "2" << "3" << "4" << "5" << "6" << "7" << "8";
+	pWorkerCount->setOptions(workerOpts);
+	connect(pWorkerCount, SIGNAL(optionChanged(int, int)), m_pEngine,
+		SLOT(setParamWorkerCount(int)), Qt::DirectConnection);
+
+	FPTItemOption* pCheckpoint = new FPTItemOption("Checkpoint Interval", QStringList(), pGroupBatch);
+	QStringList checkpointOpts;
+	checkpointOpts << "Off" << "100" << "1000" << "10000";
+	pCheckpoint->setOptions(checkpointOpts);
+	connect(pCheckpoint, SIGNAL(optionChanged(int, int)), m_pEngine,
+		SLOT(setParamCheckpointInterval(int)), Qt::DirectConnection);
 }
 
 // ----------------------------------------------------------------------------------------------------
\ No newline at end of file
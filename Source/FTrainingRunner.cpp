@@ -0,0 +1,293 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FTrainingRunner.cpp
+//  Description		Implementation of class FTrainingRunner
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-10-02 11:24:36 +0200 (So, 02 Okt 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#include "FTrackMeStable.h"
+
+#include <QTextStream>
+#include "FTrainingEngine.h"
+#include "FPatchSizePreset.h"
+#include "FStopWatch.h"
+
+#include "FTrainingRunner.h"
+#include "FMemoryTracer.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FTrainingRunner
+// ----------------------------------------------------------------------------------------------------
+
+// Constructors and destructor ------------------------------------------------------------------------
+
+FTrainingRunner::FTrainingRunner()
+: m_numPoses(1000),
+  m_batchSize(32),
+  m_workerCount(0),
+  m_randomSeed(-1),
+  m_checkpointInterval(0),
+  m_templateSizeIndex(-1),
+  m_patchSizeIndex(-1),
+  m_focalLength(0.0)
+{
+	for (int i = 0; i < PoseLimitCount; i++)
+		m_hasPoseLimit[i] = false;
+}
+
+FTrainingRunner::~FTrainingRunner()
+{
+}
+
+// Public commands ------------------------------------------------------------------------------------
+
+int FTrainingRunner::run(const QStringList& arguments)
+{
+	QTextStream out(stdout);
+
+	if (!_parseArguments(arguments))
+	{
+		out << usage();
+		return 1;
+	}
+
+	FTrainingEngine engine(NULL);
+	engine.setParamWorkerCount(m_workerCount);
+	engine.setCheckpointInterval(m_checkpointInterval);
+
+	// sizes and focal length must be set before the database is created
+	if (m_templateSizeIndex >= 0)
+		engine.setParamTemplateSize(m_templateSizeIndex);
+	if (m_patchSizeIndex >= 0)
+		engine.setParamPatchSize(m_patchSizeIndex);
+	_applyParameters(engine);
+
+	if (!m_modelFilePath.isEmpty())
+		engine.loadContourModel(m_modelFilePath);
+	else
+		engine.loadClassifierData(m_databaseFilePath);
+
+	if (!engine.hasDatabase())
+	{
+		out << "Failed to load " << (m_modelFilePath.isEmpty() ? m_databaseFilePath : m_modelFilePath) << endl;
+		return 2;
+	}
+
+	// the seed is applied after loading, which resets the random generator
+	engine.setRandomSeed(m_randomSeed);
+	_applyParameters(engine);
+
+	// checkpoints are appended to the output file, which must exist
+	if (m_checkpointInterval > 0 && !engine.saveClassifierData(m_outputFilePath))
+	{
+		out << "Failed to save " << m_outputFilePath << endl;
+		return 2;
+	}
+
+	out << "Training " << m_numPoses << " poses, batch size " << m_batchSize << endl;
+
+	FStopWatch stopWatch;
+	double seconds = 0.0;
+	quint32 numRuns = 0;
+
+	while (numRuns < m_numPoses)
+	{
+		quint32 numBatch = fMin(m_batchSize, m_numPoses - numRuns);
+
+		stopWatch.start();
+		if (numBatch > 1)
+			engine.runBatch(numBatch);
+		else
+			engine.runOnce();
+		seconds += stopWatch.stop();
+
+		numRuns += numBatch;
+		_printProgress(engine, numRuns, seconds);
+	}
+
+	if (!engine.saveClassifierData(m_outputFilePath))
+	{
+		out << "Failed to save " << m_outputFilePath << endl;
+		return 2;
+	}
+
+	out << "Classifier data saved: " << m_outputFilePath << endl;
+	return 0;
+}
+
+// Public queries -------------------------------------------------------------------------------------
+
+bool FTrainingRunner::isRequested(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+		if (qstrcmp(argv[i], "--train") == 0)
+			return true;
+
+	return false;
+}
+
+QString FTrainingRunner::usage()
+{
+	return QString(
+		"Usage: TrackMe --train (--model <file> | --database <file>) --output <file> [options]\n"
+		"  --model <file>          contour model for a new database\n"
+		"  --database <file>       classifier data to continue training\n"
+		"  --output <file>         file the classifier data is saved to\n"
+		"  --poses <n>             number of random poses (1000)\n"
+		"  --batch <n>             poses per training step, 1 trains pose by pose (32)\n"
+		"  --workers <n>           number of worker threads, 0 for automatic (0)\n"
+		"  --seed <n>              seed of the random poses\n"
+		"  --checkpoint <n>        training runs between checkpoints of the output file\n"
+		"  --template-size <n>     template size of a new database: 32, 48, 64, 96, 128, 256\n"
+		"  --patch-size <n>        patch size of a new database: 32, 48, 64, 96, 128, 256\n"
+		"  --position-min <x,y,z>  minimum camera position\n"
+		"  --position-max <x,y,z>  maximum camera position\n"
+		"  --orbit-min <y,p,r>     minimum camera orbit in degrees\n"
+		"  --orbit-max <y,p,r>     maximum camera orbit in degrees\n"
+		"  --focal-length <mm>     camera focal length\n");
+}
+
+// Internal functions ---------------------------------------------------------------------------------
+
+bool FTrainingRunner::_parseArguments(const QStringList& arguments)
+{
+	QTextStream out(stdout);
+
+	for (int i = 1; i < arguments.size(); i++)
+	{
+		const QString& option = arguments[i];
+		if (option == "--train")
+			continue;
+
+		if (i + 1 >= arguments.size())
+		{
+			out << "Missing value: " << option << endl;
+			return false;
+		}
+
+		const QString& value = arguments[++i];
+		bool ok = true;
+
+		if (option == "--model")
+			m_modelFilePath = value;
+		else if (option == "--database")
+			m_databaseFilePath = value;
+		else if (option == "--output")
+			m_outputFilePath = value;
+		else if (option == "--poses")
+			m_numPoses = value.toUInt(&ok);
+		else if (option == "--batch")
+			m_batchSize = value.toUInt(&ok);
+		else if (option == "--workers")
+			m_workerCount = value.toInt(&ok);
+		else if (option == "--seed")
+			m_randomSeed = value.toInt(&ok);
+		else if (option == "--checkpoint")
+			m_checkpointInterval = value.toUInt(&ok);
+		else if (option == "--template-size")
+			ok = _parseSize(value, m_templateSizeIndex);
+		else if (option == "--patch-size")
+			ok = _parseSize(value, m_patchSizeIndex);
+		else if (option == "--position-min")
+			ok = m_hasPoseLimit[PositionMin] = _parseVector(value, m_poseLimit[PositionMin]);
+		else if (option == "--position-max")
+			ok = m_hasPoseLimit[PositionMax] = _parseVector(value, m_poseLimit[PositionMax]);
+		else if (option == "--orbit-min")
+			ok = m_hasPoseLimit[OrbitMin] = _parseVector(value, m_poseLimit[OrbitMin]);
+		else if (option == "--orbit-max")
+			ok = m_hasPoseLimit[OrbitMax] = _parseVector(value, m_poseLimit[OrbitMax]);
+		else if (option == "--focal-length")
+			m_focalLength = value.toDouble(&ok);
+		else
+		{
+			out << "Unknown option: " << option << endl;
+			return false;
+		}
+
+		if (!ok)
+		{
+			out << "Invalid value for " << option << ": " << value << endl;
+			return false;
+		}
+	}
+
+	if (m_modelFilePath.isEmpty() == m_databaseFilePath.isEmpty())
+	{
+		out << "Either a contour model or a database is required" << endl;
+		return false;
+	}
+
+	if (m_outputFilePath.isEmpty())
+	{
+		out << "An output file is required" << endl;
+		return false;
+	}
+
+	m_batchSize = fMax(m_batchSize, (quint32)1);
+	return true;
+}
+
+bool FTrainingRunner::_parseVector(const QString& text, FVector3f& result) const
+{
+	QStringList values = text.split(',');
+	if (values.size() != 3)
+		return false;
+
+	bool ok[3];
+	result.set(values[0].toFloat(&ok[0]), values[1].toFloat(&ok[1]), values[2].toFloat(&ok[2]));
+	return ok[0] && ok[1] && ok[2];
+}
+
+bool FTrainingRunner::_parseSize(const QString& text, int& presetIndex) const
+{
+	bool ok;
+	int width = text.toInt(&ok);
+
+	for (size_t i = 0; ok && i < FPatchSizePreset::size(); i++)
+	{
+		if (FPatchSizePreset((int)i).toSize().width() == width)
+		{
+			presetIndex = (int)i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void FTrainingRunner::_applyParameters(FTrainingEngine& engine) const
+{
+	FTrainingParameter params = engine.parameters();
+
+	if (m_hasPoseLimit[PositionMin])
+		params.posMin = m_poseLimit[PositionMin];
+	if (m_hasPoseLimit[PositionMax])
+		params.posMax = m_poseLimit[PositionMax];
+	if (m_hasPoseLimit[OrbitMin])
+		params.yprMin = m_poseLimit[OrbitMin];
+	if (m_hasPoseLimit[OrbitMax])
+		params.yprMax = m_poseLimit[OrbitMax];
+	if (m_focalLength > 0.0)
+		params.focalLength = (float)m_focalLength;
+
+	engine.setParameters(params);
+	engine.setParamCamFocalLength(params.focalLength);
+}
+
+void FTrainingRunner::_printProgress(const FTrainingEngine& engine, quint32 numRuns, double seconds) const
+{
+	const FTrainingStatistics* pStats = engine.statistics();
+	if (!pStats)
+		return;
+
+	// the run count includes the runs of a loaded database, the rate covers this session only
+	QTextStream out(stdout);
+	out << QString("Run %1: %2 classes, %3 samples, %4 fits (%5 skipped), %6 poses/s")
+		.arg(pStats->runCount).arg(pStats->totalClassCount).arg(pStats->totalSampleCount)
+		.arg(pStats->totalFitCount).arg(pStats->totalSkippedFitCount)
+		.arg(seconds > 0.0 ? numRuns / seconds : 0.0, 0, 'f', 1) << endl;
+}
+
+// ----------------------------------------------------------------------------------------------------
@@ -0,0 +1,99 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FTrainingRunner.h
+//  Description		Header file for FTrainingRunner.cpp
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-10-02 11:24:36 +0200 (So, 02 Okt 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#ifndef FTRAININGRUNNER_H
+#define FTRAININGRUNNER_H
+
+#include <QStringList>
+#include "FTrackMe.h"
+#include "FlowMath.h"
+
+class FTrainingEngine;
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FTrainingRunner
+// ----------------------------------------------------------------------------------------------------
+
+/// Offline training from the command line. Runs a FTrainingEngine without OpenGL for a given
+/// number of random poses and saves the resulting classifier data. Started with
+///   TrackMe --train (--model <file> | --database <file>) --output <file> [options]
+/// See usage() for the options. Progress is written to the standard output.
+class FTrainingRunner
+{
+	//  Constructors and destructor --------------------------------------------
+
+public:
+	/// Default Constructor.
+	FTrainingRunner();
+	/// Virtual destructor.
+	virtual ~FTrainingRunner();
+
+private:
+	FTrainingRunner(const FTrainingRunner& other);
+	FTrainingRunner& operator=(const FTrainingRunner& other);
+
+	//  Public commands --------------------------------------------------------
+
+public:
+	/// Parses the given command line arguments and runs the training.
+	/// Returns 0 on success, 1 for invalid arguments and 2 if the training failed.
+	int run(const QStringList& arguments);
+
+	//  Public queries ---------------------------------------------------------
+
+	/// Returns true if the command line requests offline training.
+	static bool isRequested(int argc, char* argv[]);
+	/// Returns the description of the command line options.
+	static QString usage();
+
+	//  Internal types ---------------------------------------------------------
+
+private:
+	enum poseLimit_t
+	{
+		PositionMin,
+		PositionMax,
+		OrbitMin,
+		OrbitMax,
+		PoseLimitCount
+	};
+
+	//  Internal functions -----------------------------------------------------
+
+private:
+	bool _parseArguments(const QStringList& arguments);
+	bool _parseVector(const QString& text, OUT FVector3f& result) const;
+	bool _parseSize(const QString& text, OUT int& presetIndex) const;
+	void _applyParameters(FTrainingEngine& engine) const;
+	void _printProgress(const FTrainingEngine& engine, quint32 numRuns, double seconds) const;
+
+	//  Internal data members --------------------------------------------------
+
+private:
+	QString m_modelFilePath;
+	QString m_databaseFilePath;
+	QString m_outputFilePath;
+
+	quint32 m_numPoses;
+	quint32 m_batchSize;
+	int m_workerCount;
+	int m_randomSeed;
+	quint32 m_checkpointInterval;
+	int m_templateSizeIndex;
+	int m_patchSizeIndex;
+
+	// pose range, only the given limits are applied
+	FVector3f m_poseLimit[PoseLimitCount];
+	bool m_hasPoseLimit[PoseLimitCount];
+	double m_focalLength;
+};
+
+// ----------------------------------------------------------------------------------------------------
+
+#endif // FTRAININGRUNNER_H
@@ -26,6 +26,7 @@ public:
 		for (size_t i = 0; i < MAX_CONTOURS; i++)
 			contour[i].clear();
 		runCount = totalClassCount = totalSampleCount = 0;
+		totalFitCount = totalSkippedFitCount = 0;
 	}
 
 	static const size_t MAX_CONTOURS = 64;
@@ -34,12 +35,14 @@ public:
 	{
 		contourInfo_t() : isPresent(false), isMatch(false),
 			meanSquaredError(0.0f), scaledMSE(0.0f), normalizationScale(1.0f, 1.0f),
-			normalizationAngle(0.0f), classCount(0), sampleCount(0) { }
+			normalizationAngle(0.0f), classCount(0), sampleCount(0),
+			fitCount(0), skippedFitCount(0) { }
 
 		void clear() { isPresent = isMatch = false;
 			meanSquaredError = scaledMSE = normalizationAngle = 0.0f;
 			normalizationScale.makeZero();
-			classCount = sampleCount = 0; }
+			classCount = sampleCount = 0;
+			fitCount = skippedFitCount = 0; }
 
 		bool isPresent;
 		bool isMatch;
@@ -52,6 +55,8 @@ public:
 		QString name;
 		quint32 classCount;
 		quint32 sampleCount;
+		quint32 fitCount;
+		quint32 skippedFitCount;
 	};
 
 	contourInfo_t contour[MAX_CONTOURS];
@@ -59,6 +64,8 @@ public:
 	quint32 runCount;
 	quint32 totalClassCount;
 	quint32 totalSampleCount;
+	quint32 totalFitCount;
+	quint32 totalSkippedFitCount;
 };
 	
 // ----------------------------------------------------------------------------------------------------
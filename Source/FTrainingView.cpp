@@ -81,7 +81,8 @@ void FTrainingTextView::paintEvent(QPaintEvent* pPaintEvent)
 			*/
 
 			painter.drawText(x, 60, QString("#Samples: %1").arg(info.sampleCount));
-			painter.drawText(x, 76, QString("#classes: %1").arg(info.classCount));
+			painter.drawText(x, 76, QString("#classes: %1, fits: %2")
+				.arg(info.classCount).arg(info.fitCount));
 		}
 		else
 		{
@@ -90,9 +91,10 @@ void FTrainingTextView::paintEvent(QPaintEvent* pPaintEvent)
 	}
 
 	painter.fillRect(2, 81, 1020, 14, QColor(64, 64, 64));
-	painter.drawText(4, 92, QString("Run: %1     Total Classes: %2     Total Samples: %3")
-		.arg(m_statistics.runCount).arg(m_statistics.totalClassCount).arg(m_statistics.totalSampleCount));
-	painter.drawText(350, 92, "FA: Fitting Accuracy, PA: Pose Ambiguity, E: Mean Squared Error, SE: Scaled MSE");
+	painter.drawText(4, 92, QString("Run: %1     Total Classes: %2     Total Samples: %3     Skipped Fits: %4 / %5")
+		.arg(m_statistics.runCount).arg(m_statistics.totalClassCount).arg(m_statistics.totalSampleCount)
+		.arg(m_statistics.totalSkippedFitCount).arg(m_statistics.totalFitCount + m_statistics.totalSkippedFitCount));
+	painter.drawText(560, 92, "FA: Fitting Accuracy, PA: Pose Ambiguity, E: Mean Squared Error, SE: Scaled MSE");
 }
 
 // ----------------------------------------------------------------------------------------------------
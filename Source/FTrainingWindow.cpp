@@ -86,6 +86,23 @@ void FTrainingWindow::onSaveData()
 	m_pTrainingEngine->saveClassifierData(filePath);
 }
 
+void FTrainingWindow::onConvertData()
+{
+	QString sourceFilePath = QFileDialog::getOpenFileName(
+		this, "Convert Training Data File", QString(), "TrackMe Training (*.tmt)");
+
+	if (sourceFilePath.isEmpty())
+		return;
+
+	QString targetFilePath = QFileDialog::getSaveFileName(
+		this, "Save Converted Training Data File", sourceFilePath, "TrackMe Training (*.tmt)");
+
+	if (targetFilePath.isEmpty())
+		return;
+
+	m_pTrainingEngine->convertClassifierData(sourceFilePath, targetFilePath);
+}
+
 void FTrainingWindow::onRunTraining()
 {
 	if (m_testRunning)
@@ -110,7 +127,7 @@ void FTrainingWindow::onTrainingStep()
 	if (m_testRunning)
 		return;
 
-	m_pTrainingEngine->runOnce();
+	_runTraining();
 	m_pTrainingEngine->updateView();
 }
 
@@ -126,10 +143,17 @@ void FTrainingWindow::onRunTest()
 		m_protocolFile.open(QIODevice::WriteOnly);
 		m_protocolStream.setDevice(&m_protocolFile);
 		m_testRun = 0;
+		m_pTrainingEngine->startClassificationCheck();
 	}
 	else
 	{
 		killTimer(m_testTimer);
+		QString report = m_pTrainingEngine->finishClassificationCheck();
+		if (!report.isEmpty())
+		{
+			m_protocolStream << "# " << report << "\n";
+			postMessage(report);
+		}
 		m_protocolStream.flush();
 		m_protocolFile.close();
 	}
@@ -183,7 +207,7 @@ void FTrainingWindow::timerEvent(QTimerEvent* pTimerEvent)
 {
 	if (pTimerEvent->timerId() == m_trainingTimer)
 	{
-		m_pTrainingEngine->runOnce();
+		_runTraining();
 		m_pTrainingEngine->updateView();
 	}
 	else if (pTimerEvent->timerId() == m_testTimer)
@@ -234,6 +258,7 @@ void FTrainingWindow::onCreateToolbar()
 	pToolBar->addSeparator();
 	pToolBar->addAction(QIcon(":/icons/document_open_16"), "Load Classifier Data", this, SLOT(onLoadData()));
 	pToolBar->addAction(QIcon(":/icons/document_save_16"), "Save Classifier Data", this, SLOT(onSaveData()));
+	pToolBar->addAction(QIcon(":/icons/document_16"), "Convert Classifier Data", this, SLOT(onConvertData()));
 
 	pToolBar->addSeparator();
 	m_pActionTraining = pToolBar->addAction(QIcon(":/icons/media_play_16"), "Start/Stop Training", this, SLOT(onRunTraining()));
@@ -250,4 +275,16 @@ void FTrainingWindow::onCreateToolbar()
 	pToolBar->addWidget(m_pLabelDatabaseInfo);
 }
 
+// Internal functions ---------------------------------------------------------------------------------
+
+void FTrainingWindow::_runTraining()
+{
+	size_t batchSize = m_pTrainingEngine->batchSize();
+
+	if (batchSize > 1)
+		m_pTrainingEngine->runBatch(batchSize);
+	else
+		m_pTrainingEngine->runOnce();
+}
+
 // ----------------------------------------------------------------------------------------------------
\ No newline at end of file
@@ -42,6 +42,7 @@ public:
 		void onLoadContourModel();
 		void onLoadData();
 		void onSaveData();
+		void onConvertData();
 		void onRunTraining();
 		void onTrainingStep();
 		void onRunTest();
@@ -60,6 +61,12 @@ protected:
 	virtual void onCreateDockWidgets(QMenu* pMenuView);
 	virtual void onCreateToolbar();
 
+	//  Internal functions -----------------------------------------------------
+
+private:
+	/// Trains a single pose or a batch of poses, depending on the engine's batch size.
+	void _runTraining();
+
 	//  Internal data members --------------------------------------------------
 
 private:
@@ -0,0 +1,199 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FWorkerPool.cpp
+//  Description		Implementation of class FWorkerPool
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-20 10:41:05 +0200 (Di, 20 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#include "FTrackMeStable.h"
+
+#include <QThread>
+
+#include "FWorkerPool.h"
+#include "FMemoryTracer.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FWorkerPool::FWorker
+// ----------------------------------------------------------------------------------------------------
+
+class FWorkerPool::FWorker : public QThread
+{
+public:
+	FWorker(FWorkerPool* pPool, size_t workerIndex, quint32 batchId)
+		: m_pPool(pPool), m_workerIndex(workerIndex), m_batchId(batchId) { }
+
+protected:
+	virtual void run() { m_pPool->_workerLoop(m_workerIndex, m_batchId); }
+
+private:
+	FWorkerPool* m_pPool;
+	size_t m_workerIndex;
+	quint32 m_batchId;
+};
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FWorkerPool
+// ----------------------------------------------------------------------------------------------------
+
+// Constructors and destructor ------------------------------------------------------------------------
+
+FWorkerPool::FWorkerPool(size_t workerCount /* = 0 */)
+: m_pTask(NULL),
+  m_taskCount(0),
+  m_nextTask(0),
+  m_busyWorkers(0),
+  m_batchId(0),
+  m_wantExit(false)
+{
+	setWorkerCount(workerCount);
+}
+
+FWorkerPool::~FWorkerPool()
+{
+	_stopWorkers();
+}
+
+// Public commands ------------------------------------------------------------------------------------
+
+void FWorkerPool::setWorkerCount(size_t workerCount)
+{
+	if (workerCount == 0)
+		workerCount = (size_t)fMax(1, QThread::idealThreadCount());
+
+	if (workerCount == this->workerCount())
+		return;
+
+	_stopWorkers();
+	_startWorkers(workerCount - 1);
+}
+
+void FWorkerPool::run(FWorkerTask* pTask, size_t taskCount)
+{
+	F_ASSERT(pTask);
+	if (taskCount == 0)
+		return;
+
+	if (m_workers.empty() || taskCount == 1)
+	{
+		for (size_t i = 0; i < taskCount; i++)
+			pTask->runTask(i, 0);
+		return;
+	}
+
+	start(pTask, taskCount);
+
+	// the calling thread is worker 0
+	_runTasks(0);
+
+	wait();
+}
+
+void FWorkerPool::start(FWorkerTask* pTask, size_t taskCount)
+{
+	F_ASSERT(pTask);
+	F_ASSERT(m_pTask == NULL);
+	if (taskCount == 0)
+		return;
+
+	if (m_workers.empty())
+	{
+		for (size_t i = 0; i < taskCount; i++)
+			pTask->runTask(i, 0);
+		return;
+	}
+
+	m_lock.lock();
+	m_pTask = pTask;
+	m_taskCount = taskCount;
+	m_nextTask = 0;
+	m_busyWorkers = m_workers.size();
+	m_batchId++;
+	m_batchAvailable.wakeAll();
+	m_lock.unlock();
+}
+
+void FWorkerPool::wait()
+{
+	m_lock.lock();
+	while (m_busyWorkers > 0)
+		m_batchFinished.wait(&m_lock);
+	m_pTask = NULL;
+	m_taskCount = 0;
+	m_lock.unlock();
+}
+
+// Internal functions ---------------------------------------------------------------------------------
+
+void FWorkerPool::_startWorkers(size_t threadCount)
+{
+	F_ASSERT(m_workers.empty());
+	m_wantExit = false;
+
+	for (size_t i = 0; i < threadCount; i++)
+	{
+		// the worker waits for batches issued after its creation
+		FWorker* pWorker = new FWorker(this, i + 1, m_batchId);
+		m_workers.push_back(pWorker);
+		pWorker->start();
+	}
+}
+
+void FWorkerPool::_stopWorkers()
+{
+	if (m_workers.empty())
+		return;
+
+	m_lock.lock();
+	m_wantExit = true;
+	m_batchAvailable.wakeAll();
+	m_lock.unlock();
+
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i]->wait(ULONG_MAX);
+		delete m_workers[i];
+	}
+
+	m_workers.clear();
+}
+
+void FWorkerPool::_workerLoop(size_t workerIndex, quint32 lastBatchId)
+{
+	m_lock.lock();
+
+	while (true)
+	{
+		while (!m_wantExit && m_batchId == lastBatchId)
+			m_batchAvailable.wait(&m_lock);
+
+		if (m_wantExit)
+			break;
+
+		lastBatchId = m_batchId;
+		m_lock.unlock();
+
+		_runTasks(workerIndex);
+
+		m_lock.lock();
+		if (--m_busyWorkers == 0)
+			m_batchFinished.wakeAll();
+	}
+
+	m_lock.unlock();
+}
+
+void FWorkerPool::_runTasks(size_t workerIndex)
+{
+	while (true)
+	{
+		size_t taskIndex = (size_t)m_nextTask.fetchAndAddOrdered(1);
+		if (taskIndex >= m_taskCount)
+			return;
+
+		m_pTask->runTask(taskIndex, workerIndex);
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------
@@ -0,0 +1,115 @@
+// ----------------------------------------------------------------------------------------------------
+//  Title			FWorkerPool.h
+//  Description		Header file for FWorkerPool.cpp
+// ----------------------------------------------------------------------------------------------------
+//  $Author: ralphw $
+//  $Revision: 1 $
+//  $Date: 2011-09-20 10:41:05 +0200 (Di, 20 Sep 2011) $
+// ----------------------------------------------------------------------------------------------------
+
+#ifndef FWORKERPOOL_H
+#define FWORKERPOOL_H
+
+#include <vector>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+
+#include "FTrackMe.h"
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FWorkerTask
+// ----------------------------------------------------------------------------------------------------
+
+/// Interface for a batch of independent tasks executed by FWorkerPool.
+class FWorkerTask
+{
+public:
+	/// Virtual destructor.
+	virtual ~FWorkerTask() { }
+
+	/// Executes the task with the given index. The worker index is in the range
+	/// [0, FWorkerPool::workerCount()) and can be used to address per-worker data.
+	virtual void runTask(size_t taskIndex, size_t workerIndex) = 0;
+};
+
+// ----------------------------------------------------------------------------------------------------
+//  Class FWorkerPool
+// ----------------------------------------------------------------------------------------------------
+
+/// Pool of persistent worker threads. A call to run() distributes a batch of tasks among
+/// the workers and the calling thread and returns when all tasks are done. Idle workers
+/// fetch the next pending task index from a shared counter, so expensive tasks do not stall
+/// the others. The order in which tasks complete is undefined; callers needing deterministic
+/// results should write per-task results and merge them after run() returns.
+class FWorkerPool
+{
+	//  Constructors and destructor --------------------------------------------
+
+public:
+	/// Creates a pool with the given number of workers, including the calling thread.
+	/// A count of 0 uses one worker per processor core.
+	FWorkerPool(size_t workerCount = 0);
+	/// Virtual destructor. Stops all worker threads.
+	virtual ~FWorkerPool();
+
+	//  Public commands --------------------------------------------------------
+
+public:
+	/// Changes the number of workers, including the calling thread. A count of 0 uses
+	/// one worker per processor core. Must not be called while run() is executing.
+	void setWorkerCount(size_t workerCount);
+
+	/// Executes the tasks [0, taskCount) of the given task object and blocks until
+	/// all of them are done. With a single worker the tasks run in order in the calling thread.
+	void run(FWorkerTask* pTask, size_t taskCount);
+
+	/// Starts executing the tasks [0, taskCount) in the worker threads and returns immediately,
+	/// the calling thread does not take part. Each start() must be followed by a call to wait()
+	/// before the next batch is issued. Without worker threads the tasks run before start() returns.
+	void start(FWorkerTask* pTask, size_t taskCount);
+	/// Blocks until all tasks issued with start() are done.
+	void wait();
+
+	//  Public queries ---------------------------------------------------------
+
+public:
+	/// Returns the number of workers, including the calling thread.
+	size_t workerCount() const { return m_workers.size() + 1; }
+
+	//  Internal types ---------------------------------------------------------
+
+private:
+	class FWorker;
+
+	//  Internal functions -----------------------------------------------------
+
+private:
+	FWorkerPool(const FWorkerPool&);
+	FWorkerPool& operator=(const FWorkerPool&);
+
+	void _startWorkers(size_t threadCount);
+	void _stopWorkers();
+	void _workerLoop(size_t workerIndex, quint32 lastBatchId);
+	void _runTasks(size_t workerIndex);
+
+	//  Internal data members --------------------------------------------------
+
+private:
+	std::vector<FWorker*> m_workers;
+
+	QMutex m_lock;
+	QWaitCondition m_batchAvailable;
+	QWaitCondition m_batchFinished;
+
+	FWorkerTask* m_pTask;
+	size_t m_taskCount;
+	QAtomicInt m_nextTask;
+	size_t m_busyWorkers;
+	quint32 m_batchId;
+	bool m_wantExit;
+};
+
+// ----------------------------------------------------------------------------------------------------
+
+#endif // FWORKERPOOL_H
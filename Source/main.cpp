@@ -10,12 +10,42 @@
 #include "FTrackMeStable.h"
 
 #include "FMainWindow.h"
+#include "FTrainingRunner.h"
+#include "FTrackingRunner.h"
 #include "FMemoryTracer.h"
 
 int main(int argc, char *argv[])
 {
 	MEMORY_TRACER_START;
 	int retCode = 0;
+
+	// offline training without a window
+	if (FTrainingRunner::isRequested(argc, argv))
+	{
+		QCoreApplication application(argc, argv);
+		application.setOrganizationName("ETH Zrich");
+		application.setApplicationName("TrackMe");
+		application.setApplicationVersion("0.1");
+
+		FTrainingRunner runner;
+		retCode = runner.run(application.arguments());
+	}
+	// batch tracking, on Windows the OpenGL context needs a window which is never shown
+	else if (FTrackingRunner::isRequested(argc, argv))
+	{
+#ifdef Q_OS_WIN
+		QApplication application(argc, argv);
+#else
+		QCoreApplication application(argc, argv);
+#endif
+		application.setOrganizationName("ETH Zrich");
+		application.setApplicationName("TrackMe");
+		application.setApplicationVersion("0.1");
+
+		FTrackingRunner runner;
+		retCode = runner.run(application.arguments());
+	}
+	else
 	{
 		QApplication application(argc, argv);
 		application.setOrganizationName("ETH Zrich");